@@ -261,14 +261,18 @@ int main(int argc,char *argv[])
     double start,stop;
 
     start=(double)clock()/CLOCKS_PER_SEC;
-    for (i=k2listproc.filecount=0;i<k2conv->k2files.n;i++)
-        {
-        k2listproc.outname=NULL;
-        k2listproc.bmp=NULL;
-        k2listproc.mode=K2PDFOPT_FILELIST_PROCESS_MODE_CONVERT_FILES;
-        k2pdfopt_proc_wildarg(k2settings,k2conv->k2files.file[i],&k2listproc);
-        willus_mem_free((double **)&k2listproc.outname,funcname);
-        }
+    /* v2.56:  -jobs converts several documents at once */
+    if (k2settings->jobs>1 && k2settings->preview_page==0 && !k2settings->info)
+        k2ctx_convert_files(k2settings,&k2conv->k2files);
+    else
+        for (i=k2listproc.filecount=0;i<k2conv->k2files.n;i++)
+            {
+            k2listproc.outname=NULL;
+            k2listproc.bmp=NULL;
+            k2listproc.mode=K2PDFOPT_FILELIST_PROCESS_MODE_CONVERT_FILES;
+            k2pdfopt_proc_wildarg(k2settings,k2conv->k2files.file[i],&k2listproc);
+            willus_mem_free((double **)&k2listproc.outname,funcname);
+            }
     stop=(double)clock()/CLOCKS_PER_SEC;
     k2sys_cpu_update(k2settings,start,stop);
     }
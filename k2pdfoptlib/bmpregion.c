@@ -26,6 +26,11 @@
 /*
 static void bmpregion_get_rowcount_assuming_text(int *rowcount,BMPREGION *region,TEXTROW *bbox);
 */
+static int *bmpregion_integral(BMPREGION *region);
+static void bmpregion_find_textrows_1(BMPREGION *region,K2PDFOPT_SETTINGS *k2settings,
+                                      int dynamic_aperture,
+                                      int remove_small_rows,double minrowgap,
+                                      int join_figure_captions);
 static void trim_to(int *count,int *i1,int i2,double gaplen,int dpi,double defect_size_pts);
 static int height2_calc(int *rc,int n);
 static void bmpregion_count_text_row_pixels(BMPREGION *region,int *gw,int *copt,int *ngaps,
@@ -45,6 +50,8 @@ int bmpregion_row_black_count(BMPREGION *region,int r0)
     unsigned char *p;
     int i,nc,c;
 
+    if (bmpregion_integral(region)!=NULL)
+        return(bmpregion_black_count(region,r0,region->c1,r0,region->c2));
     p=bmp_rowptr_from_top(region->bmp8,r0)+region->c1;
     nc=region->c2-region->c1+1;
     for (c=i=0;i<nc;i++,p++)
@@ -60,6 +67,8 @@ int bmpregion_col_black_count(BMPREGION *region,int c0)
     unsigned char *p;
     int i,nr,c,bw;
 
+    if (bmpregion_integral(region)!=NULL)
+        return(bmpregion_black_count(region,region->r1,c0,region->r2,c0));
     bw=bmp_bytewidth(region->bmp8);
     p=bmp_rowptr_from_top(region->bmp8,region->r1)+c0;
     nr=region->r2-region->r1+1;
@@ -70,6 +79,151 @@ int bmpregion_col_black_count(BMPREGION *region,int c0)
     }
 
 
+/*
+** v2.56:  Number of dark pixels (< region->bgcolor) in rows r1 to r2 and
+** columns c1 to c2 (inclusive) of region->bmp8.  The rectangle is clipped
+** to the bitmap.  O(1) if the region has an integral image.
+*/
+int bmpregion_black_count(BMPREGION *region,int r1,int c1,int r2,int c2)
+
+    {
+    int *count;
+    int i,j,c,w1;
+
+    if (r1<0)
+        r1=0;
+    if (c1<0)
+        c1=0;
+    if (r2>region->bmp8->height-1)
+        r2=region->bmp8->height-1;
+    if (c2>region->bmp8->width-1)
+        c2=region->bmp8->width-1;
+    if (r2<r1 || c2<c1)
+        return(0);
+    count=bmpregion_integral(region);
+    if (count!=NULL)
+        {
+        w1=region->bmp8->width+1;
+        return(count[(r2+1)*w1+c2+1] - count[r1*w1+c2+1] - count[(r2+1)*w1+c1] + count[r1*w1+c1]);
+        }
+    for (c=0,i=r1;i<=r2;i++)
+        {
+        unsigned char *p;
+
+        p=bmp_rowptr_from_top(region->bmp8,i)+c1;
+        for (j=c1;j<=c2;j++,p++)
+            if (p[0]<region->bgcolor)
+                c++;
+        }
+    return(c);
+    }
+
+
+/*
+** v2.56:  Give region (and all future copies of it) an integral image of its
+** bmp8 bitmap.  It is calculated the first time it is needed, i.e. after
+** the bitmap is finished.  Call bmpregion_integral_invalidate() whenever
+** the bitmap is changed or re-allocated after that.  (The data pointer can't
+** be relied on to detect a re-allocation, since bmp_alloc() re-uses pooled
+** buffers.)
+*/
+void bmpregion_integral_allocate(BMPREGION *region)
+
+    {
+    static char *funcname="bmpregion_integral_allocate";
+
+    bmpregion_integral_free(region);
+    willus_dmem_alloc_warn(48,(void **)&region->integral,sizeof(BMPINTEGRAL),funcname,10);
+    region->integral_allocated=1;
+    region->integral->bmp8=NULL;
+    region->integral->count=NULL;
+    region->integral->valid=0;
+    }
+
+
+void bmpregion_integral_free(BMPREGION *region)
+
+    {
+    static char *funcname="bmpregion_integral_free";
+
+    if (region->integral!=NULL && region->integral_allocated)
+        {
+        willus_mem_free((double **)&region->integral->count,funcname);
+        willus_dmem_free(48,(double **)&region->integral,funcname);
+        region->integral_allocated=0;
+        }
+    else
+        region->integral=NULL;
+    }
+
+
+void bmpregion_integral_invalidate(BMPREGION *region)
+
+    {
+    if (region->integral!=NULL)
+        region->integral->valid=0;
+    }
+
+
+/*
+** Returns the integral image counts for region->bmp8, calculating them if
+** necessary, or NULL if the region doesn't have one.  Regions that were
+** copied from the one that allocated the integral image but point to a
+** different bitmap don't use it.
+*/
+static int *bmpregion_integral(BMPREGION *region)
+
+    {
+    static char *funcname="bmpregion_integral";
+    BMPINTEGRAL *integral;
+    WILLUSBITMAP *bmp8;
+    int i,j,w1;
+
+    integral=region->integral;
+    bmp8=region->bmp8;
+    if (integral==NULL || integral->valid<0 || bmp8==NULL || bmp8->bpp!=8)
+        return(NULL);
+    if (integral->bmp8!=NULL && integral->bmp8!=bmp8)
+        return(NULL);
+    if (integral->valid && integral->data==bmp8->data && integral->width==bmp8->width
+                        && integral->height==bmp8->height && integral->bgcolor==region->bgcolor)
+        return(integral->count);
+    w1=bmp8->width+1;
+    willus_mem_free((double **)&integral->count,funcname);
+    if (!willus_mem_alloc((double **)&integral->count,(long)sizeof(int)*w1*(bmp8->height+1),
+                          funcname))
+        {
+        /* Not enough memory--count pixels the slow way */
+        integral->valid=-1;
+        return(NULL);
+        }
+    integral->bmp8=bmp8;
+    integral->data=bmp8->data;
+    integral->width=bmp8->width;
+    integral->height=bmp8->height;
+    integral->bgcolor=region->bgcolor;
+    memset(integral->count,0,sizeof(int)*w1);
+    for (i=0;i<bmp8->height;i++)
+        {
+        unsigned char *p;
+        int *cp,*cp0,rowsum;
+
+        p=bmp_rowptr_from_top(bmp8,i);
+        cp0=&integral->count[i*w1];
+        cp=&cp0[w1];
+        cp[0]=0;
+        for (rowsum=0,j=0;j<bmp8->width;j++)
+            {
+            if (p[j]<region->bgcolor)
+                rowsum++;
+            cp[j+1]=cp0[j+1]+rowsum;
+            }
+        }
+    integral->valid=1;
+    return(integral->count);
+    }
+
+
 // #if (defined(WILLUSDEBUGX) || defined(WILLUSDEBUG))
 void bmpregion_write(BMPREGION *region,char *filename)
 
@@ -153,37 +307,25 @@ void bmpregion_row_histogram(BMPREGION *region)
 ** Return 0 if there are dark pixels in the region.  NZ otherwise.
 */
 int bmpregion_is_clear(BMPREGION *region,int *row_black_count,int *col_black_count,
-                       int *col_pix_count,int rpc,double gt_in)
+                       double gt_in)
 
     {
     int nr,nc,r,c,pt,mindim;
 
 #if (WILLUSDEBUGX & 128)
-printf("@bmpregion_is_clear(rpc=%d, gt_in=%g), region->dpi=%d\n",rpc,gt_in,region->dpi);
+printf("@bmpregion_is_clear(gt_in=%g), region->dpi=%d\n",gt_in,region->dpi);
 #endif
     pt=(int)(gt_in*region->dpi*(region->c2-region->c1+1)+.5);
     if (pt<0)
         pt=0;
     /*
-    ** Fast way to count dark pixels, but requires big array
+    ** Fast way to count dark pixels (v2.56:  integral image)
     */
-    if (col_pix_count!=NULL && rpc>0)
+    if (bmpregion_integral(region)!=NULL)
         {
-        int i;
-        if (region->r1>0)
-            for (c=0,i=region->c1;i<=region->c2;i++)
-                {
-                c += col_pix_count[i*rpc+region->r2] - col_pix_count[i*rpc+(region->r1-1)];
-                if (c>pt)
-                    return(0);
-                }
-        else
-            for (c=0,i=region->c1;i<=region->c2;i++)
-                {
-                c += col_pix_count[i*rpc+region->r2];
-                if (c>pt)
-                    return(0);
-                }
+        c=bmpregion_black_count(region,region->r1,region->c1,region->r2,region->c2);
+        if (c>pt)
+            return(0);
         return(pt<=0 ? 1 : 1+(int)10*c/pt);
         }
         
@@ -357,6 +499,8 @@ void bmpregion_init(BMPREGION *region)
     region->wrectmaps=NULL;
     region->k2pagebreakmarks=NULL;
     region->k2pagebreakmarks_allocated=0;
+    region->integral=NULL;
+    region->integral_allocated=0;
     }
 
 
@@ -394,6 +538,7 @@ void bmpregion_free(BMPREGION *region)
     static char *funcname="bmpregion_free";
 
     bmpregion_k2pagebreakmarks_free(region);
+    bmpregion_integral_free(region);
     willus_dmem_free(11,(double **)&region->rowcount,funcname);
     willus_dmem_free(10,(double **)&region->colcount,funcname);
     textrows_free(&region->textrows);
@@ -425,6 +570,7 @@ printf("a1=%g, a2=%g, a2/a1=%g\n",a1,a2,a2/a1);
 
 /*
 ** Doesn't copy the colcount / rowcount pointers--those get NULLed.
+** The integral image is shared (but only freed with src).
 */
 void bmpregion_copy(BMPREGION *dst,BMPREGION *src,int copy_text_rows)
 
@@ -435,6 +581,7 @@ void bmpregion_copy(BMPREGION *dst,BMPREGION *src,int copy_text_rows)
     dtr=dst->textrows;
     (*dst)=(*src);
     dst->k2pagebreakmarks_allocated=0;
+    dst->integral_allocated=0;
     dst->textrows=dtr;
     textrows_clear(&dst->textrows);
     if (copy_text_rows)
@@ -523,17 +670,25 @@ exit(10);
 
     memset(colcount,0,(bbox->c2+1)*sizeof(int));
     memset(rowcount,0,(bbox->r2+1)*sizeof(int));
-    for (j=bbox->r1;j<=bbox->r2;j++)
+    if (bmpregion_integral(region)!=NULL)
         {
-        unsigned char *p;
-        p=bmp_rowptr_from_top(region->bmp8,j)+bbox->c1;
-        for (i=0;i<n;i++,p++)
-            if (p[0]<region->bgcolor)
-                {
-                rowcount[j]++;
-                colcount[i+bbox->c1]++;
-                }
+        for (j=bbox->r1;j<=bbox->r2;j++)
+            rowcount[j]=bmpregion_black_count(region,j,bbox->c1,j,bbox->c2);
+        for (i=bbox->c1;i<=bbox->c2;i++)
+            colcount[i]=bmpregion_black_count(region,bbox->r1,i,bbox->r2,i);
         }
+    else
+        for (j=bbox->r1;j<=bbox->r2;j++)
+            {
+            unsigned char *p;
+            p=bmp_rowptr_from_top(region->bmp8,j)+bbox->c1;
+            for (i=0;i<n;i++,p++)
+                if (p[0]<region->bgcolor)
+                    {
+                    rowcount[j]++;
+                    colcount[i+bbox->c1]++;
+                    }
+            }
 #if (WILLUSDEBUGX & 0x2)
 {
 if (region->rowcount!=NULL && region->r1>6690 && region->r1<6800)
@@ -1289,6 +1444,22 @@ void bmpregion_find_textrows(BMPREGION *region,K2PDFOPT_SETTINGS *k2settings,
                              int remove_small_rows,double minrowgap,
                              int join_figure_captions)
 
+    {
+    WPROFILETIMER timer;
+
+    /* v2.56:  -profile */
+    wprofile_start(&timer);
+    bmpregion_find_textrows_1(region,k2settings,dynamic_aperture,remove_small_rows,minrowgap,
+                              join_figure_captions);
+    wprofile_stop(&timer,"textrows",0.);
+    }
+
+
+static void bmpregion_find_textrows_1(BMPREGION *region,K2PDFOPT_SETTINGS *k2settings,
+                                      int dynamic_aperture,
+                                      int remove_small_rows,double minrowgap,
+                                      int join_figure_captions)
+
     {
     static char *funcname="bmpregion_find_textrows";
     int nr,i,brc,brcmin,dtrc,trc,figrow,labelrow;
@@ -1936,7 +2107,7 @@ printf("    Subdivided:  New len = %d pixels, multiplier=%g.\n",c2-c1+1,multipli
         {
         double median_gap;
         textwords_add_word_gaps(add_to_dbase ? textwords : NULL,lcheight,&median_gap,
-                                (double)gap_thresh/dr);
+                                (double)gap_thresh/dr,k2settings);
         textwords_remove_small_col_gaps(textwords,lcheight,median_gap/1.9,(double)gap_thresh/dr);
         }
 
@@ -2422,6 +2593,7 @@ void bmpregion_whiteout(BMPREGION *dstregion,BMPREGION *croppedregion)
         bmp_draw_filled_rect(dstregion->bmp8,croppedregion->c1,croppedregion->r1,
                                              croppedregion->c2,croppedregion->r2,
                                              255,255,255);
+    bmpregion_integral_invalidate(dstregion);
     }
 
 
@@ -21,6 +21,7 @@
 */
 
 #include "k2pdfopt.h"
+#include <sys/stat.h>
 
 static int inflection_count(double *x,int n,int delta,int *wthresh);
 static int vert_line_erase(WILLUSBITMAP *bmp,WILLUSBITMAP *cbmp,WILLUSBITMAP *tmp,
@@ -37,6 +38,9 @@ static void bmp_autocrop_refine(WILLUSBITMAP *bmp,int whitethresh,double thresho
 static double find_threshold(double *x,double *y,int n,double threshold);
 static void xsmooth(double *y,int n,int cwin);
 static double frame_area(double area,int *cx);
+static int bmp_get_one_document_page_1(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
+                                       int src_type,char *filename,
+                                       int pageno,double dpi,int bpp,FILE *out);
 static void bmp_convert_to_monochrome(WILLUSBITMAP *bmp,int whitethresh);
 static double frame_stdev_norm(WILLUSBITMAP *bmp,int *cx,int flags);
 static double frame_black_percentage(WILLUSBITMAP *bmp,int *cx,int flags);
@@ -50,6 +54,96 @@ int bmp_get_one_document_page(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
                               int src_type,char *filename,
                               int pageno,double dpi,int bpp,FILE *out)
 
+    {
+    WPROFILETIMER timer;
+    char key[MAXFILENAMELEN+128];
+    int status;
+
+    /* v2.56:  Already rendered? */
+    if (bmp_get_cached_document_page(src,k2settings,src_type,filename,pageno,dpi,bpp))
+        return(0);
+    /* v2.56:  -profile */
+    wprofile_start(&timer);
+    status=bmp_get_one_document_page_1(src,k2settings,src_type,filename,pageno,dpi,bpp,out);
+    wprofile_stop(&timer,"rasterize",status<0 ? 0. : (double)bmp_bytewidth(src)*src->height);
+    /* Key after rendering, in case MuPDF failed and Ghostscript was used instead */
+    if (!status && k2bmp_page_cache_key(key,src_type,filename,pageno,dpi,bpp,
+                                        k2settings->usegs,k2settings->document_scale_factor))
+        bmpcache_put(src,key);
+    return(status);
+    }
+
+
+/*
+** v2.56:  If page pageno of filename has already been rendered at dpi and bpp
+** (and is still in the -rc cache), put it in src and return 1.  Otherwise
+** return 0.
+*/
+int bmp_get_cached_document_page(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
+                                 int src_type,char *filename,int pageno,double dpi,int bpp)
+
+    {
+    char key[MAXFILENAMELEN+128];
+
+    if (!k2bmp_page_cache_key(key,src_type,filename,pageno,dpi,bpp,
+                              k2settings->usegs,k2settings->document_scale_factor))
+        return(0);
+    return(bmpcache_get(src,key));
+    }
+
+
+/*
+** v2.56:  Rendered-page cache key:  the source file (name, size, and mod time),
+** page number, bits per pixel, renderer, and the resolution that the
+** renderer is asked for (dpi x scale for MuPDF and DjVuLibre, dpi for
+** Ghostscript, and none for bitmap files).  key must have room for
+** MAXFILENAMELEN+128 chars.  Returns 0 if the page cannot be cached.
+** Called from page-rendering threads, so stat() is used directly rather
+** than wfile_date() (localtime() is not thread safe).
+*/
+int k2bmp_page_cache_key(char *key,int src_type,char *filename,int pageno,double dpi,int bpp,
+                         int usegs,double scale)
+
+    {
+    struct stat fs;
+    int renderer;
+
+    if (strlen(filename)>=MAXFILENAMELEN || stat(filename,&fs))
+        return(0);
+    if (src_type==SRC_TYPE_PDF || src_type==SRC_TYPE_PS || src_type==SRC_TYPE_CBZ)
+        {
+        renderer='g';
+#ifdef HAVE_MUPDF_LIB
+        if (src_type==SRC_TYPE_CBZ || (src_type==SRC_TYPE_PDF && usegs<=0))
+            {
+            renderer='m';
+            dpi *= scale;
+            }
+#endif
+        }
+#ifdef HAVE_DJVU_LIB
+    else if (src_type==SRC_TYPE_DJVU)
+        {
+        renderer='d';
+        dpi *= scale;
+        }
+#endif
+    else
+        {
+        renderer='b';
+        dpi=0.;
+        pageno=0;
+        }
+    sprintf(key,"%s|%.0f|%.0f|%c|%d|%.3f|%d",
+            filename,(double)fs.st_size,(double)fs.st_mtime,renderer,pageno,dpi,bpp);
+    return(1);
+    }
+
+
+static int bmp_get_one_document_page_1(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
+                                       int src_type,char *filename,
+                                       int pageno,double dpi,int bpp,FILE *out)
+
     {
     int status;
 
@@ -88,14 +182,19 @@ return(status);
             exit(20);
             }
 #endif
-        bmp_set_pdf_pageno(pageno);
-        bmp_set_pdf_dpi(dpi);
         /*
         k2printf("Converting " TTEXT_BOLD2 "%s" TTEXT_NORMAL 
             " page %2d to %d dpi bitmap ... ",filename,i,dpi);
         fflush(stdout);
         */
+#ifdef HAVE_GHOSTSCRIPT
+        /* v2.56:  Not through bmp_read() and its page/dpi globals (-jobs) */
+        status=willusgs_read_pdf_or_ps_bmp(src,filename,pageno,dpi,NULL);
+#else
+        bmp_set_pdf_pageno(pageno);
+        bmp_set_pdf_dpi(dpi);
         status=bmp_read(src,filename,NULL);
+#endif
         if (!status && bpp==8)
             bmp_convert_to_greyscale(src);
         return(status);
@@ -464,12 +563,9 @@ static int inflection_count(double *x,int n,int delta,int *wthresh)
     int i,i0,ni,ww,c,ct,wt,mode;
     double meandi,meandisq,f1,f2,stdev;
     double *xs;
-    static int *hist;
+    int hist[256]; /* v2.56:  Was static--shared by -jobs threads */
     static char *funcname="inflection_count";
 
-    /* Allocate memory for hist[] array rather than using static array */
-    /* v2.13 fix */
-    willus_dmem_alloc_warn(34,(void **)&hist,sizeof(int)*256,funcname,10);
     /* Find threshold white value that peaks must exceed */
     if ((*wthresh)<0)
         {
@@ -501,7 +597,6 @@ k2printf("wt=%d\n",wt);
         }
     else
         wt=(*wthresh);
-    willus_dmem_free(34,(double **)&hist,funcname);
     ww=n/150;
     if (ww<1)
         ww=1;
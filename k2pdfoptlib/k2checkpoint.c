@@ -0,0 +1,559 @@
+/*
+** k2checkpoint.c   Preview checkpoints:  copies of the layout state (master
+**                  bitmap, wrap bitmap, queued pages, last row, working
+**                  settings) taken at source-page boundaries during a
+**                  preview, so that the next preview of the same document
+**                  with the same settings can start from the last source
+**                  page before the requested output page instead of from
+**                  source page 1.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+
+#include "k2pdfopt.h"
+
+/*
+** The checkpoints are kept (in memory) in the K2CONTEXT and are keyed by a
+** hash of the source file (name, size, date), the rotation, and the
+** settings that affect the layout (see k2checkpoint_hash_settings()).  Any
+** change to the key throws the checkpoints away.
+**
+** At most K2CHECKPOINT_MAX checkpoints are kept.  When they run out, every
+** other one is dropped and the spacing between checkpoints is doubled.
+*/
+#define K2CHECKPOINT_MAX 32
+
+typedef struct
+    {
+    int index;          /* Source page index (in the -p page list) just completed */
+    int pages_done;
+    K2PDFOPT_SETTINGS k2settings; /* Working settings (device size can change per page) */
+    MASTERINFO masterinfo;        /* Only the layout fields--see masterinfo_layout_copy() */
+    int mark_page_count;
+    int word_gap_count;
+    double word_gap[1024];
+    int last_ncols;
+    double last_region_width_inches;
+    int last_source_page;
+    int last_region_r2;
+    int last_page_height;
+    int last_notes_type;
+    } K2CHECKPOINT;
+
+typedef struct
+    {
+    unsigned long long key;
+    int active;         /* Checkpoints are being used for the current preview */
+    int interval;       /* Save a checkpoint every interval source pages */
+    K2CHECKPOINT *cp;   /* [K2CHECKPOINT_MAX], in order of index */
+    int n;
+    } K2CHECKPOINTS;
+
+static K2CHECKPOINTS *k2checkpoints_get(K2CONTEXT *k2ctx);
+static void k2checkpoints_clear(K2CHECKPOINTS *k2cps);
+static unsigned long long k2checkpoint_key(K2PDFOPT_SETTINGS *k2settings0,char *filename,
+                                           double rot_deg);
+static unsigned long long k2checkpoint_hash(unsigned long long hash,void *data,int n);
+static unsigned long long k2checkpoint_hash_string(unsigned long long hash,char *s);
+static unsigned long long k2checkpoint_hash_settings(unsigned long long hash,
+                                                     K2PDFOPT_SETTINGS *k2settings);
+static unsigned long long k2checkpoint_hash_cropbox(unsigned long long hash,K2CROPBOX *box);
+static int  k2checkpoint_usable(K2PDFOPT_SETTINGS *k2settings);
+static void k2checkpoint_init(K2CHECKPOINT *cp,int color);
+static void k2checkpoint_free(K2CHECKPOINT *cp);
+static void masterinfo_layout_copy(MASTERINFO *dst,MASTERINFO *src,int use_crop_boxes);
+
+
+/*
+** Called at the start of a preview conversion of filename, after masterinfo
+** has been initialized for the document.  If there is a checkpoint for the
+** same document and settings that is before the preview page, the layout
+** state is restored from it.
+**
+** Returns the index of the source page to continue with, or -1 to start at
+** the beginning (with the cover image).
+*/
+int k2checkpoint_resume(K2PDFOPT_SETTINGS *k2settings0,char *filename,double rot_deg,
+                        MASTERINFO *masterinfo,int *pages_done)
+
+    {
+    K2CONTEXT *k2ctx;
+    K2CHECKPOINTS *k2cps;
+    K2CHECKPOINT *cp;
+    unsigned long long key;
+    int i;
+
+    k2ctx=k2ctx_get(k2settings0);
+    k2cps=k2checkpoints_get(k2ctx);
+    k2cps->active=k2checkpoint_usable(&k2ctx->k2settings);
+    if (!k2cps->active)
+        return(-1);
+    key=k2checkpoint_key(k2settings0,filename,rot_deg);
+    if (key!=k2cps->key)
+        {
+        k2checkpoints_clear(k2cps);
+        k2cps->key=key;
+        return(-1);
+        }
+    for (i=k2cps->n-1;i>=0;i--)
+        if (k2cps->cp[i].masterinfo.published_pages < abs(k2settings0->preview_page))
+            break;
+    if (i<0)
+        return(-1);
+    cp=&k2cps->cp[i];
+    k2pdfopt_settings_copy(&k2ctx->k2settings,&cp->k2settings);
+    k2ctx->k2settings.preview_page=k2settings0->preview_page;
+    k2ctx->k2settings.ctx=k2settings0->ctx;
+    masterinfo_layout_copy(masterinfo,&cp->masterinfo,cp->k2settings.use_crop_boxes);
+    k2ctx->mark_page_count=cp->mark_page_count;
+    k2ctx->word_gap_count=cp->word_gap_count;
+    memcpy(k2ctx->word_gap,cp->word_gap,sizeof(k2ctx->word_gap));
+    k2ctx->last_ncols=cp->last_ncols;
+    k2ctx->last_region_width_inches=cp->last_region_width_inches;
+    k2ctx->last_source_page=cp->last_source_page;
+    k2ctx->last_region_r2=cp->last_region_r2;
+    k2ctx->last_page_height=cp->last_page_height;
+    k2ctx->last_notes_type=cp->last_notes_type;
+    (*pages_done)=cp->pages_done;
+    return(cp->index+1);
+    }
+
+
+/*
+** Called after source page index (index into the -p page list) has been
+** laid out and published.  Saves a checkpoint if checkpoints are active
+** for this preview and one is due.
+*/
+void k2checkpoint_save(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,int index,
+                       int pages_done)
+
+    {
+    K2CONTEXT *k2ctx;
+    K2CHECKPOINTS *k2cps;
+    K2CHECKPOINT *cp;
+
+    k2ctx=k2ctx_get(k2settings);
+    k2cps=k2checkpoints_get(k2ctx);
+    /* Pages left in the queue after the preview page was captured aren't reproducible */
+    if (!k2cps->active || index<0 || masterinfo->preview_captured)
+        return;
+    if ((index+1)%k2cps->interval!=0 || (k2cps->n>0 && k2cps->cp[k2cps->n-1].index>=index))
+        return;
+    if (k2cps->n>=K2CHECKPOINT_MAX)
+        {
+        int i;
+
+        /* Keep checkpoints at (index+1) = 2*interval, 4*interval, ... */
+        for (i=0;i<k2cps->n/2;i++)
+            {
+            K2CHECKPOINT t;
+
+            t=k2cps->cp[i];
+            k2cps->cp[i]=k2cps->cp[2*i+1];
+            k2cps->cp[2*i+1]=t;
+            }
+        for (;i<k2cps->n;i++)
+            k2checkpoint_free(&k2cps->cp[i]);
+        k2cps->n/=2;
+        k2cps->interval*=2;
+        if ((index+1)%k2cps->interval!=0)
+            return;
+        }
+    cp=&k2cps->cp[k2cps->n++];
+    k2checkpoint_init(cp,k2settings->dst_color);
+    cp->index=index;
+    cp->pages_done=pages_done;
+    k2pdfopt_settings_copy(&cp->k2settings,k2settings);
+    masterinfo_layout_copy(&cp->masterinfo,masterinfo,k2settings->use_crop_boxes);
+    cp->mark_page_count=k2ctx->mark_page_count;
+    cp->word_gap_count=k2ctx->word_gap_count;
+    memcpy(cp->word_gap,k2ctx->word_gap,sizeof(cp->word_gap));
+    cp->last_ncols=k2ctx->last_ncols;
+    cp->last_region_width_inches=k2ctx->last_region_width_inches;
+    cp->last_source_page=k2ctx->last_source_page;
+    cp->last_region_r2=k2ctx->last_region_r2;
+    cp->last_page_height=k2ctx->last_page_height;
+    cp->last_notes_type=k2ctx->last_notes_type;
+    }
+
+
+void k2checkpoints_free(K2CONTEXT *k2ctx)
+
+    {
+    static char *funcname="k2checkpoints_free";
+    K2CHECKPOINTS *k2cps;
+
+    k2cps=(K2CHECKPOINTS *)k2ctx->checkpoints;
+    if (k2cps==NULL)
+        return;
+    k2checkpoints_clear(k2cps);
+    willus_mem_free((double **)&k2cps->cp,funcname);
+    willus_mem_free((double **)&k2ctx->checkpoints,funcname);
+    }
+
+
+static K2CHECKPOINTS *k2checkpoints_get(K2CONTEXT *k2ctx)
+
+    {
+    static char *funcname="k2checkpoints_get";
+    K2CHECKPOINTS *k2cps;
+
+    if (k2ctx->checkpoints==NULL)
+        {
+        willus_mem_alloc_warn((void **)&k2ctx->checkpoints,sizeof(K2CHECKPOINTS),funcname,10);
+        k2cps=(K2CHECKPOINTS *)k2ctx->checkpoints;
+        willus_mem_alloc_warn((void **)&k2cps->cp,K2CHECKPOINT_MAX*sizeof(K2CHECKPOINT),
+                              funcname,10);
+        k2cps->key=0;
+        k2cps->active=0;
+        k2cps->n=0;
+        k2cps->interval=1;
+        }
+    return((K2CHECKPOINTS *)k2ctx->checkpoints);
+    }
+
+
+static void k2checkpoints_clear(K2CHECKPOINTS *k2cps)
+
+    {
+    int i;
+
+    for (i=0;i<k2cps->n;i++)
+        k2checkpoint_free(&k2cps->cp[i]);
+    k2cps->n=0;
+    k2cps->interval=1;
+    }
+
+
+/*
+** Layout state that isn't copied to the checkpoints:  OCR words (queued for
+** OCR), dewarp models, and the source page marking order.  So previews with
+** OCR or -dw always start from source page 1:  a page with too few text
+** lines for its own dewarp model uses the model of an earlier page
+** (masterinfo->dewarp_models), which a resumed preview wouldn't have.
+*/
+static int k2checkpoint_usable(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+#ifdef HAVE_OCR_LIB
+    if (k2settings->dst_ocr)
+        return(0);
+#endif
+#ifdef HAVE_LEPTONICA_LIB
+    if (k2settings->dewarp)
+        return(0);
+#endif
+    return(k2settings->preview_page!=0 && !k2settings->show_marked_source);
+    }
+
+
+static unsigned long long k2checkpoint_key(K2PDFOPT_SETTINGS *k2settings0,char *filename,
+                                           double rot_deg)
+
+    {
+    struct tm filedate;
+    char buf[128];
+    unsigned long long key;
+
+    memset(&filedate,0,sizeof(struct tm));
+    wfile_date(filename,&filedate);
+    sprintf(buf,"%.0f %04d-%02d-%02d %02d:%02d:%02d %g",wfile_size(filename),
+            filedate.tm_year+1900,filedate.tm_mon+1,filedate.tm_mday,
+            filedate.tm_hour,filedate.tm_min,filedate.tm_sec,rot_deg);
+    /* FNV-1a */
+    key=k2checkpoint_hash(14695981039346656037ULL,filename,strlen(filename)+1);
+    key=k2checkpoint_hash(key,buf,strlen(buf)+1);
+    key=k2checkpoint_hash_settings(key,k2settings0);
+    return(key);
+    }
+
+
+/*
+** Hash the settings that affect the layout, field by field, so that the key
+** doesn't depend on struct padding, on the bytes after the NUL in the string
+** arrays, or on pointers.  Settings that only affect messages, threading,
+** the preview page, or the output file (not its layout) are left out.
+*/
+#define K2CP_HASHVAR(x) hash=k2checkpoint_hash(hash,&k2settings->x,sizeof(k2settings->x))
+#define K2CP_HASHSTR(x) hash=k2checkpoint_hash_string(hash,k2settings->x)
+static unsigned long long k2checkpoint_hash_settings(unsigned long long hash,
+                                                     K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    int i;
+
+    K2CP_HASHVAR(cdthresh);
+    K2CP_HASHVAR(src_rot);
+    K2CP_HASHVAR(gtc_in);
+    K2CP_HASHVAR(gtr_in);
+    K2CP_HASHVAR(gtw_in);
+    K2CP_HASHVAR(src_left_to_right);
+    K2CP_HASHVAR(src_whitethresh);
+    K2CP_HASHSTR(dst_fgcolor);
+    K2CP_HASHVAR(dst_fgtype);
+    K2CP_HASHSTR(dst_bgcolor);
+    K2CP_HASHVAR(dst_bgtype);
+    K2CP_HASHVAR(src_paintwhite);
+    K2CP_HASHVAR(text_only);
+    K2CP_HASHVAR(dst_userdpi);
+    K2CP_HASHVAR(dst_dpi);
+    K2CP_HASHVAR(dst_dither);
+    K2CP_HASHVAR(dst_break_pages);
+    K2CP_HASHVAR(render_dpi);
+    K2CP_HASHVAR(fit_columns);
+    K2CP_HASHVAR(user_src_dpi);
+    K2CP_HASHVAR(document_scale_factor);
+    K2CP_HASHVAR(src_dpi);
+    K2CP_HASHVAR(user_usegs);
+    K2CP_HASHVAR(usegs);
+    K2CP_HASHVAR(dst_width);
+    K2CP_HASHVAR(dst_height);
+    K2CP_HASHVAR(dst_userwidth);
+    K2CP_HASHVAR(dst_userheight);
+    K2CP_HASHVAR(dst_magnification);
+    K2CP_HASHVAR(dst_display_resolution);
+    K2CP_HASHVAR(dst_userwidth_units);
+    K2CP_HASHVAR(dst_userheight_units);
+    K2CP_HASHVAR(dst_justify);
+    K2CP_HASHVAR(dst_figure_justify);
+    K2CP_HASHVAR(dst_figure_rotate);
+    K2CP_HASHVAR(dst_min_figure_height_in);
+    K2CP_HASHVAR(dst_fulljustify);
+    K2CP_HASHVAR(dst_sharpen);
+    K2CP_HASHVAR(dst_color);
+    K2CP_HASHVAR(dst_bpc);
+    K2CP_HASHVAR(dst_landscape);
+    K2CP_HASHSTR(dst_landscape_pages);
+    K2CP_HASHVAR(src_autostraighten);
+    K2CP_HASHVAR(autocrop);
+    hash=k2checkpoint_hash_cropbox(hash,&k2settings->dstmargins);
+    hash=k2checkpoint_hash_cropbox(hash,&k2settings->dstmargins_org);
+    K2CP_HASHVAR(pad_left);
+    K2CP_HASHVAR(pad_right);
+    K2CP_HASHVAR(pad_bottom);
+    K2CP_HASHVAR(pad_top);
+    K2CP_HASHVAR(mark_corners);
+    K2CP_HASHVAR(min_column_gap_inches);
+    K2CP_HASHVAR(max_column_gap_inches);
+    K2CP_HASHVAR(min_column_height_inches);
+    hash=k2checkpoint_hash_cropbox(hash,&k2settings->srccropmargins);
+    K2CP_HASHVAR(max_region_width_inches);
+    K2CP_HASHVAR(max_columns);
+    K2CP_HASHVAR(column_gap_range);
+    K2CP_HASHVAR(column_offset_max);
+    K2CP_HASHVAR(column_row_gap_height_in);
+    K2CP_HASHVAR(row_split_fom);
+    K2CP_HASHVAR(text_wrap);
+    K2CP_HASHVAR(word_spacing);
+    K2CP_HASHVAR(display_width_inches);
+    K2CP_HASHSTR(pagelist);
+    K2CP_HASHSTR(pagexlist);
+    K2CP_HASHSTR(bpl);
+    K2CP_HASHVAR(use_toc);
+    K2CP_HASHSTR(toclist);
+    K2CP_HASHVAR(column_fitted);
+    K2CP_HASHVAR(dpi_org);
+    K2CP_HASHVAR(contrast_max);
+    K2CP_HASHVAR(dst_gamma);
+    K2CP_HASHVAR(dst_negative);
+    K2CP_HASHVAR(show_marked_source);
+    K2CP_HASHVAR(use_crop_boxes);
+    K2CP_HASHVAR(preserve_indentation);
+    K2CP_HASHVAR(defect_size_pts);
+    K2CP_HASHVAR(max_vertical_gap_inches);
+    K2CP_HASHVAR(vertical_multiplier);
+    K2CP_HASHVAR(vertical_line_spacing);
+    K2CP_HASHVAR(vertical_break_threshold);
+    K2CP_HASHVAR(src_trim);
+    K2CP_HASHVAR(erase_vertical_lines);
+    K2CP_HASHVAR(erase_horizontal_lines);
+    K2CP_HASHVAR(hyphen_detect);
+    K2CP_HASHVAR(dst_fit_to_page);
+    K2CP_HASHVAR(src_grid_rows);
+    K2CP_HASHVAR(src_grid_cols);
+    K2CP_HASHVAR(grid_order);
+    K2CP_HASHVAR(src_grid_overlap_percentage);
+    K2CP_HASHVAR(cropboxes.n);
+    for (i=0;i<k2settings->cropboxes.n && i<MAXK2CROPBOXES;i++)
+        hash=k2checkpoint_hash_cropbox(hash,&k2settings->cropboxes.cropbox[i]);
+    K2CP_HASHVAR(noteset.n);
+    for (i=0;i<k2settings->noteset.n && i<MAXK2NOTES;i++)
+        {
+        K2CP_HASHSTR(noteset.notes[i].pagelist);
+        K2CP_HASHVAR(noteset.notes[i].left);
+        K2CP_HASHVAR(noteset.notes[i].right);
+        }
+    K2CP_HASHVAR(no_wrap_ar_limit);
+    K2CP_HASHVAR(no_wrap_height_limit_inches);
+    K2CP_HASHVAR(little_piece_threshold_inches);
+    K2CP_HASHVAR(devsize_set);
+    K2CP_HASHVAR(pagebreakmark_breakpage_color);
+    K2CP_HASHVAR(pagebreakmark_nobreak_color);
+    K2CP_HASHVAR(dst_fontsize_pts);
+    K2CP_HASHSTR(dst_coverimage);
+    K2CP_HASHVAR(user_mag);
+    K2CP_HASHVAR(join_figure_captions);
+    K2CP_HASHVAR(src_erosion);
+    K2CP_HASHVAR(detect_double_rows);
+    K2CP_HASHVAR(textheight_min_pts);
+    return(hash);
+    }
+
+
+static unsigned long long k2checkpoint_hash_cropbox(unsigned long long hash,K2CROPBOX *box)
+
+    {
+    hash=k2checkpoint_hash_string(hash,box->pagelist);
+    hash=k2checkpoint_hash(hash,box->box,sizeof(box->box));
+    hash=k2checkpoint_hash(hash,box->units,sizeof(box->units));
+    hash=k2checkpoint_hash(hash,&box->cboxflags,sizeof(box->cboxflags));
+    return(hash);
+    }
+
+
+static unsigned long long k2checkpoint_hash_string(unsigned long long hash,char *s)
+
+    {
+    return(k2checkpoint_hash(hash,s,strlen(s)+1));
+    }
+
+
+static unsigned long long k2checkpoint_hash(unsigned long long hash,void *data,int n)
+
+    {
+    unsigned char *p;
+    int i;
+
+    p=(unsigned char *)data;
+    for (i=0;i<n;i++)
+        {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+        }
+    return(hash);
+    }
+
+
+static void k2checkpoint_init(K2CHECKPOINT *cp,int color)
+
+    {
+    MASTERINFO *masterinfo;
+
+    masterinfo=&cp->masterinfo;
+    bmp_init(&masterinfo->bmp);
+    wrapbmp_init(&masterinfo->wrapbmp,color);
+    masterinfo->queued_page_info.page=NULL;
+    masterinfo->queued_page_info.n=masterinfo->queued_page_info.na=0;
+#ifdef HAVE_MUPDF_LIB
+    wpdfboxes_init(&masterinfo->pageinfo.boxes);
+#endif
+    }
+
+
+static void k2checkpoint_free(K2CHECKPOINT *cp)
+
+    {
+    static char *funcname="k2checkpoint_free";
+    MASTERINFO *masterinfo;
+
+    masterinfo=&cp->masterinfo;
+#ifdef HAVE_MUPDF_LIB
+    wpdfboxes_free(&masterinfo->pageinfo.boxes);
+#endif
+    willus_mem_free((double **)&masterinfo->queued_page_info.page,funcname);
+    masterinfo->queued_page_info.n=masterinfo->queued_page_info.na=0;
+    wrapbmp_free(&masterinfo->wrapbmp);
+    bmp_free(&masterinfo->bmp);
+    }
+
+
+/*
+** Copy the MASTERINFO fields that carry layout state from one source page
+** to the next.  The document fields (file names, output file, outline,
+** preview bitmap) are left alone.  dst must have been initialized.
+*/
+static void masterinfo_layout_copy(MASTERINFO *dst,MASTERINFO *src,int use_crop_boxes)
+
+    {
+    static char *funcname="masterinfo_layout_copy";
+    QUEUED_PAGE_INFO *qpi;
+    WILLUSBITMAP wbmp,view;
+    WRECTMAPS wrectmaps;
+    int i;
+
+    /* Only the live rows of the master bitmap (see masterinfo_more_rows()) */
+    masterinfo_bmp_view(src,&view,0,src->rows);
+    bmp_copy(&dst->bmp,&view);
+    dst->rows=src->rows;
+    dst->toprow=0;
+    /* Queued output pages */
+    qpi=&dst->queued_page_info;
+    if (qpi->na < src->queued_page_info.n)
+        {
+        willus_mem_realloc_robust_warn((void **)&qpi->page,
+                                       src->queued_page_info.n*sizeof(QUEUED_PAGE),
+                                       qpi->na*sizeof(QUEUED_PAGE),funcname,10);
+        qpi->na=src->queued_page_info.n;
+        }
+    qpi->n=src->queued_page_info.n;
+    if (qpi->n>0)
+        memcpy(qpi->page,src->queued_page_info.page,qpi->n*sizeof(QUEUED_PAGE));
+    /* Wrap bitmap */
+    wbmp=dst->wrapbmp.bmp;
+    wrectmaps=dst->wrapbmp.wrectmaps;
+    dst->wrapbmp=src->wrapbmp;
+    dst->wrapbmp.bmp=wbmp;
+    dst->wrapbmp.wrectmaps=wrectmaps;
+    bmp_copy(&dst->wrapbmp.bmp,&src->wrapbmp.bmp);
+    wrectmaps_clear(&dst->wrapbmp.wrectmaps);
+    for (i=0;i<src->wrapbmp.wrectmaps.n;i++)
+        wrectmaps_add_wrectmap(&dst->wrapbmp.wrectmaps,&src->wrapbmp.wrectmaps.wrectmap[i]);
+    /* Crop boxes for native PDF output */
+#ifdef HAVE_MUPDF_LIB
+    if (use_crop_boxes)
+        {
+        WPDFBOXES boxes;
+
+        boxes=dst->pageinfo.boxes;
+        dst->pageinfo=src->pageinfo;
+        dst->pageinfo.boxes=boxes;
+        dst->pageinfo.boxes.n=0;
+        for (i=0;i<src->pageinfo.boxes.n;i++)
+            wpdfboxes_add_box(&dst->pageinfo.boxes,&src->pageinfo.boxes.box[i]);
+        }
+#endif
+    dst->k2pagebreakmarks=src->k2pagebreakmarks;
+    dst->preview_captured=0;
+    dst->outline_srcpage_completed=src->outline_srcpage_completed;
+    dst->document_scale_factor=src->document_scale_factor;
+    dst->landscape=src->landscape;
+    dst->landscape_next=src->landscape_next;
+    dst->nextpage=src->nextpage;
+    dst->published_pages=src->published_pages;
+    dst->bgcolor=src->bgcolor;
+    dst->fit_to_page=src->fit_to_page;
+    dst->wordcount=src->wordcount;
+    dst->output_page_count=src->output_page_count;
+    for (i=0;i<4;i++)
+        dst->autocrop_margins[i]=src->autocrop_margins[i];
+    dst->lastrow=src->lastrow;
+    dst->rcindex=src->rcindex;
+    dst->nocr=src->nocr;
+    dst->gapblank=src->gapblank;
+    dst->mandatory_region_gap=src->mandatory_region_gap;
+    dst->page_region_gap_in=src->page_region_gap_in;
+    }
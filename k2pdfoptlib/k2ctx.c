@@ -0,0 +1,363 @@
+/*
+** k2ctx.c    Conversion contexts for k2pdfopt.  A K2CONTEXT owns the state
+**            needed to convert documents (settings, master bitmap, marked
+**            source file, OCR engine, MuPDF session), so that documents can
+**            be converted on separate threads inside one process, e.g.:
+**
+**                k2sys_init();                 (once per process)
+**                k2ctx=k2ctx_new(k2settings);
+**                k2ctx_convert_file(k2ctx,"doc.pdf");
+**                k2ctx_free(k2ctx);
+**
+**            k2ctx_convert_files() converts a list of documents on
+**            k2settings->jobs threads, one context per thread (-jobs).
+**
+**            Settings that are not attached to a context (k2settings->ctx==NULL),
+**            e.g. the ones used by the command line and the GUI, use a
+**            default context.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+
+#include "k2pdfopt.h"
+#include <pthread.h>
+
+static K2CONTEXT k2ctx_default;
+
+static void k2ctx_convert(K2CONTEXT *k2ctx,char *filename,K2PDFOPT_FILELIST_PROCESS *k2listproc,
+                          int single_doc);
+static void *k2ctx_batch_worker(void *data);
+static int  k2ctx_uses_ghostscript(K2PDFOPT_SETTINGS *k2settings,char *filename);
+
+
+/*
+** Create a new conversion context with a copy of k2settings (the defaults
+** if k2settings==NULL).  Free with k2ctx_free().
+*/
+K2CONTEXT *k2ctx_new(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    static char *funcname="k2ctx_new";
+    K2CONTEXT *k2ctx;
+
+    willus_mem_alloc_warn((void **)&k2ctx,sizeof(K2CONTEXT),funcname,10);
+    memset(k2ctx,0,sizeof(K2CONTEXT));
+    if (k2settings!=NULL)
+        k2pdfopt_settings_copy(&k2ctx->settings,k2settings);
+    else
+        k2pdfopt_settings_init(&k2ctx->settings);
+    k2ctx->settings.ctx=k2ctx;
+#ifdef HAVE_MUPDF_LIB
+    k2ctx->mupdf_session=bmpmupdf_session_new();
+#endif
+    return(k2ctx);
+    }
+
+
+/*
+** Convert filename (may be a folder or a wildcard) using the context settings.
+** Returns the number of files successfully converted.
+*/
+int k2ctx_convert_file(K2CONTEXT *k2ctx,char *filename)
+
+    {
+    static char *funcname="k2ctx_convert_file";
+    K2PDFOPT_FILELIST_PROCESS k2listproc;
+
+    k2listproc.filecount=0;
+    k2listproc.outname=NULL;
+    k2listproc.bmp=NULL;
+    k2listproc.status=0;
+    k2listproc.files=NULL;
+    k2listproc.mode=K2PDFOPT_FILELIST_PROCESS_MODE_CONVERT_FILES;
+    k2ctx_convert(k2ctx,filename,&k2listproc,0);
+    willus_mem_free((double **)&k2listproc.outname,funcname);
+    return(k2listproc.filecount);
+    }
+
+
+/*
+** Runs the conversion on the calling thread with the context's MuPDF session.
+** If single_doc!=0, filename is one document (or one folder of bitmaps) from
+** the GET_FILELIST mode of k2pdfopt_proc_wildarg().
+*/
+static void k2ctx_convert(K2CONTEXT *k2ctx,char *filename,K2PDFOPT_FILELIST_PROCESS *k2listproc,
+                          int single_doc)
+
+    {
+#ifdef HAVE_MUPDF_LIB
+    bmpmupdf_session_use(k2ctx->mupdf_session);
+#endif
+    if (single_doc)
+        k2pdfopt_preprocess_single_doc(&k2ctx->settings,filename,k2listproc);
+    else
+        k2pdfopt_proc_wildarg(&k2ctx->settings,filename,k2listproc);
+#ifdef HAVE_MUPDF_LIB
+    bmpmupdf_session_use(NULL);
+#endif
+    }
+
+
+void k2ctx_free(K2CONTEXT *k2ctx)
+
+    {
+    static char *funcname="k2ctx_free";
+
+    if (k2ctx==NULL)
+        return;
+    /* A shared OCR engine is ended by the context that owns it */
+    if (k2ctx->shared_ocr==NULL)
+        k2ocr_end(&k2ctx->settings);
+    k2checkpoints_free(k2ctx);
+#if (defined(HAVE_MUPDF_LIB) || defined(HAVE_DJVU_LIB))
+    k2ocr_ocrlayer_free(k2ctx);
+#endif
+#ifdef HAVE_MUPDF_LIB
+    bmpmupdf_session_free(k2ctx->mupdf_session);
+#endif
+    willus_mem_free((double **)&k2ctx,funcname);
+    }
+
+
+/*
+** Context that owns k2settings.  k2settings may be NULL (default context).
+*/
+K2CONTEXT *k2ctx_get(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    if (k2settings==NULL || k2settings->ctx==NULL)
+        return(&k2ctx_default);
+    return(k2settings->ctx);
+    }
+
+
+K2OCRENGINE *k2ctx_ocr_engine(K2CONTEXT *k2ctx)
+
+    {
+    return(k2ctx->shared_ocr!=NULL ? k2ctx->shared_ocr : &k2ctx->ocr);
+    }
+
+
+/*
+** v2.56:  -jobs batch mode.  Each of the k2settings->jobs threads converts
+** whole documents with its own context.  All of the contexts share the OCR
+** engine (and thread pool) of the default context.
+*/
+typedef struct
+    {
+    K2PDFOPT_SETTINGS *k2settings;
+    K2PDFOPT_FILES *files;
+    int next;            /* Next files->file[] index to be claimed by a worker */
+    int *status;         /* 0=pending, 1=converted, -1=failed, +/-2 = reported */
+    char **outname;
+    double ocr_cpu_secs;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_mutex_t gs_mutex; /* Held by the job converting a Ghostscript document */
+    } K2CTXBATCH;
+
+
+/*
+** Convert the files / folders / wildcards in k2files using k2settings->jobs
+** threads.  Progress is reported as each document finishes.  Since the jobs
+** can't prompt the user, existing output files are not overwritten unless -y
+** is specified.  Ghostscript is not thread safe, so documents rendered with it
+** (PostScript, or PDF with -gs) are converted one at a time.
+** Returns the number of documents successfully converted.
+*/
+int k2ctx_convert_files(K2PDFOPT_SETTINGS *k2settings,K2PDFOPT_FILES *k2files)
+
+    {
+    static char *funcname="k2ctx_convert_files";
+    K2CTXBATCH _batch,*batch;
+    K2PDFOPT_FILES _files,*files;
+    K2PDFOPT_FILELIST_PROCESS k2listproc;
+    pthread_t *thread;
+    int i,nthreads,nreported,nconverted;
+    double t0;
+
+    /* Expand folders and wildcards into the list of documents */
+    files=&_files;
+    k2pdfopt_files_init(files);
+    k2listproc.filecount=0;
+    k2listproc.outname=NULL;
+    k2listproc.bmp=NULL;
+    k2listproc.status=0;
+    k2listproc.files=files;
+    k2listproc.mode=K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILELIST;
+    for (i=0;i<k2files->n;i++)
+        k2pdfopt_proc_wildarg(k2settings,k2files->file[i],&k2listproc);
+    if (files->n==0)
+        {
+        k2pdfopt_files_free(files);
+        return(0);
+        }
+    k2settings_check_and_warn(k2settings);
+    if (!k2settings->assume_yes)
+        overwrite_set(-1);
+#ifdef HAVE_OCR_LIB
+    /* Load the shared OCR engine before the jobs start so that they all use it */
+    if (k2settings->dst_ocr)
+        {
+        char initstr[256];
+        k2ocr_init(k2settings,initstr);
+        }
+#endif
+    nthreads=k2settings->jobs;
+    if (nthreads>files->n)
+        nthreads=files->n;
+    k2printf(TTEXT_HEADER "Converting %d documents using %d jobs." TTEXT_NORMAL "\n\n",
+             files->n,nthreads);
+    t0=(double)time(NULL);
+    batch=&_batch;
+    batch->k2settings=k2settings;
+    batch->files=files;
+    batch->next=0;
+    batch->ocr_cpu_secs=0.;
+    willus_mem_alloc_warn((void **)&batch->status,sizeof(int)*files->n,funcname,10);
+    willus_mem_alloc_warn((void **)&batch->outname,sizeof(char *)*files->n,funcname,10);
+    willus_mem_alloc_warn((void **)&thread,sizeof(pthread_t)*nthreads,funcname,10);
+    for (i=0;i<files->n;i++)
+        {
+        batch->status[i]=0;
+        batch->outname[i]=NULL;
+        }
+    pthread_mutex_init(&batch->mutex,NULL);
+    pthread_cond_init(&batch->cond,NULL);
+    pthread_mutex_init(&batch->gs_mutex,NULL);
+    for (i=0;i<nthreads;i++)
+        if (pthread_create(&thread[i],NULL,k2ctx_batch_worker,batch)!=0)
+            break;
+    nthreads=i;
+    /* No threads?  Do the jobs here. */
+    if (nthreads==0)
+        k2ctx_batch_worker(batch);
+    pthread_mutex_lock(&batch->mutex);
+    for (nreported=nconverted=0;nreported<files->n;)
+        {
+        for (i=0;i<files->n;i++)
+            if (batch->status[i]==1 || batch->status[i]==-1)
+                break;
+        if (i>=files->n)
+            {
+            pthread_cond_wait(&batch->cond,&batch->mutex);
+            continue;
+            }
+        nreported++;
+        if (batch->status[i]>0)
+            {
+            nconverted++;
+            k2printf("[%d/%d] %s -> " TTEXT_BOLD "%s" TTEXT_NORMAL "\n",nreported,files->n,
+                     files->file[i],batch->outname[i]!=NULL ? batch->outname[i] : "");
+            }
+        else
+            k2printf("[%d/%d] %s " TTEXT_WARN "** FAILED **" TTEXT_NORMAL "\n",nreported,
+                     files->n,files->file[i]);
+        batch->status[i]*=2;
+        }
+    pthread_mutex_unlock(&batch->mutex);
+    for (i=0;i<nthreads;i++)
+        pthread_join(thread[i],NULL);
+    k2ctx_get(k2settings)->ocr.cpu_time_secs += batch->ocr_cpu_secs;
+    k2printf("\n" TTEXT_HEADER "%d of %d documents converted in %.0f s." TTEXT_NORMAL "\n",
+             nconverted,files->n,(double)time(NULL)-t0);
+    if (nconverted<files->n)
+        {
+        k2printf(TTEXT_WARN "These documents failed (run them again without -jobs for"
+                 " details):" TTEXT_NORMAL "\n");
+        for (i=0;i<files->n;i++)
+            if (batch->status[i]<0)
+                k2printf("    %s\n",files->file[i]);
+        }
+    pthread_mutex_destroy(&batch->gs_mutex);
+    pthread_cond_destroy(&batch->cond);
+    pthread_mutex_destroy(&batch->mutex);
+    for (i=files->n-1;i>=0;i--)
+        willus_mem_free((double **)&batch->outname[i],funcname);
+    willus_mem_free((double **)&thread,funcname);
+    willus_mem_free((double **)&batch->outname,funcname);
+    willus_mem_free((double **)&batch->status,funcname);
+    k2pdfopt_files_free(files);
+    return(nconverted);
+    }
+
+
+static void *k2ctx_batch_worker(void *data)
+
+    {
+    K2CTXBATCH *batch;
+    K2CONTEXT *k2ctx;
+
+    batch=(K2CTXBATCH *)data;
+    /* The main thread reports the progress */
+    k2printf_mute_thread(1);
+    k2ctx=k2ctx_new(batch->k2settings);
+    k2ctx->shared_ocr=k2ctx_ocr_engine(k2ctx_get(batch->k2settings));
+    while (1)
+        {
+        K2PDFOPT_FILELIST_PROCESS k2listproc;
+        int i,usegs;
+
+        pthread_mutex_lock(&batch->mutex);
+        i = batch->next < batch->files->n ? batch->next++ : -1;
+        pthread_mutex_unlock(&batch->mutex);
+        if (i<0)
+            break;
+        /* filecount=i keeps the output file names the same as a serial run */
+        k2listproc.filecount=i;
+        k2listproc.outname=NULL;
+        k2listproc.bmp=NULL;
+        k2listproc.status=0;
+        k2listproc.files=NULL;
+        k2listproc.mode=K2PDFOPT_FILELIST_PROCESS_MODE_CONVERT_FILES;
+        usegs=k2ctx_uses_ghostscript(batch->k2settings,batch->files->file[i]);
+        if (usegs)
+            pthread_mutex_lock(&batch->gs_mutex);
+        k2ctx_convert(k2ctx,batch->files->file[i],&k2listproc,1);
+        if (usegs)
+            pthread_mutex_unlock(&batch->gs_mutex);
+        pthread_mutex_lock(&batch->mutex);
+        batch->status[i] = k2listproc.filecount>i ? 1 : -1;
+        batch->outname[i] = k2listproc.outname;
+        batch->ocr_cpu_secs += k2ctx->ocr.cpu_time_secs;
+        k2ctx->ocr.cpu_time_secs = 0.;
+        pthread_cond_signal(&batch->cond);
+        pthread_mutex_unlock(&batch->mutex);
+        }
+    k2ctx_free(k2ctx);
+    k2printf_mute_thread(0);
+    return(NULL);
+    }
+
+
+/*
+** Non-zero if the pages of filename are rendered with Ghostscript.
+*/
+static int k2ctx_uses_ghostscript(K2PDFOPT_SETTINGS *k2settings,char *filename)
+
+    {
+    int src_type;
+
+    src_type=get_source_type(filename);
+    if (src_type==SRC_TYPE_PS)
+        return(1);
+#ifdef HAVE_MUPDF_LIB
+    return(src_type==SRC_TYPE_PDF && k2settings->user_usegs>0);
+#else
+    return(src_type==SRC_TYPE_PDF);
+#endif
+    }
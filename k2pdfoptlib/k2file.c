@@ -27,15 +27,13 @@ static void k2pdfopt_proc_file_or_folder(K2PDFOPT_SETTINGS *k2settings,char *arg
                                          K2PDFOPT_FILELIST_PROCESS *k2listproc);
 static void k2pdfopt_warn_file_not_found(K2PDFOPT_SETTINGS *k2settings,char *filename,
                                          K2PDFOPT_FILELIST_PROCESS *k2listproc);
-static void k2pdfopt_preprocess_single_doc(K2PDFOPT_SETTINGS *k2settings,char *filename,
-                                           K2PDFOPT_FILELIST_PROCESS *k2listproc);
 static void k2pdfopt_echo_file_info(K2PDFOPT_SETTINGS *k2settings,char *filename);
 static int k2pdfopt_proc_one(K2PDFOPT_SETTINGS *k2settings,char *filename,
                              K2PDFOPT_FILE_PROCESS *k2fileproc);
 static int k2_handle_preview(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
                              int k2mark_page_count,WILLUSBITMAP *markedbmp,
                              K2PDFOPT_FILE_PROCESS *k2fileproc);
-static char *pagename(int pageno);
+static char *pagename(char *pname,int pageno);
 static int  filename_comp(char *name1,char *name2);
 static int  filename_get_temp_pdf_name(char *dst,char *fmt,char *psname);
 static int  count_format_strings(char *fmt,int type);
@@ -57,7 +55,10 @@ static int  k2pdfopt_get_cover_image(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2sett
                                      char *filename,int dpi,int *errcnt,int *pixwarn);
 static int  k2pdfopt_get_file_image(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
                                     int src_type,char *filename,int pageno,
-                                    int dpi,int *errcnt,int *pixwarn);
+                                    int dpi,int *errcnt,int *pixwarn,void *prefetch);
+static void *k2pdfopt_prefetch_start(K2PDFOPT_SETTINGS *k2settings,int src_type,
+                                     char *filename,int pagecount,int pagestep,int np,
+                                     int dpi);
 static int  k2file_get_bitmap_file_list(FILELIST *fl,char *filename,int first_time_through);
 static int k2file_setup_output_file_names(K2PDFOPT_SETTINGS *k2settings,char *filename,
                                           K2PDFOPT_FILE_PROCESS *k2fileproc,
@@ -78,6 +79,8 @@ void k2pdfopt_proc_wildarg(K2PDFOPT_SETTINGS *k2settings,char *arg,
 #if (WILLUSDEBUGX & 1)
 printf("@k2pdfopt_proc_wildarg(%s)\n",arg);
 #endif
+    /* v2.56:  Rendered-page cache size */
+    bmpcache_set_max_bytes(k2settings->render_cache_mb*1024.*1024.);
     /* Init width to -1 */
     if (k2settings->preview_page!=0 && k2listproc->bmp!=NULL)
         k2listproc->bmp->width = -1;
@@ -213,8 +216,8 @@ static void k2pdfopt_warn_file_not_found(K2PDFOPT_SETTINGS *k2settings,char *fil
 **     2. Process the file with the determined rotation.
 **
 */
-static void k2pdfopt_preprocess_single_doc(K2PDFOPT_SETTINGS *k2settings,char *srcfilename_passed,
-                                           K2PDFOPT_FILELIST_PROCESS *k2listproc)
+void k2pdfopt_preprocess_single_doc(K2PDFOPT_SETTINGS *k2settings,char *srcfilename_passed,
+                                    K2PDFOPT_FILELIST_PROCESS *k2listproc)
 
     {
     K2PDFOPT_FILE_PROCESS _k2fileproc,*k2fileproc;
@@ -244,8 +247,11 @@ printf("    src_rot=%d\n",k2settings->src_rot);
         return;
         }
     /* File is legit and counts towards total (if counting) */
-    if (k2listproc->mode==K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILECOUNT)
+    if (k2listproc->mode==K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILECOUNT
+          || k2listproc->mode==K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILELIST)
         {
+        if (k2listproc->mode==K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILELIST)
+            k2pdfopt_files_add_file(k2listproc->files,filename);
         k2listproc->filecount++;
         k2pdfopt_file_process_close(k2fileproc);
         return;
@@ -429,9 +435,10 @@ static int k2pdfopt_proc_one(K2PDFOPT_SETTINGS *k2settings0,char *filename,
                              K2PDFOPT_FILE_PROCESS *k2fileproc)
 
     {
-    static K2PDFOPT_SETTINGS _k2settings,*k2settings;
-    static MASTERINFO _masterinfo,*masterinfo;
-    static PDFFILE _mpdf,*mpdf;
+    K2CONTEXT *k2ctx;
+    K2PDFOPT_SETTINGS *k2settings;
+    MASTERINFO *masterinfo;
+    PDFFILE *mpdf;
     char dstfile[MAXFILENAMELEN];
     char markedfile[MAXFILENAMELEN];
     char rotstr[128];
@@ -440,14 +447,14 @@ static int k2pdfopt_proc_one(K2PDFOPT_SETTINGS *k2settings0,char *filename,
     WILLUSBITMAP _srcgrey,*srcgrey;
     WILLUSBITMAP _marked,*marked;
     WILLUSBITMAP preview_internal;
-    int i,status,pw,pq,np,src_type,first_time_through,or_detect,fontsize_detect,preview;
+    int i,i0,status,pw,pq,np,src_type,first_time_through,or_detect,fontsize_detect,preview;
     int pagecount,pagestep,pages_done,local_tocwrites;
     int errcnt,pixwarn;
     FILELIST *fl,_fl;
     int dpi;
     double rot_deg,size,bormean;
     char *srcfilename;
-    extern int k2mark_page_count;
+    void *prefetch;
 /*
     static char *funcname="k2pdfopt_proc_one";
     static char *readerr=TTEXT_WARN "\a\n ** ERROR reading page %d from " TTEXT_BOLD2 "%s" TTEXT_WARN ".\n\n" TTEXT_NORMAL;
@@ -468,18 +475,20 @@ printf("    filecount=%d\n",k2fileproc->filecount);
 #endif
     /* Default rotation */
     local_tocwrites=0;
-    k2settings=&_k2settings;
+    /* v2.56:  Conversion state is kept in the context that owns the settings */
+    k2ctx=k2ctx_get(k2settings0);
+    k2settings=&k2ctx->k2settings;
     k2pdfopt_settings_copy(k2settings,k2settings0);
 #ifdef HAVE_K2GUI
     if (k2gui_active())
         k2gui_cbox_set_filename(filename);
 #endif
-    mpdf=&_mpdf;
+    mpdf=&k2ctx->mpdf;
     /* Must be called once per conversion to init margins / devsize / output size */
     k2pdfopt_settings_new_source_document_init(k2settings,initstr);
     errcnt=0;
     pixwarn=0;
-    srcfilename=_masterinfo.srcfilename;
+    srcfilename=k2ctx->masterinfo.srcfilename;
     strncpy(srcfilename,filename,MAXFILENAMELEN-1);
     srcfilename[MAXFILENAMELEN-1]='\0';
     or_detect=(k2fileproc->mode==K2PDFOPT_FILE_PROCESS_MODE_GET_ROTATION);
@@ -566,7 +575,7 @@ printf("first_time_through = %d\n",first_time_through);
     if (k2settings->dst_ocr=='m' && src_type!=SRC_TYPE_PDF && src_type!=SRC_TYPE_DJVU)
         k2settings->dst_ocr=0;
 #endif
-    masterinfo=&_masterinfo;
+    masterinfo=&k2ctx->masterinfo;
     masterinfo_init(masterinfo,k2settings);
     masterinfo->filecount=k2fileproc->filecount;
     if (k2settings->preview_page!=0 && !or_detect && !fontsize_detect)
@@ -738,13 +747,27 @@ printf("first_time_through = %d\n",first_time_through);
             }
         }
     bormean=1.0;
+    /* v2.56:  -profile (only the conversion pass, not orientation / font size detection) */
+    if (!preview && !or_detect && !fontsize_detect)
+        k2profile_document_start(k2settings);
+    /* v2.56:  Render upcoming source pages on worker threads */
+    if (!preview)
+        prefetch=k2pdfopt_prefetch_start(k2settings,src_type,srcfilename,pagecount,pagestep,
+                                         np,dpi);
+    else
+        prefetch=NULL;
+    /* v2.56:  Preview resumes from the last checkpoint before the preview page */
+    if (preview)
+        i0=k2checkpoint_resume(k2settings0,filename,rot_deg,masterinfo,&pages_done);
+    else
+        i0=-1;
 /*
 printf("np=%d, src_type=%d\n",np,src_type);
 */
     /*
     ** LOOP THROUGH SOURCE DOCUMENT PAGES
     */
-    for (i=-1;1;i+=pagestep)
+    for (i=i0;1;i+=pagestep)
         {
         char bmpfile[MAXFILENAMELEN];
         int pageno,nextpage;
@@ -753,6 +776,7 @@ printf("np=%d, src_type=%d\n",np,src_type);
 willus_mem_debug_update(bmpfile);
 */
         pageno=0;
+        k2profile_page_start(k2settings);
         if (pagecount>0 && i+1>pagecount)
             break;
         nextpage = (i+2>pagecount) ? -1 : double_pagelist_page_by_index(k2settings->pagelist,
@@ -802,14 +826,14 @@ willus_mem_debug_update(bmpfile);
                         && src_type!=SRC_TYPE_CBZ)
                     break;
                 status=k2pdfopt_get_file_image(src,k2settings,src_type,srcfilename,
-                                               pageno,dpi,&errcnt,&pixwarn);
+                                               pageno,dpi,&errcnt,&pixwarn,prefetch);
                 if (status<0)
                     break;
                 if (status==0)
                     continue;
                 }
             } /* closing brace for "else" from checking for cover page */
-        k2mark_page_count = i+1;
+        k2ctx->mark_page_count = i+1;
 
         {
         BMPREGION region;
@@ -818,6 +842,7 @@ willus_mem_debug_update(bmpfile);
         /* Got Good Page Render */
         bmpregion_init(&region);
         bmpregion_k2pagebreakmarks_allocate(&region);
+        bmpregion_integral_allocate(&region);
         mstatus=masterinfo_new_source_page_init(masterinfo,k2settings,src,srcgrey,marked,
                                  &region,rot_deg,&bormean,rotstr,pageno,nextpage,stdout);
         if (mstatus==0 || fontsize_detect)
@@ -828,7 +853,10 @@ willus_mem_debug_update(bmpfile);
                 si=k2fileproc->fsh.n;
                 k2proc_get_fontsize_histogram(&region,masterinfo,k2settings,&k2fileproc->fsh);
                 if (k2settings->verbose)
-                    k2printf("    %d text rows on %s.\n",k2fileproc->fsh.n-si,pagename(pageno));
+                    {
+                    char pname[32];
+                    k2printf("    %d text rows on %s.\n",k2fileproc->fsh.n-si,pagename(pname,pageno));
+                    }
                 }
             /* v2.15 -- memory leak fix */
             bmpregion_free(&region);
@@ -850,7 +878,10 @@ willus_mem_debug_update(bmpfile);
             k2proc_get_fontsize_histogram(&region,masterinfo,k2settings,&k2fileproc->fsh);
             src_fontsize_pts = fontsize_histogram_median(&k2fileproc->fsh,si);
             if (k2settings->verbose)
-                k2printf("    %d text rows on page %s\n",k2fileproc->fsh.n-si,pagename(pageno));
+                {
+                char pname[32];
+                k2printf("    %d text rows on page %s\n",k2fileproc->fsh.n-si,pagename(pname,pageno));
+                }
             }
         else
             src_fontsize_pts=-1.;
@@ -925,7 +956,9 @@ willus_mem_debug_update(bmpfile);
             flush_output=masterinfo_should_flush(masterinfo,k2settings);
         masterinfo_publish(masterinfo,k2settings,flush_output);
         }
-        if (preview && k2_handle_preview(k2settings,masterinfo,k2mark_page_count,
+        if (preview)
+            k2checkpoint_save(k2settings,masterinfo,i,pages_done);
+        if (preview && k2_handle_preview(k2settings,masterinfo,k2ctx->mark_page_count,
                                          k2settings->dst_color?marked:src,k2fileproc))
             {
             bmp_free(marked);
@@ -945,15 +978,14 @@ willus_mem_debug_update(bmpfile);
         if (!k2settings->preview_page)
             {
             int np,qp;
-            static int qpl=0;
 /*
-printf("(queue=%d,qpl=%d,pq=%d)",masterinfo->queued_page_info.n,qpl,pq);
+printf("(queue=%d,pq=%d)",masterinfo->queued_page_info.n,pq);
 */
             np=masterinfo->published_pages-pw;
             qp=masterinfo->queued_page_info.n-pq;
-            if (qpl>0)
+            /* v2.56:  pq replaces static qpl (same value, but per document) */
+            if (pq>0)
                 qp+=np;
-            qpl=masterinfo->queued_page_info.n;
             if (!k2settings_output_is_bitmap(k2settings))
                 {
                 k2printf("%d page%s saved",np,np==1?"":"s");
@@ -964,12 +996,20 @@ printf("(queue=%d,qpl=%d,pq=%d)",masterinfo->queued_page_info.n,qpl,pq);
             }
         pw=masterinfo->published_pages;
         pq=masterinfo->queued_page_info.n;
+        k2profile_page_end(k2settings,pageno);
+        /* v2.56:  Free pooled bitmap buffers that weren't re-used on this page */
+        bmppool_page_end();
         }
     /*
     **
     ** END MAIN SOURCE DOCUMENT PAGE PROCESSING LOOP
     **
     */
+    k2prefetch_stop(prefetch);
+#ifdef HAVE_GHOSTSCRIPT
+    /* v2.56:  Done with any Ghostscript render sessions for this file */
+    willusgs_sessions_end();
+#endif
 /*
 willus_mem_debug_update("End");
 */
@@ -977,7 +1017,7 @@ willus_mem_debug_update("End");
     if (preview)
         {
         masterinfo_flush(masterinfo,k2settings,1); /* 1=final call--clear bitmap */
-        if (!k2_handle_preview(k2settings,masterinfo,k2mark_page_count,
+        if (!k2_handle_preview(k2settings,masterinfo,k2ctx->mark_page_count,
                                k2settings->dst_color?marked:src,k2fileproc))
             {
             /* No preview bitmap--return zero-width bitmap */
@@ -1178,7 +1218,10 @@ printf("Calling wmupdf_remake_pdf()...\n");
 #endif
     if (local_tocwrites>0)
         k2printf(TTEXT_BOLD "%d bytes" TTEXT_NORMAL " written to " TTEXT_MAGENTA "%s" TTEXT_NORMAL ".\n\n",(int)(wfile_size(k2settings->tocsavefile)+.5),k2settings->tocsavefile);
+    k2profile_document_end(k2settings,filename,dstfile,pages_done,masterinfo->published_pages);
     masterinfo_free(masterinfo,k2settings);
+    /* v2.56:  Don't hold pooled bitmap buffers between documents */
+    bmppool_free_all();
     if (src_type==SRC_TYPE_BITMAPFOLDER)
         filelist_free(fl);
     k2fileproc->status=0;
@@ -1255,10 +1298,10 @@ masterinfo->preview_bitmap->width,masterinfo->preview_bitmap->height,masterinfo-
     }
 
 
-static char *pagename(int pageno)
+/* v2.56:  pname[] supplied by caller (was static) */
+static char *pagename(char *pname,int pageno)
 
     {
-    static char pname[32];
 
     if (pageno<0)
         strcpy(pname,"cover page");
@@ -2069,6 +2112,10 @@ static void gs_postprocess(char *filename)
 static void gs_conv_cleanup(int psconv,char *filename,char *original_file)
 
     {
+#ifdef HAVE_MUPDF_LIB
+    /* Temp file may be held open by the MuPDF document session */
+    bmpmupdf_session_close();
+#endif
     if (psconv)
         {
         remove(filename);
@@ -2095,6 +2142,9 @@ static void k2pdfopt_file_process_close(K2PDFOPT_FILE_PROCESS *k2fileproc)
 
     fontsize_histogram_free(&k2fileproc->fsh);
     willus_mem_free((double **)&k2fileproc->outname,funcname);
+#ifdef HAVE_MUPDF_LIB
+    bmpmupdf_session_close();
+#endif
     }
 
 /*
@@ -2134,7 +2184,7 @@ static int k2pdfopt_get_cover_image(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2setti
     /* If integer, interpret as page number of PDF source file */
     if ((src_type==SRC_TYPE_PDF || src_type==SRC_TYPE_DJVU || src_type==SRC_TYPE_CBZ) && pageno<=0)
         pageno=1;
-    status=k2pdfopt_get_file_image(src,k2settings,src_type,covfile,pageno,dpi,errcnt,pixwarn);
+    status=k2pdfopt_get_file_image(src,k2settings,src_type,covfile,pageno,dpi,errcnt,pixwarn,NULL);
     return(status==1 ? 1 : 0);
     }
     
@@ -2148,7 +2198,7 @@ static int k2pdfopt_get_cover_image(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2setti
 */
 static int k2pdfopt_get_file_image(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
                                    int src_type,char *filename,int pageno,
-                                   int dpi,int *errcnt,int *pixwarn)
+                                   int dpi,int *errcnt,int *pixwarn,void *prefetch)
 
     {
     static char *readerr=TTEXT_WARN "\a\n ** ERROR reading page %d from " TTEXT_BOLD2 "%s" TTEXT_WARN ".\n\n" TTEXT_NORMAL;
@@ -2159,10 +2209,30 @@ static int k2pdfopt_get_file_image(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settin
 /*
 printf("@k2pdfopt_get_file_image, fn=%s, src_type=%d, pageno=%d, dpi=%d\n",filename,src_type,pageno,dpi);
 */
-    /* Pre-read at low dpi to check bitmap size */
+    /* v2.56:  Already rendered by a worker thread? */
+    if (k2prefetch_get_page(prefetch,src,pageno))
+        {
+        npix = (double)src->width*src->height;
+        if (npix > 2.5e8 && !(*pixwarn))
+            {
+            k2printf("\a\n" TTEXT_WARN "\n\a ** Source resolution is very high (%d x %d pixels)!\n"
+                    "    You may want to reduce the -odpi or -idpi setting!"
+                    TTEXT_NORMAL "\n\n",src->width,src->height);
+            (*pixwarn)=1;
+            }
+        return(1);
+        }
 
     source_is_bitmap = (src_type!=SRC_TYPE_PS && src_type!=SRC_TYPE_PDF && src_type!=SRC_TYPE_DJVU
                              && src_type!=SRC_TYPE_CBZ);
+    /* v2.56:  Page already rendered (e.g. by the -rt auto / -fs sampling pass)? */
+    if (!source_is_bitmap
+          && bmp_get_cached_document_page(src,k2settings,src_type,filename,pageno,(double)dpi,
+                                          k2settings_need_color_initially(k2settings) ? 24 : 8))
+        return(1);
+
+    /* Pre-read at low dpi to check bitmap size */
+
     if (source_is_bitmap && k2settings_need_color_initially(k2settings))
         bpp=24;
     else
@@ -2229,6 +2299,39 @@ printf("@k2pdfopt_get_file_image, fn=%s, src_type=%d, pageno=%d, dpi=%d\n",filen
     }
 
 
+/*
+** Start rendering the source pages in the same order that the main loop in
+** k2pdfopt_proc_one() will request them (v2.56).
+*/
+static void *k2pdfopt_prefetch_start(K2PDFOPT_SETTINGS *k2settings,int src_type,
+                                     char *filename,int pagecount,int pagestep,int np,
+                                     int dpi)
+
+    {
+    static char *funcname="k2pdfopt_prefetch_start";
+    void *prefetch;
+    int *pages;
+    int i,n;
+
+    if (pagecount<2 || !k2prefetch_source_ok(k2settings,src_type))
+        return(NULL);
+    willus_mem_alloc_warn((void **)&pages,sizeof(int)*pagecount,funcname,10);
+    for (n=0,i=pagestep-1;i<pagecount;i+=pagestep)
+        {
+        int pageno;
+
+        pageno=double_pagelist_page_by_index(k2settings->pagelist,k2settings->pagexlist,i,np);
+        if (pageno<0)
+            break;
+        pages[n++]=pageno;
+        }
+    prefetch=k2prefetch_start(k2settings,src_type,filename,pages,n,dpi,
+                              k2settings_need_color_initially(k2settings) ? 24 : 8);
+    willus_mem_free((double **)&pages,funcname);
+    return(prefetch);
+    }
+
+
 static int k2file_get_bitmap_file_list(FILELIST *fl,char *filename,int first_time_through)
 
     {
@@ -2307,7 +2410,15 @@ static int k2file_setup_output_file_names(K2PDFOPT_SETTINGS *k2settings,char *fi
         return(0);
         }
     if (!bitmap && !k2settings->use_crop_boxes)
+        {
         can_write = (pdffile_init(&masterinfo->outfile,dstfile,1)!=NULL);
+        /* v2.56 */
+        if (k2settings->write_threads<0)
+            masterinfo->outfile.nthreads=wsys_num_cpus()*abs(k2settings->write_threads)/100;
+        else
+            masterinfo->outfile.nthreads=k2settings->write_threads;
+        masterinfo->outfile.xref_stream=k2settings->xref_stream;
+        }
     else
         {
         FILE *f1;
@@ -19,8 +19,12 @@
 */
 
 #include "k2pdfopt.h"
+#ifndef K2PDFOPT_KINDLEPDFVIEWER
+#include <pthread.h>
 
-int k2mark_page_count=0;
+/* v2.56:  The fontrender settings are global, so -jobs threads take turns */
+static pthread_mutex_t k2mark_font_mutex=PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 /*
 ** src guaranteed to be 24-bit color
@@ -79,7 +83,7 @@ void mark_source_page(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
                       BMPREGION *region0,int caller_id,int mark_flags)
 
     {
-    static int display_order=0;
+    K2CONTEXT *k2ctx;
     int i,n,nn,r,g,b;
 #ifndef K2PDFOPT_KINDLEPDFVIEWER
     int shownum,nval,fontsize;
@@ -91,12 +95,15 @@ void mark_source_page(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
         return;
 
     /* Don't waste time marking this page if we're previewing and this isn't the preview page */
-    if (k2settings->preview_page!=0 && abs(k2settings->preview_page)!=k2mark_page_count)
+    /* v2.56:  display_order is kept in the context (was static) */
+    k2ctx=k2ctx_get(k2settings);
+    if (k2settings->preview_page!=0
+          && abs(k2settings->preview_page)!=k2ctx->mark_page_count)
         return;
 
     if (region0==NULL)
         {
-        display_order=0;
+        k2ctx->mark_display_order=0;
         return;
         }
 
@@ -130,7 +137,7 @@ void mark_source_page(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
         return;
         }
 
-    /* k2printf("@mark_source_page(display_order=%d)\n",display_order); */
+    /* k2printf("@mark_source_page(display_order=%d)\n",k2ctx->mark_display_order); */
 #ifndef K2PDFOPT_KINDLEPDFVIEWER
     shownum=0;
     nval=0;
@@ -138,10 +145,10 @@ void mark_source_page(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
 /* aprintf(ANSI_YELLOW "MARK CALLER ID = %d" ANSI_NORMAL "\n",caller_id); */
     if (caller_id==1)
         {
-        display_order++;
+        k2ctx->mark_display_order++;
 #ifndef K2PDFOPT_KINDLEPDFVIEWER
         shownum=1;
-        nval=display_order;
+        nval=k2ctx->mark_display_order;
 #endif
         n=(int)(region->dpi/60.+0.5);
         if (n<5)
@@ -285,6 +292,7 @@ void mark_source_page(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
         bmpregion_free(region);
         return;
         }
+    pthread_mutex_lock(&k2mark_font_mutex);
     fontrender_set_typeface("helvetica-bold");
     fontrender_set_fgcolor(r,g,b);
     fontrender_set_bgcolor(255,255,255);
@@ -294,6 +302,7 @@ void mark_source_page(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,
     sprintf(num,"%d",nval);
     fontrender_render(region->marked,(double)(region->c1+region->c2)/2.,
                       (double)(region->marked->height-((region->r1+region->r2)/2.)),num,0,NULL);    
+    pthread_mutex_unlock(&k2mark_font_mutex);
 #endif
     bmpregion_free(region);
     /* k2printf("    done mark_source_page.\n"); */
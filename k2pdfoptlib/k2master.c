@@ -30,6 +30,7 @@ static int calculate_line_gap(BMPREGION *region,MASTERINFO *masterinfo,
 static void masterinfo_pagequeue_pop_queue(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings);
 static void masterinfo_remove_top_rows(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,int rows);
 static int masterinfo_pageheight_pixels(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings);
+static int masterinfo_page_threads(K2PDFOPT_SETTINGS *k2settings);
 #ifdef HAVE_MUPDF_LIB
 static void masterinfo_add_cropbox(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
                                    WILLUSBITMAP *bmp1,double bmpdpi,int rows);
@@ -86,6 +87,15 @@ void masterinfo_init(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings)
                             sizeof(QUEUED_PAGE)*masterinfo->queued_page_info.na,
                             funcname,10);
     /* v2.53 end */
+    masterinfo->deferred_ocr_pages.page=NULL;
+    masterinfo->deferred_ocr_pages.n=masterinfo->deferred_ocr_pages.na=0;
+    masterinfo->dewarp_models=NULL;
+    wtextchars_init(&masterinfo->ocrlayer_chars);
+    masterinfo->ocrlayer_page=-1;
+#ifdef HAVE_OCR_LIB
+    /* v2.56:  Don't leave jobs for the freed words in a (possibly shared) OCR pool */
+    k2ocr_discard_jobs(k2settings);
+#endif
     masterinfo->bmp.height=masterinfo->bmp.width=0;
     masterinfo->bmp.bpp=k2settings->dst_color ? 24 : 8;
     for (i=0;i<256;i++)
@@ -109,6 +119,7 @@ void masterinfo_init(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings)
 #endif
         masterinfo->debugfolder[0]='\0';
     masterinfo->rows=0;
+    masterinfo->toprow=0;
     masterinfo->lastrow.lcheight = -1;
     masterinfo->lastrow.capheight = -1;
     masterinfo->lastrow.h5050 = -1;
@@ -175,6 +186,20 @@ void masterinfo_free(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings)
 #endif
     wpdfoutline_free(masterinfo->outline);
     ocrwords_free(&masterinfo->mi_ocrwords);
+#ifdef HAVE_LEPTONICA_LIB
+    wlept_dewarp_models_free(masterinfo->dewarp_models);
+    masterinfo->dewarp_models=NULL;
+#endif
+    wtextchars_free(&masterinfo->ocrlayer_chars);
+    masterinfo->ocrlayer_page=-1;
+    /* v2.56:  Deferred OCR pages should already be written out */
+    {
+    int i;
+    for (i=masterinfo->deferred_ocr_pages.n-1;i>=0;i--)
+        ocrwords_free(&masterinfo->deferred_ocr_pages.page[i].words);
+    }
+    willus_mem_free((double **)&masterinfo->deferred_ocr_pages.page,funcname);
+    masterinfo->deferred_ocr_pages.n=masterinfo->deferred_ocr_pages.na=0;
     /* Clear page queue */
     willus_mem_free((double **)&masterinfo->queued_page_info.page,funcname);
     masterinfo->queued_page_info.n=0;
@@ -275,9 +300,13 @@ printf("masterinfo->landscape=%d\n",masterinfo->landscape);
                         k2settings->debug,k2settings->verbose);
     if (k2settings->src_autostraighten > 0.)
         {
+        WPROFILETIMER timer;
         double rot;
+
+        wprofile_start(&timer);
         rot=bmp_autostraighten(src,srcgrey,white,k2settings->src_autostraighten,0.1,
-                               k2settings->debug,out);
+                               masterinfo_page_threads(k2settings),k2settings->debug,out);
+        wprofile_stop(&timer,"deskew",(double)bmp_bytewidth(srcgrey)*srcgrey->height);
 #ifdef HAVE_K2GUI
         if (k2gui_active() && fabs(rot)>1e-4)
             k2printf("\n(Page straightened--rotated cc by %.2f deg.)\n",rot);
@@ -299,7 +328,9 @@ printf("Done autocrop.\n");
     if (k2settings->dewarp && !k2settings->use_crop_boxes)
         {
         WILLUSBITMAP _dwbmp,*dwbmp;
+        WPROFILETIMER timer;
 
+        wprofile_start(&timer);
         dwbmp=&_dwbmp;
         bmp_init(dwbmp);
         bmp_copy(dwbmp,srcgrey);
@@ -320,8 +351,11 @@ printf("Done autocrop.\n");
             wfile_written_info("dewarp_image.png",stdout);
             aprintf(TTEXT_NORMAL);
             }
-        wlept_bmp_dewarp(dwbmp,src,srcgrey,white,k2settings->dewarp,
-                         k2settings->debug?"k2opt_dewarp_model.pdf":NULL);
+        /* v2.56:  Pages with no usable model of their own use a nearby page's */
+        if (masterinfo->dewarp_models==NULL)
+            masterinfo->dewarp_models=wlept_dewarp_models_new(30);
+        wlept_bmp_dewarp(masterinfo->dewarp_models,pageno,dwbmp,src,srcgrey,white,
+                         k2settings->dewarp,k2settings->debug?"k2opt_dewarp_model.pdf":NULL);
         if (k2settings->debug)
             {
             aprintf(TTEXT_BOLD);
@@ -329,6 +363,7 @@ printf("Done autocrop.\n");
             aprintf(TTEXT_NORMAL);
             }
         bmp_free(dwbmp);
+        wprofile_stop(&timer,"dewarp",(double)bmp_bytewidth(srcgrey)*srcgrey->height);
         /* Re-do autocrop after de-warp */
         if (k2settings->autocrop)
             bmp_autocrop2(srcgrey,masterinfo->autocrop_margins,(double)k2settings->autocrop/1000.);
@@ -362,6 +397,8 @@ printf("22\n");
     region->bgcolor = white;
     region->bmp = src;
     region->bmp8 = srcgrey;
+    /* v2.56:  srcgrey was changed (and may have been re-allocated) above */
+    bmpregion_integral_invalidate(region);
     region->pageno = pageno;
     /* Not parsed for rows of text yet */
     textrows_clear(&region->textrows);
@@ -409,6 +446,18 @@ void masterinfo_add_pagebreakmark(MASTERINFO *masterinfo,int marktype)
     }
 
 
+/*
+** v2.56:  Threads used to deskew a source page (the -ntr count)
+*/
+static int masterinfo_page_threads(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    if (k2settings->render_threads<0)
+        return(wsys_num_cpus()*abs(k2settings->render_threads)/100);
+    return(k2settings->render_threads);
+    }
+
+
 static int masterinfo_detecting_orientation(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
                                  WILLUSBITMAP *src,WILLUSBITMAP *srcgrey,
                                  char *rotstr,double rot_deg,double *bormean,int pageno)
@@ -864,24 +913,22 @@ printf("==> FLUSHING\n");
     dw2=masterinfo->bmp.width-tmp->width-dw;
     dw *= srcbytespp;
     dw2 *= srcbytespp;
-    while (masterinfo->rows+tmp->height+gap_start > masterinfo->bmp.height)
-        bmp_more_rows(&masterinfo->bmp,1.4,255);
+    masterinfo_more_rows(masterinfo,tmp->height+gap_start);
 #if (WILLUSDEBUGX & 512)
 {
-static int count=0;
 /*
+static int count=0;
 char filename[MAXFILENAMELEN];
-int ht;
-ht=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
+WILLUSBITMAP view;
+masterinfo_bmp_view(masterinfo,&view,0,masterinfo->rows);
 sprintf(filename,"master%03da.png",count);
-if (masterinfo->bmp.height>0)
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=ht;
+if (view.height>0)
+bmp_write(&view,filename,stdout,100);
 sprintf(filename,"master%03db.png",count);
 if (tmp->height>0)
 bmp_write(tmp,filename,stdout,100);
 */
+}
 #endif
     /*
     ** Add gap
@@ -893,7 +940,7 @@ printf("Applying gap_start=%d before adding tmp bitmap ht %d\n",gap_start,tmp->h
         {
         unsigned char *pdst;
 
-        pdst=bmp_rowptr_from_top(&masterinfo->bmp,masterinfo->rows);
+        pdst=masterinfo_rowptr(masterinfo,masterinfo->rows);
         memset(pdst,255,bmp_bytewidth(&masterinfo->bmp)*gap_start);
         masterinfo->rows += gap_start;
         }
@@ -906,7 +953,7 @@ printf("dw=%d, srcbytewidth=%d, dw2=%d\n",dw,srcbytewidth,dw2);
         unsigned char *pdst,*psrc;
 
         psrc=bmp_rowptr_from_top(tmp,i);
-        pdst=bmp_rowptr_from_top(&masterinfo->bmp,masterinfo->rows);
+        pdst=masterinfo_rowptr(masterinfo,masterinfo->rows);
         memset(pdst,255,dw);
         pdst += dw;
         memcpy(pdst,psrc,srcbytewidth);
@@ -917,14 +964,12 @@ printf("dw=%d, srcbytewidth=%d, dw2=%d\n",dw,srcbytewidth,dw2);
 #if (WILLUSDEBUGX2==3)
 {
 static int count=0;
-int ht;
+WILLUSBITMAP view;
 char filename[128];
 count++;
 sprintf(filename,"master%03d.png",count);
-ht=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=ht;
+masterinfo_bmp_view(masterinfo,&view,0,masterinfo->rows);
+bmp_write(&view,filename,stdout,100);
 wfile_written_info(filename,stdout);
 }
 #endif
@@ -932,27 +977,17 @@ wfile_written_info(filename,stdout);
 #if (WILLUSDEBUGX & 512)
 {
 static int count=0;
-int ht;
+WILLUSBITMAP view;
 char filename[128];
 count++;
 sprintf(filename,"tmp%03d.png",count);
 bmp_write(tmp,filename,stdout,100);
 wfile_written_info(filename,stdout);
 sprintf(filename,"mst%03d.png",count);
-ht=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
-if (masterinfo->bmp.height>0)
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=ht;
+masterinfo_bmp_view(masterinfo,&view,0,masterinfo->rows);
+if (view.height>0)
+bmp_write(&view,filename,stdout,100);
 wfile_written_info(filename,stdout);
-/*
-ht=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
-sprintf(filename,"master%03dc.png",count);
-if (masterinfo->bmp.height>0)
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=ht;
-*/
 }
 #endif
 
@@ -1196,18 +1231,16 @@ static void masterinfo_pagequeue_pop_queue(MASTERINFO *masterinfo,K2PDFOPT_SETTI
 static void masterinfo_remove_top_rows(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,int rows)
 
     {
-    int bw,i,j;
+    int i,j;
 
-    /* Clear the published page:  move everything "up" by "rows" pixels */
-    bw=bmp_bytewidth(&masterinfo->bmp);
-    for (i=rows;i<masterinfo->rows;i++)
-        {
-        unsigned char *psrc,*pdst;
-        pdst=bmp_rowptr_from_top(&masterinfo->bmp,i-rows);
-        psrc=bmp_rowptr_from_top(&masterinfo->bmp,i);
-        memcpy(pdst,psrc,bw);
-        }
+    /*
+    ** Clear the published page.  v2.56:  Just move the top of the master
+    ** bitmap down by "rows" pixels (see masterinfo_more_rows()).
+    */
+    masterinfo->toprow += rows;
     masterinfo->rows -= rows;
+    if (masterinfo->rows<=0)
+        masterinfo->toprow=0;
 
     /* Adjust page break markers and remove if they are out of range */
     for (i=j=0;i<masterinfo->k2pagebreakmarks.n;i++)
@@ -1245,6 +1278,55 @@ static void masterinfo_remove_top_rows(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS
     }
 
 
+/*
+** v2.56:  Row 0 of the master bitmap is row masterinfo->toprow of masterinfo->bmp.
+** Publishing a page moves toprow down instead of moving the remaining rows up.
+*/
+unsigned char *masterinfo_rowptr(MASTERINFO *masterinfo,int row)
+
+    {
+    return(bmp_rowptr_from_top(&masterinfo->bmp,masterinfo->toprow+row));
+    }
+
+
+/*
+** v2.56:  Make room for nrows more rows at the bottom of the master bitmap.
+** The rows are only moved back up to the top of masterinfo->bmp once the
+** unused rows above them are at least as many as they are, so on average
+** each row is moved no more than once no matter how many pages are taken
+** off the top.
+*/
+void masterinfo_more_rows(MASTERINFO *masterinfo,int nrows)
+
+    {
+    if (masterinfo->toprow+masterinfo->rows+nrows <= masterinfo->bmp.height)
+        return;
+    if (masterinfo->toprow>0 && masterinfo->toprow>=masterinfo->rows)
+        {
+        if (masterinfo->rows>0)
+            memmove(bmp_rowptr_from_top(&masterinfo->bmp,0),masterinfo_rowptr(masterinfo,0),
+                    (size_t)bmp_bytewidth(&masterinfo->bmp)*masterinfo->rows);
+        masterinfo->toprow=0;
+        }
+    while (masterinfo->toprow+masterinfo->rows+nrows > masterinfo->bmp.height)
+        bmp_more_rows(&masterinfo->bmp,1.4,255);
+    }
+
+
+/*
+** v2.56:  Sets view to rows row0 to row0+nrows-1 of the master bitmap without
+** copying them.  Don't free or re-allocate view.
+*/
+void masterinfo_bmp_view(MASTERINFO *masterinfo,WILLUSBITMAP *view,int row0,int nrows)
+
+    {
+    (*view)=masterinfo->bmp;
+    view->data=masterinfo_rowptr(masterinfo,row0);
+    view->height=nrows;
+    view->size_allocated=0;
+    }
+
+
 int masterinfo_fits_on_existing_page(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
                                      int bmpheight_pixels)
 
@@ -1292,14 +1374,13 @@ printf("k2pp=%d, published_pages=%d ==> skippage=%d\n",k2settings->preview_page,
 /*
 if (masterinfo->rows>0)
 {
-static int r,count=0;
+static int count=0;
+WILLUSBITMAP view;
 char filename[128];
 count++;
 sprintf(filename,"master%03d.png",count);
-r=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=r;
+masterinfo_bmp_view(masterinfo,&view,0,masterinfo->rows);
+bmp_write(&view,filename,stdout,100);
 wfile_written_info(filename,stdout);
 }
 */
@@ -1388,14 +1469,13 @@ printf("k2pp=%d, published_pages=%d ==> skippage=%d\n",k2settings->preview_page,
 /*
 if (masterinfo->rows>0)
 {
-static int r,count=0;
+static int count=0;
+WILLUSBITMAP view;
 char filename[128];
 count++;
 sprintf(filename,"master%03d.png",count);
-r=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=r;
+masterinfo_bmp_view(masterinfo,&view,0,masterinfo->rows);
+bmp_write(&view,filename,stdout,100);
 wfile_written_info(filename,stdout);
 }
 */
@@ -1533,15 +1613,25 @@ printf("SELECTED LIST BEFORE:\n");
 ocrwords_echo(ocrwords,stdout,1,0);
 #endif
         for (i=0;i<masterinfo->mi_ocrwords.n;i++)
-            if (masterinfo->mi_ocrwords.word[i].r 
-                        - masterinfo->mi_ocrwords.word[i].maxheight 
-                        + masterinfo->mi_ocrwords.word[i].h/2 < rowcount)
+            {
+            OCRWORD *word;
+            WILLUSBITMAP *wbmp;
+            double rc;
+
+            word=&masterinfo->mi_ocrwords.word[i];
+            /* v2.56:  Words still being OCR'd (-ocrasync) are placed by their bitmap */
+            if ((wbmp=ocrword_bitmap_ptr(word))!=NULL)
+                rc = word->r + wbmp->height*word->bmpscale/2.;
+            else
+                rc = word->r - word->maxheight + word->h/2;
+            if (rc < rowcount)
                 {
                 if (ocrwords!=NULL)
                     ocrwords_add_word((OCRWORDS *)ocrwords,&masterinfo->mi_ocrwords.word[i]);
                 ocrwords_remove_words(&masterinfo->mi_ocrwords,i,i);
                 i--;
                 }
+            }
         }
 #if (WILLUSDEBUGX2==3)
 printf("SELECTED LIST AFTER:\n");
@@ -1569,7 +1659,7 @@ ocrwords_echo(ocrwords,stdout,1,0);
     bw=bmp_bytewidth(&masterinfo->bmp);
     bw1=w1*bpp;
     for (i=0;i<rowcount;i++)
-        memcpy(bmp_rowptr_from_top(bmp1,i)+bw1,bmp_rowptr_from_top(&masterinfo->bmp,i),bw);
+        memcpy(bmp_rowptr_from_top(bmp1,i)+bw1,masterinfo_rowptr(masterinfo,i),bw);
 #ifdef HAVE_OCR_LIB
     if (k2settings->dst_ocr && ocrwords!=NULL)
         {
@@ -1649,7 +1739,10 @@ ocrwords_to_easyplot(ocrwords,"postsort.ep",0,NULL);
         {
         char basename[32];
         char opbmpfile[512];
-        static int filecount=0;
+        int filecount;
+
+        /* v2.56:  Count is in the context (was static) for -jobs */
+        filecount=k2ctx_get(k2settings)->debug_page_count;
 
         sprintf(basename,"outpage%05d.%s",filecount+1,k2settings->jpeg_quality>0?"jpg":"png");
         wfile_fullname(opbmpfile,masterinfo->debugfolder,basename);
@@ -1671,7 +1764,7 @@ ocrwords_to_easyplot(ocrwords,"postsort.ep",0,NULL);
                 }
             }
 #endif
-        filecount++;
+        k2ctx_get(k2settings)->debug_page_count=filecount+1;
         }
 #endif
 
@@ -2330,14 +2423,12 @@ static int masterinfo_break_point(MASTERINFO *masterinfo,int row0,
 aprintf(ANSI_CYAN "\n@masterinfo_break_point(rows=%d)" ANSI_NORMAL "\n",masterinfo->rows);
 {
 static int count=0;
-int h;
+WILLUSBITMAP view;
 char filename[256];
 count++;
-h=masterinfo->bmp.height;
-masterinfo->bmp.height=masterinfo->rows;
+masterinfo_bmp_view(masterinfo,&view,0,masterinfo->rows);
 sprintf(filename,"master%04d.png",count);
-bmp_write(&masterinfo->bmp,filename,stdout,100);
-masterinfo->bmp.height=h;
+bmp_write(&view,filename,stdout,100);
 wfile_written_info(filename,stdout);
 }
 #endif
@@ -2422,16 +2513,19 @@ static int masterinfo_break_point_ignoring_page_break_markers(MASTERINFO *master
     {
     int scanheight,j,r1,r2,r1a,r2a,rowcount,rows;
     BMPREGION region;
-    WILLUSBITMAP *bmp,_bmp;
+    WILLUSBITMAP *bmp,_bmp,_view,*view;
 
 /*
 k2printf("@breakpoint, mi->rows=%d, maxsize=%d\n",masterinfo->rows,maxsize);
 k2printf("    fit_to_page=%d\n",(int)masterinfo->fit_to_page);
 {
 static int count=1;
+WILLUSBITMAP mview;
 char filename[MAXFILENAMELEN];
 sprintf(filename,"page%04d.png",count++);
-bmp_write(&masterinfo->bmp,filename,stdout,100);
+masterinfo_bmp_view(masterinfo,&mview,0,masterinfo->rows);
+if (mview.height>0)
+bmp_write(&mview,filename,stdout,100);
 }
 */
     /* Valid rows in master bitmap */
@@ -2463,17 +2557,15 @@ fabs((double)scanheight/masterinfo->rows-1.));
     /*
     ** Find text rows (and gaps between)
     */
+    /* v2.56:  Only copy the rows being scanned */
+    view=&_view;
+    masterinfo_bmp_view(masterinfo,view,row0,scanheight*1.4 > rows ? rows : scanheight*1.4);
     bmp=&_bmp;
     bmp_init(bmp);
-    if (bmp_is_grayscale(&masterinfo->bmp))
-        bmp_copy(bmp,&masterinfo->bmp);
+    if (bmp_is_grayscale(view))
+        bmp_copy(bmp,view);
     else
-        bmp_convert_to_grayscale_ex(bmp,&masterinfo->bmp);
-    if (row0>0)
-        bmp_eliminate_top_rows(bmp,row0);
-    bmp->height=scanheight*1.4;
-    if (bmp->height >  rows)
-        bmp->height = rows;
+        bmp_convert_to_grayscale_ex(bmp,view);
     bmpregion_init(&region);
     region.bgcolor=masterinfo->bgcolor;
     region.c1=0;
@@ -2726,6 +2818,8 @@ printf("userrect(end)=%g,%g,%g,%g\n",userrect->p[0].x,userrect->p[0].y,userrect-
     }
             
 /*
+** v2.56:  The text-layer chars are kept in masterinfo (they were static).
+**
 ** Distances are from upper-left corner of source page in inches.
 ** rect->p[0].x = left side of OCR layer bounding box.
 ** rect->p[0].y = top side of OCR layer bounding box.
@@ -2736,25 +2830,15 @@ static int ocrlayer_bounding_box_inches(MASTERINFO *masterinfo,LINE2D *rect)
 
     {
 #if (defined(HAVE_MUPDF_LIB) || defined(HAVE_DJVU_LIB))
-    static WTEXTCHARS *wtcs=NULL;
-    static WTEXTCHARS _wtcs;
-    static int pageno=-1;
-    static char pdffile[512];
+    WTEXTCHARS *wtcs;
 
 #if (WILLUSDEBUGX & 0x200000)
 printf("@ocrlayer_bounding_box_inches...masterinfo=%p\n",masterinfo);
-if (wtcs!=NULL)
-printf("    wtcs->n = %d\n",wtcs->n);
 #endif
     if (masterinfo==NULL)
         return(0);
-    if (wtcs==NULL)
-        {
-        wtcs=&_wtcs;
-        wtextchars_init(wtcs);
-        pdffile[0]='\0';
-        }
-    if (pageno!=masterinfo->pageinfo.srcpage || strcmp(pdffile,masterinfo->srcfilename))
+    wtcs=&masterinfo->ocrlayer_chars;
+    if (masterinfo->ocrlayer_page!=masterinfo->pageinfo.srcpage)
         {
         wtextchars_clear(wtcs); /* v2.32 bug fix--clear out any previous words */
         k2ocr_wtextchars_fill_from_page(wtcs,masterinfo->srcfilename,masterinfo->pageinfo.srcpage,"",1);
@@ -2762,9 +2846,7 @@ printf("    wtcs->n = %d\n",wtcs->n);
         if (masterinfo->document_scale_factor!=1)
             wtextchars_scale_page(wtcs,masterinfo->document_scale_factor);
         wtextchars_rotate_clockwise(wtcs,360-(int)masterinfo->pageinfo.srcpage_rot_deg);
-        pageno=masterinfo->pageinfo.srcpage;
-        strncpy(pdffile,masterinfo->srcfilename,511);
-        pdffile[511]='\0';
+        masterinfo->ocrlayer_page=masterinfo->pageinfo.srcpage;
         }
 #if (WILLUSDEBUGX & 0x200000)
 if (wtcs!=NULL)
@@ -2868,11 +2950,9 @@ printf("TEXTROW[%2d]=%d\n",i,region->textrows.textrow[i].type);
             if (textrow->type==REGION_TYPE_TEXTLINE)
                 {
                 if (k2settings->dst_fgtype==4)
-                    strcpy(fgc,k2settings_color_by_index(k2settings->dst_fgcolor,
-                                                         masterinfo->rcindex%nfg));
+                    k2settings_color_by_index(fgc,k2settings->dst_fgcolor,masterinfo->rcindex%nfg);
                 if (k2settings->dst_bgtype==4)
-                    strcpy(bgc,k2settings_color_by_index(k2settings->dst_bgcolor,
-                                                         masterinfo->rcindex%nbg));
+                    k2settings_color_by_index(bgc,k2settings->dst_bgcolor,masterinfo->rcindex%nbg);
                 masterinfo->rcindex++;
                 /* For some reason if it's a single text line, need to re-calc bbox. */
                 /* Should investigate why at some point... */
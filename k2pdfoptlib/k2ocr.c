@@ -27,24 +27,24 @@
 
 #ifdef HAVE_OCR_LIB
 static int k2ocr_gocr_inited=0;
-static int maxthreads=0;
-static double ocr_cpu_time_secs=0.;
 #if (defined(HAVE_TESSERACT_LIB))
-static void **ocrtess_api;
 static void *otinit(void *data);
-static int k2ocr_tess_inited=0;
 static int k2ocr_tess_status=0;
 typedef struct
     {
     K2PDFOPT_SETTINGS *k2settings;
+    K2OCRENGINE *engine;
     int index;
     int ni;
     char initstr[256];
     } OCRTESSINITINFO;
 #endif
+static K2OCRENGINE *k2ocr_engine(K2PDFOPT_SETTINGS *k2settings);
 static void k2ocr_show_envvar(char *buf,char *color,char *var);
 static void k2ocr_status_line(char *buf,char *color,char *label,char *string);
 static void k2ocr_tesslang_init(char *lang,int assume_yes);
+static void k2ocr_queue_bitmap(OCRWORDS *words,K2PDFOPT_SETTINGS *k2settings,WILLUSBITMAP *bmp8,
+                               int dpi,int c1,int r1,int c2,int r2,int lcheight);
 static void k2ocr_ocrwords_add_subregion_to_queue(MASTERINFO *masterinfo,OCRWORDS *words,
                                         BMPREGION *region,K2PDFOPT_SETTINGS *k2settings);
 #endif /* HAVE_OCR_LIB */
@@ -56,6 +56,7 @@ static void k2ocr_ocrwords_get_from_ocrlayer(MASTERINFO *masterinfo,OCRWORDS *wo
 static int ocrword_map_to_bitmap(OCRWORD *word,MASTERINFO *masterinfo,BMPREGION *region,
                                  K2PDFOPT_SETTINGS *k2settings,int *index,int *i2);
 static int wrectmap_srcword_inside(WRECTMAP *wrectmap,OCRWORD *word,BMPREGION *region,int *i2);
+static void wrectmap_src_box(WRECTMAP *wrectmap,double *x0,double *y0,double *x1,double *y1);
 static int k2ocr_ocrword_verify_boundingbox(OCRWORD *word,BMPREGION *region);
 static void wtextchars_group_by_words(WTEXTCHARS *wtcs,OCRWORDS *words,
                                       K2PDFOPT_SETTINGS *k2settings);
@@ -71,18 +72,19 @@ void k2ocr_init(K2PDFOPT_SETTINGS *k2settings,char *initstr)
     {
 #ifdef HAVE_OCR_LIB
     static char *funcname="k2ocr_init";
-    static char ocrinitmessage[256];
     static char logfilename[256];
+    K2OCRENGINE *engine;
 
     initstr[0]='\0';
-    if (maxthreads==0)
+    engine=k2ocr_engine(k2settings);
+    if (engine->maxthreads==0)
         {
         if (k2settings->nthreads<0)
-            maxthreads=wsys_num_cpus()*abs(k2settings->nthreads)/100;
+            engine->maxthreads=wsys_num_cpus()*abs(k2settings->nthreads)/100;
         else
-            maxthreads=k2settings->nthreads;
-        if (maxthreads<1)
-            maxthreads=1;
+            engine->maxthreads=k2settings->nthreads;
+        if (engine->maxthreads<1)
+            engine->maxthreads=1;
         }
     if (!k2settings->dst_ocr)
         return;
@@ -114,7 +116,7 @@ void k2ocr_init(K2PDFOPT_SETTINGS *k2settings,char *initstr)
         {
 #endif
         /* v2.15 fix--specific variable for Tesseract init status */
-        if (!k2ocr_tess_inited)
+        if (!engine->tess_inited)
             {
             int i,j,ni;
             pthread_t *thread;
@@ -130,20 +132,22 @@ void k2ocr_init(K2PDFOPT_SETTINGS *k2settings,char *initstr)
             ocrtess_set_logfile(k2ocr_logfile);
 
             /* v2.40 -- multithreaded init */
-            willus_mem_alloc_warn((void **)(&ocrtess_api),sizeof(void*)*maxthreads,funcname,10); 
-            if (maxthreads>=8)
+            willus_mem_alloc_warn((void **)(&engine->ocrtess_api),
+                                  sizeof(void*)*engine->maxthreads,funcname,10);
+            if (engine->maxthreads>=8)
                 ni=4;
-            else if (maxthreads>=2)
+            else if (engine->maxthreads>=2)
                 ni=2;
             else
                 ni=1;
             willus_mem_alloc_warn((void**)&thread,sizeof(pthread_t)*ni,funcname,10);
             willus_mem_alloc_warn((void**)&otii,sizeof(OCRTESSINITINFO)*ni,funcname,10);
-            if (maxthreads>1)
-                k2printf("Initializing OCR for %d threads ",maxthreads);
+            if (engine->maxthreads>1)
+                k2printf("Initializing OCR for %d threads ",engine->maxthreads);
             for (i=0;i<ni;i++)
                 {
                 otii[i].k2settings=k2settings;
+                otii[i].engine=engine;
                 otii[i].ni=ni;
                 otii[i].index=i;
                 otii[i].initstr[0]='\0';
@@ -155,54 +159,54 @@ void k2ocr_init(K2PDFOPT_SETTINGS *k2settings,char *initstr)
                 if (istr==NULL && otii[i].initstr[0]!='\0')
                     istr=otii[i].initstr;
                 }
-            for (i=j=0;i<maxthreads;i++)
+            for (i=j=0;i<engine->maxthreads;i++)
                 {
-                if (ocrtess_api[i]==NULL)
+                if (engine->ocrtess_api[i]==NULL)
                     {
-                    if (maxthreads>1)
+                    if (engine->maxthreads>1)
                         k2printf(TTEXT_WARN "x" TTEXT_NORMAL);
                     continue;
                     }
                 if (i!=j)
-                    ocrtess_api[j]=ocrtess_api[i];
+                    engine->ocrtess_api[j]=engine->ocrtess_api[i];
                 j++;
                 }
             ocrtess_set_logfile(NULL); /* Close debugging file */
-            if (maxthreads>1)
+            if (engine->maxthreads>1)
                 k2printf("\n");
             if (j>0)
                 {
                 if (istr!=NULL)
-                    xstrncpy(ocrinitmessage,istr,255);
+                    xstrncpy(engine->initmessage,istr,255);
                 else
-                    strcpy(ocrinitmessage,"Tesseract initialized (no init message returned).");
-                k2printf("%s%s%s\n",TTEXT_BOLD,ocrinitmessage,TTEXT_NORMAL);
-                if (j<maxthreads)
+                    strcpy(engine->initmessage,"Tesseract initialized (no init message returned).");
+                k2printf("%s%s%s\n",TTEXT_BOLD,engine->initmessage,TTEXT_NORMAL);
+                if (j<engine->maxthreads)
                     {
                     k2printf(TTEXT_WARN "** Only able to initialize %d instances of Tesseract. **"
                              TTEXT_NORMAL "\n",j);
-                    maxthreads=j;
+                    engine->maxthreads=j;
                     }
                 k2ocr_tess_status=0;
                 }
             else
                 {
-                sprintf(ocrinitmessage,"Could not initialize any Tesseract threads.\n"
+                sprintf(engine->initmessage,"Could not initialize any Tesseract threads.\n"
                      "Possibly could not find Tesseract data (env var TESSDATA_PREFIX = %s).\n"
                      "Using GOCR v0.50.\n\n",
                      getenv("TESSDATA_PREFIX")==NULL?"(not assigned)":getenv("TESSDATA_PREFIX"));
                 k2ocr_tess_status=-1;
-                maxthreads=1;
-                k2printf(TTEXT_WARN "%s" TTEXT_NORMAL,ocrinitmessage);
+                engine->maxthreads=1;
+                k2printf(TTEXT_WARN "%s" TTEXT_NORMAL,engine->initmessage);
                 k2ocr_showlog();
                 }
-            strcat(initstr,ocrinitmessage);
+            strcat(initstr,engine->initmessage);
             willus_mem_free((double **)&otii,funcname);
             willus_mem_free((double **)&thread,funcname);
-            k2ocr_tess_inited=1;
+            engine->tess_inited=1;
             }
         else
-            strcat(initstr,ocrinitmessage);
+            strcat(initstr,engine->initmessage);
 #ifdef HAVE_GOCR_LIB
         }
     else
@@ -214,15 +218,50 @@ void k2ocr_init(K2PDFOPT_SETTINGS *k2settings,char *initstr)
             {
             if (!k2ocr_gocr_inited)
                 {
-                strcpy(ocrinitmessage,"GOCR v0.50 OCR Engine");
-                k2printf(TTEXT_BOLD "%s" TTEXT_NORMAL "\n\n",ocrinitmessage);
+                strcpy(engine->initmessage,"GOCR v0.50 OCR Engine");
+                k2printf(TTEXT_BOLD "%s" TTEXT_NORMAL "\n\n",engine->initmessage);
                 k2ocr_gocr_inited=1;
                 }
-            strcat(initstr,ocrinitmessage);
-            maxthreads=1;
+            strcat(initstr,engine->initmessage);
+            engine->maxthreads=1;
             }
         }
 #endif
+    /*
+    ** v2.56:  Start persistent OCR thread pool.  Word bitmaps are submitted to it
+    **         as they are queued so that OCR runs in parallel with page layout.
+    */
+    if (engine->pool!=NULL && engine->pool_type!=k2settings->dst_ocr)
+        {
+        ocrpool_stop(engine->pool);
+        engine->pool=NULL;
+        }
+    if (engine->pool==NULL && (k2settings->dst_ocr=='t' || k2settings->dst_ocr=='g'))
+        {
+#ifdef HAVE_TESSERACT_LIB
+        engine->pool=ocrpool_start(k2settings->dst_ocr=='t' ? engine->ocrtess_api : NULL,
+                                   engine->maxthreads);
+#else
+        engine->pool=ocrpool_start(NULL,engine->maxthreads);
+#endif
+        engine->pool_type=k2settings->dst_ocr;
+        }
+    /* v2.56:  OCR result cache (-ocrc, -ocrcf), kept separate for each language */
+#ifdef HAVE_TESSERACT_LIB
+    if (k2settings->dst_ocr=='t')
+        {
+        char tag[80];
+
+        sprintf(tag,"tess_%s",k2settings->dst_ocr_lang);
+        ocrcache_init(k2settings->ocr_cache_mb*1024.*1024.,k2settings->ocr_cache_file,tag);
+        }
+    else
+#endif
+    if (k2settings->dst_ocr=='g')
+        ocrcache_init(k2settings->ocr_cache_mb*1024.*1024.,k2settings->ocr_cache_file,"gocr");
+    /* v2.56:  Batch single-word bitmaps for Tesseract (-ocrwb) */
+    ocrpool_set_batch(engine->pool,k2settings->dst_ocr=='t' && k2settings->ocr_detection_type=='w'
+                                      ? k2settings->ocr_word_batch : 0);
 #ifdef HAVE_MUPDF_LIB
     /* Could announce MuPDF virtual OCR here, but I think it will just confuse people. */
     /*
@@ -377,31 +416,33 @@ static void *otinit(void *data)
 
     {
     OCRTESSINITINFO *otii;
+    K2OCRENGINE *engine;
     char *lang;
     char initstr[256];
     int ntries,i,status;
 
     otii=(OCRTESSINITINFO*)data;
+    engine=otii->engine;
     lang=otii->k2settings->dst_ocr_lang;
-    for (i=otii->index;i<maxthreads;i+=otii->ni)
-        ocrtess_api[i]=NULL;
+    for (i=otii->index;i<engine->maxthreads;i+=otii->ni)
+        engine->ocrtess_api[i]=NULL;
     for (ntries=0;ntries<5;ntries++)
         {
         int done=1;
 
-        for (i=otii->index;i<maxthreads;i+=otii->ni)
+        for (i=otii->index;i<engine->maxthreads;i+=otii->ni)
             {
-            if (ocrtess_api[i]!=NULL)
+            if (engine->ocrtess_api[i]!=NULL)
                 continue;
-            ocrtess_api[i]=ocrtess_init(NULL,NULL,0,
+            engine->ocrtess_api[i]=ocrtess_init(NULL,NULL,0,
                                         lang[0]=='\0'?NULL:lang,NULL,initstr,255,&status);
-            if (ocrtess_api[i]==NULL)
+            if (engine->ocrtess_api[i]==NULL)
                 done=0;
             else
                 {
                 if (otii->initstr[0]=='\0')
                     strcpy(otii->initstr,initstr);
-                if (maxthreads>1)
+                if (engine->maxthreads>1)
                     k2printf(".");
                 }
 //            if (ntries>3)
@@ -481,19 +522,26 @@ void k2ocr_end(K2PDFOPT_SETTINGS *k2settings)
     if (k2ocr_logfile!=NULL)
         remove(k2ocr_logfile);
 #ifdef HAVE_OCR_LIB
+    K2OCRENGINE *engine;
+
+    engine=k2ocr_engine(k2settings);
+    /* v2.56:  Pool threads use the Tesseract APIs, so stop them first */
+    ocrpool_stop(engine->pool);
+    engine->pool=NULL;
+    ocrcache_clear();
 #ifdef HAVE_TESSERACT_LIB
     static char *funcname="k2ocr_end";
-    if (k2ocr_tess_inited)
+    if (engine->tess_inited)
         {
         int i;
 
-        for (i=maxthreads-1;i>=0;i--)
+        for (i=engine->maxthreads-1;i>=0;i--)
             {
-            ocrtess_end(ocrtess_api[i]);
-            ocrtess_api[i]=NULL;
+            ocrtess_end(engine->ocrtess_api[i]);
+            engine->ocrtess_api[i]=NULL;
             }
-        willus_mem_free((double **)&ocrtess_api,funcname);
-        k2ocr_tess_inited=0;
+        willus_mem_free((double **)&engine->ocrtess_api,funcname);
+        engine->tess_inited=0;
         }
 #endif
 #endif /* HAVE_OCR_LIB */
@@ -613,8 +661,8 @@ k2printf("  %d row%s of text, dst_ocr='%c'\n",region->textrows.n,region->textrow
     if (k2settings->dst_ocr=='t' && 
           (k2settings->ocr_detection_type=='p' || k2settings->ocr_detection_type=='c'))
         /* Queue entire page at once */
-        ocrwords_queue_bitmap(words,region->bmp8,region->dpi,
-                                region->c1,region->r1,region->c2,region->r2,-1);
+        k2ocr_queue_bitmap(words,k2settings,region->bmp8,region->dpi,
+                             region->c1,region->r1,region->c2,region->r2,-1);
     else /* Use k2pdfopt engine to parse row by row */
         {
         /*
@@ -653,11 +701,11 @@ region->textrows.textrow[i].r2-region->textrows.textrow[i].r1+1);
                 if ((double)(region->textrows.textrow[i].r2-region->textrows.textrow[i].r1+1)
                               / region->dpi > k2settings->ocr_max_height_inches)
                     continue;
-                ocrwords_queue_bitmap(words,region->bmp8,region->dpi,
-                                        region->textrows.textrow[i].c1,
-                                        region->textrows.textrow[i].r1,
-                                        region->textrows.textrow[i].c2,
-                                        region->textrows.textrow[i].r2,(int)(lcheight+.5));
+                k2ocr_queue_bitmap(words,k2settings,region->bmp8,region->dpi,
+                                     region->textrows.textrow[i].c1,
+                                     region->textrows.textrow[i].r1,
+                                     region->textrows.textrow[i].c2,
+                                     region->textrows.textrow[i].r2,(int)(lcheight+.5));
                 continue;
                 }
 
@@ -671,11 +719,11 @@ region->textrows.textrow[i].r2-region->textrows.textrow[i].r1+1);
                 if ((double)(textwords->textrow[j].r2-textwords->textrow[j].r1+1)/region->dpi
                          > k2settings->ocr_max_height_inches)
                     continue;
-                ocrwords_queue_bitmap(words,region->bmp8,region->dpi,
-                                        textwords->textrow[j].c1,
-                                        textwords->textrow[j].r1,
-                                        textwords->textrow[j].c2,
-                                        textwords->textrow[j].r2,(int)(lcheight+.5));
+                k2ocr_queue_bitmap(words,k2settings,region->bmp8,region->dpi,
+                                     textwords->textrow[j].c1,
+                                     textwords->textrow[j].r1,
+                                     textwords->textrow[j].c2,
+                                     textwords->textrow[j].r2,(int)(lcheight+.5));
                 }
             bmpregion_free(newregion);
             } /* text row loop */
@@ -721,71 +769,480 @@ printf("Done k2ocr_ocrwords_add_subregion_to_queue()\n");
     }
 
 
+/*
+** Queue a word bitmap for OCR and start it in the OCR thread pool (v2.56)
+*/
+static void k2ocr_queue_bitmap(OCRWORDS *words,K2PDFOPT_SETTINGS *k2settings,WILLUSBITMAP *bmp8,
+                               int dpi,int c1,int r1,int c2,int r2,int lcheight)
+
+    {
+    K2OCRENGINE *engine;
+
+    engine=k2ocr_engine(k2settings);
+    ocrwords_queue_bitmap(words,bmp8,dpi,c1,r1,c2,r2,lcheight);
+    if (engine->pool!=NULL && engine->pool_type==k2settings->dst_ocr)
+        ocrpool_submit(engine->pool,k2ctx_get(k2settings),&words->word[words->n-1],
+                       k2settings->dst_ocr,
+                       k2settings->ocr_dpi);
+    }
+
+
 void k2ocr_multithreaded_ocr(OCRWORDS *words,K2PDFOPT_SETTINGS *k2settings)
 
     {
-    ocr_cpu_time_secs += ocrwords_multithreaded_ocr(words,ocrtess_api,maxthreads,
-                                                    k2settings->dst_ocr,
-                                                    k2settings->ocr_dpi);
+    K2OCRENGINE *engine;
+    WPROFILETIMER timer;
+    double cpu_secs;
+
+    engine=k2ocr_engine(k2settings);
+    wprofile_start(&timer);
+    if (engine->pool!=NULL && engine->pool_type==k2settings->dst_ocr)
+        cpu_secs=ocrpool_ocrwords(engine->pool,words,k2settings->dst_ocr,k2settings->ocr_dpi);
+    else
+        cpu_secs=ocrwords_multithreaded_ocr(words,engine->ocrtess_api,engine->maxthreads,
+                                            k2settings->dst_ocr,k2settings->ocr_dpi);
+    wprofile_stop_cpu(&timer,"ocr",cpu_secs,0.);
+    /* v2.56:  OCR CPU time is totaled per context, even with a shared engine */
+    k2ctx_get(k2settings)->ocr.cpu_time_secs += cpu_secs;
     }
 
 
-double k2ocr_cpu_time_secs(void)
+/*
+** v2.56:  Returns non-zero if output pages can be written before their words
+**         are OCR'd, with the OCR text layer added later (-ocrasync).
+**         Landscape output rotates the word positions, and boxes are drawn
+**         onto the bitmap, so both need the OCR results up front.
+*/
+int k2ocr_async(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings)
 
     {
-    return(ocr_cpu_time_secs);
+    K2OCRENGINE *engine;
+
+    engine=k2ocr_engine(k2settings);
+    return(k2settings->ocr_async && engine->pool!=NULL && engine->pool_type==k2settings->dst_ocr
+             && masterinfo->preview_bitmap==NULL
+             && !k2settings_output_is_bitmap(k2settings) && !k2settings->use_crop_boxes
+             && !(k2settings->dst_ocr_visibility_flags&4)
+             && !k2settings->dst_landscape && k2settings->dst_landscape_pages[0]=='\0');
     }
 
 
-void k2ocr_cpu_time_reset(void)
+/*
+** v2.56:  Write output page bmp now, and hand its words (which are still
+**         being OCR'd) to the deferred page list.  words is cleared.
+*/
+void k2ocr_deferred_page_add(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
+                             WILLUSBITMAP *bmp,double dpi,int size_reduction,OCRWORDS *words)
 
     {
-    ocr_cpu_time_secs=0.;
+    static char *funcname="k2ocr_deferred_page_add";
+    DEFERRED_OCR_PAGES *dop;
+    DEFERRED_OCR_PAGE *page;
+
+    dop=&masterinfo->deferred_ocr_pages;
+    if (dop->n>=dop->na)
+        {
+        int newsize;
+
+        newsize = dop->na<16 ? 32 : dop->na*2;
+        willus_mem_realloc_robust_warn((void **)&dop->page,newsize*sizeof(DEFERRED_OCR_PAGE),
+                                       dop->na*sizeof(DEFERRED_OCR_PAGE),funcname,10);
+        dop->na=newsize;
+        }
+    page=&dop->page[dop->n++];
+    page->handle=pdffile_add_bitmap_with_deferred_ocrwords(&masterinfo->outfile,bmp,dpi,
+                                        k2settings->jpeg_quality,size_reduction,
+                                        k2settings->dst_ocr_visibility_flags);
+    page->pageno=masterinfo->published_pages;
+    page->words=(*words);
+    ocrwords_init(words);
     }
 
 
-int k2ocr_max_threads(void)
+/*
+** v2.56:  Add the OCR text layers of deferred pages whose words are done
+**         being OCR'd, in page order.  If wait!=0, waits for all of them.
+**         Then drops any OCR jobs that no longer have a word waiting on them.
+*/
+void k2ocr_deferred_pages_write(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,int wait)
 
     {
-    return(maxthreads);
+    K2CONTEXT *k2ctx;
+    K2OCRENGINE *engine;
+    DEFERRED_OCR_PAGES *dop;
+    int i,j,ticket;
+
+    k2ctx=k2ctx_get(k2settings);
+    engine=k2ocr_engine(k2settings);
+    dop=&masterinfo->deferred_ocr_pages;
+    for (i=0;i<dop->n;i++)
+        {
+        DEFERRED_OCR_PAGE *page;
+        WPROFILETIMER timer;
+        double cpu_secs;
+
+        page=&dop->page[i];
+        if (!wait && !ocrpool_ocrwords_done(engine->pool,k2ctx,&page->words,
+                                            k2settings->dst_ocr,k2settings->ocr_dpi))
+            break;
+        wprofile_start(&timer);
+        cpu_secs=ocrpool_ocrwords(engine->pool,&page->words,k2settings->dst_ocr,
+                                  k2settings->ocr_dpi);
+        wprofile_stop_cpu(&timer,"ocr",cpu_secs,0.);
+        k2ctx->ocr.cpu_time_secs += cpu_secs;
+        if (masterinfo->ocrfilename[0]!='\0')
+            ocrwords_to_textfile(&page->words,masterinfo->ocrfilename,page->pageno>1);
+        pdffile_add_deferred_ocrwords(&masterinfo->outfile,page->handle,&page->words);
+        masterinfo->wordcount += page->words.n;
+        ocrwords_free(&page->words);
+        }
+    if (i>0)
+        {
+        for (j=i;j<dop->n;j++)
+            dop->page[j-i]=dop->page[j];
+        dop->n -= i;
+        }
+    /* Oldest OCR job that a queued word still needs */
+    for (ticket=0,i=-1;i<dop->n;i++)
+        {
+        OCRWORDS *words;
+
+        words = (i<0) ? &masterinfo->mi_ocrwords : &dop->page[i].words;
+        for (j=0;j<words->n;j++)
+            if (ocrword_bitmap_ptr(&words->word[j])!=NULL && words->word[j].ocrjob>0
+                     && (ticket==0 || words->word[j].ocrjob<ticket))
+                ticket=words->word[j].ocrjob;
+        }
+    ocrpool_discard(engine->pool,k2ctx,ticket==0 ? -1 : ticket);
+    }
+
+
+/*
+** v2.56:  Drop any OCR jobs submitted for words that have been freed
+**         without being OCR'd.
+*/
+void k2ocr_discard_jobs(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    ocrpool_discard(k2ocr_engine(k2settings)->pool,k2ctx_get(k2settings),-1);
+    }
+
+
+double k2ocr_cpu_time_secs(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    return(k2ctx_get(k2settings)->ocr.cpu_time_secs);
+    }
+
+
+void k2ocr_cpu_time_reset(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    k2ctx_get(k2settings)->ocr.cpu_time_secs=0.;
+    }
+
+
+int k2ocr_max_threads(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    return(k2ocr_engine(k2settings)->maxthreads);
+    }
+
+
+/*
+** v2.56:  OCR engine used by the conversion context that k2settings belong to.
+** k2settings may be NULL (default context).
+*/
+static K2OCRENGINE *k2ocr_engine(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    return(k2ctx_ocr_engine(k2ctx_get(k2settings)));
     }
 #endif /* HAVE_OCR_LIB */
 
 
+#if (defined(HAVE_MUPDF_LIB) || defined(HAVE_DJVU_LIB))
+/*
+** v2.56:  Uniform grid over the source-page bounding boxes (in points) of
+** the text-layer words so that each region only has to look at the words
+** near its wrectmaps.  Cell k holds word indices cellword[cellstart[k]]
+** through cellword[cellstart[k+1]-1].  A word is listed in every cell it
+** overlaps, so stamp[] is used to report it only once per query.
+*/
+typedef struct
+    {
+    double x0,y0,dx,dy;
+    int nx,ny;
+    int *cellstart;
+    int *cellword;
+    int *stamp;
+    int query;
+    int *found;
+    int nfound;
+    } OCRWORDGRID;
+
+/*
+** v2.56:  Text-layer words of the most recent source page, kept in the
+** K2CONTEXT (k2ctx->ocrlayer) so that -jobs threads don't share them.
+*/
+typedef struct
+    {
+    OCRWORDS words;
+    OCRWORDGRID grid;
+    WTEXTCHARS wtcs;
+    int pageno;
+    char pdffile[512];
+    } K2OCRLAYER;
+
+static K2OCRLAYER *k2ocrlayer_get(K2CONTEXT *k2ctx);
+static void ocrwordgrid_init(OCRWORDGRID *grid);
+static void ocrwordgrid_free(OCRWORDGRID *grid);
+static void ocrwordgrid_build(OCRWORDGRID *grid,OCRWORDS *words);
+static void ocrwordgrid_cells(OCRWORDGRID *grid,double x0,double y0,double x1,double y1,
+                              int *c0,int *r0,int *c1,int *r1);
+static void ocrwordgrid_find_region_words(OCRWORDGRID *grid,OCRWORDS *words,BMPREGION *region);
+
+
+static K2OCRLAYER *k2ocrlayer_get(K2CONTEXT *k2ctx)
+
+    {
+    static char *funcname="k2ocrlayer_get";
+    K2OCRLAYER *layer;
+
+    if (k2ctx->ocrlayer==NULL)
+        {
+        willus_mem_alloc_warn((void **)&k2ctx->ocrlayer,sizeof(K2OCRLAYER),funcname,10);
+        layer=(K2OCRLAYER *)k2ctx->ocrlayer;
+        ocrwords_init(&layer->words);
+        ocrwordgrid_init(&layer->grid);
+        wtextchars_init(&layer->wtcs);
+        layer->pageno=-1;
+        layer->pdffile[0]='\0';
+        }
+    return((K2OCRLAYER *)k2ctx->ocrlayer);
+    }
+
+
+void k2ocr_ocrlayer_free(K2CONTEXT *k2ctx)
+
+    {
+    static char *funcname="k2ocr_ocrlayer_free";
+    K2OCRLAYER *layer;
+
+    layer=(K2OCRLAYER *)k2ctx->ocrlayer;
+    if (layer==NULL)
+        return;
+    wtextchars_free(&layer->wtcs);
+    ocrwordgrid_free(&layer->grid);
+    ocrwords_free(&layer->words);
+    willus_mem_free((double **)&k2ctx->ocrlayer,funcname);
+    }
+
+
+static void ocrwordgrid_init(OCRWORDGRID *grid)
+
+    {
+    grid->nx=grid->ny=0;
+    grid->cellstart=NULL;
+    grid->cellword=NULL;
+    grid->stamp=NULL;
+    grid->found=NULL;
+    grid->query=0;
+    grid->nfound=0;
+    }
+
+
+static void ocrwordgrid_free(OCRWORDGRID *grid)
+
+    {
+    static char *funcname="ocrwordgrid_free";
+
+    willus_mem_free((double **)&grid->found,funcname);
+    willus_mem_free((double **)&grid->stamp,funcname);
+    willus_mem_free((double **)&grid->cellword,funcname);
+    willus_mem_free((double **)&grid->cellstart,funcname);
+    ocrwordgrid_init(grid);
+    }
+
+
+static void ocrwordgrid_build(OCRWORDGRID *grid,OCRWORDS *words)
+
+    {
+    static char *funcname="ocrwordgrid_build";
+    double x1,y1;
+    int i,k,n,ncells;
+
+    ocrwordgrid_free(grid);
+    if (words->n<=0)
+        return;
+    grid->x0=x1=words->word[0].x0;
+    grid->y0=y1=words->word[0].y0;
+    for (i=0;i<words->n;i++)
+        {
+        OCRWORD *word;
+
+        word=&words->word[i];
+        if (word->x0<grid->x0)
+            grid->x0=word->x0;
+        if (word->y0<grid->y0)
+            grid->y0=word->y0;
+        if (word->x0+word->w0>x1)
+            x1=word->x0+word->w0;
+        if (word->y0+word->h0>y1)
+            y1=word->y0+word->h0;
+        }
+    /* About one word per cell */
+    grid->nx=grid->ny=(int)sqrt((double)words->n)+1;
+    if (grid->nx>256)
+        grid->nx=grid->ny=256;
+    grid->dx=(x1-grid->x0)/grid->nx;
+    grid->dy=(y1-grid->y0)/grid->ny;
+    if (grid->dx<=0.)
+        grid->dx=1.;
+    if (grid->dy<=0.)
+        grid->dy=1.;
+    ncells=grid->nx*grid->ny;
+    willus_mem_alloc_warn((void **)&grid->cellstart,(ncells+1)*sizeof(int),funcname,10);
+    memset(grid->cellstart,0,(ncells+1)*sizeof(int));
+    /* Count words per cell, then turn the counts into cell end indices */
+    for (i=0;i<words->n;i++)
+        {
+        OCRWORD *word;
+        int c,r,c0,r0,c1,r1;
+
+        word=&words->word[i];
+        ocrwordgrid_cells(grid,word->x0,word->y0,word->x0+word->w0,word->y0+word->h0,
+                          &c0,&r0,&c1,&r1);
+        for (r=r0;r<=r1;r++)
+            for (c=c0;c<=c1;c++)
+                grid->cellstart[r*grid->nx+c+1]++;
+        }
+    for (k=0;k<ncells;k++)
+        grid->cellstart[k+1] += grid->cellstart[k];
+    n=grid->cellstart[ncells];
+    willus_mem_alloc_warn((void **)&grid->cellword,(n>0?n:1)*sizeof(int),funcname,10);
+    for (i=words->n-1;i>=0;i--)
+        {
+        OCRWORD *word;
+        int c,r,c0,r0,c1,r1;
+
+        word=&words->word[i];
+        ocrwordgrid_cells(grid,word->x0,word->y0,word->x0+word->w0,word->y0+word->h0,
+                          &c0,&r0,&c1,&r1);
+        for (r=r0;r<=r1;r++)
+            for (c=c0;c<=c1;c++)
+                grid->cellword[--grid->cellstart[r*grid->nx+c+1]]=i;
+        }
+    /* Filling in reverse left cellstart[k+1] at the start of cell k */
+    for (k=0;k<ncells;k++)
+        grid->cellstart[k]=grid->cellstart[k+1];
+    grid->cellstart[ncells]=n;
+    willus_mem_alloc_warn((void **)&grid->stamp,words->n*sizeof(int),funcname,10);
+    memset(grid->stamp,0,words->n*sizeof(int));
+    willus_mem_alloc_warn((void **)&grid->found,words->n*sizeof(int),funcname,10);
+    grid->query=0;
+    }
+
+
+/*
+** Range of grid cells (inclusive) covered by box (x0,y0)-(x1,y1).
+*/
+static void ocrwordgrid_cells(OCRWORDGRID *grid,double x0,double y0,double x1,double y1,
+                              int *c0,int *r0,int *c1,int *r1)
+
+    {
+    (*c0)=(int)floor((x0-grid->x0)/grid->dx);
+    (*c1)=(int)floor((x1-grid->x0)/grid->dx);
+    (*r0)=(int)floor((y0-grid->y0)/grid->dy);
+    (*r1)=(int)floor((y1-grid->y0)/grid->dy);
+    if ((*c0)<0)
+        (*c0)=0;
+    if ((*r0)<0)
+        (*r0)=0;
+    if ((*c1)>grid->nx-1)
+        (*c1)=grid->nx-1;
+    if ((*r1)>grid->ny-1)
+        (*r1)=grid->ny-1;
+    }
+
+
+/*
+** Put into grid->found[] (in word order) the indices of the words that
+** overlap any of the region's wrectmaps.  Uses the same overlap test as
+** wrectmap_srcword_inside(), so no other words can map into the region.
+*/
+static void ocrwordgrid_find_region_words(OCRWORDGRID *grid,OCRWORDS *words,BMPREGION *region)
+
+    {
+    WRECTMAPS *wrectmaps;
+    int i;
+
+    grid->nfound=0;
+    wrectmaps=region->wrectmaps;
+    if (grid->nx<=0 || wrectmaps==NULL)
+        return;
+    grid->query++;
+    for (i=0;i<wrectmaps->n;i++)
+        {
+        double x0,y0,x1,y1;
+        int c,r,c0,r0,c1,r1;
+
+        wrectmap_src_box(&wrectmaps->wrectmap[i],&x0,&y0,&x1,&y1);
+        if (x1<grid->x0 || y1<grid->y0 || x0>grid->x0+grid->nx*grid->dx
+                        || y0>grid->y0+grid->ny*grid->dy)
+            continue;
+        ocrwordgrid_cells(grid,x0,y0,x1,y1,&c0,&r0,&c1,&r1);
+        for (r=r0;r<=r1;r++)
+            for (c=c0;c<=c1;c++)
+                {
+                int k,k1;
+
+                k1=grid->cellstart[r*grid->nx+c+1];
+                for (k=grid->cellstart[r*grid->nx+c];k<k1;k++)
+                    {
+                    OCRWORD *word;
+                    int iw;
+
+                    iw=grid->cellword[k];
+                    if (grid->stamp[iw]==grid->query)
+                        continue;
+                    word=&words->word[iw];
+                    if (word->x0 >= x1 || (word->x0+word->w0) <= x0
+                                       || word->y0 >= y1 || (word->y0+word->h0) <= y0)
+                        continue;
+                    grid->stamp[iw]=grid->query;
+                    grid->found[grid->nfound++]=iw;
+                    }
+                }
+        }
+    sorti(grid->found,grid->nfound);
+    }
+
+
 /*
 ** In a contiguous rectangular region that is mapped to the PDF source file,
 ** find rows of text assuming a single column of text.
 */
-#if (defined(HAVE_MUPDF_LIB) || defined(HAVE_DJVU_LIB))
 static void k2ocr_ocrwords_get_from_ocrlayer(MASTERINFO *masterinfo,OCRWORDS *dwords,
                                              BMPREGION *region,K2PDFOPT_SETTINGS *k2settings)
 
     {
-    static OCRWORDS *words=NULL;
-    static OCRWORDS _words;
-    static int pageno=-1;
-    static char pdffile[512];
-    int i;
+    K2OCRLAYER *layer;
+    OCRWORDS *words;
+    OCRWORDGRID *grid;
+    int j;
 
 #if (WILLUSDEBUGX & 0x10000)
 printf("@k2ocr_ocrwords_get_from_ocrlayer.\n");
 #endif
-    if (words==NULL)
-        {
-        words=&_words;
-        ocrwords_init(words);
-        pdffile[0]='\0';
-        }
-    if (pageno!=masterinfo->pageinfo.srcpage || strcmp(pdffile,masterinfo->srcfilename))
+    layer=k2ocrlayer_get(k2ctx_get(k2settings));
+    words=&layer->words;
+    grid=&layer->grid;
+    if (layer->pageno!=masterinfo->pageinfo.srcpage || strcmp(layer->pdffile,masterinfo->srcfilename))
         {
-        static WTEXTCHARS *wtcs=NULL;
-        static WTEXTCHARS _wtcs;
+        WTEXTCHARS *wtcs;
 
-        if (wtcs==NULL)
-            {
-            wtcs=&_wtcs;
-            wtextchars_init(wtcs);
-            }
+        wtcs=&layer->wtcs;
         ocrwords_free(words);
         wtextchars_clear(wtcs);
         k2ocr_wtextchars_fill_from_page(wtcs,masterinfo->srcfilename,masterinfo->pageinfo.srcpage,"",0);
@@ -812,6 +1269,7 @@ fclose(f);
 #endif
         wtextchars_rotate_clockwise(wtcs,360-(int)masterinfo->pageinfo.srcpage_rot_deg);
         wtextchars_group_by_words(wtcs,words,k2settings);
+        ocrwordgrid_build(grid,words);
 #if (WILLUSDEBUGX2==4)
 ocrwords_to_easyplot(words,"words3.ep",0,NULL);
 printf("Wrote %d words to words3.ep.\n",words->n);
@@ -840,9 +1298,9 @@ word->x0,792.-word->y0,word->x0+word->w0,792.-word->y0,word->x0+word->w0,792.-(w
 fclose(f);
 }
 #endif
-        pageno=masterinfo->pageinfo.srcpage;
-        strncpy(pdffile,masterinfo->srcfilename,511);
-        pdffile[511]='\0';
+        layer->pageno=masterinfo->pageinfo.srcpage;
+        strncpy(layer->pdffile,masterinfo->srcfilename,511);
+        layer->pdffile[511]='\0';
         }
 #if (WILLUSDEBUGX & 0x10000)
 {
@@ -897,13 +1355,19 @@ fprintf(f,"//nc\n");
     ** keep only the words that are within the destination region.
     **
     ** I'm not sure this will work entirely correctly with right-to-left text
+    **
+    ** v2.56:  Only the words that overlap one of the region's wrectmaps
+    **         (found with the page's word grid) are tried.
     */
 #if (WILLUSDEBUGX & 0x10000)
 printf("words->n=%d\n",words->n);
 #endif
-    for (i=0;i<words->n;i++)
+    ocrwordgrid_find_region_words(grid,words,region);
+    for (j=0;j<grid->nfound;j++)
         {
-        int index,i2;
+        int i,index,i2;
+
+        i=grid->found[j];
 
 #if (WILLUSDEBUGX & 0x10000)
 printf("**Word[%4d] = '%s' = ",i,words->word[i].text);
@@ -1105,10 +1569,7 @@ printf("    region->c1,r1-c2,r2 = %d,%d-%d,%d\n",region->c1,region->r1,region->c
     y0_wrect=(wrectmap->coords[0].y+(region->r1-wrectmap->coords[1].y))*72./wrectmap->srcdpih;
     y1_wrect=(wrectmap->coords[0].y+(region->r2+1-wrectmap->coords[1].y))*72./wrectmap->srcdpih;
     */
-    x0_wrect=wrectmap->coords[0].x*72./wrectmap->srcdpiw;
-    x1_wrect=x0_wrect + wrectmap->coords[2].x*72./wrectmap->srcdpiw;
-    y0_wrect=wrectmap->coords[0].y*72./wrectmap->srcdpih;
-    y1_wrect=y0_wrect + wrectmap->coords[2].y*72./wrectmap->srcdpih;
+    wrectmap_src_box(wrectmap,&x0_wrect,&y0_wrect,&x1_wrect,&y1_wrect);
     cx_wrect=(x0_wrect+x1_wrect)/2.;
     cy_wrect=(y0_wrect+y1_wrect)/2.;
 #if (WILLUSDEBUGX2==4)
@@ -1245,6 +1706,20 @@ printf("    Word mxheight = %g\n",word->maxheight);
     }
 
 
+/*
+** Upper-left (x0,y0) and lower-right (x1,y1) corners of the wrectmap's box on
+** the source page, in points.
+*/
+static void wrectmap_src_box(WRECTMAP *wrectmap,double *x0,double *y0,double *x1,double *y1)
+
+    {
+    (*x0)=wrectmap->coords[0].x*72./wrectmap->srcdpiw;
+    (*x1)=(*x0) + wrectmap->coords[2].x*72./wrectmap->srcdpiw;
+    (*y0)=wrectmap->coords[0].y*72./wrectmap->srcdpih;
+    (*y1)=(*y0) + wrectmap->coords[2].y*72./wrectmap->srcdpih;
+    }
+
+
 /*
 ** Find actual word bounding box graphically
 */
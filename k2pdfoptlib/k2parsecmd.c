@@ -231,6 +231,7 @@ int parse_cmd_args(K2PDFOPT_CONVERSION *k2conv,STRBUF *env,STRBUF *cmdline,
         MINUS_OPTION("-t",src_trim,1)
         MINUS_OPTION("-s",dst_sharpen,1)
         MINUS_OPTION("-to",text_only,1)
+        MINUS_OPTION("-xrs",xref_stream,1)
         MINUS_OPTION("-fr",dst_figure_rotate,1)
         MINUS_OPTION("-y",assume_yes,1)
         MINUS_OPTION("-ddr",detect_double_rows,1)
@@ -240,6 +241,7 @@ int parse_cmd_args(K2PDFOPT_CONVERSION *k2conv,STRBUF *env,STRBUF *cmdline,
 #ifdef HAVE_OCR_LIB
         MINUS_OPTION("-ocrvbb",ocrvbb,1)
         MINUS_OPTION("-ocrsort",ocrsort,1)
+        MINUS_OPTION("-ocrasync",ocr_async,1)
         PLUS_MINUS_BITOPTION("-ocrsp",dst_ocr_visibility_flags,8,16,1)
 #endif
         /*
@@ -1443,10 +1445,14 @@ printf("units=%d\n",k2settings->srccropmargins.units[0]);
         NEEDS_STRING("-px",pagexlist,1023,0)
         NEEDS_STRING("-author",dst_author,255,0)
         NEEDS_STRING("-title",dst_title,255,0)
+        NEEDS_STRING("-profile",profile,255,1)
 #ifdef HAVE_OCR_LIB
         NEEDS_STRING("-ocrout",ocrout,127,0)
         if (k2settings->ocrout[0]!='\0' && k2settings->dst_ocr==0)
             k2settings->dst_ocr='m';
+        NEEDS_INTEGER("-ocrwb",ocr_word_batch)
+        NEEDS_INTEGER("-ocrc",ocr_cache_mb)
+        NEEDS_STRING("-ocrcf",ocr_cache_file,MAXFILENAMELEN-1,1)
 #endif
         NEEDS_STRING("-o",dst_opname_format,127,0)
         NEEDS_STRING("-ci",dst_coverimage,255,1)
@@ -1458,6 +1464,10 @@ printf("units=%d\n",k2settings->srccropmargins.units[0]);
             k2settings->user_mag |= 2;
         NEEDS_VALUE_PLUS("-fs",dst_fontsize_pts)
         NEEDS_INTEGER("-nt",nthreads)
+        NEEDS_INTEGER("-ntr",render_threads)
+        NEEDS_INTEGER("-ntw",write_threads)
+        NEEDS_INTEGER("-jobs",jobs)
+        NEEDS_INTEGER("-rc",render_cache_mb)
         NEEDS_VALUE("-vls",vertical_line_spacing)
         NEEDS_VALUE("-vs",max_vertical_gap_inches)
         NEEDS_VALUE("-de",defect_size_pts)
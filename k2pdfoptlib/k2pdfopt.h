@@ -231,6 +231,8 @@ typedef struct
     K2PAGEBREAKMARK k2pagebreakmark[MAXK2PAGEBREAKMARKS];
     } K2PAGEBREAKMARKS;
 
+struct k2context;
+
 /*
 ** K2PDFOPT_SETTINGS stores user settings that affect the document processing.
 */
@@ -272,6 +274,10 @@ typedef struct
     int dst_ocr;
     int ocrvbb;             /* New in v2.53 -ocrvbb option */
     int ocrsort;            /* Moved from visibility flags to separate variable in v2.53 */
+    int ocr_async;          /* v2.56: -ocrasync, write OCR text layers as OCR finishes */
+    int ocr_word_batch;     /* v2.56: -ocrwb, most words per Tesseract call for -ocrd w */
+    int ocr_cache_mb;       /* v2.56: -ocrc, megabytes of OCR results kept for re-use */
+    char ocr_cache_file[MAXFILENAMELEN]; /* v2.56: -ocrcf, disk store of OCR results */
     int ocr_detection_type; /* New in v2.50, 'w', 'l', or 'p' */
     int ocr_dpi;            /* New in v2.51--desired dpi for OCR bitmaps */
                             /* If zero, ignored--use default input dpi */
@@ -439,12 +445,29 @@ typedef struct
     int src_erosion; /* Source erosion filter value */
     int detect_double_rows; /* Detect double or triple text rows "stuck together" */
     double textheight_min_pts; /* Minimum text row height allowed def = -1 (not used) */
+    /* v2.56 */
+    int render_threads; /* Source page rendering threads.  Negative = percent of cpus */
+    int write_threads;  /* Output image compression threads.  Negative = percent of cpus */
+    int xref_stream;    /* -xrs:  PDF output uses a cross-reference stream */
+    int jobs;           /* -jobs:  Number of source files converted at a time */
+    char profile[256];  /* -profile:  JSON file for per-stage timing ("" = none) */
+    int render_cache_mb; /* -rc:  Megabytes of rendered source pages kept for re-use */
+    struct k2context *ctx; /* Conversion context that owns these settings (NULL = default) */
     } K2PDFOPT_SETTINGS;
 
 
+/* List of files to be processed by k2pdfopt */
+typedef struct
+    {
+    char **file;
+    int na;
+    int n;
+    } K2PDFOPT_FILES;
+
 /* Mostly for GUI--controls what to do with file list */
 #define K2PDFOPT_FILELIST_PROCESS_MODE_CONVERT_FILES  1
 #define K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILECOUNT  2
+#define K2PDFOPT_FILELIST_PROCESS_MODE_GET_FILELIST   3
 typedef struct
     {
     int mode;
@@ -452,6 +475,7 @@ typedef struct
     WILLUSBITMAP *bmp; /* Returns preview bitmap */
     char *outname;
     int status; /* 0 = success, otherwise, status code */
+    K2PDFOPT_FILES *files; /* v2.56:  Files found (MODE_GET_FILELIST) */
     } K2PDFOPT_FILELIST_PROCESS;
 
 
@@ -479,14 +503,6 @@ typedef struct
     } K2PDFOPT_FILE_PROCESS;
 
 
-/* List of files to be processed by k2pdfopt */
-typedef struct
-    {
-    char **file;
-    int na;
-    int n;
-    } K2PDFOPT_FILES;
-
 
 typedef struct
     {
@@ -587,6 +603,23 @@ typedef struct
     int n,na;
     } WRECTMAPS;
     
+/*
+** v2.56:  BMPINTEGRAL is the integral image (2-D prefix sum) of the dark
+** pixels (< bgcolor) in a BMPREGION's bmp8 bitmap, so that the number of dark
+** pixels in any rectangle is found with four look-ups.  Built on demand and
+** shared by all copies of the region.  See bmpregion_integral_allocate().
+*/
+typedef struct
+    {
+    WILLUSBITMAP *bmp8;   /* Bitmap the counts are for (set when first built) */
+    unsigned char *data;  /* bmp8->data, width, height, bgcolor when built */
+    int width,height;
+    int bgcolor;
+    int valid;            /* 1 = counts are good, 0 = re-calc, -1 = no memory */
+    int *count;  /* (width+1) x (height+1):  count[r*(width+1)+c] = dark pixels in */
+                 /* rows 0 to r-1, columns 0 to c-1 */
+    } BMPINTEGRAL;
+
 /*
 ** BMPREGION is a rectangular region within a bitmap.  This is the main
 ** data structure used by k2pdfopt to break up the source page.
@@ -609,6 +642,8 @@ typedef struct
     int rotdeg;     /* Source rotation, degrees, counterclockwise */
     int *colcount;  /* Always check for NULL before using */
     int *rowcount;  /* Always check for NULL before using */
+    BMPINTEGRAL *integral; /* NULL if not used */
+    int integral_allocated; /* = 1 if structure was allocated and needs to be freed */
     WILLUSBITMAP *bmp;
     WILLUSBITMAP *bmp8;
     WILLUSBITMAP *marked;
@@ -666,6 +701,21 @@ typedef struct
     int na;
     } QUEUED_PAGE_INFO;
 
+/* v2.56:  Output pages whose OCR text layer is still being OCR'd (-ocrasync) */
+typedef struct
+    {
+    int handle;     /* From pdffile_add_bitmap_with_deferred_ocrwords() */
+    int pageno;     /* Published page number */
+    OCRWORDS words;
+    } DEFERRED_OCR_PAGE;
+
+typedef struct
+    {
+    DEFERRED_OCR_PAGE *page;
+    int n;
+    int na;
+    } DEFERRED_OCR_PAGES;
+
 /*
 ** MASTERINFO contains performance parameters relevant to the device output.
 ** (E.g. the "master" bitmap which is a running scroll of content meant to
@@ -683,6 +733,7 @@ typedef struct
     OCRWORDS mi_ocrwords;/* Queue of OCR bitmaps that have positions corresponding to */
                          /* the master bitmap -- v2.53 */
     QUEUED_PAGE_INFO queued_page_info; /* Queued up output pages */
+    DEFERRED_OCR_PAGES deferred_ocr_pages; /* Written pages waiting on OCR -- v2.56 */
     WILLUSBITMAP *preview_bitmap;
     K2PAGEBREAKMARKS k2pagebreakmarks; /* User-specified page breaks */
     int preview_captured;  /* = 1 if preview bitmap obtained */
@@ -700,6 +751,11 @@ typedef struct
     int nextpage;
     int srcpages;         /* Total pages in source file */
     int rows;             /* Rows stored within the bmp structure */
+    int toprow;           /* v2.56:  bmp row that holds row 0 of the master bitmap */
+    void *dewarp_models;  /* v2.56:  wlept_dewarp_models_new() -- last good dewarp models */
+                          /* (not checkpointed--see k2checkpoint_usable()) */
+    WTEXTCHARS ocrlayer_chars; /* v2.56:  Text-layer chars of source page ocrlayer_page */
+    int ocrlayer_page;         /*         (see ocrlayer_bounding_box_inches())          */
     int published_pages;  /* Count of published pages */
     int bgcolor;
     int fit_to_page;
@@ -741,6 +797,63 @@ typedef struct
 #endif
     } MASTERINFO;
 
+/*
+** v2.56:  OCR engine state (Tesseract instances and OCR thread pool).
+** Each K2CONTEXT has its own unless it shares another one (-jobs).
+*/
+typedef struct
+    {
+    int maxthreads;
+    double cpu_time_secs;
+    void *pool;             /* Persistent OCR thread pool (ocrpool_start()) */
+    int pool_type;          /* OCR type the pool was started for ('t' or 'g') */
+    void **ocrtess_api;     /* One Tesseract instance per thread */
+    int tess_inited;
+    char initmessage[256];
+    } K2OCRENGINE;
+
+/*
+** v2.56:  -profile counters for the document being converted.  See k2profile.c.
+*/
+typedef struct
+    {
+    void *wprofile;     /* Stage counters from wprofile_new(), NULL = not profiling */
+    STRBUF pages;       /* JSON for the source pages done so far */
+    int npages;
+    double wall0,cpu0;  /* Start of document */
+    double page_wall0,page_cpu0; /* Start of current source page */
+    double pool_hits0,pool_misses0,pool_bytes0; /* Bitmap buffer pool counts at start */
+    } K2PROFILE;
+
+/*
+** v2.56:  K2CONTEXT holds all of the state for converting documents, so that
+** separate contexts can convert documents on separate threads.  See k2ctx.c.
+*/
+typedef struct k2context
+    {
+    K2PDFOPT_SETTINGS settings;   /* Settings passed to k2ctx_new() */
+    K2PDFOPT_SETTINGS k2settings; /* Working copy for the document being converted */
+    MASTERINFO masterinfo;
+    PDFFILE mpdf;                 /* Marked source file (-sm) */
+    int mark_page_count;
+    int mark_display_order;       /* Last region number marked on the page (-sm) */
+    int debug_page_count;         /* Output pages written to the -debug folder */
+    int word_gap_count;           /* Word gap history, see textwords_add_word_gaps() */
+    double word_gap[1024];
+    int last_ncols;               /* Last region added by bmpregion_vertically_break() */
+    double last_region_width_inches;
+    int last_source_page;
+    int last_region_r2;
+    int last_page_height;
+    int last_notes_type;          /* Notes (1) or main text (0) added last, -1 = none yet */
+    K2OCRENGINE ocr;
+    K2OCRENGINE *shared_ocr;      /* If not NULL, OCR engine shared with other contexts */
+    void *mupdf_session;          /* MuPDF document session (NULL = shared one) */
+    K2PROFILE profile;            /* -profile */
+    void *checkpoints;            /* Preview checkpoints, see k2checkpoint.c */
+    void *ocrlayer;               /* Source-page text-layer words, see k2ocr.c */
+    } K2CONTEXT;
+
 /*
 ** Used by bmpregion_add() and some other functions to specify parameters
 ** controlling how the source region is added to the destination document.
@@ -789,6 +902,8 @@ typedef struct
 /* k2file.c */
 void k2pdfopt_proc_wildarg(K2PDFOPT_SETTINGS *k2settings,char *arg,
                            K2PDFOPT_FILELIST_PROCESS *k2listproc);
+void k2pdfopt_preprocess_single_doc(K2PDFOPT_SETTINGS *k2settings,char *srcfilename_passed,
+                                    K2PDFOPT_FILELIST_PROCESS *k2listproc);
 void wpdfboxes_echo(WPDFBOXES *boxes,FILE *out);
 void overwrite_set(int status);
 void k2file_get_info(char *filename,int *pagelist,char **buf);
@@ -805,6 +920,35 @@ void k2file_look_for_pagebreakmarks(K2PAGEBREAKMARKS *k2pagebreakmarks,
                                     WILLUSBITMAP *srcgrey,int dpi);
 int get_source_type(char *filename);
 
+/* k2ctx.c */
+K2CONTEXT *k2ctx_new(K2PDFOPT_SETTINGS *k2settings);
+int  k2ctx_convert_file(K2CONTEXT *k2ctx,char *filename);
+void k2ctx_free(K2CONTEXT *k2ctx);
+K2CONTEXT *k2ctx_get(K2PDFOPT_SETTINGS *k2settings);
+K2OCRENGINE *k2ctx_ocr_engine(K2CONTEXT *k2ctx);
+int  k2ctx_convert_files(K2PDFOPT_SETTINGS *k2settings,K2PDFOPT_FILES *k2files);
+
+/* k2checkpoint.c */
+int  k2checkpoint_resume(K2PDFOPT_SETTINGS *k2settings0,char *filename,double rot_deg,
+                         MASTERINFO *masterinfo,int *pages_done);
+void k2checkpoint_save(K2PDFOPT_SETTINGS *k2settings,MASTERINFO *masterinfo,int index,
+                       int pages_done);
+void k2checkpoints_free(K2CONTEXT *k2ctx);
+
+/* k2profile.c */
+void k2profile_document_start(K2PDFOPT_SETTINGS *k2settings);
+void k2profile_page_start(K2PDFOPT_SETTINGS *k2settings);
+void k2profile_page_end(K2PDFOPT_SETTINGS *k2settings,int pageno);
+void k2profile_document_end(K2PDFOPT_SETTINGS *k2settings,char *srcfile,char *dstfile,
+                            int srcpages,int dstpages);
+
+/* k2prefetch.c */
+int  k2prefetch_source_ok(K2PDFOPT_SETTINGS *k2settings,int src_type);
+void *k2prefetch_start(K2PDFOPT_SETTINGS *k2settings,int src_type,char *filename,
+                       int *pagelist,int n,int dpi,int bpp);
+int  k2prefetch_get_page(void *handle,WILLUSBITMAP *src,int pageno);
+void k2prefetch_stop(void *handle);
+
 /* k2sys.c */
 void k2sys_init(void);
 void k2sys_cpu_update(K2PDFOPT_SETTINGS *k2settings,double start_seconds,double stop_seconds);
@@ -813,6 +957,7 @@ void k2sys_header(char *s);
 void k2sys_exit(K2PDFOPT_SETTINGS *k2settings,int val);
 void k2sys_enter_to_exit(K2PDFOPT_SETTINGS *k2settings);
 int  k2printf(char *fmt,...);
+void k2printf_mute_thread(int mute);
 #define k2dprintf willusgui_dprintf
 void k2gets(char *buf,int maxlen,char *def);
 
@@ -841,10 +986,14 @@ int  get_ttyrows(void);
 /* bmpregion.c */
 int  bmpregion_row_black_count(BMPREGION *region,int r0);
 int  bmpregion_col_black_count(BMPREGION *region,int c0);
+int  bmpregion_black_count(BMPREGION *region,int r1,int c1,int r2,int c2);
+void bmpregion_integral_allocate(BMPREGION *region);
+void bmpregion_integral_free(BMPREGION *region);
+void bmpregion_integral_invalidate(BMPREGION *region);
 void bmpregion_write(BMPREGION *region,char *filename);
 void bmpregion_row_histogram(BMPREGION *region);
 int  bmpregion_is_clear(BMPREGION *region,int *row_black_count,int *col_black_count,
-                        int *pixel_count_array,int rpc,double gt_in);
+                        double gt_in);
 void bmpregion_trim_to_crop_margins(BMPREGION *region,MASTERINFO *masterinfo,
                                     K2PDFOPT_SETTINGS *k2settings);
 int  bmpregion_column_height_and_gap_test(BMPREGION *column,BMPREGION *region,
@@ -943,7 +1092,7 @@ void textwords_compute_col_gaps(TEXTWORDS *textwords,int c2);
 void textwords_remove_small_col_gaps(TEXTWORDS *textwords,int lcheight,double mingap,
                                      double word_spacing);
 void textwords_add_word_gaps(TEXTWORDS *textwords,int lcheight,double *median_gap,
-                             double word_spacing);
+                             double word_spacing,K2PDFOPT_SETTINGS *k2settings);
 #define textwords_init(x) textrows_init(x)
 #define textwords_free(x) textrows_free(x)
 #define textwords_clear(x) textrows_clear(x)
@@ -955,7 +1104,7 @@ void textwords_add_word_gaps(TEXTWORDS *textwords,int lcheight,double *median_ga
 
 
 /* k2proc.c */
-void k2proc_init_one_document(void);
+void k2proc_init_one_document(K2PDFOPT_SETTINGS *k2settings);
 void k2proc_get_fontsize_histogram(BMPREGION *region,MASTERINFO *masterinfo,
                                    K2PDFOPT_SETTINGS *k2settings,FONTSIZE_HISTOGRAM *fsh);
 void bmpregion_add_cover_image(BMPREGION *coverimage,K2PDFOPT_SETTINGS *k2settings,
@@ -1004,7 +1153,7 @@ int  k2settings_has_cropboxes(K2PDFOPT_SETTINGS *k2settings);
 int  k2settings_need_color_initially(K2PDFOPT_SETTINGS *k2settings);
 int  k2settings_need_color_permanently(K2PDFOPT_SETTINGS *k2settings);
 int  k2settings_ncolors(char *s);
-char *k2settings_color_by_index(char *s,int index);
+char *k2settings_color_by_index(char *color,char *s,int index);
 
 /* k2mark.c */
 void publish_marked_page(PDFFILE *mpdf,WILLUSBITMAP *src,int src_dpi,char *srcname,
@@ -1052,6 +1201,9 @@ void masterinfo_add_gap(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,dou
 */
 int masterinfo_fits_on_existing_page(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
                                      int bmpheight_pixels);
+unsigned char *masterinfo_rowptr(MASTERINFO *masterinfo,int row);
+void masterinfo_more_rows(MASTERINFO *masterinfo,int nrows);
+void masterinfo_bmp_view(MASTERINFO *masterinfo,WILLUSBITMAP *view,int row0,int nrows);
 int masterinfo_queue_next_output_page(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
                                       int flushall);
 int masterinfo_pop_next_queued_page(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
@@ -1080,13 +1232,19 @@ void k2ocr_tesslang_selected(char *lang,int maxlen,K2PDFOPT_SETTINGS *settings);
 void k2ocr_ocrwords_add_to_queue(MASTERINFO *masterinfo,OCRWORDS *words,BMPREGION *region,
                                  K2PDFOPT_SETTINGS *k2settings);
 void k2ocr_multithreaded_ocr(OCRWORDS *words,K2PDFOPT_SETTINGS *k2settings);
-double k2ocr_cpu_time_secs(void);
-void k2ocr_cpu_time_reset(void);
-int k2ocr_max_threads(void);
+int  k2ocr_async(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings);
+void k2ocr_deferred_page_add(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,
+                             WILLUSBITMAP *bmp,double dpi,int size_reduction,OCRWORDS *words);
+void k2ocr_deferred_pages_write(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,int wait);
+void k2ocr_discard_jobs(K2PDFOPT_SETTINGS *k2settings);
+double k2ocr_cpu_time_secs(K2PDFOPT_SETTINGS *k2settings);
+void k2ocr_cpu_time_reset(K2PDFOPT_SETTINGS *k2settings);
+int k2ocr_max_threads(K2PDFOPT_SETTINGS *k2settings);
 #endif
 #if (defined(HAVE_MUPDF_LIB) || defined(HAVE_DJVU_LIB))
 int k2ocr_wtextchars_fill_from_page(WTEXTCHARS *wtcs,char *filename,int pageno,char *password,
                                    int boundingbox);
+void k2ocr_ocrlayer_free(K2CONTEXT *k2ctx);
 #endif
 
 /* pagelist.c */
@@ -1102,6 +1260,10 @@ void pagelist_get_array(int **pagelist,char *asciilist);
 int    bmp_get_one_document_page(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2pdfopt,
                               int src_type,char *filename,
                               int pageno,double dpi,int bpp,FILE *out);
+int    bmp_get_cached_document_page(WILLUSBITMAP *src,K2PDFOPT_SETTINGS *k2settings,
+                                    int src_type,char *filename,int pageno,double dpi,int bpp);
+int    k2bmp_page_cache_key(char *key,int src_type,char *filename,int pageno,double dpi,int bpp,
+                            int usegs,double scale);
 double bmp_orientation(WILLUSBITMAP *bmp);
 void   bmp_clear_outside_crop_border(MASTERINFO *masterinfo,WILLUSBITMAP *src,
                                      WILLUSBITMAP *srcgrey,K2PDFOPT_SETTINGS *k2settings);
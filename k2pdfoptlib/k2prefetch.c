@@ -0,0 +1,315 @@
+/*
+** k2prefetch.c   Multithreaded source-page rendering pipeline for k2pdfopt.
+**                Worker threads render the source pages that are coming up
+**                while the main thread lays out the current one.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+
+#include "k2pdfopt.h"
+#include <pthread.h>
+
+#define PREFETCH_STATE_QUEUED    0
+#define PREFETCH_STATE_RENDERING 1
+#define PREFETCH_STATE_DONE      2
+typedef struct
+    {
+    int pageno;
+    int state;   /* PREFETCH_STATE_... */
+    int status;  /* Return value from render (0 = success) */
+    WILLUSBITMAP bmp;
+    } K2PREFETCHPAGE;
+
+typedef struct
+    {
+    K2PREFETCHPAGE *page;
+    int n;          /* Number of pages in page[] (in the order they will be consumed) */
+    int next;       /* Next page[] index to be claimed by a worker */
+    int consumed;   /* Index of next page[] to be consumed by the layout thread */
+    int maxahead;   /* Max rendered pages held ahead of the layout thread */
+    int stop;
+    int src_type;
+    char filename[MAXFILENAMELEN];
+    double dpi;
+    int bpp;
+    int nthreads;
+    void *wprofile;  /* -profile counters of the thread that started the pipeline */
+    pthread_t *thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    } K2PREFETCH;
+
+static void *k2prefetch_worker(void *data);
+static int k2prefetch_render(void *session,K2PREFETCH *k2pf,WILLUSBITMAP *bmp,int pageno);
+static int k2prefetch_render_1(void *session,K2PREFETCH *k2pf,WILLUSBITMAP *bmp,int pageno);
+
+
+/*
+** Returns non-zero if the source document type can be rendered by
+** independent threads.  Ghostscript rendering is not thread safe.
+*/
+int k2prefetch_source_ok(K2PDFOPT_SETTINGS *k2settings,int src_type)
+
+    {
+#ifdef HAVE_MUPDF_LIB
+    if (src_type==SRC_TYPE_CBZ || (src_type==SRC_TYPE_PDF && k2settings->usegs<=0))
+        return(1);
+#endif
+#ifdef HAVE_DJVU_LIB
+    if (src_type==SRC_TYPE_DJVU)
+        return(1);
+#endif
+    return(0);
+    }
+
+
+/*
+** Start rendering the pages in pagelist[0..n-1] (in that order) at the
+** specified dpi and bits per pixel using worker threads.  Pages must then
+** be retrieved in the same order using k2prefetch_get_page().
+**
+** Returns NULL if no worker threads are started.
+*/
+void *k2prefetch_start(K2PDFOPT_SETTINGS *k2settings,int src_type,char *filename,
+                       int *pagelist,int n,int dpi,int bpp)
+
+    {
+    static char *funcname="k2prefetch_start";
+    K2PREFETCH *k2pf;
+    int i,nthreads;
+
+    if (k2settings->render_threads<0)
+        nthreads=wsys_num_cpus()*abs(k2settings->render_threads)/100;
+    else
+        nthreads=k2settings->render_threads;
+    if (nthreads>n)
+        nthreads=n;
+    if (nthreads<1 || n<2 || !k2prefetch_source_ok(k2settings,src_type)
+                   || strlen(filename)>=MAXFILENAMELEN)
+        return(NULL);
+    willus_mem_alloc_warn((void **)&k2pf,sizeof(K2PREFETCH),funcname,10);
+    willus_mem_alloc_warn((void **)&k2pf->page,sizeof(K2PREFETCHPAGE)*n,funcname,10);
+    willus_mem_alloc_warn((void **)&k2pf->thread,sizeof(pthread_t)*nthreads,funcname,10);
+    for (i=0;i<n;i++)
+        {
+        k2pf->page[i].pageno=pagelist[i];
+        k2pf->page[i].state=PREFETCH_STATE_QUEUED;
+        k2pf->page[i].status=0;
+        bmp_init(&k2pf->page[i].bmp);
+        }
+    k2pf->n=n;
+    k2pf->next=0;
+    k2pf->consumed=0;
+    /* Bound memory use:  one rendered page per thread plus the one being waited on */
+    k2pf->maxahead=nthreads+1;
+    k2pf->stop=0;
+    k2pf->src_type=src_type;
+    strcpy(k2pf->filename,filename);
+    k2pf->dpi=(double)dpi*k2settings->document_scale_factor;
+    k2pf->bpp=bpp;
+    k2pf->wprofile=wprofile_current();
+    pthread_mutex_init(&k2pf->mutex,NULL);
+    pthread_cond_init(&k2pf->cond,NULL);
+    for (i=0;i<nthreads;i++)
+        if (pthread_create(&k2pf->thread[i],NULL,k2prefetch_worker,k2pf)!=0)
+            break;
+    k2pf->nthreads=i;
+    if (k2pf->nthreads==0)
+        {
+        k2prefetch_stop(k2pf);
+        return(NULL);
+        }
+    return((void *)k2pf);
+    }
+
+
+/*
+** Get the next source page from the pipeline.  Pages that the caller skipped
+** over are discarded.  Returns 1 and puts the rendered page into src if
+** it was successfully rendered by a worker.  Returns 0 if the page is not in
+** the pipeline or could not be rendered by the worker, in which case the caller
+** should read it the normal way (which also handles error reporting and the
+** Ghostscript fall-back).
+*/
+int k2prefetch_get_page(void *handle,WILLUSBITMAP *src,int pageno)
+
+    {
+    K2PREFETCH *k2pf;
+    K2PREFETCHPAGE *page;
+    int i,status;
+
+    k2pf=(K2PREFETCH *)handle;
+    if (k2pf==NULL)
+        return(0);
+    pthread_mutex_lock(&k2pf->mutex);
+    for (i=k2pf->consumed;i<k2pf->n;i++)
+        if (k2pf->page[i].pageno==pageno)
+            break;
+    if (i>=k2pf->n)
+        {
+        pthread_mutex_unlock(&k2pf->mutex);
+        return(0);
+        }
+    /* Discard pages that were skipped (if they've been rendered) */
+    for (;k2pf->consumed<i;k2pf->consumed++)
+        if (k2pf->page[k2pf->consumed].state==PREFETCH_STATE_DONE)
+            bmp_free(&k2pf->page[k2pf->consumed].bmp);
+    /* Let workers move ahead */
+    pthread_cond_broadcast(&k2pf->cond);
+    page=&k2pf->page[i];
+    if (page->state!=PREFETCH_STATE_DONE)
+        {
+        WPROFILETIMER timer;
+
+        wprofile_start(&timer);
+        while (page->state!=PREFETCH_STATE_DONE)
+            pthread_cond_wait(&k2pf->cond,&k2pf->mutex);
+        wprofile_stop(&timer,"rasterize_wait",0.);
+        }
+    k2pf->consumed=i+1;
+    pthread_cond_broadcast(&k2pf->cond);
+    pthread_mutex_unlock(&k2pf->mutex);
+    status=page->status;
+    if (status<0)
+        {
+        bmp_free(&page->bmp);
+        return(0);
+        }
+    /* Hand over the bitmap data without copying it */
+    bmp_free(src);
+    (*src)=page->bmp;
+    bmp_init(&page->bmp);
+    return(1);
+    }
+
+
+void k2prefetch_stop(void *handle)
+
+    {
+    static char *funcname="k2prefetch_stop";
+    K2PREFETCH *k2pf;
+    int i;
+
+    k2pf=(K2PREFETCH *)handle;
+    if (k2pf==NULL)
+        return;
+    pthread_mutex_lock(&k2pf->mutex);
+    k2pf->stop=1;
+    pthread_cond_broadcast(&k2pf->cond);
+    pthread_mutex_unlock(&k2pf->mutex);
+    for (i=0;i<k2pf->nthreads;i++)
+        pthread_join(k2pf->thread[i],NULL);
+    for (i=0;i<k2pf->n;i++)
+        bmp_free(&k2pf->page[i].bmp);
+    pthread_cond_destroy(&k2pf->cond);
+    pthread_mutex_destroy(&k2pf->mutex);
+    willus_mem_free((double **)&k2pf->thread,funcname);
+    willus_mem_free((double **)&k2pf->page,funcname);
+    willus_mem_free((double **)&k2pf,funcname);
+    }
+
+
+static void *k2prefetch_worker(void *data)
+
+    {
+    K2PREFETCH *k2pf;
+    void *session;
+
+    k2pf=(K2PREFETCH *)data;
+    wprofile_use(k2pf->wprofile);
+    /* Each worker has its own copy of the open document */
+#ifdef HAVE_MUPDF_LIB
+    session=bmpmupdf_session_new();
+#else
+    session=NULL;
+#endif
+    while (1)
+        {
+        K2PREFETCHPAGE *page;
+        WILLUSBITMAP _bmp,*bmp;
+        WPROFILETIMER timer;
+        int status;
+
+        pthread_mutex_lock(&k2pf->mutex);
+        while (!k2pf->stop && k2pf->next<k2pf->n && k2pf->next>=k2pf->consumed+k2pf->maxahead)
+            pthread_cond_wait(&k2pf->cond,&k2pf->mutex);
+        /* Don't bother with pages the layout thread has already skipped */
+        if (k2pf->next<k2pf->consumed)
+            k2pf->next=k2pf->consumed;
+        if (k2pf->stop || k2pf->next>=k2pf->n)
+            {
+            pthread_mutex_unlock(&k2pf->mutex);
+            break;
+            }
+        page=&k2pf->page[k2pf->next++];
+        page->state=PREFETCH_STATE_RENDERING;
+        pthread_mutex_unlock(&k2pf->mutex);
+        bmp=&_bmp;
+        bmp_init(bmp);
+        wprofile_start(&timer);
+        status=k2prefetch_render(session,k2pf,bmp,page->pageno);
+        wprofile_stop(&timer,"rasterize",status<0 ? 0. : (double)bmp_bytewidth(bmp)*bmp->height);
+        pthread_mutex_lock(&k2pf->mutex);
+        page->status=status;
+        page->bmp=(*bmp);
+        page->state=PREFETCH_STATE_DONE;
+        pthread_cond_broadcast(&k2pf->cond);
+        pthread_mutex_unlock(&k2pf->mutex);
+        }
+#ifdef HAVE_MUPDF_LIB
+    bmpmupdf_session_free(session);
+#endif
+    pthread_exit(NULL);
+    return(NULL);
+    }
+
+
+/*
+** Renders the page unless it is in the rendered-page cache (v2.56).  k2pf->dpi
+** already includes the document scale factor.
+*/
+static int k2prefetch_render(void *session,K2PREFETCH *k2pf,WILLUSBITMAP *bmp,int pageno)
+
+    {
+    char key[MAXFILENAMELEN+128];
+    int status,haskey;
+
+    haskey=k2bmp_page_cache_key(key,k2pf->src_type,k2pf->filename,pageno,k2pf->dpi,k2pf->bpp,0,1.);
+    if (haskey && bmpcache_get(bmp,key))
+        return(0);
+    status=k2prefetch_render_1(session,k2pf,bmp,pageno);
+    if (haskey && !status)
+        bmpcache_put(bmp,key);
+    return(status);
+    }
+
+
+static int k2prefetch_render_1(void *session,K2PREFETCH *k2pf,WILLUSBITMAP *bmp,int pageno)
+
+    {
+#ifdef HAVE_MUPDF_LIB
+    if (k2pf->src_type==SRC_TYPE_PDF || k2pf->src_type==SRC_TYPE_CBZ)
+        return(bmpmupdf_session_pdffile_to_bmp(session,bmp,k2pf->filename,pageno,
+                                               k2pf->dpi,k2pf->bpp));
+#endif
+#ifdef HAVE_DJVU_LIB
+    if (k2pf->src_type==SRC_TYPE_DJVU)
+        return(bmpdjvu_djvufile_to_bmp(bmp,k2pf->filename,pageno,(int)k2pf->dpi,
+                                       k2pf->bpp,NULL));
+#endif
+    return(-1);
+    }
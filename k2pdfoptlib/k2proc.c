@@ -78,11 +78,11 @@ static void bmpregion_one_row_wrap_and_add(BMPREGION *region,K2PDFOPT_SETTINGS *
 /*
 ** Call once per document
 */
-void k2proc_init_one_document(void)
+void k2proc_init_one_document(K2PDFOPT_SETTINGS *k2settings)
 
     {
     /* Init vert break routine */
-    bmpregion_vertically_break(NULL,NULL,NULL,0.,0,0,NULL);
+    bmpregion_vertically_break(NULL,k2settings,NULL,0.,0,0,NULL);
     }
 
 
@@ -803,12 +803,14 @@ void pageregions_find_columns(PAGEREGIONS *pageregions_sorted,BMPREGION *srcregi
     {
     int ilevel;
     K2NOTES *notes;
+    WPROFILETIMER timer;
 
 #if (!(WILLUSDEBUGX & 0x200))
     if (k2settings->debug)
 #endif
         k2printf("@pageregions_find_columns (%d,%d) - (%d,%d) maxlevels=%d\n",
                srcregion->c1,srcregion->r1,srcregion->c2,srcregion->r2,maxlevels);
+    wprofile_start(&timer);
 
     /*
     ** v2.20:  Check to see if we should be looking for a "notes" column
@@ -819,6 +821,7 @@ void pageregions_find_columns(PAGEREGIONS *pageregions_sorted,BMPREGION *srcregi
     if (maxlevels==1)
         {
         pageregions_add_pageregion(pageregions_sorted,srcregion,1,1,0);
+        wprofile_stop(&timer,"columns",0.);
         return;
         }
     pageregions_find_next_level(pageregions_sorted,srcregion,k2settings,1,notes);
@@ -848,6 +851,7 @@ void pageregions_find_columns(PAGEREGIONS *pageregions_sorted,BMPREGION *srcregi
                 }
             }
         }
+    wprofile_stop(&timer,"columns",0.);
     }
         
 
@@ -1594,8 +1598,7 @@ bmp_write(tmp,filename,stdout,100);
         ** Add scaled bitmap to destination.
         */
         /* Allocate more rows if necessary */
-        while (masterinfo->rows+tmp->height/nocr > masterinfo->bmp.height)
-            bmp_more_rows(&masterinfo->bmp,1.4,255);
+        masterinfo_more_rows(masterinfo,tmp->height/nocr);
         /* Check special justification for tall regions */
         if (tall_region && k2settings->dst_figure_justify>=0)
             justification_flags_ex = k2settings->dst_figure_justify;
@@ -1815,8 +1818,6 @@ static int bmpregion_find_multicolumn_divider(BMPREGION *region,K2PDFOPT_SETTING
     BMPREGION _newregion,*newregion,column[2];
     int *rowmin,*rowmax;
     int *black_pixel_count_by_column;
-    int *pixel_count_array;
-    int rows_per_column;
     int notesleft;
     TEXTROWS *textrows;
     TEXTROW *textrow;
@@ -1887,58 +1888,22 @@ printf("After remove small rows:  %d rows left\n",textrows->n);
     willus_dmem_alloc_warn(5,(void **)&rowmin,(region->c2+10)*3*sizeof(int),funcname,10);
     rowmax=&rowmin[region->c2+10];
     black_pixel_count_by_column=&rowmax[region->c2+10];
-    rows_per_column=0;
 
     /*
-    ** If enough memory cache pixel counts into large 2-D array for fast calcs
+    ** v2.56:  Dark pixel counts come from the source page's integral image
+    ** (see bmpregion_integral_allocate()).  If this region doesn't have
+    ** one, give the working copy one for the shaft searches below.
     */
-    pixel_count_array=NULL;
-    rows_per_column=0;
-#if (WILLUSDEBUGX & 0x100000)
-    willus_dmem_alloc_warn(38,(void **)&pixel_count_array,
-                                  sizeof(int)*(region->c2+2)*(region->r2+2),
-                                  funcname,10);
-    if (1)
-#else
-    if (willus_mem_alloc((double **)&pixel_count_array,sizeof(int)*(region->c2+2)*(region->r2+2),
-                                  funcname))
-#endif
-        {
-        int bw,jmax;
-
-        rows_per_column=region->r2+2;
-        memset(pixel_count_array,0,sizeof(int)*(region->c2+2)+(region->r2+2));
-        bw=bmp_bytewidth(region->bmp8);
-        jmax = region->r2+2;
-        /* Don't exceed bitmap height--v1.66 fix, 7-22-2013 */
-        if (jmax > region->bmp8->height)
-            jmax = region->bmp8->height;
-        for (i=0;i<=region->c2+1;i++)
-            {
-            unsigned char *p;
-            int *cp;
-            int j;
+    if (newregion->integral==NULL)
+        bmpregion_integral_allocate(newregion);
 
-            if (i>=region->bmp8->width)
-                continue;
-            cp=&pixel_count_array[i*rows_per_column];
-            p=bmp_rowptr_from_top(region->bmp8,0)+i;
-            cp[0] = (p[0]<region->bgcolor) ? 1 : 0;
-            for (p+=bw,cp++,j=1;j<jmax;j++,p+=bw,cp++)
-                if (p[0]<region->bgcolor)
-                    (*cp)=cp[-1]+1;
-                else
-                    (*cp)=cp[-1];
-            }
-        }
-        
     /*
     ** Populate black pixel count by column
     */
     for (i=0;i<region->c1;i++)
         black_pixel_count_by_column[i]=1;
     for (i=region->c1;i<=region->c2;i++)
-        black_pixel_count_by_column[i]=bmpregion_col_black_count(region,i);
+        black_pixel_count_by_column[i]=bmpregion_col_black_count(newregion,i);
     for (i=region->c2+1;i<region->c2+2;i++)
         black_pixel_count_by_column[i]=1;
     /*
@@ -2023,7 +1988,7 @@ lec++;
 printf("    Checking shaft:  (%d,%d) - (%d,%d)\n",newregion->c1,newregion->r1,newregion->c2,newregion->r2);
 #endif
                 foundgap=bmpregion_is_clear(newregion,row_black_count,black_pixel_count_by_column,
-                                             pixel_count_array,rows_per_column,k2settings->gtc_in);
+                                             k2settings->gtc_in);
                 if (!foundgap && i>0)
                     {
                     newregion->c1=region->c1+middle+i;
@@ -2053,7 +2018,6 @@ printf("    Checking shaft:  (%d,%d) - (%d,%d)\n",newregion->c1,newregion->r1,ne
 #endif
                     foundgap=bmpregion_is_clear(newregion,row_black_count,
                                            black_pixel_count_by_column,
-                                           pixel_count_array,rows_per_column,
                                            k2settings->gtc_in);
                     }
                 if (!foundgap)
@@ -2077,7 +2041,6 @@ printf("    Shaft is clear!\n");
                         continue;
                     newgap=bmpregion_is_clear(newregion,row_black_count,
                                              black_pixel_count_by_column,
-                                             pixel_count_array,rows_per_column,
                                              k2settings->gtc_in);
                     if (newgap>0 && newgap<foundgap)
                         {
@@ -2176,11 +2139,6 @@ printf("Notes region: (%d - %d) / %d\n",column[ic1].c1,column[ic1].c2,region->c2
                     pageregions_add_pageregion(pageregions,&column[ic2],0,0,0);
                     }
                     colheight = textrow[ibottom].r2-region->r1+1;
-#if (WILLUSDEBUGX & 0x100000)
-                    willus_dmem_free(38,(double **)&pixel_count_array,funcname);
-#else
-                    willus_mem_free((double **)&pixel_count_array,funcname);
-#endif
                     willus_dmem_free(5,(double **)&rowmin,funcname);
                     bmpregion_free(&column[1]);
                     bmpregion_free(&column[0]);
@@ -2208,11 +2166,6 @@ printf("Done looking for columns.\n");
     bmpregion_trim_margins(&pageregions->pageregion[pageregions->n-1].bmpregion,
                            k2settings,k2settings->src_trim?0xf:0);
     /* (*divider_column)=region->c2+1; */
-#if (WILLUSDEBUGX & 0x100000)
-    willus_dmem_free(38,(double **)&pixel_count_array,funcname);
-#else
-    willus_mem_free((double **)&pixel_count_array,funcname);
-#endif
     willus_dmem_free(5,(double **)&rowmin,funcname);
     bmpregion_free(&column[1]);
     bmpregion_free(&column[0]);
@@ -2241,12 +2194,8 @@ static void bmpregion_vertically_break(BMPREGION *region,K2PDFOPT_SETTINGS *k2se
                                        int source_page,int ncols,BMPREGION *notes)
 
     {
-    /* Keep track of last region dimensions */
-    static int    last_ncols=-1;
-    static double last_region_width_inches=-1.;
-    static int    last_source_page=-1;
-    static int    last_region_r2=-1;
-    static int    last_page_height=-1;
+    /* Keep track of last region dimensions (v2.56:  in the conversion context) */
+    K2CONTEXT *k2ctx;
     int i,biggap,revert;
     int region_is_centered;
     int ni,notesgap,notes_are_centered;
@@ -2264,13 +2213,15 @@ static void bmpregion_vertically_break(BMPREGION *region,K2PDFOPT_SETTINGS *k2se
     static char *funcname="bmpregion_vertically_break";
 
     added_region.force_scale = force_scale;
+    k2ctx=k2ctx_get(k2settings);
     if (region==NULL)
         {
-        last_ncols = -1;
-        last_region_width_inches = -1.;
-        last_source_page=-1;
-        last_region_r2=-1;
-        last_page_height=-1;
+        k2ctx->last_ncols = -1;
+        k2ctx->last_region_width_inches = -1.;
+        k2ctx->last_source_page=-1;
+        k2ctx->last_region_r2=-1;
+        k2ctx->last_page_height=-1;
+        k2ctx->last_notes_type=-1;
         return;
         }
 /*
@@ -2429,7 +2380,8 @@ k2printf("    biggap=%d\n",biggap);
     region_width_inches = (double)(region->c2-region->c1+1)/region->dpi;
     region_height_inches = (double)(region->r2-region->r1+1)/region->dpi;
     /* If user wants a gap between pages--do that */
-    if (k2settings->dst_break_pages<-1 && source_page>0 && source_page != last_source_page)
+    if (k2settings->dst_break_pages<-1 && source_page>0
+                                       && source_page != k2ctx->last_source_page)
         {
         masterinfo->mandatory_region_gap=2; /* 2 means set by -bp option */
         masterinfo->page_region_gap_in=(-1-k2settings->dst_break_pages)/1000.;
@@ -2442,24 +2394,25 @@ printf("page_region_gap set by dst_break to %g in.\n",masterinfo->page_region_ga
         double gap_in;
 
         /* First region on the source page? */
-        if (source_page != last_source_page)
+        if (source_page != k2ctx->last_source_page)
             {
             double margins_inches[4];
 
             masterinfo_get_margins(k2settings,margins_inches,&k2settings->srccropmargins,
                                    masterinfo,region);
             gap_in = (double)region->r1/k2settings->src_dpi - margins_inches[1];
-            if (last_source_page>=0)
-                gap_in += (double)(last_page_height-last_region_r2)/k2settings->src_dpi
+            if (k2ctx->last_source_page>=0)
+                gap_in += (double)(k2ctx->last_page_height-k2ctx->last_region_r2)
+                                                     /k2settings->src_dpi
                             - margins_inches[3];
 #if (WILLUSDEBUGX & 0x800000)
-printf("page_region_gap 1. set to %g in (sp=%d, lsp=%d).\n",gap_in,source_page,last_source_page);
+printf("page_region_gap 1. set to %g in (sp=%d, lsp=%d).\n",gap_in,source_page,k2ctx->last_source_page);
 printf("          r->r1=%d, srcdpi=%d, margin=%g\n",region->r1,(int)k2settings->src_dpi,margins_inches[1]);
 #endif
             }
         else
             {
-            gap_in = (double)(region->r1 - last_region_r2 - 1)/k2settings->src_dpi;
+            gap_in = (double)(region->r1 - k2ctx->last_region_r2 - 1)/k2settings->src_dpi;
             if (gap_in < 0.)
                 gap_in = 0.25;
 #if (WILLUSDEBUGX & 0x800000)
@@ -2469,8 +2422,8 @@ printf("page_region_gap 2. set to %g in.\n",gap_in);
         masterinfo->page_region_gap_in = gap_in;
 
         /* Got the gap--now determine whether it should be mandatory */
-        if (different_widths(last_region_width_inches,region_width_inches)
-               || ncols != last_ncols)
+        if (different_widths(k2ctx->last_region_width_inches,region_width_inches)
+               || ncols != k2ctx->last_ncols)
             masterinfo->mandatory_region_gap=1;
         else
             masterinfo->mandatory_region_gap=0;
@@ -2479,11 +2432,11 @@ printf("page_region_gap 2. set to %g in.\n",gap_in);
     /*
     ** Done determining region gap--store data about this region for next comparison
     */
-    last_ncols = ncols;
-    last_region_width_inches = region_width_inches;
-    last_source_page=source_page;
-    last_region_r2=region->r2;
-    last_page_height=region->bmp->height;
+    k2ctx->last_ncols = ncols;
+    k2ctx->last_region_width_inches = region_width_inches;
+    k2ctx->last_source_page=source_page;
+    k2ctx->last_region_r2=region->r2;
+    k2ctx->last_page_height=region->bmp->height;
 
 
 /*
@@ -2676,8 +2629,8 @@ static void bmpregion_add_textrows(ADDED_REGION_INFO *added_region,
     {
     BMPREGION *region,_region;
     TEXTROW *textrow;
+    K2CONTEXT *k2ctx;
     int n,j,c1,c2,nc,marking_flags;
-    static int lasttype=-1;
 
 #if (WILLUSDEBUGX & 0x40000)
 printf("ADDING %s ROWS %d - %d OUT OF %d ...\n",added_region->notes?"NOTES":"MAIN TEXT",added_region->firstrow+1,added_region->lastrow+1,added_region->region->textrows.n);
@@ -2717,7 +2670,9 @@ printf("ADDING %s ROWS %d - %d OUT OF %d ...\n",added_region->notes?"NOTES":"MAI
     /*
     ** Much simpler decision making about gap now (v2.00, 22 Aug 2013)
     */
-    if (lasttype>=0 && added_region->notes != lasttype)
+    /* v2.56:  Last type is kept in the context (was static) */
+    k2ctx=k2ctx_get(k2settings);
+    if (k2ctx->last_notes_type>=0 && added_region->notes != k2ctx->last_notes_type)
         {
         wrapbmp_flush(masterinfo,k2settings,0);
         masterinfo->mandatory_region_gap=1;
@@ -2742,7 +2697,7 @@ printf("page_region_gap set by add_text_rows II to %g in.\n",masterinfo->page_re
 #endif
             }
         }
-    lasttype = added_region->notes;
+    k2ctx->last_notes_type = added_region->notes;
 /* printf("Adding %s region...\n",added_region->notes?"NOTES":"MAIN TEXT"); */
     {
     ADDED_REGION_INFO new_added_region;
@@ -3519,6 +3474,7 @@ static void bmpregion_one_row_wrap_and_add(BMPREGION *region,K2PDFOPT_SETTINGS *
     TEXTWORDS *textwords;
     TEXTWORD *textword;
     int n;
+    WPROFILETIMER timer;
 
     if (region->textrows.n>0)
         {
@@ -3527,6 +3483,7 @@ static void bmpregion_one_row_wrap_and_add(BMPREGION *region,K2PDFOPT_SETTINGS *
         k2printf("Please report error.\n");
         exit(20);
         }
+    wprofile_start(&timer);
     wrapbmp=&masterinfo->wrapbmp;
     newregion=&_newregion;
     bmpregion_init(newregion);
@@ -3537,6 +3494,7 @@ static void bmpregion_one_row_wrap_and_add(BMPREGION *region,K2PDFOPT_SETTINGS *
     if (nc<6)
         {
         bmpregion_free(newregion);
+        wprofile_stop(&timer,"wrap",0.);
         return;
         }
     bmpregion_one_row_find_textwords(newregion,k2settings,1);
@@ -3561,7 +3519,8 @@ static void bmpregion_one_row_wrap_and_add(BMPREGION *region,K2PDFOPT_SETTINGS *
     */
     {
     double median_gap;
-    textwords_add_word_gaps(NULL,newregion->bbox.lcheight,&median_gap,k2settings->word_spacing);
+    textwords_add_word_gaps(NULL,newregion->bbox.lcheight,&median_gap,k2settings->word_spacing,
+                            k2settings);
     gappix = (int)(median_gap*newregion->bbox.lcheight+.5);
     }
 #if (WILLUSDEBUGX & 4)
@@ -3675,6 +3634,7 @@ k2printf("wrapflush7\n");
         i0=i+1;
         }
     bmpregion_free(newregion);
+    wprofile_stop(&timer,"wrap",0.);
     }
 
 
@@ -0,0 +1,185 @@
+/*
+** k2profile.c   -profile:  wall / CPU time, call count, and byte counters for
+**               each processing stage (rasterize, deskew, dewarp, columns,
+**               text rows, wrap, OCR, PNG/JPEG/flate encoding, PDF writing),
+**               written as JSON per source page and per document.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+
+#include "k2pdfopt.h"
+#include <pthread.h>
+
+/*
+** The stages are timed where they happen (see the wprofile_start() /
+** wprofile_stop() calls), into the counters selected for the thread by
+** wprofile_use().  Stages can be nested (e.g. text rows are found during
+** column detection, and images are encoded while the PDF is written), in
+** which case the inner stage time is also counted in the outer stage.
+**
+** Each converted document is appended to the -profile file as one line
+** of JSON (the file is started over the first time it is written by
+** this process):
+**
+** {"source":"a.pdf","output":"a_k2opt.pdf","source_pages":2,"output_pages":5,
+**  "wall_secs":1.2345,"cpu_secs":1.1111,"stages":{...},"bitmap_pool":{...},
+**  "pages":[{"page":1,"wall_secs":0.6,"cpu_secs":0.55,"stages":{...}},...]}
+**
+** where "stages" is e.g.
+**     {"rasterize":{"calls":1,"wall_secs":0.0213,"cpu_secs":0.0211,"bytes":8415000},...}
+**
+** The document line also has the bitmap buffer pool counts (see
+** willuslib/bmppool.c) for the document, e.g.
+**     "bitmap_pool":{"hits":5120,"misses":96,"bytes_reused":1934000000}
+** (all threads, so they include other documents being converted with -jobs).
+*/
+static pthread_mutex_t k2profile_mutex=PTHREAD_MUTEX_INITIALIZER;
+static char k2profile_started[256]; /* -profile file that has been started over */
+
+static void k2profile_json_string(STRBUF *json,char *s);
+
+
+void k2profile_document_start(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    K2PROFILE *profile;
+
+    profile=&k2ctx_get(k2settings)->profile;
+    if (k2settings->profile[0]=='\0' || profile->wprofile!=NULL)
+        return;
+    profile->wprofile=wprofile_new();
+    strbuf_init(&profile->pages);
+    profile->npages=0;
+    wprofile_use(profile->wprofile);
+    profile->wall0=profile->page_wall0=wprofile_wall_secs();
+    profile->cpu0=profile->page_cpu0=wprofile_cpu_secs();
+    bmppool_stats(&profile->pool_hits0,&profile->pool_misses0,&profile->pool_bytes0);
+    }
+
+
+void k2profile_page_start(K2PDFOPT_SETTINGS *k2settings)
+
+    {
+    K2PROFILE *profile;
+
+    profile=&k2ctx_get(k2settings)->profile;
+    if (profile->wprofile==NULL)
+        return;
+    wprofile_page_reset(profile->wprofile);
+    profile->page_wall0=wprofile_wall_secs();
+    profile->page_cpu0=wprofile_cpu_secs();
+    }
+
+
+/*
+** pageno<0 for the cover image
+*/
+void k2profile_page_end(K2PDFOPT_SETTINGS *k2settings,int pageno)
+
+    {
+    K2PROFILE *profile;
+
+    profile=&k2ctx_get(k2settings)->profile;
+    if (profile->wprofile==NULL)
+        return;
+    strbuf_sprintf_no_space(&profile->pages,"%s{\"page\":%d,\"wall_secs\":%.4f,\"cpu_secs\":%.4f,"
+                                            "\"stages\":",
+                            profile->npages>0 ? "," : "",pageno,
+                            wprofile_wall_secs()-profile->page_wall0,
+                            wprofile_cpu_secs()-profile->page_cpu0);
+    wprofile_stages_json(&profile->pages,profile->wprofile,1);
+    strbuf_cat_ex(&profile->pages,"}");
+    profile->npages++;
+    }
+
+
+/*
+** Append the document's counters to the -profile file and stop profiling.
+*/
+void k2profile_document_end(K2PDFOPT_SETTINGS *k2settings,char *srcfile,char *dstfile,
+                            int srcpages,int dstpages)
+
+    {
+    K2PROFILE *profile;
+    STRBUF _json,*json;
+    FILE *f;
+    double hits,misses,bytes;
+
+    profile=&k2ctx_get(k2settings)->profile;
+    if (profile->wprofile==NULL)
+        return;
+    json=&_json;
+    strbuf_init(json);
+    strbuf_cat_ex(json,"{\"source\":");
+    k2profile_json_string(json,srcfile);
+    strbuf_cat_ex(json,",\"output\":");
+    k2profile_json_string(json,dstfile);
+    strbuf_sprintf_no_space(json,",\"source_pages\":%d,\"output_pages\":%d,"
+                                 "\"wall_secs\":%.4f,\"cpu_secs\":%.4f,\"stages\":",
+                            srcpages,dstpages,wprofile_wall_secs()-profile->wall0,
+                            wprofile_cpu_secs()-profile->cpu0);
+    wprofile_stages_json(json,profile->wprofile,0);
+    bmppool_stats(&hits,&misses,&bytes);
+    strbuf_sprintf_no_space(json,",\"bitmap_pool\":{\"hits\":%.0f,\"misses\":%.0f,"
+                                 "\"bytes_reused\":%.0f}",
+                            hits-profile->pool_hits0,misses-profile->pool_misses0,
+                            bytes-profile->pool_bytes0);
+    strbuf_cat_ex(json,",\"pages\":[");
+    strbuf_cat_ex(json,profile->pages.s);
+    strbuf_cat_ex(json,"]}\n");
+    /* Documents may finish at the same time with -jobs */
+    pthread_mutex_lock(&k2profile_mutex);
+    f=fopen(k2settings->profile,strcmp(k2profile_started,k2settings->profile) ? "w" : "a");
+    if (f==NULL)
+        k2printf(TTEXT_WARN "\n** Cannot write profile to file %s. **" TTEXT_NORMAL "\n\n",
+                 k2settings->profile);
+    else
+        {
+        fputs(json->s,f);
+        fclose(f);
+        strcpy(k2profile_started,k2settings->profile);
+        }
+    pthread_mutex_unlock(&k2profile_mutex);
+    strbuf_free(json);
+    strbuf_free(&profile->pages);
+    wprofile_free(profile->wprofile);
+    profile->wprofile=NULL;
+    }
+
+
+static void k2profile_json_string(STRBUF *json,char *s)
+
+    {
+    char buf[8];
+    int i;
+
+    strbuf_cat_ex(json,"\"");
+    for (i=0;s[i]!='\0';i++)
+        {
+        if (s[i]=='"' || s[i]=='\\')
+            sprintf(buf,"\\%c",s[i]);
+        else if ((unsigned char)s[i]<32)
+            sprintf(buf,"\\u%04x",(unsigned char)s[i]);
+        else
+            {
+            buf[0]=s[i];
+            buf[1]='\0';
+            }
+        strbuf_cat_ex(json,buf);
+        }
+    strbuf_cat_ex(json,"\"");
+    }
@@ -32,16 +32,12 @@ static void k2publish_outline_check(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2
 void masterinfo_publish(MASTERINFO *masterinfo,K2PDFOPT_SETTINGS *k2settings,int flushall)
 
     {
-#ifdef HAVE_MUPDF_LIB
-    static WTEXTCHARS *wtcs=NULL;
-    static WTEXTCHARS _wtcs;
-    /* static int pageno=0; */
-#endif
     WILLUSBITMAP _bmp,*bmp;
     double bmpdpi;
     int local_output_page_count,size_reduction,nocr,queue_pages_only;
 #ifdef HAVE_OCR_LIB
     OCRWORDS *ocrwords,_ocrwords;
+    int async;
 #else
     void *ocrwords;
 #endif
@@ -60,13 +56,6 @@ ocrwords_echo(&masterinfo->mi_ocrwords,stdout,2,1);
 /*
 aprintf(ANSI_GREEN "\n   @masterinfo_publish(flushall=%d)....\n\n" ANSI_NORMAL,flushall);
 */
-#ifdef HAVE_MUPDF_LIB
-    if (wtcs==NULL)
-        {
-        wtcs=&_wtcs;
-        wtextchars_init(wtcs);
-        }
-#endif
 #ifdef HAVE_OCR_LIB
     ocrwords=&_ocrwords;
     ocrwords_init(ocrwords);
@@ -74,9 +63,14 @@ aprintf(ANSI_GREEN "\n   @masterinfo_publish(flushall=%d)....\n\n" ANSI_NORMAL,f
     ** If using native PDF OCR layer, nocr will be zero.
     */
     nocr=ocrwords_num_queued(&masterinfo->mi_ocrwords);
-    queue_pages_only = (flushall<2 && nocr>0
-                                   && k2ocr_max_threads()>1 
-                                   && nocr < 3*k2ocr_max_threads());
+    /*
+    ** v2.56:  With -ocrasync, pages are written without waiting for their words
+    **         to be OCR'd, and their OCR text layers are added later.
+    */
+    async = k2ocr_async(masterinfo,k2settings);
+    queue_pages_only = (!async && flushall<2 && nocr>0
+                                   && k2ocr_max_threads(k2settings)>1 
+                                   && nocr < 3*k2ocr_max_threads(k2settings));
 #if (WILLUSDEBUGX2==3)
 if (!queue_pages_only && flushall<2)
 {
@@ -84,7 +78,7 @@ printf("Changing queue_pages_only to 1.\n");
 queue_pages_only=1;
 }
 #endif
-    if (nocr>0 && !queue_pages_only)
+    if (nocr>0 && !queue_pages_only && !async)
         {
         if (!k2settings->preview_page)
             k2printf("OCRing %d images ... ",nocr);
@@ -107,7 +101,7 @@ ocrwords_echo(&masterinfo->mi_ocrwords,stdout,1,1);
     queue_page=0;
 #endif
 #if (WILLUSDEBUGX2==3)
-aprintf(ANSI_GREEN "\n   SRC PAGE %d, nocr=%d, queue=%d, threads=%d\n\n" ANSI_NORMAL,masterinfo->pageinfo.srcpage,nocr,queue_pages_only,k2ocr_max_threads());
+aprintf(ANSI_GREEN "\n   SRC PAGE %d, nocr=%d, queue=%d, threads=%d\n\n" ANSI_NORMAL,masterinfo->pageinfo.srcpage,nocr,queue_pages_only,k2ocr_max_threads(k2settings));
 #endif
     bmp=&_bmp;
     bmp_init(bmp);
@@ -171,7 +165,10 @@ printf("use_toc=%d, outline=%p, spc=%d, srcpage=%d\n",k2settings->use_toc,master
         ** get written after all pages have been processed.
         */
 #ifdef HAVE_OCR_LIB
-        if (k2settings->dst_ocr)
+        /* Deferred pages are finished in order, so -ocrout text stays in page order */
+        if (async)
+            k2ocr_deferred_page_add(masterinfo,k2settings,bmp,bmpdpi,size_reduction,ocrwords);
+        else if (k2settings->dst_ocr)
             {
             if (masterinfo->ocrfilename[0]!='\0')
                 ocrwords_to_textfile(ocrwords,masterinfo->ocrfilename,
@@ -237,6 +234,10 @@ printf("Calling pdffile_add_bitmap... (%d x %d, %d dpi)\n",bmp->width,bmp->heigh
     if (!queue_pages_only && local_output_page_count==0)
         k2publish_outline_check(masterinfo,k2settings,masterinfo->pageinfo.srcpage,1);
     bmp_free(bmp);
+#ifdef HAVE_OCR_LIB
+    /* v2.56:  Add finished OCR text layers--all of them on the final flush */
+    k2ocr_deferred_pages_write(masterinfo,k2settings,flushall==2);
+#endif
     }
 
 
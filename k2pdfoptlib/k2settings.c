@@ -33,6 +33,8 @@ void k2pdfopt_settings_init(K2PDFOPT_SETTINGS *k2settings)
     {
     int i;
 
+    /* v2.56:  Start from zeros so that no field is left uninitialized */
+    memset(k2settings,0,sizeof(K2PDFOPT_SETTINGS));
     k2settings->verbose=0;
     k2settings->debug=0;
     k2settings->cdthresh=.01;
@@ -58,6 +60,10 @@ void k2pdfopt_settings_init(K2PDFOPT_SETTINGS *k2settings)
     /* v2.51 */
     /* Tesseract v4.0.0 English "Tessbest" seems to do best with 300 dpi for ~8 - 15 pt fonts */
     k2settings->ocr_dpi=300;
+    k2settings->ocr_async=0;
+    k2settings->ocr_word_batch=16;
+    k2settings->ocr_cache_mb=16;
+    k2settings->ocr_cache_file[0]='\0';
 #ifdef HAVE_TESSERACT_LIB
     k2settings->dst_ocr_lang[0]='\0';
 #endif
@@ -238,6 +244,14 @@ void k2pdfopt_settings_init(K2PDFOPT_SETTINGS *k2settings)
     /* v2.52 */
     k2settings->detect_double_rows=1;
     k2settings->textheight_min_pts=-1.;
+    /* v2.56 */
+    k2settings->render_threads=-50; /* Use 50% of available CPUs */
+    k2settings->write_threads=-50;
+    k2settings->xref_stream=0; /* xref table unless output is > 10 GB */
+    k2settings->jobs=1;
+    k2settings->profile[0]='\0'; /* No -profile */
+    k2settings->render_cache_mb=256;
+    k2settings->ctx=NULL; /* Default conversion context */
     }
 
 
@@ -469,17 +483,19 @@ void k2pdfopt_settings_quick_sanity_check(K2PDFOPT_SETTINGS *k2settings)
     if (k2settings->dst_fgtype==4)
         {
         int i,n;
+        char color[128];
         n=k2settings_ncolors(k2settings->dst_fgcolor);
         for (i=0;i<n;i++)
-            if (k2settings_color_type(k2settings_color_by_index(k2settings->dst_fgcolor,i))==2)
+            if (k2settings_color_type(k2settings_color_by_index(color,k2settings->dst_fgcolor,i))==2)
                 k2settings->dst_color=1;
         }
     if (k2settings->dst_bgtype==4)
         {
         int i,n;
+        char color[128];
         n=k2settings_ncolors(k2settings->dst_bgcolor);
         for (i=0;i<n;i++)
-            if (k2settings_color_type(k2settings_color_by_index(k2settings->dst_bgcolor,i))==2)
+            if (k2settings_color_type(k2settings_color_by_index(color,k2settings->dst_bgcolor,i))==2)
                 k2settings->dst_color=1;
         }
 
@@ -556,13 +572,13 @@ void k2pdfopt_settings_new_source_document_init(K2PDFOPT_SETTINGS *k2settings,ch
     /* Reset usegs for each document */
     k2settings->usegs=k2settings->user_usegs;
     /* Init document word spacing history */
-    textwords_add_word_gaps(NULL,0,NULL,0.);
+    textwords_add_word_gaps(NULL,0,NULL,0.,k2settings);
 #ifdef HAVE_OCR_LIB
     /* Init document OCR word list */
     if (k2settings->dst_ocr)
         k2ocr_init(k2settings,initstr);
 #endif
-    k2proc_init_one_document();
+    k2proc_init_one_document(k2settings);
     }
 
 
@@ -799,6 +815,7 @@ printf("    after devdims adjust = %d x %d\n",new_width,new_height);
             bmp_alloc(&masterinfo->bmp);
             bmp_fill(&masterinfo->bmp,255,255,255);
             masterinfo->rows=0;
+            masterinfo->toprow=0;
             }
         if (pageinfo!=NULL && k2settings->use_crop_boxes)
             {
@@ -994,19 +1011,21 @@ int k2settings_ncolors(char *s)
     }
 
 
-char *k2settings_color_by_index(char *s,int index)
+/*
+** v2.56:  color[] (at least 128 chars) is supplied by the caller (was static).
+*/
+char *k2settings_color_by_index(char *color,char *s,int index)
 
     {
     int i,c;
-    static char x[128];
 
     for (i=c=0;c<index && s[i]!='\0';i++)
         if (s[i]==',')
             c++;
     for (c=0;s[i]!='\0' && s[i]!=',' && c<127;i++)
-        x[c++]=s[i];
-    x[c]='\0';
-    return(x);
+        color[c++]=s[i];
+    color[c]='\0';
+    return(color);
     /* return(hexcolor(x)); */
     }
 
@@ -359,9 +359,14 @@ static void k2settings_to_cmd(STRBUF *cmdline,K2PDFOPT_SETTINGS *dst,
     integer_check(cmdline,nongui,"-go",&src->grid_order,dst->grid_order);
     integer_check(cmdline,nongui,"-f2p",&src->dst_fit_to_page,dst->dst_fit_to_page);
     integer_check(cmdline,NULL,"-nt",&src->nthreads,dst->nthreads);
+    integer_check(cmdline,nongui,"-ntr",&src->render_threads,dst->render_threads);
+    integer_check(cmdline,nongui,"-ntw",&src->write_threads,dst->write_threads);
+    integer_check(cmdline,NULL,"-jobs",&src->jobs,dst->jobs);
+    integer_check(cmdline,NULL,"-rc",&src->render_cache_mb,dst->render_cache_mb);
     double_check(cmdline,nongui,"-vb",&src->vertical_break_threshold,dst->vertical_break_threshold);
     minus_check(cmdline,NULL,"-sm",&src->show_marked_source,dst->show_marked_source);
     minus_check(cmdline,nongui,"-toc",&src->use_toc,dst->use_toc);
+    minus_check(cmdline,nongui,"-xrs",&src->xref_stream,dst->xref_stream);
     plus_minus_check(cmdline,nongui,"-jfc",&src->use_toc,dst->use_toc);
     if (src->dst_break_pages != dst->dst_break_pages)
         {
@@ -408,6 +413,10 @@ static void k2settings_to_cmd(STRBUF *cmdline,K2PDFOPT_SETTINGS *dst,
         strbuf_dsprintf(cmdline,nongui,"-ocrdpi %d",dst->ocr_dpi);
         }
     minus_check(cmdline,nongui,"-ocrsort",&src->ocrsort,dst->ocrsort);
+    minus_check(cmdline,nongui,"-ocrasync",&src->ocr_async,dst->ocr_async);
+    integer_check(cmdline,nongui,"-ocrwb",&src->ocr_word_batch,dst->ocr_word_batch);
+    integer_check(cmdline,nongui,"-ocrc",&src->ocr_cache_mb,dst->ocr_cache_mb);
+    string_check_minus(cmdline,nongui,"-ocrcf",src->ocr_cache_file,dst->ocr_cache_file);
     minus_check(cmdline,nongui,"-ocrvbb",&src->ocrvbb,dst->ocrvbb);
     if ((src->dst_ocr_visibility_flags&7) != (dst->dst_ocr_visibility_flags&7))
         {
@@ -513,6 +522,7 @@ static void k2settings_to_cmd(STRBUF *cmdline,K2PDFOPT_SETTINGS *dst,
     string_check(cmdline,nongui,"-bpl",src->bpl,dst->bpl);
     string_check(cmdline,nongui,"-toclist",src->toclist,dst->toclist);
     string_check(cmdline,nongui,"-tocsave",src->tocsavefile,dst->tocsavefile);
+    string_check_minus(cmdline,nongui,"-profile",src->profile,dst->profile);
     string_check_minus(cmdline,nongui,"-ci",src->dst_coverimage,dst->dst_coverimage);
     integer_check(cmdline,nongui,"-bpc",&src->dst_bpc,dst->dst_bpc);
     double_check(cmdline,nongui,"-g",&src->dst_gamma,dst->dst_gamma);
@@ -20,18 +20,24 @@
 
 #include "k2pdfopt.h"
 #include <stdarg.h>
+#include <pthread.h>
 
 #ifdef __ANDROID__
 #include <android/log.h>
 #endif
 
+static pthread_key_t k2printf_mute_key;
+static pthread_once_t k2printf_mute_once=PTHREAD_ONCE_INIT;
+static int k2printf_muted(void);
+static void k2printf_mute_key_create(void);
+
 
 void k2sys_init(void)
 
     {
     wsys_set_decimal_period(1);
 #ifdef HAVE_OCR_LIB
-    k2ocr_cpu_time_reset();
+    k2ocr_cpu_time_reset(NULL);
 #endif
     /* wrapbmp_init(); */
     }
@@ -46,8 +52,8 @@ void k2sys_cpu_update(K2PDFOPT_SETTINGS *k2settings,double start_seconds,double
         int mt;
         double cpusecs;
 
-        mt=k2ocr_max_threads();
-        cpusecs=k2ocr_cpu_time_secs();
+        mt=k2ocr_max_threads(k2settings);
+        cpusecs=k2ocr_cpu_time_secs(k2settings);
         k2printf("Total OCR CPU time used:  ");
         if (mt<=1)        
             k2printf("%.2f s\n",cpusecs);
@@ -79,6 +85,7 @@ void k2sys_close(K2PDFOPT_SETTINGS *k2settings)
 void k2sys_exit(K2PDFOPT_SETTINGS *k2settings,int val)
 
     {
+    k2printf_mute_thread(0);
     k2sys_enter_to_exit(k2settings);
     k2sys_close(k2settings);
     exit(val);
@@ -158,6 +165,8 @@ int k2printf(char *fmt,...)
     static void *k2printf_semaphore;
     static int count=0;
     
+    if (k2printf_muted())
+        return(0);
     if (count==0)
         k2printf_semaphore = willusgui_semaphore_create_ex("k2printf",1,1);
     count++;
@@ -195,6 +204,33 @@ int k2printf(char *fmt,...)
     }
 
 
+/*
+** v2.56:  Discard (mute!=0) or restore the k2printf() output of the calling
+**         thread.  Used for the conversion threads of -jobs.
+*/
+void k2printf_mute_thread(int mute)
+
+    {
+    pthread_once(&k2printf_mute_once,k2printf_mute_key_create);
+    pthread_setspecific(k2printf_mute_key,mute ? (void *)&k2printf_mute_key : NULL);
+    }
+
+
+static int k2printf_muted(void)
+
+    {
+    pthread_once(&k2printf_mute_once,k2printf_mute_key_create);
+    return(pthread_getspecific(k2printf_mute_key)!=NULL);
+    }
+
+
+static void k2printf_mute_key_create(void)
+
+    {
+    pthread_key_create(&k2printf_mute_key,NULL);
+    }
+
+
 void k2gets(char *buf,int maxlen,char *def)
 
     {
@@ -457,6 +457,15 @@ static char *k2pdfopt_options=
 "                  the multi-column layout if it is also trying to detect what\n"
 "                  is a figure caption.  See also -cg, -cgmax, -cgr, -crgh.\n"
 "                  Default = -jfc.\n"
+"-jobs <n>         Convert <n> source files at a time (batch mode), each on its\n"
+"                  own thread, after expanding any folders and wildcards.  The\n"
+"                  OCR engine (e.g. the Tesseract instances, see -nt) is\n"
+"                  loaded once and shared by all of the files.  Output from\n"
+"                  the individual conversions is not shown; a line is printed\n"
+"                  as each file finishes, followed by a summary.  Since there\n"
+"                  is no prompting, existing output files that would need to\n"
+"                  be confirmed for overwriting (see -ow) are skipped unless\n"
+"                  -y is specified.  Default is -jobs 1 (one file at a time).\n"
 "-jpg [<quality>]  Use JPEG compression in PDF file with quality level\n"
 "                  <quality> (def=90).  A lower quality value will make your\n"
 "                  file smaller.  See also -png. Use of -jpg is incompatible\n"
@@ -675,6 +684,19 @@ static char *k2pdfopt_options=
 "                  NOTE:  -nt has no effect if you select -ocrd c or -ocrd p.\n"
 "                         See -ocrd.\n"
 #endif
+#if (defined(HAVE_MUPDF_LIB) || defined(HAVE_DJVU_LIB))
+"-ntr <nthreads>   Use <nthreads> parallel threads to render upcoming source\n"
+"                  pages (PDF, CBZ, and DJVU files) while the current page is\n"
+"                  being processed.  Each thread holds at most one rendered\n"
+"                  page in memory.  A negative value is interpreted as a\n"
+"                  percentage of available CPUs.  Use -ntr 0 to render pages\n"
+"                  one at a time.  Default is -50 (half of the CPU threads).\n"
+"                  Has no effect when Ghostscript is used to render pages.\n"
+#endif
+"-ntw <nthreads>   Use up to <nthreads> parallel threads to compress each\n"
+"                  output page image (when not using JPEG compression).  A\n"
+"                  negative value is interpreted as a percentage of available\n"
+"                  CPUs.  Default is -50 (half of the CPU threads).\n"
 "-o <namefmt>      Set the output file name using <namefmt>.  %s will be\n"
 "                  replaced with the full name of the source file minus the\n"
 "                  extension.  %b will be replaced by the base name of the\n"
@@ -723,6 +745,21 @@ static char *k2pdfopt_options=
 "                      that word because the OCR of that word is incorrect, or\n"
 "                      if you copy a selection of the OCR text and paste it\n"
 "                      into something else so that you can actually see it.\n"
+"-ocrasync[-]      Write each output page as soon as it is laid out and add its\n"
+"                  OCR text layer later, when the OCR threads finish with it.\n"
+"                  This keeps all of the OCR threads busy with words from many\n"
+"                  pages at once.  Ignored for bitmap output, native PDF\n"
+"                  output, landscape output, or -ocrvis b.  Default is\n"
+"                  -ocrasync- (off).\n"
+"-ocrc <MB>        Keep up to <MB> megabytes of OCR results in memory, looked\n"
+"                  up by the word bitmap, so that words that look exactly the\n"
+"                  same as ones already OCR'd (e.g. running headers and page\n"
+"                  numbers) aren't OCR'd again.  Default = 16.  Use -ocrc 0\n"
+"                  to turn this off.  See also -ocrcf.\n"
+"-ocrcf[-] <file>  Also save [don't save] the OCR results in <file> and\n"
+"                  re-use the ones already there, e.g. to convert the same\n"
+"                  document again with different options without OCR-ing\n"
+"                  it again.  Default is -ocrcf- (no file).\n"
 "-ocrcol <n>       If you are simply processing a PDF to OCR it (e.g. if you\n"
 "                  are using the -mode copy option) and the source document has\n"
 "                  multiple columns of text, set this value to the number of\n"
@@ -833,6 +870,14 @@ static char *k2pdfopt_options=
                    "  See also -ocrlang (the note about -ocrvis t)."
 #endif
 "\n"
+#ifdef HAVE_TESSERACT_LIB
+"-ocrwb <n>        With -ocrd w, OCR up to <n> words with each call to\n"
+"                  Tesseract by placing them side by side in one bitmap.\n"
+"                  This is much faster than one call per word, since most of\n"
+"                  the time for a single word goes into Tesseract's setup\n"
+"                  for each call.  Use -ocrwb 1 to OCR one word at a time.\n"
+"                  Default = 16.\n"
+#endif
 #endif
 "-odpi <dpi>       Set pixels per inch of output screen (def=167). See also\n"
 "                  -dr, -w, -h, -fc.  You can also use -dpi for this.\n"
@@ -891,10 +936,26 @@ static char *k2pdfopt_options=
 "                     <srcfile>\n"
 "                  The default is not to post process with ghostscript.\n"
 #endif
+"-profile[-] <file>\n"
+"                  Append [don't append] wall and CPU time, call count, and\n"
+"                  bytes for each processing stage (rasterize, deskew, dewarp,\n"
+"                  columns, textrows, wrap, ocr, png, jpeg, flate, pdfwrite)\n"
+"                  to <file> as JSON:  one line per converted document, with\n"
+"                  totals for the document and for each source page.  CPU\n"
+"                  times are for the thread that ran the stage (OCR CPU time\n"
+"                  includes the OCR threads).  Stage times overlap when one\n"
+"                  stage runs inside another (e.g. textrows inside columns).\n"
+"                  <file> is started over the first time it is written by each\n"
+"                  run of k2pdfopt.  Default = -profile- (no profiling).\n"
 "-px <pagelist>    Exclude pages from <pagelist>.  Overrides -p option.  Default\n"
 "                  is no excluded pages (-px -1).\n"
 "-r[-]             Right-to-left [left-to-right] page scans.  Default is\n"
 "                  left to right.  See also -go option.\n"
+"-rc <MB>          Keep up to <MB> megabytes of rendered source pages in memory\n"
+"                  so that a page needed again at the same resolution (e.g.\n"
+"                  after the -rt auto or -fs page sampling pass, or when the\n"
+"                  preview is redone) does not have to be rendered again.\n"
+"                  Use -rc 0 to turn this off.  Default is -rc 256.\n"
 "-rhmin <points>   Row Height Minimum.  This sets the minimum height that any\n"
 "                  text row or text-row-like object can be, in points.  If\n"
 "                  the object is less than this height, it will be ignored\n"
@@ -1062,6 +1123,11 @@ static char *k2pdfopt_options=
 "                  The default value for -wt is -1, which tells k2pdfopt to pick\n"
 "                  the optimum value.  See also -cmax, -colorfg, -colorbg.\n"
 "-x[-]             Exit [don't exit--wait for <Enter>] after completion.\n"
+"-xrs[-]           End the output PDF file with [without] a compressed\n"
+"                  cross-reference stream (PDF 1.5) instead of a cross-\n"
+"                  reference table.  Smaller for files with many pages, but\n"
+"                  some older readers can't open it.  Output files over 10 GB\n"
+"                  always use a cross-reference stream.  Default is -xrs-.\n"
 "-y[-]             Assume [don't assume] \"yes\" to queries, such as whether\n"
 "                  to overwrite a file.  See also -ow.  Also turns off any\n"
 "                  warning messages.\n";
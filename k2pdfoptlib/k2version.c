@@ -1,4 +1,4 @@
-char *k2pdfopt_version = "v2.55";
+char *k2pdfopt_version = "v2.56";
 /*
 ** k2version.c  K2pdfopt version number and history.
 **
@@ -20,6 +20,129 @@ char *k2pdfopt_version = "v2.55";
 **
 ** VERSION HISTORY
 **
+** v2.56     16 OCT 2026
+**           ENHANCEMENTS
+**           -MuPDF documents are now opened once per conversion and kept open
+**            (along with their font/glyph caches) for all page renders, page
+**            counts, text-layer reads, and outline reads.  See
+**            bmpmupdf_session_document() in bmpmupdf.c.
+**           -Upcoming source pages (PDF, CBZ, DJVU) are rendered on worker
+**            threads, each with its own MuPDF document, while the current
+**            page is laid out.  New option -ntr controls the number of
+**            render threads (default -50 = half the CPU threads).  See
+**            k2prefetch.c.
+**           -OCR threads are now started once (in k2ocr_init()) and kept for
+**            the whole run instead of being created for every OCR batch.
+**            Word bitmaps are handed to the OCR threads as soon as they are
+**            queued, so OCR runs while the page layout continues.  See
+**            ocrpool_start() in willuslib/ocr.c.
+**           -New -ocrasync option:  output pages are written as soon as they
+**            are laid out and their OCR text layers are added to the PDF
+**            file once the OCR threads are done with them, so OCR runs on
+**            words from many pages at once.  See
+**            pdffile_add_bitmap_with_deferred_ocrwords() in pdfwrite.c.
+**           -The state used to convert a document (settings, master bitmap,
+**            marked-source PDF, OCR engine and thread pool, MuPDF session) is
+**            now kept in a K2CONTEXT instead of in static variables, so
+**            several documents can be converted on separate threads in one
+**            process.  See k2ctx_new() / k2ctx_convert_file() in k2ctx.c.
+**           -New -jobs option converts several documents at once, each on
+**            its own thread and K2CONTEXT, all sharing one OCR engine and
+**            OCR thread pool.  Progress is reported as each document
+**            finishes, followed by a list of the ones that failed.
+**            Documents rendered with Ghostscript (PostScript, or PDF with
+**            -gs) are converted one at a time.  See k2ctx_convert_files()
+**            in k2ctx.c.
+**           -Dark-pixel counts used to find columns, gaps and region
+**            bounding boxes now come from an integral image of the source
+**            page that is built once per page, so each count takes constant
+**            time.  See bmpregion_black_count() in bmpregion.c.
+**           -SSE2 / AVX2 versions (chosen at run time) of the bitmap grey
+**            conversion, white threshold, and invert loops give the same
+**            results as the C versions several times faster.  See
+**            willuslib/bmpsimd.c.
+**           -bmp_resample_fixed_point() is now separable (precomputed row and
+**            column weights, horizontal pass into a ring buffer of rows, SIMD
+**            vertical pass) and is used for all page scaling.  Its weights
+**            are now calculated in floating point, so output is within one
+**            grey level of bmp_resample() when up-scaling, too (the old
+**            fixed-point spans were off by up to 36 levels at 200x).
+**           -New -profile <file> option writes the wall time, CPU time, call
+**            count and bytes for each processing stage (rasterize, deskew,
+**            dewarp, columns, text rows, wrap, OCR, PNG/JPEG/flate, PDF
+**            writing) per page and per document, one line of JSON per
+**            document.  See k2profile.c and willuslib/wprofile.c.
+**           -Publishing an output page no longer moves all of the remaining
+**            rows of the master bitmap up.  The master bitmap now has a top
+**            row offset, and rows are only moved back up when the space
+**            above them is at least as large as they are.  See
+**            masterinfo_more_rows() in k2master.c.
+**           -Flate-compressed output page images are compressed by several
+**            threads (new -ntw option).  Each thread deflates a band of rows,
+**            and the bands are joined into one stream.  8-bit images now
+**            use PNG row predictors if a trial compression of their first
+**            band says it helps, which makes grey and photo-like pages
+**            10-25% smaller (dithered or noisy ones are left as they were).
+**            See pdffile_flate_image() in willuslib/pdfwrite.c.
+**           -Bilevel output page images (-bpc 1, or grey images with only
+**            black and white pixels) are now CCITT Group 4 encoded
+**            (/CCITTFaxDecode), unless 1-bit flate is smaller for the
+**            first band of the image (e.g. dithered or noisy pages).  See
+**            willuslib/bmpg4.c.
+**           -The PDF writer uses 64-bit file offsets, so output files over
+**            2 GB are no longer corrupted, and it ends files over 10 GB
+**            (or any file, with the new -xrs option) with a compressed
+**            cross-reference stream.  See pdffile_xref_stream() in
+**            willuslib/pdfwrite.c.
+**           -Auto-straightening (-as) finds the skew angle with a coarse
+**            sweep on a 4x downsampled black/white copy of the page (angles
+**            tried in parallel by -ntr threads) and then a golden-section
+**            search at full resolution, instead of trying every 0.05 deg
+**            step at full resolution.  About 10x faster, same angle to
+**            within 0.05 deg.  See bmp_autostraighten() in willuslib/bmp.c.
+**           -De-warping (-dw) keeps the last good Leptonica page model for
+**            even and odd pages, so a page without enough text lines for
+**            its own model uses a nearby page's.  See
+**            willuslib/wleptonica.c.
+**           -With -ocr m, the words in the PDF text layer are put in a grid
+**            (by source-page position) when the page is loaded, so each
+**            region only copies and tests the words that overlap it
+**            instead of every word on the page.  See
+**            ocrwordgrid_find_region_words() in k2ocr.c.
+**           -Previews save the layout state (master and wrap bitmaps, queued
+**            pages, last row, working settings) at source-page boundaries,
+**            so the next preview of the same file with the same settings
+**            starts from the last source page before the requested output
+**            page instead of from page 1.  See k2checkpoint.c.
+**           -Rendered source pages are kept in a memory-limited LRU cache
+**            (new -rc option, default 256 MB) keyed by file, date, page,
+**            resolution and bits per pixel, so the -rt auto / -fs sampling
+**            pass, the conversion pass, the render threads, repeated
+**            previews, and the GUI overlay don't render a page twice.
+**            See willuslib/bmpcache.c.
+**           -bmp_alloc() / bmp_free() get bitmap buffers from a per-thread
+**            pool of size classes (4 per power of two) instead of from
+**            malloc() / free() every time.  Buffers not re-used by the end
+**            of the next source page are freed.  -profile reports the pool
+**            hits and misses.  See willuslib/bmppool.c.
+**           -When Ghostscript renders the source pages (-gs, or no MuPDF),
+**            it is run once for a run of pages instead of once per page,
+**            and sends them as raw ppm frames through a pipe instead of
+**            writing and re-reading a temporary PNG file for each page.
+**            See willusgs_session_get() in willuslib/wgs.c.
+**           -Tesseract OCR:  each word bitmap is bordered, down-sampled,
+**            and packed into the Tesseract PIX in one pass (no temporary
+**            bitmap, resize copy, or byte swap of the PIX data).
+**           -New option -ocrwb:  with -ocrd w, the OCR threads pass up to
+**            16 (default) queued word bitmaps of similar height to
+**            Tesseract at once, side by side in one bitmap, instead of
+**            making one Tesseract call per word.
+**           -New options -ocrc and -ocrcf:  OCR results are cached by a
+**            hash of the word bitmap (with the OCR language and dpi), so
+**            repeated words like running headers and page numbers are
+**            only OCR'd once, and with -ocrcf <file>, the results are
+**            re-used by later conversions too.  See willuslib/ocrcache.c.
+**
 ** v2.55     26 DEC 2023
 **           ENHANCEMENTS
 **           -Windows version compiled with MinGW, gcc v13.2.0 on Windows 11
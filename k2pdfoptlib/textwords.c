@@ -75,18 +75,21 @@ void textwords_remove_small_col_gaps(TEXTWORDS *textwords,int lcheight,double mi
 /*
 ** Track gaps between words so that we can tell when one is out of family.
 ** lcheight = height of a lowercase letter.
+** v2.56:  The gap history is kept in the conversion context (was static).
 */
 void textwords_add_word_gaps(TEXTWORDS *textwords,int lcheight,double *median_gap,
-                             double word_spacing)
+                             double word_spacing,K2PDFOPT_SETTINGS *k2settings)
 
     {
-    static int nn=0;
-    static double gap[1024];
     static char *funcname="word_gaps_add";
+    K2CONTEXT *k2ctx;
+    double *gap;
 
+    k2ctx=k2ctx_get(k2settings);
+    gap=k2ctx->word_gap;
     if (textwords==NULL && median_gap==NULL)
         {
-        nn=0;
+        k2ctx->word_gap_count=0;
         return;
         }
     if (textwords!=NULL && textwords->n>1)
@@ -99,19 +102,19 @@ void textwords_add_word_gaps(TEXTWORDS *textwords,int lcheight,double *median_ga
             g = (double)textwords->textrow[i].gap / lcheight;
             if (g>=word_spacing)
                 {
-                gap[nn&0x3ff]= g;
-                nn++;
+                gap[k2ctx->word_gap_count&0x3ff]= g;
+                k2ctx->word_gap_count++;
                 }
             }
         }
     if (median_gap!=NULL)
         {
-        if (nn>0)
+        if (k2ctx->word_gap_count>0)
             {
             int n;
             double *gap_sorted;  /* v2.02--this variable is no longer static */
 
-            n = (nn>1024) ? 1024 : nn;
+            n = (k2ctx->word_gap_count>1024) ? 1024 : k2ctx->word_gap_count;
             willus_dmem_alloc_warn(28,(void **)&gap_sorted,sizeof(double)*n,funcname,10);
             memcpy(gap_sorted,gap,n*sizeof(double));
             sortd(gap_sorted,n);
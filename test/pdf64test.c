@@ -0,0 +1,222 @@
+/*
+** pdf64test.c    Checks that PDFFILE can write objects, /Length fields and
+**                xref offsets past 4 GB (v2.56).  The 5 GB gap in front of
+**                the image object is left unwritten, so on file systems
+**                with sparse file support it takes no disk space.
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2023  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <willus.h>
+
+#define GAP_BYTES (5LL<<30)
+
+static int check_objects(FILE *f,long long xrefpos,int *nbig);
+static int check_stream_length(FILE *f,long long objpos);
+
+
+int main(int argc,char *argv[])
+
+    {
+    PDFFILE _pdf,*pdf;
+    WILLUSBITMAP _bmp,*bmp;
+    FILE *f;
+    char filename[512];
+    char buf[256];
+    long long size,xrefpos;
+    int i,status,nbig;
+
+    pdf=&_pdf;
+    bmp=&_bmp;
+    sprintf(filename,"%s",argc>1 ? argv[1] : "pdf64test.pdf");
+    if (pdffile_init(pdf,filename,0)==NULL)
+        {
+        printf("pdf64test:  Cannot open %s for writing.\n",filename);
+        return(10);
+        }
+    /* Skip 5 GB so that the image object and its /Length land past 4 GB */
+    wfile_seek(pdf->f,GAP_BYTES,0);
+    bmp_init(bmp);
+    bmp->width=64;
+    bmp->height=48;
+    bmp->bpp=8;
+    bmp_alloc(bmp);
+    for (i=0;i<256;i++)
+        bmp->red[i]=bmp->green[i]=bmp->blue[i]=i;
+    for (i=0;i<bmp->height;i++)
+        memset(bmp_rowptr_from_top(bmp,i),(i*5)&0xff,bmp->width);
+    pdffile_add_bitmap(pdf,bmp,100.,-1,0);
+    bmp_free(bmp);
+    pdffile_finish(pdf,"pdf64test","",NULL,NULL);
+    pdffile_close(pdf);
+
+    status=1;
+    f=fopen(filename,"rb");
+    if (f==NULL)
+        {
+        printf("pdf64test:  Cannot re-open %s.\n",filename);
+        remove(filename);
+        return(10);
+        }
+    wfile_seek(f,0,2);
+    size=wfile_tell(f);
+    if (size<=GAP_BYTES)
+        {
+        printf("pdf64test:  File size %lld is not past the %lld-byte gap.\n",size,GAP_BYTES);
+        goto done;
+        }
+    /* startxref value is the next-to-last line */
+    wfile_seek(f,size-64,0);
+    i=fread(buf,1,64,f);
+    buf[i]='\0';
+    {
+    char *p;
+    p=strstr(buf,"startxref");
+    if (p==NULL || sscanf(p+9,"%lld",&xrefpos)!=1)
+        {
+        printf("pdf64test:  No startxref at end of file.\n");
+        goto done;
+        }
+    }
+    if (xrefpos<=GAP_BYTES || xrefpos>=size)
+        {
+        printf("pdf64test:  startxref %lld is wrong (file size %lld).\n",xrefpos,size);
+        goto done;
+        }
+    wfile_seek(f,xrefpos,0);
+    if (fgets(buf,255,f)==NULL || strncmp(buf,"xref",4))
+        {
+        printf("pdf64test:  No xref table at startxref %lld.\n",xrefpos);
+        goto done;
+        }
+    if (check_objects(f,xrefpos,&nbig))
+        goto done;
+    if (nbig==0)
+        {
+        printf("pdf64test:  No objects were written past 4 GB.\n");
+        goto done;
+        }
+    printf("pdf64test:  %lld-byte file, %d object(s) past 4 GB, xref at %lld:  OK\n",
+           size,nbig,xrefpos);
+    status=0;
+done:
+    fclose(f);
+    remove(filename);
+    return(status);
+    }
+
+
+/*
+** Each xref entry must point at its "N 0 obj" line, and each stream's
+** /Length must end exactly at "endstream".
+*/
+static int check_objects(FILE *f,long long xrefpos,int *nbig)
+
+    {
+    char buf[256];
+    long long *pos;
+    int i,i0,n;
+
+    (*nbig)=0;
+    wfile_seek(f,xrefpos,0);
+    if (fgets(buf,255,f)==NULL || fgets(buf,255,f)==NULL || sscanf(buf,"%d %d",&i0,&n)!=2)
+        {
+        printf("pdf64test:  Bad xref subsection header.\n");
+        return(-1);
+        }
+    pos=malloc(sizeof(long long)*n);
+    for (i=0;i<n;i++)
+        if (fgets(buf,255,f)==NULL || sscanf(buf,"%lld",&pos[i])!=1)
+            {
+            printf("pdf64test:  Bad xref entry %d.\n",i);
+            free(pos);
+            return(-2);
+            }
+    for (i=1;i<n;i++)
+        {
+        int objnum;
+
+        wfile_seek(f,pos[i],0);
+        if (fgets(buf,255,f)==NULL || sscanf(buf,"%d 0 obj",&objnum)!=1 || objnum!=i)
+            {
+            printf("pdf64test:  xref offset %lld for object %d is wrong.\n",pos[i],i);
+            free(pos);
+            return(-3);
+            }
+        if (pos[i]>0xffffffffLL)
+            (*nbig)++;
+        if (check_stream_length(f,pos[i]))
+            {
+            free(pos);
+            return(-4);
+            }
+        }
+    free(pos);
+    return(0);
+    }
+
+
+static int check_stream_length(FILE *f,long long objpos)
+
+    {
+    char buf[256];
+    long long len;
+    int haslen;
+
+    wfile_seek(f,objpos,0);
+    haslen=0;
+    len=0;
+    while (fgets(buf,255,f)!=NULL)
+        {
+        char *p;
+
+        if (!strncmp(buf,"endobj",6))
+            return(0);
+        p=strstr(buf,"/Length ");
+        if (p!=NULL)
+            {
+            if (sscanf(p+8,"%lld",&len)!=1)
+                {
+                printf("pdf64test:  Blank /Length in object at %lld.\n",objpos);
+                return(-1);
+                }
+            haslen=1;
+            }
+        if (!strncmp(buf,"stream",6))
+            {
+            if (!haslen)
+                {
+                printf("pdf64test:  Stream without /Length in object at %lld.\n",objpos);
+                return(-2);
+                }
+            wfile_seek(f,wfile_tell(f)+len,0);
+            if (fgets(buf,255,f)==NULL || (buf[0]=='\n' && fgets(buf,255,f)==NULL)
+                    || strncmp(buf,"endstream",9))
+                {
+                printf("pdf64test:  /Length %lld does not end at endstream (object at %lld).\n",
+                       len,objpos);
+                return(-3);
+                }
+            return(0);
+            }
+        }
+    return(0);
+    }
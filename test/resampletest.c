@@ -0,0 +1,125 @@
+/*
+** resampletest.c    Checks that bmp_resample_fixed_point() (which is what
+**                   bmp_resample_optimum_performance() uses) stays within
+**                   one grey level of the floating-point bmp_resample()
+**                   when scaling down, scaling up, and from fractional
+**                   source origins (v2.56).
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2023  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <willus.h>
+
+typedef struct
+    {
+    int sw,sh;      /* Source size */
+    double x1,y1;   /* Source origin (resampled to the bottom right corner) */
+    int nw,nh;      /* Destination size */
+    } RESAMPLECASE;
+
+static RESAMPLECASE rcase[] =
+    {
+    { 2550, 3300,  0.,   0.,   1072, 1448 },  /* Typical page down-scale */
+    {  100,  100,  0.,   0.,     37,   41 },
+    {  300,  300,  2.5,  7.25,   31,   29 },
+    { 1000, 1000,  0.,   0.,   1001,  999 },
+    {  100,  100,  0.,   0.,    250,  250 },
+    {   37,   53,  0.3,  0.7,   400,  500 },
+    {   50,   50,  1.1,  2.9,   173,  911 },  /* 18x vertical up-scale */
+    {    7,    5,  0.37, 1.21, 1917, 1433 },
+    {    0,    0,  0.,   0.,      0,    0 }
+    };
+
+static int resample_maxdiff(RESAMPLECASE *rc,int bpp);
+
+
+int main(int argc,char *argv[])
+
+    {
+    int i,bpp,status;
+
+    status=0;
+    for (bpp=8;bpp<=24;bpp+=16)
+        for (i=0;rcase[i].sw>0;i++)
+            {
+            int md;
+
+            md=resample_maxdiff(&rcase[i],bpp);
+            printf("resampletest:  %2d-bit %4dx%-4d (from %g,%g) -> %4dx%-4d:  max diff = %d%s\n",
+                   bpp,rcase[i].sw,rcase[i].sh,rcase[i].x1,rcase[i].y1,
+                   rcase[i].nw,rcase[i].nh,md,md>1 ? "  ** FAILED **" : "");
+            if (md>1)
+                status=1;
+            }
+    return(status);
+    }
+
+
+/*
+** Largest difference (in any color plane) between bmp_resample() and
+** bmp_resample_fixed_point() on a noise image, which is the worst case.
+*/
+static int resample_maxdiff(RESAMPLECASE *rc,int bpp)
+
+    {
+    WILLUSBITMAP _src,*src,_fl,*fl,_fp,*fp;
+    int i,row,md,nb;
+
+    src=&_src;
+    fl=&_fl;
+    fp=&_fp;
+    bmp_init(src);
+    bmp_init(fl);
+    bmp_init(fp);
+    src->width=rc->sw;
+    src->height=rc->sh;
+    src->bpp=bpp;
+    bmp_alloc(src);
+    for (i=0;i<256;i++)
+        src->red[i]=src->green[i]=src->blue[i]=i;
+    srand(1);
+    nb=bmp_bytewidth(src);
+    for (row=0;row<src->height;row++)
+        {
+        unsigned char *p;
+
+        p=bmp_rowptr_from_top(src,row);
+        for (i=0;i<nb;i++)
+            p[i]=rand()&0xff;
+        }
+    bmp_resample(fl,src,rc->x1,rc->y1,(double)rc->sw,(double)rc->sh,rc->nw,rc->nh);
+    bmp_resample_fixed_point(fp,src,rc->x1,rc->y1,(double)rc->sw,(double)rc->sh,rc->nw,rc->nh);
+    md=0;
+    nb=bmp_bytewidth(fl);
+    for (row=0;row<fl->height;row++)
+        {
+        unsigned char *p,*q;
+
+        p=bmp_rowptr_from_top(fl,row);
+        q=bmp_rowptr_from_top(fp,row);
+        for (i=0;i<nb;i++)
+            if (abs(p[i]-q[i])>md)
+                md=abs(p[i]-q[i]);
+        }
+    bmp_free(fp);
+    bmp_free(fl);
+    bmp_free(src);
+    return(md);
+    }
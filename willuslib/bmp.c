@@ -27,6 +27,7 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <pthread.h>
 
 
 #ifdef HAVE_PNG_LIB
@@ -125,11 +126,9 @@ static void bmp_resample_1(double *tempbmp,WILLUSBITMAP *src,double x1,double y1
                            double *temprow,int color);
 static void resample_1d(double *dst,double *src,double x1,double x2,int n);
 static double resample_single(double *y,double x1,double x2);
-static void bmp_resample_1_fixed_point(int *tempbmp,WILLUSBITMAP *src,int x1_fp,int y1_fp,
-                                       int x2_fp,int y2_fp,int newwidth,int newheight,
-                                       int *temprow,int color);
-static void resample_1d_fixed_point(int *dst,int *src,int x1_fp,int x2_fp,int n);
-static double resample_single_fixed_point(int *y,int x1_fp,int x2_fp);
+struct resample_weights;
+static int resample_weights_fixed_point(struct resample_weights *rsw,double x1,double x2,int n);
+static void resample_weights_free(struct resample_weights *rsw);
 #ifdef HAVE_PNG_LIB
 static void bmp_read_png_from_memory(png_structp png_ptr,void *buf,int nbytes);
 #endif
@@ -147,6 +146,10 @@ static void bmp_apply_filter_gray(WILLUSBITMAP *dest,WILLUSBITMAP *src,
                                   double **filter,int ncols,int nrows);
 static double bmp_row_by_row_stdev(WILLUSBITMAP *bmp,int ccount,int whitethresh,
                                    double theta_radians);
+static void bmp_row_by_row_stdevs(WILLUSBITMAP *bmp,int ccount,int whitethresh,
+                                  double *theta_radians,double *sdev,int n,int nthreads);
+static void *bmp_skew_thread(void *data);
+static void bmp_skew_downsample(WILLUSBITMAP *dst,WILLUSBITMAP *src,int ds,int whitethresh);
 static int pixval_dither(int pv,int n,int maxsrc,int maxdst,int x0,int y0);
 static int dither_rec(int bits,int x0,int y0);
 static int pcl_get_resolution(char *pclbuf,int n,int *w,int *h);
@@ -214,7 +217,15 @@ int bmp_write(WILLUSBITMAP *bmap,char *filename,FILE *out,int quality)
         return(bmp_write_ico(bmap,filename,out));
 #ifdef HAVE_PNG_LIB
     if (!stricmp(fileext,"png"))
-        return(bmp_write_png(bmap,filename,out));
+        {
+        WPROFILETIMER timer;
+        int status;
+
+        wprofile_start(&timer);
+        status=bmp_write_png(bmap,filename,out);
+        wprofile_stop(&timer,"png",status<0 ? 0. : wfile_size(filename));
+        return(status);
+        }
 #endif
     if (!stricmp(fileext,"pdf"))
         {
@@ -236,13 +247,19 @@ int bmp_write(WILLUSBITMAP *bmap,char *filename,FILE *out,int quality)
 #ifdef HAVE_JPEG_LIB
     if (!stricmp(fileext,"jpg") || !stricmp(fileext,"jpeg"))
         {
+        WPROFILETIMER timer;
+        int status;
+
         if (bmap->bpp!=24)
             {
             if (out!=NULL)
                 fprintf(out,"Can only write JPEG output for 24-bit bitmaps.\n");
             return(-10);
             }
-        return(bmp_write_jpeg(bmap,filename,quality,out));
+        wprofile_start(&timer);
+        status=bmp_write_jpeg(bmap,filename,quality,out);
+        wprofile_stop(&timer,"jpeg",status<0 ? 0. : wfile_size(filename));
+        return(status);
         }
 #endif
     if (stricmp(fileext,"bmp") && out!=NULL)
@@ -695,7 +712,7 @@ int bmp_read_png_stream(WILLUSBITMAP *bmp,void *io,int size,FILE *out)
     png_structp png_ptr;
     png_infop info_ptr,end_info;
     int     color_type,gotpal,rowbytes;
-    static png_colorp pngpal;
+    png_colorp pngpal;
     unsigned char **rowptrs;
     double *dptr;
     int     i,num_palette;
@@ -946,7 +963,7 @@ int bmp_write_png_stream_ex(WILLUSBITMAP *bmp,int trns_rgb,FILE *f,FILE *out)
                  PNG_FILTER_TYPE_DEFAULT);
     if (bmp->bpp==8)
         {
-        static png_color pngpal[256];
+        png_color pngpal[256];
         int     i;
 
         for (i=0;i<256;i++)
@@ -1390,10 +1407,20 @@ int bmp_alloc(WILLUSBITMAP *bmap)
     size = bmp_bytewidth_win32(bmap)*bmap->height;
     if (bmap->data!=NULL && bmap->size_allocated>=size)
         return(1);
+    /* v2.56:  Buffers are pool size classes (see bmppool.c) */
     if (bmap->data!=NULL)
+        {
+        size=(int)bmppool_size(size);
         willus_mem_realloc_robust_warn((void **)&bmap->data,size,bmap->size_allocated,funcname,10);
+        }
     else
-        willus_mem_alloc_warn((void **)&bmap->data,size,funcname,10);
+        {
+        size_t psize;
+
+        psize=size;
+        bmap->data=(unsigned char *)bmppool_get(&psize,funcname);
+        size=(int)psize;
+        }
     bmap->size_allocated=size;
     return(1);
     }
@@ -1755,7 +1782,9 @@ void bmp_free(WILLUSBITMAP *bmap)
     {
     if (bmap->data!=NULL)
         {
-        willus_mem_free((double **)&bmap->data,"bmp_free");
+        /* v2.56:  Keep the buffer for re-use if it's from the pool */
+        if (bmap->size_allocated<=0 || !bmppool_put(bmap->data,bmap->size_allocated))
+            willus_mem_free((double **)&bmap->data,"bmp_free");
         bmap->data=NULL;
         bmap->size_allocated=0;
         }
@@ -2306,11 +2335,29 @@ void bmp_convert_to_greyscale_ex(WILLUSBITMAP *dst,WILLUSBITMAP *src)
     newbpr=bmp_bytewidth(dst);
     /* Possibly restore src->bpp to 24 so RGBGET works right (src & dst may be the same) */
     src->bpp=bpp; 
+    /* v2.56:  Already grey?  Then it's just a copy. */
+    if (bpp==8 && bmp_is_grayscale(src))
+        {
+        if (dst!=src)
+            for (rownum=0;rownum<src->height;rownum++)
+                memcpy(&dst->data[newbpr*rownum],&src->data[oldbpr*rownum],src->width);
+        dst->bpp=8;
+        return;
+        }
     for (rownum=0;rownum<src->height;rownum++)
         {
         unsigned char *oldp,*newp;
         oldp = &src->data[oldbpr*rownum];
         newp = &dst->data[newbpr*rownum];
+        /* v2.56:  SSE2 / AVX2 kernel for 24-bit (see bmpsimd.c) */
+        if (bpp==24)
+            {
+            if (src->type==WILLUSBITMAP_TYPE_NATIVE)
+                bmp_simd_rgb_to_grey(newp,oldp,src->width,0,2);
+            else
+                bmp_simd_rgb_to_grey(newp,oldp,src->width,2,0);
+            continue;
+            }
         for (colnum=0;colnum<src->width;colnum++,oldp+=dp,newp++)
             {
             int r,g,b;
@@ -2952,17 +2999,36 @@ static double resample_single(double *y,double x1,double x2)
 /*
 ** Resample (re-size) bitmap, but use fixed-point and all integer math.
 ** Only slightly less accurate than floating point, but faster.
+**
+** v2.56:  Separable version.  Each output pixel is the area-weighted average
+** of the source pixels it covers (same as bmp_resample()).  The weights for
+** each output column and row are calculated once (RESAMPLE_WEIGHTS).  Each
+** source row is resampled horizontally once, into a small ring buffer of
+** rows, and each output row is then a weighted sum of ring buffer rows,
+** done with bmp_simd_madd().  The spans and weights are calculated in
+** floating point, exactly as bmp_resample() does, so the two agree to
+** within one grey level for any scale factor (test/resampletest.c).
 */
+#define RSWBITS    14
+#define RSWONE     (1<<RSWBITS)
+typedef struct resample_weights
+    {
+    int *i0;   /* First source pixel of each output pixel */
+    int *nw;   /* Number of source pixels (weights) for each output pixel */
+    int *iw;   /* Index into w[] of first weight for each output pixel */
+    int *w;    /* Weights--add up to RSWONE for each output pixel */
+    int maxnw;
+    } RESAMPLE_WEIGHTS;
+
 int bmp_resample_fixed_point(WILLUSBITMAP *dest,WILLUSBITMAP *src,double fx1,double fy1,
                              double fx2,double fy2,int newwidth,int newheight)
 
     {
-    int gray,maxlen,colorplanes;
-    /* Assumes integers are 32-bit */
-    int *tempbmp;
-    int *temprow;
-    int x1_fp,y1_fp,x2_fp,y2_fp,swidth_fp,sheight_fp;
-    int color,hmax,row,col,dy,dx;
+    RESAMPLE_WEIGHTS xw,yw;
+    int gray,colorplanes,rowlen,nring,ring0,ring1,pal;
+    int *ring,*acc;
+    double t;
+    int row,x0,y0,cr,cb;
     static char *funcname="bmp_resample";
 
     if (newwidth==0 || newheight==0)
@@ -2974,71 +3040,71 @@ int bmp_resample_fixed_point(WILLUSBITMAP *dest,WILLUSBITMAP *src,double fx1,dou
         return(0);
         }
     /*
-    ** Make sure we won't have fixed-precision overruns.
-    ** If so, just use the float routine
+    ** Make sure we won't have fixed-precision overruns (or weights that
+    ** round to zero).  If so, just use the float routine
     */
     if (fabs(fx2-fx1)*fabs(fy2-fy1)/(newheight*newwidth) > FPARMAX
+          || fabs(fx2-fx1)/newwidth > 256. || fabs(fy2-fy1)/newheight > 256.
           || fx1>FPDIMMAX || fx2>FPDIMMAX || fy1>FPDIMMAX || fy2>FPDIMMAX
           || newwidth>FPDIMMAX || newheight>FPDIMMAX
           || src->width>FPDIMMAX || src->height>FPDIMMAX)
         return(bmp_resample(dest,src,fx1,fy1,fx2,fy2,newwidth,newheight));
 
-    /* Convert to fixed-point integers */
-    x1_fp=fx1*FPMULT+0.5;
-    y1_fp=fy1*FPMULT+0.5;
-    x2_fp=fx2*FPMULT+0.5;
-    y2_fp=fy2*FPMULT+0.5;
-    swidth_fp = src->width<<FPBITS;
-    sheight_fp = src->height<<FPBITS;
-    /* Clip and sort x1,y1 and x2,y2 */
-    if (x1_fp>swidth_fp)
-        x1_fp=swidth_fp;
-    else if (x1_fp<0)
-        x1_fp=0;
-    if (x2_fp>swidth_fp)
-        x2_fp=swidth_fp;
-    else if (x2_fp<0)
-        x2_fp=0;
-    if (y1_fp>sheight_fp)
-        y1_fp=sheight_fp;
-    else if (y1_fp<0)
-        y1_fp=0;
-    if (y2_fp>sheight_fp)
-        y2_fp=sheight_fp;
-    else if (y2_fp<0)
-        y2_fp=0;
-    if (x2_fp<x1_fp)
+    /* Clip and sort x1,y1 and x2,y2 (same as bmp_resample()) */
+    if (fx1>src->width)
+        fx1=src->width;
+    else if (fx1<0.)
+        fx1=0.;
+    if (fx2>src->width)
+        fx2=src->width;
+    else if (fx2<0.)
+        fx2=0.;
+    if (fy1>src->height)
+        fy1=src->height;
+    else if (fy1<0.)
+        fy1=0.;
+    if (fy2>src->height)
+        fy2=src->height;
+    else if (fy2<0.)
+        fy2=0.;
+    if (fx2<fx1)
         {
-        int t;
-        t=x2_fp;
-        x2_fp=x1_fp;
-        x1_fp=t;
+        t=fx2;
+        fx2=fx1;
+        fx1=t;
         }
-    if (y2_fp<y1_fp)
+    if (fy2<fy1)
         {
-        int t;
-        t=y2_fp;
-        y2_fp=y1_fp;
-        y1_fp=t;
+        t=fy2;
+        fy2=fy1;
+        fy1=t;
         }
-    dy=(y2_fp-y1_fp)>>FPBITS;
-    dy += 2;
-    if (x2_fp==x1_fp || y2_fp==y1_fp)
+    if (fx2-fx1==0. || fy2-fy1==0.)
         return(-2);
+    x0=floor(fx1);
+    y0=floor(fy1);
 
-    /* Allocate temp storage */
-    dx = (x2_fp-x1_fp)>>FPBITS;
-    maxlen = dx > dy+newheight ? dx : dy+newheight;
-    maxlen += 16;
-    hmax = newheight > dy ? newheight : dy;
-    if (!willus_mem_alloc((double **)&temprow,maxlen*sizeof(int),funcname))
+    /* Weight tables */
+    if (!resample_weights_fixed_point(&xw,fx1-x0,fx2-x0,newwidth))
         return(-1);
-    if (!willus_mem_alloc((double **)&tempbmp,hmax*newwidth*sizeof(int),funcname))
+    if (!resample_weights_fixed_point(&yw,fy1-y0,fy2-y0,newheight))
         {
-        willus_mem_free((double **)&temprow,funcname);
+        resample_weights_free(&xw);
         return(-1);
         }
-    if ((gray=bmp_is_grayscale(src))!=0)
+    gray=bmp_is_grayscale(src);
+    colorplanes = gray ? 1 : 3;
+    rowlen = newwidth*colorplanes;
+    /* Ring buffer holds the horizontally resampled source rows for one output row */
+    nring = yw.maxnw;
+    if (!willus_mem_alloc((double **)&ring,(long)(nring+1)*rowlen*sizeof(int),funcname))
+        {
+        resample_weights_free(&yw);
+        resample_weights_free(&xw);
+        return(-1);
+        }
+    acc=&ring[nring*rowlen];
+    if (gray)
         {
         int i;
         dest->bpp=8;
@@ -3052,137 +3118,188 @@ int bmp_resample_fixed_point(WILLUSBITMAP *dest,WILLUSBITMAP *src,double fx1,dou
     dest->type=WILLUSBITMAP_TYPE_NATIVE;
     if (!bmp_alloc(dest))
         {
-        willus_mem_free((double **)&tempbmp,funcname);
-        willus_mem_free((double **)&temprow,funcname);
+        willus_mem_free((double **)&ring,funcname);
+        resample_weights_free(&yw);
+        resample_weights_free(&xw);
         return(-1);
         }
-    colorplanes = gray ? 1 : 3;
-    for (color=0;color<colorplanes;color++)
+    /* Source byte offsets of red and blue for 24-bit */
+    cr = src->type==WILLUSBITMAP_TYPE_WIN32 ? 2 : 0;
+    cb = 2-cr;
+    pal = (!gray && src->bpp==8);
+    /* Source rows ring0 to ring1-1 are in the ring buffer (at index row % nring) */
+    ring0=ring1=0;
+    for (row=0;row<newheight;row++)
         {
-        bmp_resample_1_fixed_point(tempbmp,src,x1_fp,y1_fp,x2_fp,y2_fp,newwidth,newheight,
-                                   temprow,gray ? -1 : color);
-        for (row=0;row<newheight;row++)
+        unsigned char *p;
+        int i,col,*w;
+
+        if (ring0 < yw.i0[row])
+            ring0 = yw.i0[row];
+        if (ring1 < ring0)
+            ring1 = ring0;
+        /* Horizontally resample the source rows that aren't in the ring yet */
+        for (;ring1<yw.i0[row]+yw.nw[row];ring1++)
             {
-            unsigned char *p;
-            int *s;
-            p=bmp_rowptr_from_top(dest,row)+color;
-            s=&tempbmp[row*newwidth];
-            if (colorplanes==1)
-                for (col=0;col<newwidth;p[0]=(s[0]+(FPPIXMULT/2-1))>>FPPIXBITS,col++,s++,p++);
-            else
-                for (col=0;col<newwidth;p[0]=(s[0]+(FPPIXMULT/2-1))>>FPPIXBITS,col++,s++,p+=colorplanes);
+            int *h;
+
+            h=&ring[(ring1%nring)*rowlen];
+            p=bmp_rowptr_from_top(src,ring1+y0)+(src->bpp==8 ? x0 : 3*x0);
+            for (col=0;col<newwidth;col++)
+                {
+                int k,nw,i0,r,g,b;
+
+                w=&xw.w[xw.iw[col]];
+                nw=xw.nw[col];
+                i0=xw.i0[col];
+                if (gray)
+                    {
+                    for (r=k=0;k<nw;k++)
+                        r += w[k]*p[i0+k];
+                    h[col] = (r+(1<<(RSWBITS-FPPIXBITS-1)))>>(RSWBITS-FPPIXBITS);
+                    continue;
+                    }
+                if (pal)
+                    for (r=g=b=k=0;k<nw;k++)
+                        {
+                        r += w[k]*src->red[p[i0+k]];
+                        g += w[k]*src->green[p[i0+k]];
+                        b += w[k]*src->blue[p[i0+k]];
+                        }
+                else
+                    {
+                    unsigned char *q;
+
+                    q=&p[3*i0];
+                    for (r=g=b=k=0;k<nw;k++,q+=3)
+                        {
+                        r += w[k]*q[cr];
+                        g += w[k]*q[1];
+                        b += w[k]*q[cb];
+                        }
+                    }
+                h[3*col] = (r+(1<<(RSWBITS-FPPIXBITS-1)))>>(RSWBITS-FPPIXBITS);
+                h[3*col+1] = (g+(1<<(RSWBITS-FPPIXBITS-1)))>>(RSWBITS-FPPIXBITS);
+                h[3*col+2] = (b+(1<<(RSWBITS-FPPIXBITS-1)))>>(RSWBITS-FPPIXBITS);
+                }
             }
-        }
-    willus_mem_free((double **)&tempbmp,funcname);
-    willus_mem_free((double **)&temprow,funcname);
+        /* Vertical:  weighted sum of the ring buffer rows */
+        memset(acc,0,rowlen*sizeof(int));
+        w=&yw.w[yw.iw[row]];
+        for (i=0;i<yw.nw[row];i++)
+            bmp_simd_madd(acc,&ring[((yw.i0[row]+i)%nring)*rowlen],w[i],rowlen);
+        p=bmp_rowptr_from_top(dest,row);
+        for (i=0;i<rowlen;i++)
+            p[i]=(acc[i]+(1<<(RSWBITS+FPPIXBITS-1)))>>(RSWBITS+FPPIXBITS);
+        }
+    willus_mem_free((double **)&ring,funcname);
+    resample_weights_free(&yw);
+    resample_weights_free(&xw);
     return(0);
     }
 
 
-static void bmp_resample_1_fixed_point(int *tempbmp,WILLUSBITMAP *src,int x1_fp,int y1_fp,
-                                       int x2_fp,int y2_fp,int newwidth,int newheight,
-                                       int *temprow,int color)
+/*
+** Weights for resampling source pixels x1 to x2 into n output pixels.
+** Output pixel i covers the same source span, with the same area weights,
+** as in bmp_resample() (see resample_1d() and resample_single()):  only the
+** weights themselves are rounded, to 1/RSWONE.  (v2.56:  Rounding the span
+** ends to 1/FPMULT pixel instead, as the v1.x - v2.55 fixed-point resampler
+** did, is off by several grey levels when upscaling by 10x or more.)
+** Returns 0 if out of memory.
+*/
+static int resample_weights_fixed_point(RESAMPLE_WEIGHTS *rsw,double x1,double x2,int n)
 
     {
-    int row,col,x0,dx,y0,dy;
+    static char *funcname="resample_weights_fixed_point";
+    int i,pass,nwtot;
+    double last;
 
-    x0=x1_fp>>FPBITS;
-    dx=((x2_fp+(FPMULT-1))>>FPBITS)-x0;
-    x1_fp-=(x0<<FPBITS);
-    x2_fp-=(x0<<FPBITS);
-    y0=y1_fp>>FPBITS;
-    dy=((y2_fp+(FPMULT-1))>>FPBITS)-y0;
-    y1_fp-=(y0<<FPBITS);
-    y2_fp-=(y0<<FPBITS);
-    if (src->type==WILLUSBITMAP_TYPE_WIN32 && color>=0)
-        color=2-color;
-    for (row=0;row<dy;row++)
+    rsw->i0=NULL;
+    rsw->w=NULL;
+    rsw->maxnw=1;
+    if (!willus_mem_alloc((double **)&rsw->i0,(long)3*n*sizeof(int),funcname))
+        return(0);
+    rsw->nw=&rsw->i0[n];
+    rsw->iw=&rsw->nw[n];
+    /* Pass 0:  count the weights.  Pass 1:  calculate them. */
+    for (pass=0;pass<2;pass++)
         {
-        unsigned char *p;
-        p=bmp_rowptr_from_top(src,row+y0);
-        if (src->bpp==8)
+        last=x1;
+        for (nwtot=i=0;i<n;i++)
             {
-            switch (color)
+            int i1,i2,k,sum,kmax;
+            double new,dx,dx1,dx2,dxmin;
+            int *w;
+
+            new=x1+(x2-x1)*(i+1)/n;
+            i1=floor(last);
+            i2=floor(new);
+            dx=new-last;
+            dx1=1.-(last-i1);
+            dx2=new-i2;
+            last=new;
+            /* Source pixels with (next to) no area in the span are left out */
+            dxmin = 1e-8*(dx>1. ? 1. : dx);
+            if (i2>i1 && dx2<=dxmin)
                 {
-                case -1:
-                    for (col=0,p+=x0;col<dx;col++,p++)
-                        temprow[col]=(((unsigned int)p[0])<<FPPIXBITS);
-                    break;
-                case 0:
-                    for (col=0,p+=x0;col<dx;col++,p++)
-                        temprow[col]=src->red[p[0]]<<FPPIXBITS;
-                    break;
-                case 1:
-                    for (col=0,p+=x0;col<dx;col++,p++)
-                        temprow[col]=src->green[p[0]]<<FPPIXBITS;
-                    break;
-                case 2:
-                    for (col=0,p+=x0;col<dx;col++,p++)
-                        temprow[col]=src->blue[p[0]]<<FPPIXBITS;
-                    break;
+                i2--;
+                dx2=1.;
                 }
+            if (i2>i1 && dx1<=dxmin)
+                {
+                i1++;
+                dx1=1.;
+                }
+            if (pass==0)
+                {
+                rsw->i0[i]=i1;
+                rsw->nw[i]=i2-i1+1;
+                rsw->iw[i]=nwtot;
+                nwtot+=rsw->nw[i];
+                if (rsw->nw[i]>rsw->maxnw)
+                    rsw->maxnw=rsw->nw[i];
+                continue;
+                }
+            w=&rsw->w[rsw->iw[i]];
+            if (i1==i2 || dx<=0.)
+                {
+                w[0]=RSWONE;
+                continue;
+                }
+            for (sum=kmax=0,k=i1;k<=i2;k++)
+                {
+                double wk;
+
+                wk = (k==i1) ? dx1 : (k==i2 ? dx2 : 1.);
+                w[k-i1]=(int)(wk*RSWONE/dx+.5);
+                sum+=w[k-i1];
+                if (w[k-i1]>w[kmax])
+                    kmax=k-i1;
+                }
+            /* Make the weights add up to exactly RSWONE */
+            w[kmax] += RSWONE-sum;
             }
-        else
+        if (pass==0 && !willus_mem_alloc((double **)&rsw->w,(long)nwtot*sizeof(int),funcname))
             {
-            p+=color;
-            for (col=0,p+=3*x0;col<dx;temprow[col]=(((unsigned int)p[0])<<FPPIXBITS),col++,p+=3);
+            willus_mem_free((double **)&rsw->i0,funcname);
+            return(0);
             }
-        resample_1d_fixed_point(&tempbmp[row*newwidth],temprow,x1_fp,x2_fp,newwidth);
-        }
-    for (col=0;col<newwidth;col++)
-        {
-        int *p,*s;
-        p=&tempbmp[col];
-        s=&temprow[dy];
-        for (row=0;row<dy;row++,p+=newwidth)
-            temprow[row]=p[0];
-        resample_1d_fixed_point(s,temprow,y1_fp,y2_fp,newheight);
-        p=&tempbmp[col];
-        for (row=0;row<newheight;row++,p+=newwidth,s++)
-            p[0]=s[0];
-        }
-    }
-
-
-/*
-** Fixed point version of resample_1d().
-*/
-static void resample_1d_fixed_point(int *dst,int *src,int x1_fp,int x2_fp,int n)
-
-    {
-    int i,new_fp,last_fp;
-
-    last_fp=x1_fp;
-    for (i=0;i<n;i++)
-        {
-        /* Needs to go to double to prevent integer overflow */
-        new_fp=(int)(x1_fp+(double)(x2_fp-x1_fp)*(i+1)/n+.5);
-        dst[i] = resample_single_fixed_point(src,last_fp,new_fp);
-        last_fp=new_fp;
         }
+    return(1);
     }
 
 
-static double resample_single_fixed_point(int *y,int x1_fp,int x2_fp)
+static void resample_weights_free(RESAMPLE_WEIGHTS *rsw)
 
     {
-    int i,i1,i2;
-    int dx_fp,dx1_fp,dx2_fp,sum;
+    static char *funcname="resample_weights_free";
 
-    i1=x1_fp>>FPBITS;
-    i2=x2_fp>>FPBITS;
-    if (i1==i2)
-        return(y[i1]);
-    dx_fp = x2_fp-x1_fp;
-    dx1_fp = FPMULT-(x1_fp-(i1<<FPBITS));
-    dx2_fp = x2_fp-(i2<<FPBITS);
-    sum= ((dx1_fp*y[i1]+(FPMULT/2))>>FPBITS) + ((dx2_fp*y[i2]+(FPMULT/2))>>FPBITS);
-    for (i=i1+1;i<=i2-1;sum+=y[i],i++);
-    return((sum<=FPMAX) ? ((sum<<FPBITS)+(FPMULT/2))/dx_fp : ((double)sum*FPMULT+(FPMULT/2))/dx_fp);
+    willus_mem_free((double **)&rsw->w,funcname);
+    willus_mem_free((double **)&rsw->i0,funcname);
     }
 
 
-
 /*
 ** dest bitmap MUST BE 24-bit
 */     
@@ -3231,8 +3348,7 @@ void bmp_invert(WILLUSBITMAP *bmp)
         int nb;
         p=bmp_rowptr_from_top(bmp,0);
         nb=bmp_bytewidth(bmp)*bmp->height;
-        for (i=0;i<nb;i++,p++)
-            (*p) = 255-(*p);
+        bmp_simd_invert(p,nb);
         }
     else
         for (i=0;i<256;i++)
@@ -3346,7 +3462,7 @@ void bmp_contrast_adjust(WILLUSBITMAP *dest,WILLUSBITMAP *src,double contrast)
 
     {
     int i;
-    static unsigned char newval[256];
+    unsigned char newval[256];
 
     for (i=0;i<256;i++)
         {
@@ -3389,7 +3505,7 @@ void bmp_gamma_correct(WILLUSBITMAP *dest,WILLUSBITMAP *src,double gamma)
     {
     double gc;
     int i;
-    static unsigned char newval[256];
+    unsigned char newval[256];
 
     if (gamma<0.001)
         gamma=0.001;
@@ -3431,6 +3547,13 @@ void bmp_color_xform(WILLUSBITMAP *dest,WILLUSBITMAP *src,unsigned char *newval)
         unsigned char *sp,*dp;
         sp=bmp_rowptr_from_top(src,ir);
         dp=bmp_rowptr_from_top(dest,ir);
+        /* v2.56:  Same byte order?  Then every byte gets the same look-up. */
+        if (src->bpp==24 && src->type==dest->type)
+            {
+            for (ic=0;ic<3*src->width;ic++)
+                dp[ic]=newval[sp[ic]];
+            continue;
+            }
         for (ic=0;ic<src->width;ic++,dp+=3)
             {
             int r,g,b;
@@ -4548,13 +4671,143 @@ static double bmp_row_by_row_stdev(WILLUSBITMAP *bmp,int ccount,int whitethresh,
     }
 
 
+/*
+** v2.56:  sdev[i] = bmp_row_by_row_stdev(bmp,...,theta_radians[i]) for i=0..n-1,
+** computed by up to nthreads threads.
+*/
+typedef struct
+    {
+    WILLUSBITMAP *bmp;
+    int ccount;
+    int whitethresh;
+    double *theta_radians;
+    double *sdev;
+    int n;
+    int next;  /* Next angle to try */
+    pthread_mutex_t mutex;
+    } SKEWJOBS;
+
+static void bmp_row_by_row_stdevs(WILLUSBITMAP *bmp,int ccount,int whitethresh,
+                                  double *theta_radians,double *sdev,int n,int nthreads)
+
+    {
+    static char *funcname="bmp_row_by_row_stdevs";
+    SKEWJOBS _jobs,*jobs;
+    pthread_t *thread;
+    int i;
+
+    jobs=&_jobs;
+    jobs->bmp=bmp;
+    jobs->ccount=ccount;
+    jobs->whitethresh=whitethresh;
+    jobs->theta_radians=theta_radians;
+    jobs->sdev=sdev;
+    jobs->n=n;
+    jobs->next=0;
+    if (nthreads>n)
+        nthreads=n;
+    if (nthreads<1)
+        nthreads=1;
+    pthread_mutex_init(&jobs->mutex,NULL);
+    willus_mem_alloc_warn((void **)&thread,sizeof(pthread_t)*nthreads,funcname,10);
+    /* The calling thread is one of the workers */
+    for (i=1;i<nthreads;i++)
+        if (pthread_create(&thread[i],NULL,bmp_skew_thread,(void *)jobs))
+            break;
+    nthreads=i;
+    bmp_skew_thread((void *)jobs);
+    for (i=1;i<nthreads;i++)
+        pthread_join(thread[i],NULL);
+    willus_mem_free((double **)&thread,funcname);
+    pthread_mutex_destroy(&jobs->mutex);
+    }
+
+
+static void *bmp_skew_thread(void *data)
+
+    {
+    SKEWJOBS *jobs;
+
+    jobs=(SKEWJOBS *)data;
+    while (1)
+        {
+        int i;
+
+        pthread_mutex_lock(&jobs->mutex);
+        i=jobs->next++;
+        pthread_mutex_unlock(&jobs->mutex);
+        if (i>=jobs->n)
+            break;
+        jobs->sdev[i]=bmp_row_by_row_stdev(jobs->bmp,jobs->ccount,jobs->whitethresh,
+                                           jobs->theta_radians[i]);
+        }
+    return(NULL);
+    }
+
+
+/*
+** v2.56:  dst = src (grey) downsampled ds times in each direction.  A dst
+** pixel is black (0) if at least a quarter of its ds x ds block of src is
+** darker than whitethresh, otherwise white (255).
+*/
+static void bmp_skew_downsample(WILLUSBITMAP *dst,WILLUSBITMAP *src,int ds,int whitethresh)
+
+    {
+    static char *funcname="bmp_skew_downsample";
+    int *count;
+    int i,r,c,thresh;
+
+    dst->width=src->width/ds;
+    dst->height=src->height/ds;
+    dst->bpp=8;
+    bmp_alloc(dst);
+    for (i=0;i<256;i++)
+        dst->red[i]=dst->green[i]=dst->blue[i]=i;
+    willus_mem_alloc_warn((void **)&count,sizeof(int)*(dst->width+1),funcname,10);
+    thresh=(ds*ds+3)/4;
+    for (r=0;r<dst->height;r++)
+        {
+        unsigned char *p;
+
+        memset(count,0,sizeof(int)*dst->width);
+        for (i=0;i<ds;i++)
+            {
+            unsigned char *ps;
+
+            ps=bmp_rowptr_from_top(src,r*ds+i);
+            for (c=0;c<dst->width*ds;c++)
+                if (ps[c]<whitethresh)
+                    count[c/ds]++;
+            }
+        p=bmp_rowptr_from_top(dst,r);
+        for (c=0;c<dst->width;c++)
+            p[c] = count[c]>=thresh ? 0 : 255;
+        }
+    willus_mem_free((double **)&count,funcname);
+    }
+
+
+/*
+** v2.56:  The skew angle is found in two steps:
+**     1. A coarse sweep over +/- maxdegrees on a copy of srcgrey that is
+**        downsampled SKEW_DS times and thresholded to black/white.  The step
+**        is SKEW_DS times the 0.05-deg step of the old full-res sweep, which
+**        is the same step in pixels.  The angles are tried by nthreads
+**        threads.
+**     2. If the coarse sweep has one clear peak, a golden-section search
+**        at full resolution within one coarse step of it, to 0.01 deg.
+** So a page costs about a dozen full-resolution passes instead of 160+.
+*/
+#define SKEW_DS 4
+
 double bmp_autostraighten(WILLUSBITMAP *src,WILLUSBITMAP *srcgrey,int white,double maxdegrees,
-                          double mindegrees,int debug,FILE *out)
+                          double mindegrees,int nthreads,int debug,FILE *out)
 
     {
-    int i,na,n,imax,maxpt;
+    int i,na,n,imax,maxpt,ds;
     double stepsize,sdmin,sdmax,rotdeg;
-    double *sdev;
+    double *sdev,*theta;
+    WILLUSBITMAP _coarse,*coarse;
     FILE *f;
     static int rpc=0;
     static char *funcname="bmp_autostraighten";
@@ -4566,7 +4819,9 @@ double bmp_autostraighten(WILLUSBITMAP *src,WILLUSBITMAP *srcgrey,int white,doub
         f=wfile_fopen_utf8("straighten_metrics.ep",rpc==1?"w":"a");
         nprintf(f,"/sa l \"src page %d\" 2\n",rpc);
         }
-    stepsize=.05;
+    /* Small bitmaps aren't downsampled as much */
+    for (ds=SKEW_DS;ds>1 && srcgrey->height/ds<400;ds--);
+    stepsize=.05*ds;
     na = (int)(maxdegrees/stepsize+.5);
     if (na<1)
         na=1;
@@ -4574,21 +4829,25 @@ double bmp_autostraighten(WILLUSBITMAP *src,WILLUSBITMAP *srcgrey,int white,doub
     sdmin=999.;
     sdmax=-999.;
     imax=0;
-    willus_mem_alloc_warn((void **)&sdev,n*sizeof(double),funcname,10);
+    willus_mem_alloc_warn((void **)&sdev,2*n*sizeof(double),funcname,10);
+    theta=&sdev[n];
+    coarse=&_coarse;
+    bmp_init(coarse);
+    bmp_skew_downsample(coarse,srcgrey,ds,white);
+    for (i=0;i<n;i++)
+        theta[i] = (i-na)*stepsize*PI/180.;
+    /* Same column spacing (in source pixels) as the full-res passes */
+    bmp_row_by_row_stdevs(coarse,400/ds,128,theta,sdev,n,nthreads);
+    bmp_free(coarse);
     for (i=0;i<n;i++)
         {
-        double theta,sdev0;
-
-        theta = (i-na)*stepsize*PI/180.;
-        sdev0=bmp_row_by_row_stdev(srcgrey,400,white,theta);
-        if (sdmin > sdev0)
-            sdmin = sdev0;
-        if (sdmax < sdev0)
+        if (sdmin > sdev[i])
+            sdmin = sdev[i];
+        if (sdmax < sdev[i])
             {
             imax = i;
-            sdmax = sdev0;
+            sdmax = sdev[i];
             }
-        sdev[i]=sdev0;
         }
     if (sdmax<=0.)
         {
@@ -4637,32 +4896,44 @@ double bmp_autostraighten(WILLUSBITMAP *src,WILLUSBITMAP *srcgrey,int white,doub
             }
         }
 
-    /* If one peak (maximum)--do fine grain search near that point and return the highest value */
+    /*
+    ** If one peak (maximum)--golden-section search at full resolution
+    ** for the highest value within one coarse step of it.
+    */
     if (maxpt==1)
         {
-        double sdmax2;
-        double thbest;
-        int ifine,nfine;
-        sdmax2=1.0;
-        thbest=(imax-na)*stepsize*PI/180.;
-        nfine=5;
-        for (ifine=-nfine+1;ifine<nfine;ifine++)
-            {
-            double theta,sdev0;
+        double gr,th[4],sd[4];
 
-            if (ifine==0)
-                continue;
-            theta = (imax+(double)ifine/nfine-na)*stepsize*PI/180.;
-            sdev0=bmp_row_by_row_stdev(srcgrey,400,white,theta)/sdmax;
+        gr=(sqrt(5.)-1.)/2.;
+
+        th[0]=(imax-na-1)*stepsize;
+        th[3]=(imax-na+1)*stepsize;
+        th[1]=th[3]-gr*(th[3]-th[0]);
+        th[2]=th[0]+gr*(th[3]-th[0]);
+        for (i=1;i<3;i++)
+            sd[i]=bmp_row_by_row_stdev(srcgrey,400,white,th[i]*PI/180.);
+        while (th[3]-th[0]>.01)
+            {
             if (debug)
-                nprintf(f,"%.3f %g\n",theta*180./PI,sdev0);
-            if (sdev0>sdmax2)
+                nprintf(f,"%.3f %g\n%.3f %g\n",th[1],sd[1]/sdmax,th[2],sd[2]/sdmax);
+            if (sd[1]>=sd[2])
                 {
-                sdmax2=sdev0;
-                thbest=theta;
+                th[3]=th[2];
+                th[2]=th[1];
+                sd[2]=sd[1];
+                th[1]=th[3]-gr*(th[3]-th[0]);
+                sd[1]=bmp_row_by_row_stdev(srcgrey,400,white,th[1]*PI/180.);
+                }
+            else
+                {
+                th[0]=th[1];
+                th[1]=th[2];
+                sd[1]=sd[2];
+                th[2]=th[0]+gr*(th[3]-th[0]);
+                sd[2]=bmp_row_by_row_stdev(srcgrey,400,white,th[2]*PI/180.);
                 }
             }
-        rotdeg = -thbest*180./PI;
+        rotdeg = -(sd[1]>=sd[2] ? th[1] : th[2]);
         if (debug)
             nprintf(f,"//nc\n");
         }
@@ -4777,17 +5048,8 @@ void bmp_apply_whitethresh(WILLUSBITMAP *bmp,int whitethresh)
             }
         }
     else
-        {
         for (i=0;i<bmp->height;i++)
-            {
-            unsigned char *p;
-
-            p=bmp_rowptr_from_top(bmp,i);
-            for (j=0;j<bmp->width;j++,p++)
-                if ((*p)>=whitethresh)
-                    (*p)=255;
-            }
-        }
+            bmp_simd_whitethresh(bmp_rowptr_from_top(bmp,i),bmp->width,whitethresh);
     }
 
 
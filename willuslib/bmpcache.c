@@ -0,0 +1,209 @@
+/*
+** bmpcache.c   Process-wide, memory-bounded LRU cache of bitmaps, looked up
+**              by a caller-defined string key (e.g. rendered document pages,
+**              so that a page that is needed again at the same resolution
+**              does not have to be rasterized again).  Thread safe.
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include "willus.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct
+    {
+    char *key;
+    WILLUSBITMAP bmp;
+    double bytes;
+    double lastuse;     /* Use stamp--lowest is evicted first */
+    } BMPCACHEENTRY;
+
+typedef struct
+    {
+    BMPCACHEENTRY *entry;
+    int n,na;
+    double bytes;       /* Total bitmap bytes held */
+    double max_bytes;   /* 0 = caching is off */
+    double stamp;
+    } BMPCACHE;
+
+static BMPCACHE bmpcache={NULL,0,0,0.,0.,0.};
+static pthread_mutex_t bmpcache_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+static int  bmpcache_index(char *key);
+static void bmpcache_remove(int index);
+static void bmpcache_trim(double max_bytes);
+static double bmpcache_bmp_bytes(WILLUSBITMAP *bmp);
+
+
+/*
+** Set the most bitmap memory (in bytes) the cache may hold.  0 turns
+** caching off (and frees anything held).
+*/
+void bmpcache_set_max_bytes(double max_bytes)
+
+    {
+    pthread_mutex_lock(&bmpcache_mutex);
+    bmpcache.max_bytes = max_bytes < 0. ? 0. : max_bytes;
+    bmpcache_trim(bmpcache.max_bytes);
+    pthread_mutex_unlock(&bmpcache_mutex);
+    }
+
+
+/*
+** If key is in the cache, copy its bitmap to bmp and return 1.
+** Otherwise return 0 (bmp is not changed).
+*/
+int bmpcache_get(WILLUSBITMAP *bmp,char *key)
+
+    {
+    int i,status;
+
+    pthread_mutex_lock(&bmpcache_mutex);
+    i=bmpcache_index(key);
+    status=0;
+    if (i>=0)
+        {
+        status=bmp_copy(bmp,&bmpcache.entry[i].bmp);
+        bmpcache.entry[i].lastuse = ++bmpcache.stamp;
+        }
+    pthread_mutex_unlock(&bmpcache_mutex);
+    return(status);
+    }
+
+
+/*
+** Store a copy of bmp under key (replacing any bitmap already stored under
+** key), then evict the least recently used bitmaps until the cache is back
+** within its limit.  Bitmaps larger than the limit are not stored.
+*/
+void bmpcache_put(WILLUSBITMAP *bmp,char *key)
+
+    {
+    static char *funcname="bmpcache_put";
+    BMPCACHEENTRY *entry;
+    double bytes;
+    int i;
+
+    bytes=bmpcache_bmp_bytes(bmp);
+    pthread_mutex_lock(&bmpcache_mutex);
+    if (bytes<=0. || bytes>bmpcache.max_bytes)
+        {
+        pthread_mutex_unlock(&bmpcache_mutex);
+        return;
+        }
+    i=bmpcache_index(key);
+    if (i>=0)
+        bmpcache_remove(i);
+    bmpcache_trim(bmpcache.max_bytes-bytes);
+    if (bmpcache.n>=bmpcache.na)
+        {
+        int newsize;
+        newsize = bmpcache.na<16 ? 16 : bmpcache.na*2;
+        willus_mem_realloc_robust_warn((void **)&bmpcache.entry,newsize*sizeof(BMPCACHEENTRY),
+                                       bmpcache.na*sizeof(BMPCACHEENTRY),funcname,10);
+        bmpcache.na=newsize;
+        }
+    entry=&bmpcache.entry[bmpcache.n];
+    bmp_init(&entry->bmp);
+    if (!bmp_copy(&entry->bmp,bmp))
+        {
+        pthread_mutex_unlock(&bmpcache_mutex);
+        return;
+        }
+    willus_mem_alloc_warn((void **)&entry->key,strlen(key)+1,funcname,10);
+    strcpy(entry->key,key);
+    entry->bytes=bytes;
+    entry->lastuse = ++bmpcache.stamp;
+    bmpcache.bytes += bytes;
+    bmpcache.n++;
+    pthread_mutex_unlock(&bmpcache_mutex);
+    }
+
+
+/*
+** Free all cached bitmaps.  The limit is not changed.
+*/
+void bmpcache_clear(void)
+
+    {
+    static char *funcname="bmpcache_clear";
+
+    pthread_mutex_lock(&bmpcache_mutex);
+    bmpcache_trim(0.);
+    willus_mem_free((double **)&bmpcache.entry,funcname);
+    bmpcache.na=0;
+    pthread_mutex_unlock(&bmpcache_mutex);
+    }
+
+
+static int bmpcache_index(char *key)
+
+    {
+    int i;
+
+    for (i=0;i<bmpcache.n;i++)
+        if (!strcmp(bmpcache.entry[i].key,key))
+            return(i);
+    return(-1);
+    }
+
+
+static void bmpcache_remove(int index)
+
+    {
+    static char *funcname="bmpcache_remove";
+    BMPCACHEENTRY *entry;
+
+    entry=&bmpcache.entry[index];
+    bmpcache.bytes -= entry->bytes;
+    bmp_free(&entry->bmp);
+    willus_mem_free((double **)&entry->key,funcname);
+    bmpcache.n--;
+    if (index<bmpcache.n)
+        bmpcache.entry[index]=bmpcache.entry[bmpcache.n];
+    }
+
+
+/*
+** Evict least recently used bitmaps until no more than max_bytes are held.
+*/
+static void bmpcache_trim(double max_bytes)
+
+    {
+    while (bmpcache.n>0 && bmpcache.bytes>max_bytes)
+        {
+        int i,ilru;
+
+        for (ilru=0,i=1;i<bmpcache.n;i++)
+            if (bmpcache.entry[i].lastuse<bmpcache.entry[ilru].lastuse)
+                ilru=i;
+        bmpcache_remove(ilru);
+        }
+    if (bmpcache.n==0)
+        bmpcache.bytes=0.;
+    }
+
+
+static double bmpcache_bmp_bytes(WILLUSBITMAP *bmp)
+
+    {
+    return((double)bmp_bytewidth(bmp)*bmp->height);
+    }
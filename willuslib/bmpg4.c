@@ -0,0 +1,291 @@
+/*
+** bmpg4.c    CCITT Group 4 (ITU-T T.6) encoding of bilevel bitmaps, e.g. for
+**            PDF image streams with the /CCITTFaxDecode filter (/K -1).
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include "willus.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+** Modified Huffman run-length codes (ITU-T T.4 tables 2 and 3)
+*/
+static char *g4_white_term[64]=
+    {
+    "00110101","000111","0111","1000","1011","1100","1110","1111",
+    "10011","10100","00111","01000","001000","000011","110100","110101",
+    "101010","101011","0100111","0001100","0001000","0010111","0000011","0000100",
+    "0101000","0101011","0010011","0100100","0011000","00000010","00000011","00011010",
+    "00011011","00010010","00010011","00010100","00010101","00010110","00010111","00101000",
+    "00101001","00101010","00101011","00101100","00101101","00000100","00000101","00001010",
+    "00001011","01010010","01010011","01010100","01010101","00100100","00100101","01011000",
+    "01011001","01011010","01011011","01001010","01001011","00110010","00110011","00110100"
+    };
+static char *g4_black_term[64]=
+    {
+    "0000110111","010","11","10","011","0011","0010","00011",
+    "000101","000100","0000100","0000101","0000111","00000100","00000111","000011000",
+    "0000010111","0000011000","0000001000","00001100111","00001101000","00001101100",
+    "00000110111","00000101000","00000010111","00000011000","000011001010","000011001011",
+    "000011001100","000011001101","000001101000","000001101001","000001101010",
+    "000001101011","000011010010","000011010011","000011010100","000011010101",
+    "000011010110","000011010111","000001101100","000001101101","000011011010",
+    "000011011011","000001010100","000001010101","000001010110","000001010111",
+    "000001100100","000001100101","000001010010","000001010011","000000100100",
+    "000000110111","000000111000","000000100111","000000101000","000001011000",
+    "000001011001","000000101011","000000101100","000001011010","000001100110",
+    "000001100111"
+    };
+/* Make-up codes for 64, 128, ..., 1728 */
+static char *g4_white_makeup[27]=
+    {
+    "11011","10010","010111","0110111","00110110","00110111","01100100","01100101",
+    "01101000","01100111","011001100","011001101","011010010","011010011","011010100",
+    "011010101","011010110","011010111","011011000","011011001","011011010","011011011",
+    "010011000","010011001","010011010","011000","010011011"
+    };
+static char *g4_black_makeup[27]=
+    {
+    "0000001111","000011001000","000011001001","000001011011","000000110011",
+    "000000110100","000000110101","0000001101100","0000001101101","0000001001010",
+    "0000001001011","0000001001100","0000001001101","0000001110010","0000001110011",
+    "0000001110100","0000001110101","0000001110110","0000001110111","0000001010010",
+    "0000001010011","0000001010100","0000001010101","0000001011010","0000001011011",
+    "0000001100100","0000001100101"
+    };
+/* Make-up codes for 1792, 1856, ..., 2560 (same for white and black) */
+static char *g4_ext_makeup[13]=
+    {
+    "00000001000","00000001100","00000001101","000000010010","000000010011",
+    "000000010100","000000010101","000000010110","000000010111","000000011100",
+    "000000011101","000000011110","000000011111"
+    };
+/* Two-dimensional mode codes (T.4 table 4):  V(L3) ... V(R3) */
+static char *g4_vert[7]={ "0000010","000010","010","1","011","000011","0000011" };
+#define G4_PASS  "0001"
+#define G4_HORIZ "001"
+#define G4_EOL   "000000000001"
+
+typedef struct
+    {
+    FILE *f;
+    int byte;
+    int nbits;
+    long nbytes;
+    } G4BITS;
+
+static void g4bits_put(G4BITS *g4,char *code);
+static void g4bits_flush(G4BITS *g4);
+static void g4_put_run(G4BITS *g4,int run,int black);
+static int  g4_next_change(unsigned char *row,int x,int width);
+
+
+/*
+** Returns non-zero if bmp is grey scale with only black (0) and white (255)
+** pixels, i.e. it can be stored without loss as a 1-bit image.
+*/
+int bmp_is_bilevel(WILLUSBITMAP *bmp)
+
+    {
+    int row;
+
+    if (bmp->bpp!=8 || !bmp_is_grayscale(bmp))
+        return(0);
+    for (row=0;row<bmp->height;row++)
+        {
+        unsigned char *p;
+        int i;
+
+        p=bmp_rowptr_from_top(bmp,row);
+        for (i=0;i<bmp->width;i++)
+            if (p[i]!=0 && p[i]!=255)
+                return(0);
+        }
+    return(1);
+    }
+
+
+/*
+** Write bmp to f as a CCITT Group 4 (T.6) stream.  Pixels darker than
+** whitethresh (0 - 255) are black.  The stream ends with an EOFB and is
+** padded to a whole byte.  In a PDF, use
+**     /Filter /CCITTFaxDecode /DecodeParms << /K -1 /Columns <width> /Rows <height> >>
+**
+** Returns the number of bytes written.  If f is NULL, nothing is written,
+** but the size of the stream is still returned (v2.56).
+**
+** The coding follows T.6 section 2.2 (and libtiff's Fax3Encode2DRow()):
+** each row is coded against the row above it (all white for the first row).
+*/
+long bmp_write_ccitt_g4_stream(WILLUSBITMAP *bmp,FILE *f,int whitethresh)
+
+    {
+    static char *funcname="bmp_write_ccitt_g4_stream";
+    G4BITS _g4,*g4;
+    unsigned char *cur,*ref;
+    int w,row;
+
+    g4=&_g4;
+    g4->f=f;
+    g4->byte=0;
+    g4->nbits=0;
+    g4->nbytes=0;
+    w=bmp->width;
+    /* One byte per pixel (0=white, 1=black), plus a white pixel past the end */
+    willus_mem_alloc_warn((void **)&cur,w+1,funcname,10);
+    willus_mem_alloc_warn((void **)&ref,w+1,funcname,10);
+    memset(ref,0,w+1);
+    cur[w]=0;
+    for (row=0;row<bmp->height;row++)
+        {
+        unsigned char *p,*t;
+        int a0,a1,a2,b1,b2,i;
+
+        p=bmp_rowptr_from_top(bmp,row);
+        if (bmp->bpp==8)
+            for (i=0;i<w;i++)
+                cur[i]=(bmp->red[p[i]]<whitethresh);
+        else
+            for (i=0;i<w;i++,p+=3)
+                cur[i]=((p[0]+p[1]+p[2])<3*whitethresh);
+        /* Changing elements:  a0 starts on an imaginary white pixel */
+        a0=0;
+        a1=cur[0] ? 0 : g4_next_change(cur,0,w);
+        b1=ref[0] ? 0 : g4_next_change(ref,0,w);
+        while (1)
+            {
+            b2 = b1<w ? g4_next_change(ref,b1,w) : w;
+            if (b2<a1)
+                {
+                g4bits_put(g4,G4_PASS);
+                a0=b2;
+                }
+            else if (b1-a1>=-3 && b1-a1<=3)
+                {
+                g4bits_put(g4,g4_vert[a1-b1+3]);
+                a0=a1;
+                }
+            else
+                {
+                a2 = a1<w ? g4_next_change(cur,a1,w) : w;
+                g4bits_put(g4,G4_HORIZ);
+                if (a0+a1==0 || cur[a0]==0)
+                    {
+                    g4_put_run(g4,a1-a0,0);
+                    g4_put_run(g4,a2-a1,1);
+                    }
+                else
+                    {
+                    g4_put_run(g4,a1-a0,1);
+                    g4_put_run(g4,a2-a1,0);
+                    }
+                a0=a2;
+                }
+            if (a0>=w)
+                break;
+            /* Next changing elements after a0 */
+            a1=g4_next_change(cur,a0,w);
+            /* First element of ref past a0 that changes to the opposite color of a0 */
+            for (b1=a0;b1<w && ref[b1]!=cur[a0];b1++);
+            for (;b1<w && ref[b1]==cur[a0];b1++);
+            }
+        t=ref;
+        ref=cur;
+        cur=t;
+        }
+    /* EOFB */
+    g4bits_put(g4,G4_EOL);
+    g4bits_put(g4,G4_EOL);
+    g4bits_flush(g4);
+    willus_mem_free((double **)&ref,funcname);
+    willus_mem_free((double **)&cur,funcname);
+    return(g4->nbytes);
+    }
+
+
+/*
+** Position of the first pixel after x that is a different color than pixel x
+** (width if none).
+*/
+static int g4_next_change(unsigned char *row,int x,int width)
+
+    {
+    int c;
+
+    for (c=row[x],x++;x<width && row[x]==c;x++);
+    return(x);
+    }
+
+
+static void g4_put_run(G4BITS *g4,int run,int black)
+
+    {
+    while (run>=2624)
+        {
+        g4bits_put(g4,g4_ext_makeup[12]);
+        run -= 2560;
+        }
+    if (run>=1792)
+        {
+        g4bits_put(g4,g4_ext_makeup[(run-1792)>>6]);
+        run &= 63;
+        }
+    else if (run>=64)
+        {
+        g4bits_put(g4,black ? g4_black_makeup[(run>>6)-1] : g4_white_makeup[(run>>6)-1]);
+        run &= 63;
+        }
+    g4bits_put(g4,black ? g4_black_term[run] : g4_white_term[run]);
+    }
+
+
+static void g4bits_put(G4BITS *g4,char *code)
+
+    {
+    int i;
+
+    for (i=0;code[i]!='\0';i++)
+        {
+        g4->byte = (g4->byte<<1) | (code[i]=='1');
+        g4->nbits++;
+        if (g4->nbits==8)
+            {
+            if (g4->f!=NULL)
+                fputc(g4->byte,g4->f);
+            g4->nbytes++;
+            g4->byte=0;
+            g4->nbits=0;
+            }
+        }
+    }
+
+
+static void g4bits_flush(G4BITS *g4)
+
+    {
+    if (g4->nbits>0)
+        {
+        if (g4->f!=NULL)
+            fputc((g4->byte<<(8-g4->nbits))&0xff,g4->f);
+        g4->nbytes++;
+        g4->byte=0;
+        g4->nbits=0;
+        }
+    }
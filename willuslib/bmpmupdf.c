@@ -21,6 +21,7 @@
 */
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
 #include "willus.h"
 
 #ifdef HAVE_MUPDF_LIB
@@ -30,10 +31,45 @@ void pdf_install_load_system_font_funcs(fz_context *ctx);
 static void mupdf_cbz_add_page_info(char *buf,fz_context *ctx,fz_document *doc,
                                     int pageno,int npages);
 static int bmpmupdf_pixmap_to_bmp(WILLUSBITMAP *bmp,fz_context *ctx,fz_pixmap *pixmap);
+fz_document *bmpmupdf_session_document(fz_context **ctx,char *filename,char *password);
+
+/* An open document and the MuPDF context it was opened with */
+typedef struct
+    {
+    fz_context *ctx;
+    fz_document *doc;
+    char filename[MAXFILENAMELEN];
+    double filesize;
+    struct tm filedate;
+    int    private_session; /* Used by only one thread for only one file */
+    } BMPMUPDF_SESSION;
+static BMPMUPDF_SESSION main_session;
+static pthread_key_t thread_session_key; /* Session selected by bmpmupdf_session_use() */
+static pthread_once_t thread_session_once=PTHREAD_ONCE_INIT;
+static fz_document *bmpmupdf_session_open(BMPMUPDF_SESSION *session,char *filename,
+                                          char *password);
+static void bmpmupdf_session_drop(BMPMUPDF_SESSION *session);
+static BMPMUPDF_SESSION *bmpmupdf_thread_session(void);
+static void bmpmupdf_thread_session_key_create(void);
+
 
 int bmpmupdf_pdffile_to_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,double dpi,
                             int bpp)
 
+    {
+    return(bmpmupdf_session_pdffile_to_bmp(bmpmupdf_thread_session(),bmp,filename,pageno,
+                                           dpi,bpp));
+    }
+
+
+/*
+** Same as bmpmupdf_pdffile_to_bmp(), but uses the document session
+** returned by bmpmupdf_session_new().  Separate sessions may be used
+** concurrently from separate threads (v2.56).
+*/
+int bmpmupdf_session_pdffile_to_bmp(void *session,WILLUSBITMAP *bmp,char *filename,
+                                    int pageno,double dpi,int bpp)
+
     {
     fz_context *ctx;
     fz_colorspace *colorspace;
@@ -46,57 +82,40 @@ int bmpmupdf_pdffile_to_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,double d
     fz_rect bounds,bounds2;
     fz_matrix ctm,identity;
     fz_irect bbox;
-//    fz_glyph_cache *glyphcache;
-//    fz_error error;
     int np,status;
 
     dev=NULL;
     list=NULL;
     page=NULL;
-    doc=NULL;
     status=0;
     if (pageno<1)
         return(-99);
-    ctx = fz_new_context(NULL,NULL,FZ_STORE_DEFAULT);
-    if (!ctx)
+    /* v2.56:  Re-use open document (and its caches) from previous page */
+    doc=bmpmupdf_session_open((BMPMUPDF_SESSION *)session,filename,NULL);
+    if (doc==NULL)
         return(-1);
-    fz_try(ctx)
-    {
-    fz_register_document_handlers(ctx);
-    fz_set_aa_level(ctx,8);
-    /* Sumatra version of MuPDF v1.4 -- use locally installed fonts */
-    pdf_install_load_system_font_funcs(ctx);
-//    fz_accelerate();
-//    glyphcache=fz_new_glyph_cache();
+    ctx=((BMPMUPDF_SESSION *)session)->ctx;
     colorspace=(bpp==8 ? fz_device_gray(ctx) : fz_device_rgb(ctx));
-    fz_try(ctx) { doc=fz_open_document(ctx,filename); }
-    fz_catch(ctx) 
-        { 
-        fz_drop_context(ctx);
-        return(-1);
+    np=0;
+    fz_var(page);
+    fz_var(list);
+    fz_var(dev);
+    fz_try(ctx)
+        {
+        np=fz_count_pages(ctx,doc);
+        if (pageno<=np)
+            {
+            page=fz_load_page(ctx,doc,pageno-1);
+            bounds=fz_bound_page(ctx,page);
+            }
         }
-    /*
-    if (fz_needs_password(doc) && !fz_authenticate_password(doc,password))
-        return(-2);
-    */
-//    error=pdf_load_page_tree(xref);
-//    if (error)
-//        {
-//        pdf_free_xref(xref);
-//        return(-2);
-//        }
-
-    np=fz_count_pages(ctx,doc);
-    if (pageno>np)
-        return(-99);
-    fz_try(ctx) { page = fz_load_page(ctx,doc,pageno-1); }
     fz_catch(ctx) 
         {
-        fz_drop_document(ctx,doc);
-        fz_drop_context(ctx);
+        fz_drop_page(ctx,page);
         return(-3);
         }
-    bounds=fz_bound_page(ctx,page);
+    if (pageno>np)
+        return(-99);
     fz_try(ctx) { list=fz_new_display_list(ctx,bounds);
                   dev=fz_new_list_device(ctx,list);
                   fz_run_page(ctx,page,dev,fz_identity,NULL);
@@ -107,8 +126,6 @@ int bmpmupdf_pdffile_to_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,double d
         fz_drop_device(ctx,dev);
         fz_drop_display_list(ctx,list);
         fz_drop_page(ctx,page);
-        fz_drop_document(ctx,doc);
-        fz_drop_context(ctx);
         return(-4);
         }
     fz_close_device(ctx,dev);
@@ -151,30 +168,198 @@ int bmpmupdf_pdffile_to_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,double d
         fz_drop_pixmap(ctx,pix);
         fz_drop_display_list(ctx,list);
         fz_drop_page(ctx,page);
-        fz_drop_document(ctx,doc);
-        fz_drop_context(ctx);
         return(-5);
         }
     if (list)
         fz_drop_display_list(ctx,list);
     fz_drop_page(ctx,page);
-//    pdf_free_xref(xref);
-    fz_drop_document(ctx,doc);
     fz_flush_warnings(ctx);
-    } /* fz_catch before registering handlers */
-    fz_catch(ctx) /* Error registering */
-    {
-    status = -10;
-    }
-    fz_drop_context(ctx);
-//    fz_free_glyph_cache(glyphcache);
-//    fz_flush_warnings();
     if (status<0)
         return(status-10);
     return(0);
     }
 
 
+/*
+** MuPDF document session (v2.56)
+**
+** The most recently requested document is kept open, along with its fz_context
+** (and therefore its resource store and font/glyph caches), so that consecutive
+** page renders, page counts, text extraction and outline reads from the same
+** file do not have to re-open the file and re-parse its xref and page tree
+** every time.  The session is re-opened if a different file is requested or
+** if the file on disk changes.  Call bmpmupdf_session_close() when done with
+** the file.
+**
+** Returns the open document and sets (*ctx) to its context, or NULL if the
+** file cannot be opened (or authenticated with password).
+*/
+fz_document *bmpmupdf_session_document(fz_context **ctx,char *filename,char *password)
+
+    {
+    BMPMUPDF_SESSION *session;
+    fz_document *doc;
+
+    session=bmpmupdf_thread_session();
+    doc=bmpmupdf_session_open(session,filename,password);
+    if (doc!=NULL)
+        (*ctx)=session->ctx;
+    return(doc);
+    }
+
+
+void bmpmupdf_session_close(void)
+
+    {
+    bmpmupdf_session_drop(bmpmupdf_thread_session());
+    }
+
+
+/*
+** Have bmpmupdf_pdffile_to_bmp(), bmpmupdf_session_document() and
+** bmpmupdf_session_close() use session (from bmpmupdf_session_new()) when
+** called from this thread, so that threads converting different documents
+** don't share the main session.  session==NULL selects the main session.
+*/
+void bmpmupdf_session_use(void *session)
+
+    {
+    pthread_once(&thread_session_once,bmpmupdf_thread_session_key_create);
+    pthread_setspecific(thread_session_key,session);
+    }
+
+
+static BMPMUPDF_SESSION *bmpmupdf_thread_session(void)
+
+    {
+    BMPMUPDF_SESSION *session;
+
+    pthread_once(&thread_session_once,bmpmupdf_thread_session_key_create);
+    session=(BMPMUPDF_SESSION *)pthread_getspecific(thread_session_key);
+    return(session==NULL ? &main_session : session);
+    }
+
+
+static void bmpmupdf_thread_session_key_create(void)
+
+    {
+    pthread_key_create(&thread_session_key,NULL);
+    }
+
+
+/*
+** Private document session, e.g. for a page-rendering thread.
+** Free with bmpmupdf_session_free().
+*/
+void *bmpmupdf_session_new(void)
+
+    {
+    static char *funcname="bmpmupdf_session_new";
+    BMPMUPDF_SESSION *session;
+
+    willus_mem_alloc_warn((void **)&session,sizeof(BMPMUPDF_SESSION),funcname,10);
+    memset(session,0,sizeof(BMPMUPDF_SESSION));
+    session->private_session=1;
+    return((void *)session);
+    }
+
+
+void bmpmupdf_session_free(void *session)
+
+    {
+    static char *funcname="bmpmupdf_session_free";
+
+    if (session==NULL)
+        return;
+    bmpmupdf_session_drop((BMPMUPDF_SESSION *)session);
+    willus_mem_free((double **)&session,funcname);
+    }
+
+
+static fz_document *bmpmupdf_session_open(BMPMUPDF_SESSION *session,char *filename,
+                                          char *password)
+
+    {
+    struct tm filedate;
+    double filesize;
+
+    /* Private sessions do not check the file date (localtime() is not thread safe) */
+    if (session->private_session)
+        {
+        memset(&filedate,0,sizeof(struct tm));
+        filesize=0.;
+        if (session->doc!=NULL && strcmp(session->filename,filename))
+            bmpmupdf_session_drop(session);
+        }
+    else
+        {
+        if (!wfile_date(filename,&filedate))
+            memset(&filedate,0,sizeof(struct tm));
+        filesize=wfile_size(filename);
+        if (session->doc!=NULL && (strcmp(session->filename,filename)
+                                   || filesize!=session->filesize
+                                   || wfile_datecomp(&filedate,&session->filedate)!=0))
+            bmpmupdf_session_drop(session);
+        }
+    if (session->doc==NULL)
+        {
+        fz_context *ctx;
+        fz_document *doc;
+
+        if (strlen(filename)>=MAXFILENAMELEN)
+            return(NULL);
+        ctx = fz_new_context(NULL,NULL,FZ_STORE_DEFAULT);
+        if (!ctx)
+            return(NULL);
+        doc=NULL;
+        fz_var(doc);
+        fz_try(ctx)
+            {
+            fz_register_document_handlers(ctx);
+            fz_set_aa_level(ctx,8);
+            /* Sumatra version of MuPDF v1.4 -- use locally installed fonts */
+            pdf_install_load_system_font_funcs(ctx);
+            doc=fz_open_document(ctx,filename);
+            }
+        fz_catch(ctx)
+            {
+            fz_drop_document(ctx,doc);
+            fz_drop_context(ctx);
+            return(NULL);
+            }
+        if (doc==NULL)
+            {
+            fz_drop_context(ctx);
+            return(NULL);
+            }
+        session->ctx=ctx;
+        session->doc=doc;
+        strcpy(session->filename,filename);
+        session->filesize=filesize;
+        session->filedate=filedate;
+        }
+    if (password!=NULL && fz_needs_password(session->ctx,session->doc)
+                       && !fz_authenticate_password(session->ctx,session->doc,password))
+        return(NULL);
+    return(session->doc);
+    }
+
+
+static void bmpmupdf_session_drop(BMPMUPDF_SESSION *session)
+
+    {
+    if (session->ctx==NULL)
+        return;
+    if (session->doc!=NULL)
+        fz_drop_document(session->ctx,session->doc);
+    fz_flush_warnings(session->ctx);
+    fz_drop_context(session->ctx);
+    session->doc=NULL;
+    session->ctx=NULL;
+    session->filename[0]='\0';
+    }
+
+
 void wmupdf_cbzinfo_get(char *filename,int *pagelist,char **buf0)
 
     {
@@ -265,74 +450,38 @@ int bmpmupdf_pdffile_width_and_height(char *filename,int pageno,double *width_in
     fz_context *ctx;
     fz_document *doc;
     fz_page *page;
-    fz_display_list *list;
-    fz_device *dev;
     fz_rect bounds;
     int np;
 
-    dev=NULL;
-    list=NULL;
     page=NULL;
-    doc=NULL;
     if (pageno<1)
         return(-99);
-    ctx = fz_new_context(NULL,NULL,FZ_STORE_DEFAULT);
-    if (!ctx)
+    doc=bmpmupdf_session_document(&ctx,filename,NULL);
+    if (doc==NULL)
         return(-1);
+    np=0;
+    fz_var(page);
     fz_try(ctx)
-    {
-    fz_register_document_handlers(ctx);
-    fz_set_aa_level(ctx,8);
-    /* Sumatra version of MuPDF v1.4 -- use locally installed fonts */
-    pdf_install_load_system_font_funcs(ctx);
-    fz_try(ctx) { doc=fz_open_document(ctx,filename); }
-    fz_catch(ctx) 
-        { 
-        fz_drop_context(ctx);
-        return(-1);
-        }
-    np=fz_count_pages(ctx,doc);
-    if (pageno>np)
-        return(-99);
-    fz_try(ctx) { page = fz_load_page(ctx,doc,pageno-1); }
-    fz_catch(ctx) 
         {
-        fz_drop_document(ctx,doc);
-        fz_drop_context(ctx);
-        return(-3);
+        np=fz_count_pages(ctx,doc);
+        if (pageno<=np)
+            {
+            page=fz_load_page(ctx,doc,pageno-1);
+            bounds=fz_bound_page(ctx,page);
+            }
         }
-    bounds=fz_bound_page(ctx,page);
-    fz_try(ctx) { list=fz_new_display_list(ctx,bounds);
-                  dev=fz_new_list_device(ctx,list);
-                  fz_run_page(ctx,page,dev,fz_identity,NULL);
-                }
-    fz_catch(ctx)
+    fz_catch(ctx) 
         {
-        fz_close_device(ctx,dev);
-        fz_drop_device(ctx,dev);
-        fz_drop_display_list(ctx,list);
         fz_drop_page(ctx,page);
-        fz_drop_document(ctx,doc);
-        fz_drop_context(ctx);
-        return(-4);
+        return(-3);
         }
-    fz_close_device(ctx,dev);
-    fz_drop_device(ctx,dev);
-    dev=NULL;
+    if (pageno>np)
+        return(-99);
     if (width_in!=NULL)
         (*width_in)=fabs(bounds.x1-bounds.x0)/72.;
     if (height_in!=NULL)
         (*height_in)=fabs(bounds.y1-bounds.y0)/72.;
-    fz_drop_display_list(ctx,list);
     fz_drop_page(ctx,page);
-    fz_drop_document(ctx,doc);
-    } 
-    fz_catch(ctx) /* Error registering */
-    {
-    fz_drop_context(ctx);
-    return(-20);
-    }
-    fz_drop_context(ctx);
     return(0);
     }
 
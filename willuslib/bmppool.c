@@ -0,0 +1,343 @@
+/*
+** bmppool.c    Per-thread pool of bitmap data buffers for bmp_alloc() /
+**              bmp_free().  Buffers are rounded up to size classes (four per
+**              power of two) and freed buffers are kept on the thread's
+**              free list for that class, so the temporary bitmaps made for
+**              every region, row, and word don't each go through malloc()
+**              and free() (which for large buffers means mmap()/munmap()
+**              and page faults on every use).
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include "willus.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+** Buffers smaller than 2^BMPPOOL_MINBITS bytes are cheap to malloc() and
+** are not pooled.  Classes above 2^BMPPOOL_MINBITS are spaced at 1/4 of
+** their power of two, so at most 25% of a buffer is unused.
+*/
+#define BMPPOOL_MINBITS   12
+#define BMPPOOL_MAXBITS   31
+#define BMPPOOL_NCLASSES  ((BMPPOOL_MAXBITS-BMPPOOL_MINBITS)*4)
+#define BMPPOOL_FLUSH     256   /* Add thread counts to the totals this often */
+
+/* Kept at the start of each free buffer */
+typedef struct bmppool_free
+    {
+    struct bmppool_free *next;
+    int page;   /* Page count of the thread when the buffer was freed */
+    } BMPPOOLFREE;
+
+typedef struct
+    {
+    BMPPOOLFREE *head[BMPPOOL_NCLASSES];
+    double bytes;   /* Bytes held on the free lists */
+    int page;       /* Number of bmppool_page_end() calls */
+    int hits,misses,events;
+    double bytes_reused;
+    } BMPPOOL;
+
+static pthread_key_t bmppool_key;
+static pthread_once_t bmppool_once=PTHREAD_ONCE_INIT;
+static pthread_mutex_t bmppool_mutex=PTHREAD_MUTEX_INITIALIZER;
+static double bmppool_max_bytes=128e6; /* Per thread.  0 = no pooling. */
+static double bmppool_total_hits=0.;
+static double bmppool_total_misses=0.;
+static double bmppool_total_bytes_reused=0.;
+
+static void bmppool_key_create(void);
+static void bmppool_thread_exit(void *data);
+static BMPPOOL *bmppool_thread_pool(int create);
+static int  bmppool_class(size_t size,size_t *class_size);
+static void bmppool_trim(BMPPOOL *pool,int all);
+static void bmppool_flush_counts(BMPPOOL *pool);
+
+
+/*
+** Most bytes of free buffers that each thread keeps (0 = don't pool).
+*/
+void bmppool_set_max_bytes(double max_bytes)
+
+    {
+    bmppool_max_bytes = max_bytes < 0. ? 0. : max_bytes;
+    }
+
+
+/*
+** Size that bmppool_get() will actually allocate for size bytes.
+*/
+size_t bmppool_size(size_t size)
+
+    {
+    size_t class_size;
+
+    if (bmppool_class(size,&class_size)<0)
+        return(size);
+    return(class_size);
+    }
+
+
+/*
+** Returns a buffer of at least (*size) bytes and sets (*size) to the number
+** of bytes in it, which must be passed to bmppool_put() to free it.  The
+** buffer is from willus_mem_alloc(), so it may also be freed or
+** re-allocated with willus_mem_free() / willus_mem_realloc().
+*/
+void *bmppool_get(size_t *size,char *name)
+
+    {
+    BMPPOOL *pool;
+    BMPPOOLFREE *buf;
+    size_t class_size;
+    void *ptr;
+    int ic;
+
+    ic=bmppool_class(*size,&class_size);
+    if (ic<0)
+        {
+        willus_mem_alloc_warn(&ptr,*size,name,10);
+        return(ptr);
+        }
+    (*size)=class_size;
+    pool=bmppool_thread_pool(bmppool_max_bytes>0.);
+    if (pool==NULL)
+        {
+        willus_mem_alloc_warn(&ptr,class_size,name,10);
+        return(ptr);
+        }
+    buf=pool->head[ic];
+    if (buf!=NULL)
+        {
+        pool->head[ic]=buf->next;
+        pool->bytes -= class_size;
+        pool->hits++;
+        pool->bytes_reused += class_size;
+        ptr=(void *)buf;
+        }
+    else
+        {
+        pool->misses++;
+        willus_mem_alloc_warn(&ptr,class_size,name,10);
+        }
+    if ((++pool->events)>=BMPPOOL_FLUSH)
+        bmppool_flush_counts(pool);
+    return(ptr);
+    }
+
+
+/*
+** Keep ptr (size bytes from bmppool_get()) for re-use by the calling thread.
+** Returns 0 (ptr not taken) if ptr is not a pool-size buffer or the
+** thread's free lists are full, in which case the caller should free it.
+*/
+int bmppool_put(void *ptr,size_t size)
+
+    {
+    BMPPOOL *pool;
+    BMPPOOLFREE *buf;
+    size_t class_size;
+    int ic;
+
+    ic=bmppool_class(size,&class_size);
+    if (ic<0 || class_size!=size || bmppool_max_bytes<=0.)
+        return(0);
+    pool=bmppool_thread_pool(1);
+    if (pool==NULL)
+        return(0);
+    if (pool->bytes+size>bmppool_max_bytes)
+        {
+        /* Make room by dropping buffers left from earlier pages */
+        bmppool_trim(pool,0);
+        if (pool->bytes+size>bmppool_max_bytes)
+            return(0);
+        }
+    buf=(BMPPOOLFREE *)ptr;
+    buf->next=pool->head[ic];
+    buf->page=pool->page;
+    pool->head[ic]=buf;
+    pool->bytes += size;
+    return(1);
+    }
+
+
+/*
+** Call at the end of each page.  Buffers of the calling thread that have
+** not been used since the end of the previous page are freed, so scratch
+** bitmaps are re-used from one page to the next but memory isn't held for
+** sizes that are no longer needed.
+*/
+void bmppool_page_end(void)
+
+    {
+    BMPPOOL *pool;
+
+    pool=bmppool_thread_pool(0);
+    if (pool==NULL)
+        return;
+    bmppool_trim(pool,0);
+    pool->page++;
+    bmppool_flush_counts(pool);
+    }
+
+
+/*
+** Free all of the calling thread's pooled buffers.
+*/
+void bmppool_free_all(void)
+
+    {
+    BMPPOOL *pool;
+
+    pool=bmppool_thread_pool(0);
+    if (pool==NULL)
+        return;
+    bmppool_trim(pool,1);
+    bmppool_flush_counts(pool);
+    }
+
+
+/*
+** Total number of buffers that came from the pool (hits) and that had to be
+** allocated (misses) by all threads, and the bytes of re-used buffers.
+*/
+void bmppool_stats(double *hits,double *misses,double *bytes_reused)
+
+    {
+    BMPPOOL *pool;
+
+    pool=bmppool_thread_pool(0);
+    if (pool!=NULL)
+        bmppool_flush_counts(pool);
+    pthread_mutex_lock(&bmppool_mutex);
+    (*hits)=bmppool_total_hits;
+    (*misses)=bmppool_total_misses;
+    (*bytes_reused)=bmppool_total_bytes_reused;
+    pthread_mutex_unlock(&bmppool_mutex);
+    }
+
+
+static void bmppool_key_create(void)
+
+    {
+    pthread_key_create(&bmppool_key,bmppool_thread_exit);
+    }
+
+
+static void bmppool_thread_exit(void *data)
+
+    {
+    static char *funcname="bmppool_thread_exit";
+    BMPPOOL *pool;
+
+    pool=(BMPPOOL *)data;
+    if (pool==NULL)
+        return;
+    bmppool_trim(pool,1);
+    bmppool_flush_counts(pool);
+    willus_mem_free((double **)&pool,funcname);
+    }
+
+
+static BMPPOOL *bmppool_thread_pool(int create)
+
+    {
+    static char *funcname="bmppool_thread_pool";
+    BMPPOOL *pool;
+
+    pthread_once(&bmppool_once,bmppool_key_create);
+    pool=(BMPPOOL *)pthread_getspecific(bmppool_key);
+    if (pool!=NULL || !create)
+        return(pool);
+    if (!willus_mem_alloc((double **)&pool,sizeof(BMPPOOL),funcname))
+        return(NULL);
+    memset(pool,0,sizeof(BMPPOOL));
+    pthread_setspecific(bmppool_key,pool);
+    return(pool);
+    }
+
+
+/*
+** Class index for size (-1 if not pooled) and the class size.
+*/
+static int bmppool_class(size_t size,size_t *class_size)
+
+    {
+    size_t step;
+    int bits,ic;
+
+    if (size<=((size_t)1<<BMPPOOL_MINBITS))
+        return(-1);
+    /* 2^bits < size <= 2^(bits+1) */
+    for (bits=BMPPOOL_MINBITS;((size-1)>>(bits+1))!=0;bits++)
+        if (bits+1>=BMPPOOL_MAXBITS)
+            return(-1);
+    step=(size_t)1<<(bits-2);
+    ic=(int)((size-1)>>(bits-2))-4;  /* 0 - 3 */
+    (*class_size)=((size_t)ic+5)*step;
+    return((bits-BMPPOOL_MINBITS)*4+ic);
+    }
+
+
+/*
+** Free buffers put back before the current page (all!=0:  every buffer).
+*/
+static void bmppool_trim(BMPPOOL *pool,int all)
+
+    {
+    static char *funcname="bmppool_trim";
+    int ic;
+
+    for (ic=0;ic<BMPPOOL_NCLASSES;ic++)
+        {
+        BMPPOOLFREE **pbuf;
+        size_t class_size;
+
+        class_size=((size_t)(ic&3)+5)<<(ic/4+BMPPOOL_MINBITS-2);
+        for (pbuf=&pool->head[ic];(*pbuf)!=NULL;)
+            {
+            BMPPOOLFREE *buf;
+
+            buf=(*pbuf);
+            if (!all && buf->page>=pool->page)
+                {
+                pbuf=&buf->next;
+                continue;
+                }
+            (*pbuf)=buf->next;
+            pool->bytes -= class_size;
+            willus_mem_free((double **)&buf,funcname);
+            }
+        }
+    }
+
+
+static void bmppool_flush_counts(BMPPOOL *pool)
+
+    {
+    pthread_mutex_lock(&bmppool_mutex);
+    bmppool_total_hits += pool->hits;
+    bmppool_total_misses += pool->misses;
+    bmppool_total_bytes_reused += pool->bytes_reused;
+    pthread_mutex_unlock(&bmppool_mutex);
+    pool->hits=pool->misses=pool->events=0;
+    pool->bytes_reused=0.;
+    }
@@ -0,0 +1,424 @@
+/*
+** bmpsimd.c    SSE2 / AVX2 versions of the per-pixel bitmap loops in bmp.c,
+**              picked at run time by CPU feature detection.  Each kernel has
+**              a plain C version which gives identical results and is used
+**              on other CPUs / compilers.
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include "willus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+** The SIMD kernels need gcc / clang (for the target attribute and
+** __builtin_cpu_supports()) on x86-64, where SSE2 is always available and
+** scalar double precision math is done in SSE2 registers (so the grey
+** level conversion rounds the same way as bmp8_greylevel_convert()).
+*/
+#if (defined(__GNUC__) && defined(__x86_64__))
+#define BMP_SIMD_X86
+#include <immintrin.h>
+#endif
+
+static int bmp_simd=-1;
+
+static void bmp_simd_rgb_to_grey_c(unsigned char *dst,unsigned char *src,int n,int ir,int ib);
+static void bmp_simd_whitethresh_c(unsigned char *p,int n,int whitethresh);
+static void bmp_simd_invert_c(unsigned char *p,int n);
+static void bmp_simd_madd_c(int *acc,int *src,int w,int n);
+#ifdef BMP_SIMD_X86
+static int  bmp_simd_rgb_to_grey_sse2(unsigned char *dst,unsigned char *src,int n,int ir,int ib);
+static int  bmp_simd_rgb_to_grey_avx2(unsigned char *dst,unsigned char *src,int n,int ir,int ib);
+static int  bmp_simd_whitethresh_sse2(unsigned char *p,int n,int whitethresh);
+static int  bmp_simd_whitethresh_avx2(unsigned char *p,int n,int whitethresh);
+static int  bmp_simd_invert_sse2(unsigned char *p,int n);
+static int  bmp_simd_invert_avx2(unsigned char *p,int n);
+static int  bmp_simd_madd_sse2(int *acc,int *src,int w,int n);
+static int  bmp_simd_madd_avx2(int *acc,int *src,int w,int n);
+#endif
+
+
+/*
+** Returns the instruction set used by the bmp_simd_...() kernels:
+** BMP_SIMD_NONE, BMP_SIMD_SSE2, or BMP_SIMD_AVX2.
+*/
+int bmp_simd_level(void)
+
+    {
+    if (bmp_simd<0)
+        {
+#ifdef BMP_SIMD_X86
+        __builtin_cpu_init();
+        bmp_simd = __builtin_cpu_supports("avx2") ? BMP_SIMD_AVX2 : BMP_SIMD_SSE2;
+#else
+        bmp_simd = BMP_SIMD_NONE;
+#endif
+        }
+    return(bmp_simd);
+    }
+
+
+/*
+** Override the detected instruction set, e.g. to compare against the plain
+** C kernels.  Levels higher than what the CPU supports are reduced.
+** level < 0 re-detects.
+*/
+void bmp_simd_set_level(int level)
+
+    {
+    int maxlevel;
+
+    bmp_simd=-1;
+    maxlevel=bmp_simd_level();
+    if (level>=0 && level<maxlevel)
+        bmp_simd=level;
+    }
+
+
+/*
+** dst[i] = bmp8_greylevel_convert(r,g,b) for the n 24-bit pixels in src[],
+** where r = src[3*i+ir], g = src[3*i+1], b = src[3*i+ib].  dst may be
+** the same as src.
+*/
+void bmp_simd_rgb_to_grey(unsigned char *dst,unsigned char *src,int n,int ir,int ib)
+
+    {
+    int i;
+
+    i=0;
+#ifdef BMP_SIMD_X86
+    if (bmp_simd_level()==BMP_SIMD_AVX2)
+        i=bmp_simd_rgb_to_grey_avx2(dst,src,n,ir,ib);
+    else if (bmp_simd_level()==BMP_SIMD_SSE2)
+        i=bmp_simd_rgb_to_grey_sse2(dst,src,n,ir,ib);
+#endif
+    bmp_simd_rgb_to_grey_c(&dst[i],&src[3*i],n-i,ir,ib);
+    }
+
+
+/*
+** Every byte in p[0..n-1] that is >= whitethresh is set to 255.
+*/
+void bmp_simd_whitethresh(unsigned char *p,int n,int whitethresh)
+
+    {
+    int i;
+
+    if (whitethresh>255)
+        return;
+    if (whitethresh<0)
+        whitethresh=0;
+    i=0;
+#ifdef BMP_SIMD_X86
+    if (bmp_simd_level()==BMP_SIMD_AVX2)
+        i=bmp_simd_whitethresh_avx2(p,n,whitethresh);
+    else if (bmp_simd_level()==BMP_SIMD_SSE2)
+        i=bmp_simd_whitethresh_sse2(p,n,whitethresh);
+#endif
+    bmp_simd_whitethresh_c(&p[i],n-i,whitethresh);
+    }
+
+
+/*
+** p[i] = 255-p[i] for i=0..n-1
+*/
+void bmp_simd_invert(unsigned char *p,int n)
+
+    {
+    int i;
+
+    i=0;
+#ifdef BMP_SIMD_X86
+    if (bmp_simd_level()==BMP_SIMD_AVX2)
+        i=bmp_simd_invert_avx2(p,n);
+    else if (bmp_simd_level()==BMP_SIMD_SSE2)
+        i=bmp_simd_invert_sse2(p,n);
+#endif
+    bmp_simd_invert_c(&p[i],n-i);
+    }
+
+
+/*
+** acc[i] += w*src[i] for i=0..n-1 (32-bit ints--caller makes sure there
+** is no overflow).  Used by bmp_resample_fixed_point().
+*/
+void bmp_simd_madd(int *acc,int *src,int w,int n)
+
+    {
+    int i;
+
+    i=0;
+#ifdef BMP_SIMD_X86
+    if (bmp_simd_level()==BMP_SIMD_AVX2)
+        i=bmp_simd_madd_avx2(acc,src,w,n);
+    else if (bmp_simd_level()==BMP_SIMD_SSE2)
+        i=bmp_simd_madd_sse2(acc,src,w,n);
+#endif
+    bmp_simd_madd_c(&acc[i],&src[i],w,n-i);
+    }
+
+
+static void bmp_simd_rgb_to_grey_c(unsigned char *dst,unsigned char *src,int n,int ir,int ib)
+
+    {
+    int i;
+
+    for (i=0;i<n;i++,src+=3)
+        dst[i]=bmp8_greylevel_convert(src[ir],src[1],src[ib]);
+    }
+
+
+static void bmp_simd_whitethresh_c(unsigned char *p,int n,int whitethresh)
+
+    {
+    int i;
+
+    for (i=0;i<n;i++)
+        if (p[i]>=whitethresh)
+            p[i]=255;
+    }
+
+
+static void bmp_simd_invert_c(unsigned char *p,int n)
+
+    {
+    int i;
+
+    for (i=0;i<n;i++)
+        p[i]=255-p[i];
+    }
+
+
+static void bmp_simd_madd_c(int *acc,int *src,int w,int n)
+
+    {
+    int i;
+
+    for (i=0;i<n;i++)
+        acc[i]+=w*src[i];
+    }
+
+
+#ifdef BMP_SIMD_X86
+/*
+** The SIMD kernels return the number of pixels (bytes) done.  The caller
+** finishes the rest with the plain C kernel.
+**
+** The grey level kernels do the same double precision operations, in the
+** same order, as bmp8_greylevel_convert():  (int)((r*0.3+g*0.59+b*0.11)*1.002).
+** (No FMA, which would round differently.)  The AVX2 kernel loads 16 bytes
+** for every 4 pixels (12 bytes), so it stops 2 pixels short of the end.
+*/
+__attribute__((target("sse2")))
+static int bmp_simd_rgb_to_grey_sse2(unsigned char *dst,unsigned char *src,int n,int ir,int ib)
+
+    {
+    __m128d kr,kg,kb,ks;
+    int i,grey4;
+
+    kr=_mm_set1_pd(0.3);
+    kg=_mm_set1_pd(0.59);
+    kb=_mm_set1_pd(0.11);
+    ks=_mm_set1_pd(1.002);
+    for (i=0;i+4<=n;i+=4,src+=12)
+        {
+        __m128i r,g,b,lo,hi,v;
+
+        r=_mm_setr_epi32(src[ir],src[ir+3],src[ir+6],src[ir+9]);
+        g=_mm_setr_epi32(src[1],src[4],src[7],src[10]);
+        b=_mm_setr_epi32(src[ib],src[ib+3],src[ib+6],src[ib+9]);
+        lo=_mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(_mm_add_pd(
+                        _mm_mul_pd(_mm_cvtepi32_pd(r),kr),
+                        _mm_mul_pd(_mm_cvtepi32_pd(g),kg)),
+                        _mm_mul_pd(_mm_cvtepi32_pd(b),kb)),ks));
+        r=_mm_srli_si128(r,8);
+        g=_mm_srli_si128(g,8);
+        b=_mm_srli_si128(b,8);
+        hi=_mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(_mm_add_pd(
+                        _mm_mul_pd(_mm_cvtepi32_pd(r),kr),
+                        _mm_mul_pd(_mm_cvtepi32_pd(g),kg)),
+                        _mm_mul_pd(_mm_cvtepi32_pd(b),kb)),ks));
+        v=_mm_unpacklo_epi64(lo,hi);
+        v=_mm_packs_epi32(v,v);
+        v=_mm_packus_epi16(v,v);
+        grey4=_mm_cvtsi128_si32(v);
+        memcpy(&dst[i],&grey4,4);
+        }
+    return(i);
+    }
+
+
+__attribute__((target("avx2")))
+static int bmp_simd_rgb_to_grey_avx2(unsigned char *dst,unsigned char *src,int n,int ir,int ib)
+
+    {
+    __m256d kr,kg,kb,ks;
+    __m128i sr,sg,sb;
+    int i;
+
+    kr=_mm256_set1_pd(0.3);
+    kg=_mm256_set1_pd(0.59);
+    kb=_mm256_set1_pd(0.11);
+    ks=_mm256_set1_pd(1.002);
+    /* Shuffles that pull the r, g, b bytes of 4 pixels into 32-bit lanes */
+    sr=_mm_setr_epi8(ir,-1,-1,-1,ir+3,-1,-1,-1,ir+6,-1,-1,-1,ir+9,-1,-1,-1);
+    sg=_mm_setr_epi8(1,-1,-1,-1,4,-1,-1,-1,7,-1,-1,-1,10,-1,-1,-1);
+    sb=_mm_setr_epi8(ib,-1,-1,-1,ib+3,-1,-1,-1,ib+6,-1,-1,-1,ib+9,-1,-1,-1);
+    for (i=0;i+10<=n;i+=8,src+=24)
+        {
+        __m128i x,lo,hi,v;
+
+        x=_mm_loadu_si128((__m128i *)src);
+        lo=_mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(
+                    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_shuffle_epi8(x,sr)),kr),
+                    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_shuffle_epi8(x,sg)),kg)),
+                    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_shuffle_epi8(x,sb)),kb)),ks));
+        x=_mm_loadu_si128((__m128i *)(src+12));
+        hi=_mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(
+                    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_shuffle_epi8(x,sr)),kr),
+                    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_shuffle_epi8(x,sg)),kg)),
+                    _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_shuffle_epi8(x,sb)),kb)),ks));
+        v=_mm_packs_epi32(lo,hi);
+        v=_mm_packus_epi16(v,v);
+        _mm_storel_epi64((__m128i *)&dst[i],v);
+        }
+    return(i);
+    }
+
+
+/*
+** p >= t  <==>  max(p,t) == p  (unsigned bytes).  Or-ing in the compare
+** mask sets those bytes to 255.
+*/
+__attribute__((target("sse2")))
+static int bmp_simd_whitethresh_sse2(unsigned char *p,int n,int whitethresh)
+
+    {
+    __m128i t;
+    int i;
+
+    t=_mm_set1_epi8((char)whitethresh);
+    for (i=0;i+16<=n;i+=16)
+        {
+        __m128i x;
+
+        x=_mm_loadu_si128((__m128i *)&p[i]);
+        x=_mm_or_si128(x,_mm_cmpeq_epi8(_mm_max_epu8(x,t),x));
+        _mm_storeu_si128((__m128i *)&p[i],x);
+        }
+    return(i);
+    }
+
+
+__attribute__((target("avx2")))
+static int bmp_simd_whitethresh_avx2(unsigned char *p,int n,int whitethresh)
+
+    {
+    __m256i t;
+    int i;
+
+    t=_mm256_set1_epi8((char)whitethresh);
+    for (i=0;i+32<=n;i+=32)
+        {
+        __m256i x;
+
+        x=_mm256_loadu_si256((__m256i *)&p[i]);
+        x=_mm256_or_si256(x,_mm256_cmpeq_epi8(_mm256_max_epu8(x,t),x));
+        _mm256_storeu_si256((__m256i *)&p[i],x);
+        }
+    return(i);
+    }
+
+
+__attribute__((target("sse2")))
+static int bmp_simd_invert_sse2(unsigned char *p,int n)
+
+    {
+    __m128i ones;
+    int i;
+
+    ones=_mm_set1_epi8((char)0xff);
+    for (i=0;i+16<=n;i+=16)
+        _mm_storeu_si128((__m128i *)&p[i],
+                         _mm_xor_si128(_mm_loadu_si128((__m128i *)&p[i]),ones));
+    return(i);
+    }
+
+
+__attribute__((target("avx2")))
+static int bmp_simd_invert_avx2(unsigned char *p,int n)
+
+    {
+    __m256i ones;
+    int i;
+
+    ones=_mm256_set1_epi8((char)0xff);
+    for (i=0;i+32<=n;i+=32)
+        _mm256_storeu_si256((__m256i *)&p[i],
+                            _mm256_xor_si256(_mm256_loadu_si256((__m256i *)&p[i]),ones));
+    return(i);
+    }
+
+
+/*
+** SSE2 has no 32-bit multiply (low half), so do the even and odd elements
+** with _mm_mul_epu32() and put them back together.  The low 32 bits of the
+** product are the same for signed and unsigned.
+*/
+__attribute__((target("sse2")))
+static int bmp_simd_madd_sse2(int *acc,int *src,int w,int n)
+
+    {
+    __m128i ww;
+    int i;
+
+    ww=_mm_set1_epi32(w);
+    for (i=0;i+4<=n;i+=4)
+        {
+        __m128i s,even,odd;
+
+        s=_mm_loadu_si128((__m128i *)&src[i]);
+        even=_mm_mul_epu32(s,ww);
+        odd=_mm_mul_epu32(_mm_srli_epi64(s,32),ww);
+        even=_mm_unpacklo_epi32(_mm_shuffle_epi32(even,_MM_SHUFFLE(0,0,2,0)),
+                                _mm_shuffle_epi32(odd,_MM_SHUFFLE(0,0,2,0)));
+        _mm_storeu_si128((__m128i *)&acc[i],
+                         _mm_add_epi32(_mm_loadu_si128((__m128i *)&acc[i]),even));
+        }
+    return(i);
+    }
+
+
+__attribute__((target("avx2")))
+static int bmp_simd_madd_avx2(int *acc,int *src,int w,int n)
+
+    {
+    __m256i ww;
+    int i;
+
+    ww=_mm256_set1_epi32(w);
+    for (i=0;i+8<=n;i+=8)
+        _mm256_storeu_si256((__m256i *)&acc[i],
+                  _mm256_add_epi32(_mm256_loadu_si256((__m256i *)&acc[i]),
+                         _mm256_mullo_epi32(_mm256_loadu_si256((__m256i *)&src[i]),ww)));
+    return(i);
+    }
+#endif /* BMP_SIMD_X86 */
@@ -67,12 +67,12 @@
 typedef struct compress_handle_s
     {
     z_stream strm;
+    int level; /* < 0 = inflate (v2.56:  was a static, shared by all handles) */
     unsigned char in[COMPRESS_CHUNK];
     unsigned char out[COMPRESS_CHUNK];
     } compress_handle_t;
 
 typedef compress_handle_t *compress_handle_p;
-static int g_level;
 
 compress_handle compress_start(FILE *f,int level)
 
@@ -89,7 +89,7 @@ compress_handle compress_start(FILE *f,int level)
     h->strm.total_out = 0;
     h->strm.avail_in = 0;
     h->strm.next_in = &h->in[0];
-    g_level=level;
+    h->level=level;
     if (level < 0)
         ret = inflateInit2(&h->strm,(15+32));
     else
@@ -119,7 +119,7 @@ static size_t compress_out(FILE *f,compress_handle_p h,int flush)
         {
         h->strm.avail_out = COMPRESS_CHUNK;
         h->strm.next_out = &h->out[0];
-        ret = (g_level<0) ? inflate(&h->strm,flush) : deflate(&h->strm,flush);  /* no bad return value */
+        ret = (h->level<0) ? inflate(&h->strm,flush) : deflate(&h->strm,flush);  /* no bad return value */
         if (ret==Z_STREAM_ERROR)
             {
             fprintf(stderr,"Internal error in compress_out.  Z_STREAM_ERROR.\n"
@@ -129,7 +129,7 @@ static size_t compress_out(FILE *f,compress_handle_p h,int flush)
         have = COMPRESS_CHUNK - h->strm.avail_out; // size of output produced
         if (fwrite(&h->out,1,have,f)!=have || ferror(f)) 
             {
-            if (g_level<0)
+            if (h->level<0)
                 (void)inflateEnd(&h->strm);
             else
                 (void)deflateEnd(&h->strm);
@@ -162,7 +162,7 @@ void compress_done(FILE *f,compress_handle *hh)
         {
         if (f)
             compress_out(f,h,Z_FINISH);
-        if (g_level<0)
+        if (h->level<0)
             inflateEnd(&h->strm);
         else
             deflateEnd(&h->strm);
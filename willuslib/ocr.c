@@ -33,39 +33,67 @@
 typedef struct
     {
     WILLUSBITMAP *bmp;
+    WILLUSBITMAP ownbmp; /* Private copy of bitmap if submitted before the words are OCR'd */
+    int    ticket; /* Ticket of this job in the OCR pool */
+    int    type; /* 'g' for GOCR or 't' for Tesseract */
     int    dpi; /* bitmap dpi */
-    int    c1,r1;
-    int    index; /* index into ocrwords array that this came from */
-    double lcheight;
-    pthread_mutex_t mutex;
-    int done;
-    double scale;
+    int    width,height;
+    int    index; /* index into ocrwords array that this came from (-1 = not yet claimed) */
+    double downsample;
+    int    running;
+    int    done;
+    int    discard; /* Free when done--nobody will claim the result */
+    void  *owner; /* Who submitted the job (see ocrpool_discard()) */
     OCRWORDS ocrwords;
     } OCRRESULT;
 
-typedef struct
-    {
-    OCRRESULT *ocrresult;
-    int thindex;
-    int n;
-    int na;
-    } OCRRESULTS;
-
-static void **global_ocr_api;
-static int global_ocr_type;
 /*
-** If < 0, then | global_ocr_target_dpi | = the desired light of a lowercase letter
-** in pixels.
+** Persistent pool of OCR worker threads (v2.56).  Worker thread i always uses
+** OCR engine api[i].  Jobs are queued in the order they are submitted and are
+** claimed by the next idle worker, so a word bitmap can start being OCR'd as
+** soon as it is queued rather than at the next call to ocrpool_ocrwords().
 */
-static int global_ocr_target_dpi;
+typedef struct
+    {
+    void **api;
+    int nthreads;
+    pthread_t *thread;
+    void **thdata;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;      /* Signals workers:  new job or stop */
+    pthread_cond_t donecond;  /* Signals waiting caller:  job done */
+    OCRRESULT **job; /* NULL once freed */
+    int n,na;
+    int next;    /* Next job[] to be claimed by a worker */
+    int ticket0; /* Ticket of job[0] */
+    int stop;
+    int maxbatch; /* Most Tesseract word jobs OCR'd together (see ocrpool_set_batch()) */
+    double cpu_secs;
+    } OCRPOOL;
+
+#define OCRPOOL_MAXBATCH 64
+
+typedef struct
+    {
+    OCRPOOL *pool;
+    int index;
+    } OCRPOOLTHREAD;
 
 /*
 ** Support funcs for multithreaded OCR 
 */
-static void  ocrresult_init_from_ocrword(OCRRESULT *ocrresult,OCRWORD *word,int index);
-static void  ocrresults_make_room(OCRRESULTS *ocrresults);
-static void *ocrword_multithreaded_procbitmaps(void *data);
+static OCRRESULT *ocrpool_new_job(OCRPOOL *pool,OCRWORD *word,int type,int target_dpi);
+static OCRRESULT *ocrpool_find_job(OCRPOOL *pool,OCRWORD *word,int type,int target_dpi);
+static void ocrpool_free_job(OCRPOOL *pool,OCRRESULT *job);
+static void ocrpool_compact(OCRPOOL *pool);
+static void *ocrpool_worker(void *data);
+static int  ocrpool_claim_batch(OCRPOOL *pool,OCRRESULT **batch);
+static int  ocrpool_batch_compatible(OCRRESULT *job0,OCRRESULT *job);
+static void ocrpool_proc_jobs(void *api,OCRRESULT **batch,int n);
+static double ocrpool_thread_cpu_secs(void);
+static double ocr_downsample(OCRWORD *word,int type,int target_dpi);
 static void  ocrresult_proc_bitmap(void *api,OCRRESULT *ocrresult);
+static void  ocrresult_proc_batch(void *api,OCRRESULT **batch,int n);
 
 static int  vowel(int c0);
 static int  not_usually_after_T(int c0);
@@ -97,100 +125,275 @@ void ocrwords_queue_bitmap(OCRWORDS *words,WILLUSBITMAP *bmp8,int dpi,
     }
 
 
-static void ocrresult_init_from_ocrword(OCRRESULT *ocrresult,OCRWORD *word,int index)
+/*
+** Start a persistent pool of nthreads OCR worker threads.  Worker i uses
+** ocr_api[i] (ocr_api may be NULL for GOCR).  The pool should be stopped
+** with ocrpool_stop().
+*/
+void *ocrpool_start(void **ocr_api,int nthreads)
 
     {
-    ocrresult->bmp=ocrword_bitmap_ptr(word);
-    ocrresult->dpi=word->dpi;
-    ocrresult->c1=word->c;
-    ocrresult->r1=word->r;
-    ocrresult->lcheight=word->lcheight;
-    ocrresult->index=index;
-    ocrresult->done=0;
-    ocrresult->scale=word->bmpscale;
-    pthread_mutex_init(&ocrresult->mutex,NULL);
-    ocrwords_init(&ocrresult->ocrwords);
+    static char *funcname="ocrpool_start";
+    OCRPOOL *pool;
+    int i;
+
+    if (nthreads<1)
+        nthreads=1;
+    willus_mem_alloc_warn((void **)&pool,sizeof(OCRPOOL),funcname,10);
+    willus_mem_alloc_warn((void **)&pool->thread,sizeof(pthread_t)*nthreads,funcname,10);
+    willus_mem_alloc_warn((void **)&pool->thdata,sizeof(OCRPOOLTHREAD)*nthreads,funcname,10);
+    pool->api=ocr_api;
+    pool->job=NULL;
+    pool->n=pool->na=0;
+    pool->next=0;
+    pool->ticket0=1;
+    pool->stop=0;
+    pool->maxbatch=0;
+    pool->cpu_secs=0.;
+    pthread_mutex_init(&pool->mutex,NULL);
+    pthread_cond_init(&pool->cond,NULL);
+    pthread_cond_init(&pool->donecond,NULL);
+    for (i=0;i<nthreads;i++)
+        {
+        OCRPOOLTHREAD *pt;
+
+        pt=&((OCRPOOLTHREAD *)pool->thdata)[i];
+        pt->pool=pool;
+        pt->index=i;
+        if (pthread_create(&pool->thread[i],NULL,ocrpool_worker,pt)!=0)
+            break;
+        }
+    pool->nthreads=i;
+    if (pool->nthreads==0)
+        {
+        ocrpool_stop(pool);
+        return(NULL);
+        }
+    return((void *)pool);
     }
 
 
-static void ocrresults_make_room(OCRRESULTS *ocrresults)
+/*
+** v2.56:  Let each worker OCR up to maxwords queued Tesseract word bitmaps
+** in one call by placing them side by side in one bitmap (0 or 1 = one
+** word per call).  For queues of single words (e.g. -ocrd w), where
+** Tesseract's setup for each call takes longer than recognizing the word.
+*/
+void ocrpool_set_batch(void *handle,int maxwords)
 
     {
-    static char *funcname="ocrresults_make_room";
+    OCRPOOL *pool;
+
+    pool=(OCRPOOL *)handle;
+    if (pool==NULL)
+        return;
+    pthread_mutex_lock(&pool->mutex);
+    pool->maxbatch = maxwords > OCRPOOL_MAXBATCH ? OCRPOOL_MAXBATCH : maxwords;
+    pthread_mutex_unlock(&pool->mutex);
+    }
+
+
+void ocrpool_stop(void *handle)
+
+    {
+    static char *funcname="ocrpool_stop";
+    OCRPOOL *pool;
+    int i;
+
+    pool=(OCRPOOL *)handle;
+    if (pool==NULL)
+        return;
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop=1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (i=0;i<pool->nthreads;i++)
+        pthread_join(pool->thread[i],NULL);
+    for (i=pool->n-1;i>=0;i--)
+        if (pool->job[i]!=NULL)
+            ocrpool_free_job(pool,pool->job[i]);
+    willus_mem_free((double **)&pool->job,funcname);
+    pthread_cond_destroy(&pool->donecond);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    willus_mem_free((double **)&pool->thdata,funcname);
+    willus_mem_free((double **)&pool->thread,funcname);
+    willus_mem_free((double **)&pool,funcname);
+    }
+
+
+/*
+** Start OCR-ing a queued word bitmap (e.g. the one just added by
+** ocrwords_queue_bitmap()) right away.  The pool keeps its own copy of the
+** bitmap, so the word may be moved, copied, or offset before its result is
+** collected by ocrpool_ocrwords().  owner identifies the submitter when
+** several callers share the pool (see ocrpool_discard()).
+*/
+void ocrpool_submit(void *handle,void *owner,OCRWORD *word,int type,int target_dpi)
 
-    if (ocrresults->n>=ocrresults->na)
+    {
+    OCRPOOL *pool;
+    OCRRESULT *job;
+
+    pool=(OCRPOOL *)handle;
+    if (pool==NULL || ocrword_bitmap_ptr(word)==NULL)
+        return;
+    pthread_mutex_lock(&pool->mutex);
+    if (ocrpool_find_job(pool,word,type,target_dpi)==NULL)
         {
-        willus_mem_realloc_robust_warn((void **)&ocrresults->ocrresult,
-                                       ocrresults->na*2*sizeof(OCRRESULT),
-                                       ocrresults->na*sizeof(OCRRESULT),funcname,10);
-        ocrresults->na*=2;
+        job=ocrpool_new_job(pool,word,type,target_dpi);
+        job->owner=owner;
+        bmp_copy(&job->ownbmp,ocrword_bitmap_ptr(word));
+        job->bmp=&job->ownbmp;
+        word->ocrjob=job->ticket;
+        pthread_cond_signal(&pool->cond);
         }
+    pthread_mutex_unlock(&pool->mutex);
     }
 
 
 /*
-** Perform multithreaded OCR on all queued words
+** Returns non-zero if all of the queued words in words have been OCR'd by
+** the pool, i.e. ocrpool_ocrwords() can collect them without waiting.
+** Any that haven't been submitted yet are submitted.
 */
-double ocrwords_multithreaded_ocr(OCRWORDS *words,void **ocr_api,int nthreads,int type,int target_dpi)
+int ocrpool_ocrwords_done(void *handle,void *owner,OCRWORDS *words,int type,int target_dpi)
 
     {
-    OCRRESULTS _ocrresults,*ocrresults;
-    OCRRESULTS *ocrr;
-    pthread_t *thread;
-    clock_t start,stop;
-    double ocr_cpu_time_secs;
+    OCRPOOL *pool;
+    int i,done;
+
+    pool=(OCRPOOL *)handle;
+    if (pool==NULL)
+        return(1);
+    for (done=1,i=0;i<words->n;i++)
+        {
+        OCRRESULT *job;
+
+        if (ocrword_bitmap_ptr(&words->word[i])==NULL)
+            continue;
+        pthread_mutex_lock(&pool->mutex);
+        job=ocrpool_find_job(pool,&words->word[i],type,target_dpi);
+        if (job!=NULL && !job->done)
+            done=0;
+        pthread_mutex_unlock(&pool->mutex);
+        if (job==NULL)
+            {
+            ocrpool_submit(pool,owner,&words->word[i],type,target_dpi);
+            done=0;
+            }
+        }
+    return(done);
+    }
+
+
+/*
+** Discard any jobs submitted by owner older than ticket (all of them if
+** ticket <= 0) that have not been collected by ocrpool_ocrwords().  Call this
+** once the words they were submitted for have been dropped.
+*/
+void ocrpool_discard(void *handle,void *owner,int ticket)
+
+    {
+    OCRPOOL *pool;
     int i;
-    static char *funcname="ocrwords_multithreaded_ocr";
-
-    global_ocr_api=ocr_api;
-    global_ocr_type=type; /* 'g' for GOCR or 't' for Tesseract */
-    global_ocr_target_dpi=target_dpi;
-    willus_mem_alloc_warn((void**)&ocrr,sizeof(OCRRESULTS)*nthreads,funcname,10);
-    willus_mem_alloc_warn((void**)&thread,sizeof(pthread_t)*nthreads,funcname,10);
-    ocrresults=&_ocrresults;
-    ocrresults->n=0;
-    ocrresults->na=16;
-    willus_mem_alloc_warn((void **)&ocrresults->ocrresult,sizeof(OCRRESULT)*ocrresults->na,funcname,10);
-
-    /* Queue up all conversions to be done into OCRRESULTS structure */
-    for (i=0;i<words->n;i++)
+
+    pool=(OCRPOOL *)handle;
+    if (pool==NULL)
+        return;
+    pthread_mutex_lock(&pool->mutex);
+    for (i=0;i<pool->n;i++)
         {
-        OCRWORD *word;
+        OCRRESULT *job;
 
-        word=&words->word[i];
-        if (ocrword_bitmap_ptr(word)==NULL)
+        job=pool->job[i];
+        if (job==NULL || job->index>=0 || job->owner!=owner)
             continue;
-        ocrresults_make_room(ocrresults);
-        ocrresult_init_from_ocrword(&ocrresults->ocrresult[ocrresults->n++],word,i);
+        if (ticket>0 && job->ticket>=ticket)
+            break;
+        if (job->running)
+            job->discard=1;
+        else
+            ocrpool_free_job(pool,job);
         }
+    ocrpool_compact(pool);
+    pthread_mutex_unlock(&pool->mutex);
+    }
 
-    /* Perform OCR */
-    start=clock();
-    for (i=0;i<nthreads;i++)
+
+/*
+** Perform OCR on all queued words using the pool.  Words that were already
+** submitted with ocrpool_submit() use the results from their jobs.
+**
+** Returns the CPU time used by the OCR threads since the last call.
+*/
+double ocrpool_ocrwords(void *handle,OCRWORDS *words,int type,int target_dpi)
+
+    {
+    static char *funcname="ocrpool_ocrwords";
+    OCRPOOL *pool;
+    OCRRESULT **wres;
+    double cpu_secs;
+    int i,words_n0;
+
+    pool=(OCRPOOL *)handle;
+    if (pool==NULL || words->n<=0)
+        return(0.);
+    words_n0=words->n;
+    willus_mem_alloc_warn((void **)&wres,sizeof(OCRRESULT *)*words->n,funcname,10);
+
+    /* Match queued words to submitted jobs, or queue them now */
+    pthread_mutex_lock(&pool->mutex);
+    for (i=0;i<words->n;i++)
         {
-        ocrr[i]=(*ocrresults);
-        ocrr[i].thindex=i;
-        pthread_create(&thread[i],NULL,ocrword_multithreaded_procbitmaps,&ocrr[i]);
+        OCRWORD *word;
+        OCRRESULT *job;
+        WILLUSBITMAP *bmp;
+
+        wres[i]=NULL;
+        word=&words->word[i];
+        bmp=ocrword_bitmap_ptr(word);
+        if (bmp==NULL)
+            continue;
+        job=ocrpool_find_job(pool,word,type,target_dpi);
+        if (job==NULL)
+            {
+            /* Words array doesn't change until all jobs are done, so no copy needed */
+            job=ocrpool_new_job(pool,word,type,target_dpi);
+            job->bmp=bmp;
+            pthread_cond_signal(&pool->cond);
+            }
+        job->index=i;
+        wres[i]=job;
         }
-    for (i=0;i<nthreads;i++)
-        pthread_join(thread[i],NULL);
-    stop=clock();
-    ocr_cpu_time_secs=(double)stop/CLOCKS_PER_SEC - (double)start/CLOCKS_PER_SEC;
+    for (i=0;i<words->n;i++)
+        while (wres[i]!=NULL && !wres[i]->done)
+            pthread_cond_wait(&pool->donecond,&pool->mutex);
+    cpu_secs=pool->cpu_secs;
+    pool->cpu_secs=0.;
+    pthread_mutex_unlock(&pool->mutex);
 
     /* Process results */
-    for (i=0;i<ocrresults->n;i++)
+    for (i=0;i<words->n;i++)
         {
         OCRRESULT *ocrresult;
+        OCRWORD *word0;
         int j;
 
-        ocrresult=&ocrresults->ocrresult[i];
+        ocrresult=wres[i];
+        if (ocrresult==NULL)
+            continue;
+        word0=&words->word[i];
+        if (ocrresult->type=='t')
+            ocrwords_scale(&ocrresult->ocrwords,word0->bmpscale);
+        ocrwords_offset(&ocrresult->ocrwords,word0->c,word0->r);
 /*
-printf("ocrresult %d of %d: c1=%d, r1=%d, n=%d\n",i,ocrresults->n,ocrresult->c1,ocrresult->r1,ocrresult->ocrwords.n);
+printf("ocrresult %d of %d: c1=%d, r1=%d, n=%d\n",i,words->n,word0->c,word0->r,ocrresult->ocrwords.n);
 */
         if (ocrresult->ocrwords.n==0)
             {
             OCRWORD *word;
-            word=&words->word[ocrresult->index];
+            word=&words->word[i];
             ocrword_free(word);
             }
         for (j=0;j<ocrresult->ocrwords.n;j++)
@@ -199,7 +402,7 @@ printf("ocrresult %d of %d: c1=%d, r1=%d, n=%d\n",i,ocrresults->n,ocrresult->c1,
 
             if (j==0)
                 {
-                word=&words->word[ocrresult->index];
+                word=&words->word[i];
                 ocrword_free(word);
                 }
             else
@@ -230,89 +433,287 @@ printf("    word[%d] (%4d,%4d) %dx%d = '%s' (n=%d)\n",j,ocrresult->ocrwords.word
     ocrwords_sort_by_position(words);
 
     /* Clean up */
-    for (i=ocrresults->n-1;i>=0;i--)
-        ocrwords_free(&ocrresults->ocrresult[i].ocrwords);
-    willus_mem_free((double**)&ocrresults->ocrresult,funcname);
-    willus_mem_free((double**)&thread,funcname);
-    willus_mem_free((double**)&ocrr,funcname);
+    pthread_mutex_lock(&pool->mutex);
+    for (i=0;i<words_n0;i++)
+        if (wres[i]!=NULL)
+            ocrpool_free_job(pool,wres[i]);
+    ocrpool_compact(pool);
+    pthread_mutex_unlock(&pool->mutex);
+    willus_mem_free((double **)&wres,funcname);
+    return(cpu_secs);
+    }
+
+
+/*
+** Perform multithreaded OCR on all queued words using a temporary pool
+*/
+double ocrwords_multithreaded_ocr(OCRWORDS *words,void **ocr_api,int nthreads,int type,int target_dpi)
+
+    {
+    void *pool;
+    double ocr_cpu_time_secs;
+
+    pool=ocrpool_start(ocr_api,nthreads);
+    ocr_cpu_time_secs=ocrpool_ocrwords(pool,words,type,target_dpi);
+    ocrpool_stop(pool);
     return(ocr_cpu_time_secs);
     }
 
 
-static void *ocrword_multithreaded_procbitmaps(void *data)
+/*
+** Pool mutex must be locked
+*/
+static OCRRESULT *ocrpool_new_job(OCRPOOL *pool,OCRWORD *word,int type,int target_dpi)
 
     {
-    OCRRESULTS *ocrresults;
-    int i;
+    static char *funcname="ocrpool_new_job";
+    OCRRESULT *job;
 
-    ocrresults=(OCRRESULTS *)data;
-    for (i=0;i<ocrresults->n;i++)
+    if (pool->n>=pool->na)
         {
-        OCRRESULT *ocrresult;
+        int newsize;
 
-        ocrresult=&ocrresults->ocrresult[i];
-        pthread_mutex_lock(&ocrresult->mutex);
-        if (ocrresult->done==1)
-            {
-            pthread_mutex_unlock(&ocrresult->mutex);
+        newsize = pool->na<256 ? 256 : pool->na*2;
+        willus_mem_realloc_robust_warn((void **)&pool->job,newsize*sizeof(OCRRESULT *),
+                                       pool->na*sizeof(OCRRESULT *),funcname,10);
+        pool->na=newsize;
+        }
+    willus_mem_alloc_warn((void **)&job,sizeof(OCRRESULT),funcname,10);
+    pool->job[pool->n]=job;
+    job->ticket=pool->ticket0+pool->n;
+    pool->n++;
+    bmp_init(&job->ownbmp);
+    job->bmp=NULL;
+    job->type=type;
+    job->dpi=word->dpi;
+    job->width=ocrword_bitmap_ptr(word)->width;
+    job->height=ocrword_bitmap_ptr(word)->height;
+    job->index=-1;
+    job->downsample=ocr_downsample(word,type,target_dpi);
+    job->running=0;
+    job->done=0;
+    job->discard=0;
+    job->owner=NULL;
+    ocrwords_init(&job->ocrwords);
+    return(job);
+    }
+
+
+/*
+** Pool mutex must be locked.  Returns the unclaimed job that was submitted
+** for word if it's still valid for the word's current dpi and scaling.
+*/
+static OCRRESULT *ocrpool_find_job(OCRPOOL *pool,OCRWORD *word,int type,int target_dpi)
+
+    {
+    OCRRESULT *job;
+    WILLUSBITMAP *bmp;
+    int k;
+
+    bmp=ocrword_bitmap_ptr(word);
+    k=word->ocrjob-pool->ticket0;
+    if (bmp==NULL || k<0 || k>=pool->n || pool->job[k]==NULL)
+        return(NULL);
+    job=pool->job[k];
+    if (job->index>=0 || job->discard || job->type!=type || job->dpi!=(int)word->dpi
+            || job->width!=bmp->width || job->height!=bmp->height
+            || job->downsample!=ocr_downsample(word,type,target_dpi))
+        return(NULL);
+    return(job);
+    }
+
+
+/*
+** Pool mutex must be locked and the job must not be running
+*/
+static void ocrpool_free_job(OCRPOOL *pool,OCRRESULT *job)
+
+    {
+    static char *funcname="ocrpool_free_job";
+
+    pool->job[job->ticket-pool->ticket0]=NULL;
+    ocrwords_free(&job->ocrwords);
+    bmp_free(&job->ownbmp);
+    willus_mem_free((double **)&job,funcname);
+    }
+
+
+/*
+** Pool mutex must be locked.  Drop freed jobs from the front of the queue.
+*/
+static void ocrpool_compact(OCRPOOL *pool)
+
+    {
+    int k;
+
+    for (k=0;k<pool->n && pool->job[k]==NULL;k++);
+    if (k==0)
+        return;
+    if (k<pool->n)
+        memmove(pool->job,&pool->job[k],(pool->n-k)*sizeof(OCRRESULT *));
+    pool->n -= k;
+    pool->next = pool->next>k ? pool->next-k : 0;
+    pool->ticket0 += k;
+    }
+
+
+static void *ocrpool_worker(void *data)
+
+    {
+    OCRPOOLTHREAD *pt;
+    OCRPOOL *pool;
+    void *api;
+
+    pt=(OCRPOOLTHREAD *)data;
+    pool=pt->pool;
+    api=pool->api==NULL ? NULL : pool->api[pt->index];
+    pthread_mutex_lock(&pool->mutex);
+    while (1)
+        {
+        OCRRESULT *batch[OCRPOOL_MAXBATCH];
+        double t0;
+        int i,n;
+
+        while (!pool->stop && pool->next>=pool->n)
+            pthread_cond_wait(&pool->cond,&pool->mutex);
+        if (pool->stop)
+            break;
+        n=ocrpool_claim_batch(pool,batch);
+        if (n==0) /* Discarded */
             continue;
+        pthread_mutex_unlock(&pool->mutex);
+        t0=ocrpool_thread_cpu_secs();
+        ocrpool_proc_jobs(api,batch,n);
+        t0=ocrpool_thread_cpu_secs()-t0;
+        pthread_mutex_lock(&pool->mutex);
+        pool->cpu_secs += t0;
+        for (i=0;i<n;i++)
+            {
+            batch[i]->running=0;
+            batch[i]->done=1;
+            if (batch[i]->discard)
+                ocrpool_free_job(pool,batch[i]);
             }
-        ocrresult->done=1;
-        pthread_mutex_unlock(&ocrresult->mutex);
-        ocrresult_proc_bitmap(global_ocr_api[ocrresults->thindex],ocrresult);
+        pthread_cond_broadcast(&pool->donecond);
         }
+    pthread_mutex_unlock(&pool->mutex);
     pthread_exit(NULL);
     return(NULL);
     }
 
 
 /*
-** In tests I did, the ...no_mutex function is never faster
-** than the ..._mutex() function.
+** Pool mutex must be locked.  Claim the next job plus (if batching is on)
+** the compatible jobs queued right after it.  So that idle workers still
+** get work, a batch takes no more than its share of the queued jobs.
+** Returns the number of jobs claimed (0 if the next job was discarded).
 */
-#if 0
-static void *ocrword_multithreaded_procbitmaps_no_mutex(void *data)
+static int ocrpool_claim_batch(OCRPOOL *pool,OCRRESULT **batch)
 
     {
-    OCRRESULTS *ocrresults;
-    int i;
-
-    ocrresults=(OCRRESULTS *)data;
-    for (i=ocrresults->thindex;i<ocrresults->n;i+=maxthreads)
+    int n,maxn;
+
+    batch[0]=pool->job[pool->next++];
+    if (batch[0]==NULL)
+        return(0);
+    batch[0]->running=1;
+    maxn=(pool->n-pool->next+1+pool->nthreads-1)/pool->nthreads;
+    if (maxn>pool->maxbatch)
+        maxn=pool->maxbatch;
+    for (n=1;n<maxn && pool->next<pool->n;n++)
         {
-        OCRRESULT *ocrresult;
+        OCRRESULT *job;
 
-        ocrresult=&ocrresults->ocrresult[i];
-        ocrresult->done=1;
-        ocr_proc_bitmap(ocrtess_api[ocrresults->thindex],ocrresult);
+        job=pool->job[pool->next];
+        if (job==NULL || !ocrpool_batch_compatible(batch[0],job))
+            break;
+        pool->next++;
+        job->running=1;
+        batch[n]=job;
         }
-    pthread_exit(NULL);
-    return(NULL);
+    return(n);
+    }
+
+
+/*
+** Tesseract jobs with the same dpi and downsampling and similar heights
+** can be OCR'd together.
+*/
+static int ocrpool_batch_compatible(OCRRESULT *job0,OCRRESULT *job)
+
+    {
+    return(job0->type=='t' && job->type=='t' && job->dpi==job0->dpi
+             && job->downsample==job0->downsample
+             && job->height<=2*job0->height && 2*job->height>=job0->height);
     }
+
+
+/*
+** v2.56:  Jobs whose bitmaps are in the OCR result cache (see ocrcache.c)
+** get their words from it.  The rest are OCR'd (together, if more than
+** one) and their words are added to the cache.
+*/
+static void ocrpool_proc_jobs(void *api,OCRRESULT **batch,int n)
+
+    {
+    OCRRESULT *todo[OCRPOOL_MAXBATCH];
+    int i,m;
+
+    for (m=i=0;i<n;i++)
+        if (!ocrcache_get(&batch[i]->ocrwords,batch[i]->bmp,batch[i]->type,
+                          batch[i]->dpi,batch[i]->downsample))
+            todo[m++]=batch[i];
+    if (m==1)
+        ocrresult_proc_bitmap(api,todo[0]);
+    else if (m>1)
+        ocrresult_proc_batch(api,todo,m);
+    for (i=0;i<m;i++)
+        ocrcache_put(&todo[i]->ocrwords,todo[i]->bmp,todo[i]->type,
+                     todo[i]->dpi,todo[i]->downsample);
+    }
+
+
+static double ocrpool_thread_cpu_secs(void)
+
+    {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts)==0)
+        return((double)ts.tv_sec+(double)ts.tv_nsec/1e9);
 #endif
+    return((double)clock()/CLOCKS_PER_SEC);
+    }
 
 
+/*
+** If target_dpi < 0, then | target_dpi | = the desired height of a lowercase letter
+** in pixels.
+*/
+static double ocr_downsample(OCRWORD *word,int type,int target_dpi)
+
+    {
+    if (type!='t')
+        return(1.);
+    if (word->lcheight > 0. && target_dpi < 0 && word->lcheight > -target_dpi)
+        return((double)-target_dpi / word->lcheight);
+    if (word->dpi > 0 && target_dpi > 0 && word->dpi > target_dpi)
+        return((double)target_dpi / word->dpi);
+    return(1.);
+    }
+
 
 static void ocrresult_proc_bitmap(void *api,OCRRESULT *ocrresult)
 
     {
-    switch (global_ocr_type)
+    switch (ocrresult->type)
         {
 #ifdef HAVE_TESSERACT_LIB
         case 't':
             {
-            double downsample;
             OCRWORDS *ocrwords;
 
             ocrwords=&ocrresult->ocrwords;
-            if (ocrresult->lcheight > 0. && global_ocr_target_dpi < 0
-                      && ocrresult->lcheight > -global_ocr_target_dpi)
-                downsample = (double)-global_ocr_target_dpi / ocrresult->lcheight;
-            else if (ocrresult->dpi > 0 && global_ocr_target_dpi > 0
-                      && ocrresult->dpi > global_ocr_target_dpi)
-                downsample = (double)global_ocr_target_dpi / ocrresult->dpi;
-            else
-                downsample = 1.;
 /*
 {
 static int count=0;
@@ -325,9 +726,7 @@ printf("Calling ocrtess_ocrwords, bmp=%dx%d\n",ocrresult->bmp->width,ocrresult->
 */
             ocrtess_ocrwords_from_bmp8(api,ocrwords,ocrresult->bmp,
                                        0,0,ocrresult->bmp->width-1,ocrresult->bmp->height-1,
-                                       ocrresult->dpi,-1,downsample,NULL);
-            ocrwords_scale(ocrwords,ocrresult->scale);
-            ocrwords_offset(ocrwords,ocrresult->c1,ocrresult->r1);
+                                       ocrresult->dpi,-1,ocrresult->downsample,NULL);
 /*
 printf("    Result:  %d words.\n",ocrresult->ocrwords.n);
 { int i;
@@ -358,7 +757,6 @@ printf("        %2d. '%s' (%d,%d) w=%d, h=%d\n",i+1,word->text,word->c,word->r,w
         case 'g':
             gocr_ocrwords_from_bmp8(&ocrresult->ocrwords,ocrresult->bmp,0,0,
                                     ocrresult->bmp->width-1,ocrresult->bmp->height-1,0,1);
-            ocrwords_offset(&ocrresult->ocrwords,ocrresult->c1,ocrresult->r1);
             break;
 #endif
         default:
@@ -376,6 +774,90 @@ printf("        %2d. '%s' (%d,%d) w=%d, h=%d\n",i+1,word->text,word->c,word->r,w
     }
 
 
+/*
+** v2.56:  OCR several Tesseract word jobs with one call.  The word bitmaps
+** are placed in one row of a new bitmap, bottom aligned and separated by
+** white gaps as wide as the tallest one, and each word found is given to
+** the job whose bitmap it is on.  If any word found spans more than one
+** job's bitmap, the jobs are done one at a time instead.
+*/
+static void ocrresult_proc_batch(void *api,OCRRESULT **batch,int n)
+
+    {
+#ifdef HAVE_TESSERACT_LIB
+    static char *funcname="ocrresult_proc_batch";
+    WILLUSBITMAP *bmp,_bmp;
+    OCRWORDS _words,*words;
+    int *xoff;
+    int k,gap,ok;
+#endif
+    int i;
+
+#ifdef HAVE_TESSERACT_LIB
+
+    willus_mem_alloc_warn((void **)&xoff,(n+1)*sizeof(int),funcname,10);
+    bmp=&_bmp;
+    bmp_init(bmp);
+    for (gap=i=0;i<n;i++)
+        if (batch[i]->bmp->height>gap)
+            gap=batch[i]->bmp->height;
+    bmp->height=gap;
+    for (bmp->width=i=0;i<n;i++)
+        {
+        xoff[i] = bmp->width + (i>0 ? gap : 0);
+        bmp->width = xoff[i]+batch[i]->bmp->width;
+        }
+    xoff[n]=bmp->width+gap;
+    bmp->bpp=8;
+    bmp_alloc(bmp);
+    for (i=0;i<256;i++)
+        bmp->red[i]=bmp->green[i]=bmp->blue[i]=i;
+    bmp_fill(bmp,255,255,255);
+    for (i=0;i<n;i++)
+        {
+        WILLUSBITMAP *src;
+        int row,y0;
+
+        src=batch[i]->bmp;
+        y0=bmp->height-src->height;
+        for (row=0;row<src->height;row++)
+            memcpy(bmp_rowptr_from_top(bmp,y0+row)+xoff[i],bmp_rowptr_from_top(src,row),
+                   src->width);
+        }
+    words=&_words;
+    ocrwords_init(words);
+    ocrtess_ocrwords_from_bmp8(api,words,bmp,0,0,bmp->width-1,bmp->height-1,
+                               batch[0]->dpi,-1,batch[0]->downsample,NULL);
+    bmp_free(bmp);
+    for (i=0;i<n;i++)
+        ocrwords_clear(&batch[i]->ocrwords);
+    for (ok=1,k=0;k<words->n;k++)
+        {
+        OCRWORD *word;
+        int cx;
+
+        word=&words->word[k];
+        cx=word->c+word->w/2;
+        for (i=0;i<n-1 && cx>=xoff[i+1]-gap/2;i++);
+        if (word->c < xoff[i]-gap/2 || word->c+word->w > xoff[i+1]-gap/2)
+            {
+            ok=0;
+            break;
+            }
+        word->c -= xoff[i];
+        word->r -= bmp->height-batch[i]->bmp->height;
+        ocrwords_add_word(&batch[i]->ocrwords,word);
+        }
+    ocrwords_free(words);
+    willus_mem_free((double **)&xoff,funcname);
+    if (ok)
+        return;
+#endif
+    for (i=0;i<n;i++)
+        ocrresult_proc_bitmap(api,batch[i]);
+    }
+
+
 void ocr_text_proc(char *s,int allow_spaces)
 
     {
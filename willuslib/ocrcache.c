@@ -0,0 +1,517 @@
+/*
+** ocrcache.c   Process-wide, memory-bounded LRU cache of OCR results, looked
+**              up by a hash of the word bitmap (plus the OCR engine, dpi,
+**              down-sampling, and a caller tag such as the OCR language), so
+**              that running headers, page numbers, and words repeated from
+**              page to page--or from one conversion of a document to the
+**              next, with the optional disk file--are only OCR'd once.
+**              Thread safe.
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include "willus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define OCRCACHE_KEYLEN   160
+#define OCRCACHE_NBUCKETS 4096  /* Hash table size (power of 2) */
+
+/* One OCR'd word, relative to the top left of the word bitmap */
+typedef struct
+    {
+    int c,r,w,h,rot;
+    double maxheight,lcheight;
+    char *text;
+    } OCRCACHEWORD;
+
+typedef struct
+    {
+    char key[OCRCACHE_KEYLEN];
+    unsigned int hash;
+    int next;           /* Next entry in the same hash bucket (-1 = none) */
+    OCRCACHEWORD *word;
+    int n;
+    double bytes;
+    double lastuse;     /* Use stamp--lowest is evicted first */
+    } OCRCACHEENTRY;
+
+typedef struct
+    {
+    OCRCACHEENTRY *entry;
+    int n,na;
+    int bucket[OCRCACHE_NBUCKETS];
+    double bytes;       /* Total bytes held */
+    double max_bytes;   /* 0 = caching is off */
+    double stamp;
+    char tag[64];
+    char filename[MAXFILENAMELEN];
+    FILE *f;            /* Disk store, open for appending new results */
+    } OCRCACHE;
+
+static OCRCACHE ocrcache;
+static int ocrcache_inited=0;
+static pthread_mutex_t ocrcache_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+static void ocrcache_start(void);
+static unsigned int ocrcache_key(char *key,WILLUSBITMAP *bmp,int type,int dpi,double downsample);
+static int  ocrcache_index(char *key,unsigned int hash);
+static int  ocrcache_add(char *key,unsigned int hash,OCRCACHEWORD *word,int n);
+static void ocrcache_rehash(void);
+static void ocrcache_trim(double max_bytes);
+static int  ocrcache_lastuse_compare(const void *a,const void *b);
+static void ocrcache_entry_free(OCRCACHEENTRY *entry);
+static void ocrcache_file_load(char *filename);
+static void ocrcache_file_write(OCRCACHEENTRY *entry);
+
+
+/*
+** Set the most memory (in bytes) the cache may use (0 turns caching off),
+** the disk store (NULL or "" = none), and a tag that is part of every key
+** (e.g. the OCR language, so that results from different languages are
+** kept apart).  Results already in the disk store are loaded.
+*/
+void ocrcache_init(double max_bytes,char *filename,char *tag)
+
+    {
+    int i;
+
+    pthread_mutex_lock(&ocrcache_mutex);
+    ocrcache_start();
+    ocrcache.max_bytes = max_bytes < 0. ? 0. : max_bytes;
+    xstrncpy(ocrcache.tag,tag==NULL ? "" : tag,63);
+    for (i=0;ocrcache.tag[i]!='\0';i++)
+        if (ocrcache.tag[i]<=' ')
+            ocrcache.tag[i]='_';
+    if (filename==NULL)
+        filename="";
+    if (strcmp(filename,ocrcache.filename))
+        {
+        if (ocrcache.f!=NULL)
+            fclose(ocrcache.f);
+        ocrcache.f=NULL;
+        xstrncpy(ocrcache.filename,filename,MAXFILENAMELEN-1);
+        if (filename[0]!='\0' && ocrcache.max_bytes>0.)
+            {
+            ocrcache_file_load(filename);
+            ocrcache.f=fopen(filename,"ab");
+            }
+        }
+    ocrcache_trim(ocrcache.max_bytes);
+    pthread_mutex_unlock(&ocrcache_mutex);
+    }
+
+
+/*
+** If the OCR of bmp (8-bit grey) is in the cache, put it in words and
+** return 1.  Otherwise return 0 (words is not changed).
+*/
+int ocrcache_get(OCRWORDS *words,WILLUSBITMAP *bmp,int type,int dpi,double downsample)
+
+    {
+    char key[OCRCACHE_KEYLEN];
+    unsigned int hash;
+    int i,j;
+
+    if (!ocrcache_inited || ocrcache.max_bytes<=0.)
+        return(0);
+    hash=ocrcache_key(key,bmp,type,dpi,downsample);
+    pthread_mutex_lock(&ocrcache_mutex);
+    i=ocrcache_index(key,hash);
+    if (i<0)
+        {
+        pthread_mutex_unlock(&ocrcache_mutex);
+        return(0);
+        }
+    ocrcache.entry[i].lastuse = ++ocrcache.stamp;
+    ocrwords_clear(words);
+    for (j=0;j<ocrcache.entry[i].n;j++)
+        {
+        OCRCACHEWORD *cword;
+        OCRWORD word;
+
+        cword=&ocrcache.entry[i].word[j];
+        ocrword_init(&word);
+        word.c=cword->c;
+        word.r=cword->r;
+        word.w=cword->w;
+        word.h=cword->h;
+        word.rot=cword->rot;
+        word.maxheight=cword->maxheight;
+        word.lcheight=cword->lcheight;
+        word.text=cword->text;
+        word.n=utf8_to_unicode(NULL,word.text,-1);
+        ocrwords_add_word(words,&word);
+        }
+    pthread_mutex_unlock(&ocrcache_mutex);
+    return(1);
+    }
+
+
+/*
+** Store words (the OCR of bmp) in the cache (and the disk store, if any).
+*/
+void ocrcache_put(OCRWORDS *words,WILLUSBITMAP *bmp,int type,int dpi,double downsample)
+
+    {
+    static char *funcname="ocrcache_put";
+    char key[OCRCACHE_KEYLEN];
+    OCRCACHEWORD *cword;
+    unsigned int hash;
+    int i;
+
+    if (!ocrcache_inited || ocrcache.max_bytes<=0.)
+        return;
+    hash=ocrcache_key(key,bmp,type,dpi,downsample);
+    cword=NULL;
+    if (words->n>0)
+        willus_mem_alloc_warn((void **)&cword,words->n*sizeof(OCRCACHEWORD),funcname,10);
+    for (i=0;i<words->n;i++)
+        {
+        OCRWORD *word;
+        char *text;
+
+        word=&words->word[i];
+        text = word->text==NULL ? "" : word->text;
+        cword[i].c=word->c;
+        cword[i].r=word->r;
+        cword[i].w=word->w;
+        cword[i].h=word->h;
+        cword[i].rot=word->rot;
+        cword[i].maxheight=word->maxheight;
+        cword[i].lcheight=word->lcheight;
+        willus_mem_alloc_warn((void **)&cword[i].text,strlen(text)+1,funcname,10);
+        strcpy(cword[i].text,text);
+        }
+    pthread_mutex_lock(&ocrcache_mutex);
+    i=ocrcache_add(key,hash,cword,words->n);
+    if (i>=0 && ocrcache.f!=NULL)
+        ocrcache_file_write(&ocrcache.entry[i]);
+    pthread_mutex_unlock(&ocrcache_mutex);
+    }
+
+
+/*
+** Free all cached results and close the disk store.
+*/
+void ocrcache_clear(void)
+
+    {
+    static char *funcname="ocrcache_clear";
+
+    pthread_mutex_lock(&ocrcache_mutex);
+    if (ocrcache_inited)
+        {
+        ocrcache_trim(-1.);
+        willus_mem_free((double **)&ocrcache.entry,funcname);
+        ocrcache.na=0;
+        if (ocrcache.f!=NULL)
+            fclose(ocrcache.f);
+        ocrcache.f=NULL;
+        ocrcache.filename[0]='\0';
+        }
+    pthread_mutex_unlock(&ocrcache_mutex);
+    }
+
+
+/*
+** Cache mutex must be locked
+*/
+static void ocrcache_start(void)
+
+    {
+    int i;
+
+    if (ocrcache_inited)
+        return;
+    ocrcache.entry=NULL;
+    ocrcache.n=ocrcache.na=0;
+    for (i=0;i<OCRCACHE_NBUCKETS;i++)
+        ocrcache.bucket[i]=-1;
+    ocrcache.bytes=0.;
+    ocrcache.max_bytes=0.;
+    ocrcache.stamp=0.;
+    ocrcache.tag[0]='\0';
+    ocrcache.filename[0]='\0';
+    ocrcache.f=NULL;
+    ocrcache_inited=1;
+    }
+
+
+/*
+** Key for the OCR of bmp:  two 32-bit hashes of the pixels (grey levels are
+** quantized to 16 levels so that slight differences in anti-aliasing from
+** one rendering of a word to the next don't matter), plus the size, OCR
+** engine, dpi, down-sampling, and tag.  Returns the first hash.
+*/
+static unsigned int ocrcache_key(char *key,WILLUSBITMAP *bmp,int type,int dpi,double downsample)
+
+    {
+    unsigned int h1,h2;
+    int row,bw;
+
+    h1=2166136261u;  /* FNV-1a */
+    h2=5381;         /* djb2 */
+    bw = bmp->bpp==8 ? bmp->width : bmp_bytewidth(bmp);
+    for (row=0;row<bmp->height;row++)
+        {
+        unsigned char *p;
+        int i;
+
+        p=bmp_rowptr_from_top(bmp,row);
+        for (i=0;i<bw;i++)
+            {
+            int c;
+
+            c=p[i]>>4;
+            h1=(h1^c)*16777619u;
+            h2=h2*33+c;
+            }
+        }
+    sprintf(key,"%08x%08x_%dx%dx%d_%c_%d_%.4f_",h1,h2,bmp->width,bmp->height,bmp->bpp,
+                type,dpi,downsample);
+    xstrncpy(&key[strlen(key)],ocrcache.tag,OCRCACHE_KEYLEN-1-strlen(key));
+    return(h1);
+    }
+
+
+/*
+** Cache mutex must be locked
+*/
+static int ocrcache_index(char *key,unsigned int hash)
+
+    {
+    int i;
+
+    for (i=ocrcache.bucket[hash&(OCRCACHE_NBUCKETS-1)];i>=0;i=ocrcache.entry[i].next)
+        if (ocrcache.entry[i].hash==hash && !strcmp(ocrcache.entry[i].key,key))
+            return(i);
+    return(-1);
+    }
+
+
+/*
+** Cache mutex must be locked.  Takes ownership of word[] (and its text).
+** Returns the index of the new entry (-1 if it was not added).
+*/
+static int ocrcache_add(char *key,unsigned int hash,OCRCACHEWORD *word,int n)
+
+    {
+    static char *funcname="ocrcache_add";
+    OCRCACHEENTRY *entry,_entry;
+    int i,ib;
+
+    entry=&_entry;
+    entry->word=word;
+    entry->n=n;
+    entry->bytes=sizeof(OCRCACHEENTRY)+n*sizeof(OCRCACHEWORD);
+    for (i=0;i<n;i++)
+        entry->bytes += strlen(word[i].text)+1;
+    if (ocrcache_index(key,hash)>=0 || entry->bytes>ocrcache.max_bytes)
+        {
+        ocrcache_entry_free(entry);
+        return(-1);
+        }
+    if (ocrcache.bytes+entry->bytes>ocrcache.max_bytes)
+        /* Evict down to 90% so that this isn't done for every new entry */
+        ocrcache_trim(0.9*ocrcache.max_bytes-entry->bytes);
+    if (ocrcache.n>=ocrcache.na)
+        {
+        int newsize;
+
+        newsize = ocrcache.na<1024 ? 1024 : ocrcache.na*2;
+        willus_mem_realloc_robust_warn((void **)&ocrcache.entry,newsize*sizeof(OCRCACHEENTRY),
+                                       ocrcache.na*sizeof(OCRCACHEENTRY),funcname,10);
+        ocrcache.na=newsize;
+        }
+    xstrncpy(entry->key,key,OCRCACHE_KEYLEN-1);
+    entry->hash=hash;
+    entry->lastuse = ++ocrcache.stamp;
+    i=ocrcache.n++;
+    ib=hash&(OCRCACHE_NBUCKETS-1);
+    entry->next=ocrcache.bucket[ib];
+    ocrcache.bucket[ib]=i;
+    ocrcache.entry[i]=(*entry);
+    ocrcache.bytes += entry->bytes;
+    return(i);
+    }
+
+
+/*
+** Cache mutex must be locked
+*/
+static void ocrcache_rehash(void)
+
+    {
+    int i;
+
+    for (i=0;i<OCRCACHE_NBUCKETS;i++)
+        ocrcache.bucket[i]=-1;
+    for (i=0;i<ocrcache.n;i++)
+        {
+        int ib;
+
+        ib=ocrcache.entry[i].hash&(OCRCACHE_NBUCKETS-1);
+        ocrcache.entry[i].next=ocrcache.bucket[ib];
+        ocrcache.bucket[ib]=i;
+        }
+    }
+
+
+/*
+** Cache mutex must be locked.  Evict least recently used results until no
+** more than max_bytes are held (max_bytes < 0 = evict all).
+*/
+static void ocrcache_trim(double max_bytes)
+
+    {
+    int i;
+
+    if (ocrcache.bytes<=max_bytes || ocrcache.n==0)
+        return;
+    qsort(ocrcache.entry,ocrcache.n,sizeof(OCRCACHEENTRY),ocrcache_lastuse_compare);
+    for (i=0;i<ocrcache.n && ocrcache.bytes>max_bytes;i++)
+        {
+        ocrcache.bytes -= ocrcache.entry[i].bytes;
+        ocrcache_entry_free(&ocrcache.entry[i]);
+        }
+    if (i<ocrcache.n)
+        memmove(ocrcache.entry,&ocrcache.entry[i],(ocrcache.n-i)*sizeof(OCRCACHEENTRY));
+    ocrcache.n -= i;
+    if (ocrcache.n==0)
+        ocrcache.bytes=0.;
+    ocrcache_rehash();
+    }
+
+
+static int ocrcache_lastuse_compare(const void *a,const void *b)
+
+    {
+    double d;
+
+    d=((OCRCACHEENTRY *)a)->lastuse - ((OCRCACHEENTRY *)b)->lastuse;
+    return(d<0. ? -1 : (d>0. ? 1 : 0));
+    }
+
+
+static void ocrcache_entry_free(OCRCACHEENTRY *entry)
+
+    {
+    static char *funcname="ocrcache_entry_free";
+    int i;
+
+    for (i=entry->n-1;i>=0;i--)
+        willus_mem_free((double **)&entry->word[i].text,funcname);
+    willus_mem_free((double **)&entry->word,funcname);
+    entry->n=0;
+    }
+
+
+/*
+** Disk store format, one result per "K" line followed by one line per word:
+**     K <key> <number of words>
+**     W <c> <r> <w> <h> <rot> <maxheight> <lcheight> <UTF-8 text>
+** Cache mutex must be locked.
+*/
+static void ocrcache_file_load(char *filename)
+
+    {
+    static char *funcname="ocrcache_file_load";
+    char buf[1024];
+    FILE *f;
+
+    f=fopen(filename,"rb");
+    if (f==NULL)
+        return;
+    while (fgets(buf,1023,f)!=NULL)
+        {
+        char key[OCRCACHE_KEYLEN];
+        OCRCACHEWORD *word;
+        unsigned int hash;
+        int i,n;
+
+        if (buf[0]!='K' || sscanf(buf,"K %159s %d",key,&n)!=2 || n<0 || n>4096)
+            continue;
+        if (sscanf(key,"%8x",&hash)!=1)
+            continue;
+        word=NULL;
+        if (n>0)
+            willus_mem_alloc_warn((void **)&word,n*sizeof(OCRCACHEWORD),funcname,10);
+        for (i=0;i<n;i++)
+            {
+            char *p;
+            int k,len;
+
+            if (fgets(buf,1023,f)==NULL || buf[0]!='W'
+                   || sscanf(buf,"W %d %d %d %d %d %lf %lf",&word[i].c,&word[i].r,&word[i].w,
+                             &word[i].h,&word[i].rot,&word[i].maxheight,&word[i].lcheight)!=7)
+                break;
+            /* Text is everything after the 8th field */
+            for (p=buf,k=0;k<8 && (*p)!='\0';k++)
+                {
+                for (;(*p)!='\0' && (*p)!=' ';p++);
+                if ((*p)==' ')
+                    p++;
+                }
+            len=strlen(p);
+            while (len>0 && (p[len-1]=='\n' || p[len-1]=='\r'))
+                p[--len]='\0';
+            willus_mem_alloc_warn((void **)&word[i].text,len+1,funcname,10);
+            strcpy(word[i].text,p);
+            }
+        if (i<n)
+            {
+            OCRCACHEENTRY entry;
+
+            /* Truncated record */
+            entry.word=word;
+            entry.n=i;
+            ocrcache_entry_free(&entry);
+            continue;
+            }
+        ocrcache_add(key,hash,word,n);
+        }
+    fclose(f);
+    }
+
+
+/*
+** Cache mutex must be locked
+*/
+static void ocrcache_file_write(OCRCACHEENTRY *entry)
+
+    {
+    int i;
+
+    fprintf(ocrcache.f,"K %s %d\n",entry->key,entry->n);
+    for (i=0;i<entry->n;i++)
+        {
+        OCRCACHEWORD *word;
+        int k;
+
+        word=&entry->word[i];
+        fprintf(ocrcache.f,"W %d %d %d %d %d %.2f %.2f ",word->c,word->r,word->w,word->h,
+                word->rot,word->maxheight,word->lcheight);
+        for (k=0;word->text[k]!='\0';k++)
+            fputc(word->text[k]=='\n' || word->text[k]=='\r' ? ' ' : word->text[k],ocrcache.f);
+        fputc('\n',ocrcache.f);
+        }
+    fflush(ocrcache.f);
+    }
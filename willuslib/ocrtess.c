@@ -165,7 +165,9 @@ static int buf_contains_keyword(char *buf,char *keyword,int n);
 /*
 static int has_cube_data(char *lang);
 */
-static void endian_flip(char *x,int n);
+static PIX *ocrtess_pix_from_bmp8(WILLUSBITMAP *bmp8,int x1,int y1,int w,int h,int bw,
+                                  int dw,int dh,int pw,int ph);
+static void ocrtess_resample_weights(int *i0,double *wt,int maxnw,int n,int nnew);
 
 
 char *ocrtess_lang_by_index(char *lang,int index)
@@ -715,9 +717,7 @@ void ocrtess_ocrwords_from_bmp8(void *api,OCRWORDS *ocrwords,WILLUSBITMAP *bmp8,
 
     {
     PIX *pix;
-    WILLUSBITMAP *bmp,_bmp;
-    int nw,i,it,w,h,dw,dh,bw;
-    unsigned char *src,*dst;
+    int nw,i,it,w,h,dw,dh,pw,ph,bw;
     int *top,*left,*bottom,*right,*ybase;
     char *text;
 
@@ -744,52 +744,36 @@ void ocrtess_ocrwords_from_bmp8(void *api,OCRWORDS *ocrwords,WILLUSBITMAP *bmp8,
     h=y2-y1+1;
     dh=h+bw*2;
 
-    /* Store in new bitmap */
-    bmp=&_bmp;
-    bmp_init(bmp);
-    bmp->width=dw;
-    bmp->height=dh;
-    bmp->bpp=8;
-    bmp_alloc(bmp);
-    for (i=0;i<256;i++)
-        bmp->red[i]=bmp->blue[i]=bmp->green[i]=i;
-    dst=bmp_rowptr_from_top(bmp,0);
-    memset(dst,255,dw*dh);
-    src=bmp_rowptr_from_top(bmp8,y1)+x1;
-    dst=bmp_rowptr_from_top(bmp,bw)+bw;
-    for (i=y1;i<=y2;i++,dst+=dw,src+=bmp8->width) 
-        memcpy(dst,src,w);
-    bmp_set_dpi((double)dpi);
-
     /* Apply downsample */
     if (downsample > 0. && downsample < 0.9)
         {
-        int wnew;
-
         /* Make sure new width is even multiple of 4 */
-        wnew=downsample*bmp->width+0.5;
-        wnew=(wnew+3)&(~3);
-        downsample = (double)wnew/bmp->width;
-        bmp_resize(bmp,downsample);
+        pw=downsample*dw+0.5;
+        pw=(pw+3)&(~3);
+        downsample = (double)pw/dw;
+        ph=dh*downsample+0.5;
         dpi=dpi*downsample+0.5;
-        bmp_set_dpi((double)dpi);
         }
     else
+        {
         downsample=1.0;
+        pw=dw;
+        ph=dh;
+        }
+    bmp_set_dpi((double)dpi);
+    /*
+    ** v2.56:  The bordered (and down-sampled) word goes straight from bmp8
+    ** into the PIX data--no intermediate bitmaps or byte swapping.
+    */
+    pix=ocrtess_pix_from_bmp8(bmp8,x1,y1,w,h,bw,dw,dh,pw,ph);
 /*
 {
 static int counter=0;
 char filename[256];
 sprintf(filename,"ocrtext%04d.png",++counter);
-bmp_write(bmp,filename,stdout,100);
+pixWrite(filename,pix,IFF_PNG);
 }
 */
-    pix=pixCreate(bmp->width,bmp->height,8);
-    src=bmp_rowptr_from_top(bmp,0);
-    dst=(unsigned char *)pixGetData(pix);
-    memcpy(dst,src,bmp->width*bmp->height);
-    bmp_free(bmp);
-    endian_flip((char *)dst,pixGetWpl(pix)*pixGetHeight(pix));
     pixSetXRes(pix,dpi);
     pixSetYRes(pix,dpi);
     tess_capi_get_ocr_multiword(api,pix,segmode<0 || segmode>10 ? 6 : segmode,
@@ -848,8 +832,7 @@ void ocrtess_from_bmp8(void *api,char *text,int maxlen,WILLUSBITMAP *bmp8,
 
     {
     PIX *pix;
-    int i,w,h,dw,dh,bw,status;
-    unsigned char *src,*dst;
+    int w,h,dw,dh,bw,status;
 
     if (x1>x2)
         {
@@ -871,15 +854,7 @@ void ocrtess_from_bmp8(void *api,char *text,int maxlen,WILLUSBITMAP *bmp8,
         }
     h=y2-y1+1;
     dh=h+bw*2;
-    pix=pixCreate(dw,dh,8);
-    src=bmp_rowptr_from_top(bmp8,y1)+x1;
-    dst=(unsigned char *)pixGetData(pix);
-    memset(dst,255,dw*dh);
-    dst=(unsigned char *)pixGetData(pix);
-    dst += bw + dw*bw;
-    for (i=y1;i<=y2;i++,dst+=dw,src+=bmp8->width) 
-        memcpy(dst,src,w);
-    endian_flip((char *)pixGetData(pix),pixGetWpl(pix)*pixGetHeight(pix));
+    pix=ocrtess_pix_from_bmp8(bmp8,x1,y1,w,h,bw,dw,dh,dw,dh);
     /* Tesseract 3.05.00 -- need to set a resolution */
     pixSetXRes(pix,dpi);
     pixSetYRes(pix,dpi);
@@ -910,20 +885,146 @@ bmp_free(bmp);
     }
 
 
-static void endian_flip(char *x,int n)
+/*
+** v2.56:  Returns a new pw x ph 8-bit PIX of the w x h region of bmp8 at
+** (x1,y1) with a white border of bw pixels (padded on the right to dw x dh),
+** down-sampled to pw x ph if that is smaller.  Down-sampling is area-weighted,
+** the same as bmp_resize().  The pixels are packed directly into the PIX's
+** 32-bit words (leftmost pixel in the most significant byte, as leptonica
+** wants it), so no byte swapping is needed on any platform.
+*/
+static PIX *ocrtess_pix_from_bmp8(WILLUSBITMAP *bmp8,int x1,int y1,int w,int h,int bw,
+                                  int dw,int dh,int pw,int ph)
+
+    {
+    static char *funcname="ocrtess_pix_from_bmp8";
+    PIX *pix;
+    l_uint32 *data;
+    int wpl,row,col,maxnx,maxny;
+    int *ix0,*iy0;
+    double *wx,*wy,*acc;
+
+    pix=pixCreate(pw,ph,8);
+    data=pixGetData(pix);
+    wpl=pixGetWpl(pix);
+    if (pw>=dw && ph>=dh)
+        {
+        for (row=0;row<ph;row++,data+=wpl)
+            {
+            unsigned char *p;
+            int j;
+
+            if (row<bw || row>=bw+h)
+                {
+                for (j=0;j<wpl;j++)
+                    data[j]=0xffffffff;
+                continue;
+                }
+            p=bmp_rowptr_from_top(bmp8,y1+row-bw)+x1;
+            for (col=j=0;j<wpl;j++)
+                {
+                l_uint32 v;
+                int k;
+
+                for (v=0,k=0;k<4;k++,col++)
+                    v = (v<<8) | ((col<bw || col>=bw+w) ? 255 : p[col-bw]);
+                data[j]=v;
+                }
+            }
+        return(pix);
+        }
+    /* Each output pixel covers at most this many source pixels on each axis */
+    maxnx=dw/pw+2;
+    maxny=dh/ph+2;
+    willus_mem_alloc_warn((void **)&ix0,(pw+ph)*sizeof(int),funcname,10);
+    iy0=&ix0[pw];
+    willus_mem_alloc_warn((void **)&wx,(pw*maxnx+ph*maxny+pw)*sizeof(double),funcname,10);
+    wy=&wx[pw*maxnx];
+    acc=&wy[ph*maxny];
+    ocrtess_resample_weights(ix0,wx,maxnx,dw,pw);
+    ocrtess_resample_weights(iy0,wy,maxny,dh,ph);
+    for (row=0;row<ph;row++,data+=wpl)
+        {
+        int k,j;
+
+        for (col=0;col<pw;col++)
+            acc[col]=0.;
+        for (k=0;k<maxny;k++)
+            {
+            unsigned char *p;
+            double f;
+            int sr;
+
+            f=wy[row*maxny+k];
+            if (f==0.)
+                continue;
+            sr=iy0[row]+k;
+            if (sr<bw || sr>=bw+h)
+                {
+                for (col=0;col<pw;col++)
+                    acc[col] += 255.*f;
+                continue;
+                }
+            p=bmp_rowptr_from_top(bmp8,y1+sr-bw)+x1;
+            for (col=0;col<pw;col++)
+                {
+                double *g,sum;
+                int i,sc;
+
+                g=&wx[col*maxnx];
+                for (sum=0.,sc=ix0[col],i=0;i<maxnx;i++,sc++)
+                    if (g[i]!=0.)
+                        sum += g[i]*((sc<bw || sc>=bw+w) ? 255 : p[sc-bw]);
+                acc[col] += f*sum;
+                }
+            }
+        for (col=j=0;j<wpl;j++)
+            {
+            l_uint32 v;
+
+            for (v=0,k=0;k<4;k++,col++)
+                {
+                int c;
+
+                c = col<pw ? (int)(acc[col]+.5) : 255;
+                v = (v<<8) | (c>255 ? 255 : c);
+                }
+            data[j]=v;
+            }
+        }
+    willus_mem_free((double **)&wx,funcname);
+    willus_mem_free((double **)&ix0,funcname);
+    return(pix);
+    }
+
+
+/*
+** Area-weighted resampling of n source pixels to nnew:  output pixel i is
+** the sum of wt[i*maxnw+k] * source pixel i0[i]+k, k=0..maxnw-1.
+*/
+static void ocrtess_resample_weights(int *i0,double *wt,int maxnw,int n,int nnew)
 
     {
+    double x1,x2;
     int i;
 
-    for (i=0;i<n;i++,x+=4)
+    for (x1=0.,i=0;i<nnew;i++,x1=x2)
         {
-        int c;
-        c=x[0];
-        x[0]=x[3];
-        x[3]=c;
-        c=x[1];
-        x[1]=x[2];
-        x[2]=c;
+        double *w;
+        int k,j;
+
+        x2=(double)n*(i+1)/nnew;
+        w=&wt[i*maxnw];
+        i0[i]=(int)x1;
+        for (k=0;k<maxnw;k++)
+            {
+            double a,b;
+
+            j=i0[i]+k;
+            a = j>x1 ? j : x1;
+            b = j+1<x2 ? j+1 : x2;
+            w[k] = (b>a && j<n) ? (b-a)/(x2-x1) : 0.;
+            }
         }
     }
 
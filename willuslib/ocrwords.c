@@ -37,6 +37,7 @@ void ocrword_init(OCRWORD *word)
     {
     word->n=0;
     word->bmpscale=1.;
+    word->ocrjob=0;
     word->cpos=NULL;
     word->text=NULL;
     word->xbmp=NULL;
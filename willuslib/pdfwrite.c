@@ -28,6 +28,7 @@
 
 #ifdef HAVE_Z_LIB
 #include <zlib.h>
+#include <pthread.h>
 #endif
 
 #define MAXPDFPAGES 10000
@@ -38,16 +39,33 @@
 
 extern WILLUSCHARINFO pdffonts_helvetica[];
 
-static int lastfont=-1;
-static double lastfontsize=-1;
-
 static void pdffile_start(PDFFILE *pdf,int pages_at_end);
 static int pdffile_page_reference(PDFFILE *pdf,int pageno);
 static void pdffile_unicode_map(PDFFILE *pdf,WILLUSCHARMAPLIST *cmaplist,int nf);
 static void thumbnail_create(WILLUSBITMAP *thumb,WILLUSBITMAP *bmp);
 static void pdffile_bmp_stream(PDFFILE *pdf,WILLUSBITMAP *bmp,int quality,int halfsize,int thumb);
-static void bmp_flate_decode(WILLUSBITMAP *bmp,FILE *f,compress_handle handle,int halfsize);
+static int  bmp_packed_row_bytes(WILLUSBITMAP *bmp,int halfsize);
+static void bmp_pack_row(unsigned char *dst,WILLUSBITMAP *bmp,int row,int halfsize);
+#ifdef HAVE_Z_LIB
+static int  flate_band_count(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize);
+static int  flate_trial_rows(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize);
+static size_t flate_trial_size(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize,int predictor);
+static int  g4_beats_flate(PDFFILE *pdf,WILLUSBITMAP *bmp);
+static void pdffile_flate_image(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize,int predictor);
+static void *flateband_deflate(void *data);
+static void flateband_store(void *band,size_t *nalloc,unsigned char *data,int n,int final);
+static void flateband_row(void *band,unsigned char *dst,int row,unsigned char **cur,
+                          unsigned char **prev);
+static void png_filter_row(unsigned char *dst,unsigned char *row,unsigned char *prev,int n,
+                           int bpp);
+#else
+static void bmp_flate_decode(WILLUSBITMAP *bmp,FILE *f,int halfsize);
+#endif
 static void pdffile_new_object(PDFFILE *pdf,int flags);
+static long long pdffile_tell(PDFFILE *pdf);
+static void pdffile_xref_stream(PDFFILE *pdf,int infoobj);
+static void pdffile_reserve_object(PDFFILE *pdf);
+static void pdffile_reserved_object_start(PDFFILE *pdf,int objnum);
 static void pdffile_add_object(PDFFILE *pdf,PDFOBJECT *object);
 #ifdef HAVE_Z_LIB
 static int pdf_numpages_1(void *ptr,int bufsize);
@@ -55,8 +73,8 @@ static int decodecheck(FILE *f,int np);
 static int wpdf_getline(char *buf,int maxlen,FILE *f);
 static int wpdf_getbufline(char *buf,int maxlen,char *opbuf,int *i0,int bufsize);
 #endif
-static void insert_length(FILE *f,long pos,int len);
-static void ocrwords_to_pdf_stream(OCRWORDS *ocrwords,FILE *f,double dpi,
+static void insert_length(FILE *f,long long pos,long long len);
+static void ocrwords_to_pdf_stream(OCRWORDS *ocrwords,PDFFILE *pdf,double dpi,
                                    double page_height_pts,int text_render_mode,
                                    WILLUSCHARMAPLIST *cmaplist,int use_spaces,int ocr_flags);
 static double ocrwords_median_size(OCRWORDS *ocrwords,double dpi,WILLUSCHARMAPLIST *cmaplist);
@@ -68,7 +86,7 @@ static void ocrwords_optimize_spaces(OCRWORD *sentence,OCRWORD *word,int n,doubl
 static void ocrwords_sentence_construct(OCRWORD *sentence,OCRWORD *word,int n,int *nspaces);
 static void sentence_check_alignment(OCRWORD *word,int n,int *nspaces,double *pos,
                                      WILLUSCHARMAPLIST *cmaplist);
-static void ocrword_to_pdf_stream(OCRWORD *word,FILE *f,double dpi,
+static void ocrword_to_pdf_stream(OCRWORD *word,PDFFILE *pdf,double dpi,
                                   double page_height_pts,double median_size_pts,
                                   WILLUSCHARMAPLIST *cmaplist,int ocr_flags);
 static void willuscharmaplist_init(WILLUSCHARMAPLIST *list);
@@ -87,6 +105,12 @@ FILE *pdffile_init(PDFFILE *pdf,char *filename,int pages_at_end)
     pdf->object=NULL;
     pdf->pae=0;
     pdf->imc=0;
+    pdf->dpage=NULL;
+    pdf->ndp=pdf->ndpa=0;
+    pdf->nthreads=1;
+    pdf->xref_stream=0;
+    pdf->lastfont=-1;
+    pdf->lastfontsize=-1;
     strncpy(pdf->filename,filename,511);
     pdf->filename[511]='\0';
     pdf->f = wfile_fopen_utf8(filename,"wb");
@@ -107,7 +131,9 @@ void pdffile_close(PDFFILE *pdf)
         pdf->f=NULL;
         }
     willus_mem_free((double **)&pdf->object,"pdffile_close");
+    willus_mem_free((double **)&pdf->dpage,"pdffile_close");
     pdf->n=pdf->na=pdf->imc=0;
+    pdf->ndp=pdf->ndpa=0;
     }
 
 
@@ -118,18 +144,14 @@ static void pdffile_start(PDFFILE *pdf,int pages_at_end)
     pdffile_new_object(pdf,2);
     fprintf(pdf->f,"<<\n"
                    "/Pages ");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    pdf->object[pdf->n-1].ptr[1]=ftell(pdf->f);
+    pdf->object[pdf->n-1].ptr[1]=pdffile_tell(pdf);
     if (pages_at_end)
         fprintf(pdf->f,"      ");
     else
         fprintf(pdf->f,"2");
     fprintf(pdf->f," 0 R\n"
                    "/Outlines ");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    pdf->object[pdf->n-1].ptr[2]=ftell(pdf->f);
+    pdf->object[pdf->n-1].ptr[2]=pdffile_tell(pdf);
     fprintf(pdf->f,"       0 R\n"
                    "/Type /Catalog\n"
                    ">>\n"
@@ -142,9 +164,7 @@ static void pdffile_start(PDFFILE *pdf,int pages_at_end)
         fprintf(pdf->f,"<<\n"
                        "/Type /Pages\n"
                        "/Kids [");
-        fflush(pdf->f);
-        fseek(pdf->f,0L,1);
-        pdf->pae=ftell(pdf->f);
+        pdf->pae=pdffile_tell(pdf);
         cline[0]='%';
         cline[1]='%';
         for (i=2;i<71;i++)
@@ -295,8 +315,10 @@ void pdffile_add_bitmap_with_ocrwords(PDFFILE *pdf,WILLUSBITMAP *bmp,double dpi,
 
     {
     double pw,ph;
-    int ptr1,ptr2,ptrlen,showbitmap,nf;
+    int showbitmap,nf;
+    long long ptr1,ptr2,ptrlen,pos0;
     WILLUSCHARMAPLIST *cmaplist,_cmaplist;
+    WPROFILETIMER timer;
 
 /*
 {
@@ -314,8 +336,8 @@ ocrwords->word[i].w,
 ocrwords->word[i].h);
 }
 */
-    lastfont=-1;
-    lastfontsize=-1;
+    pdf->lastfont=-1;
+    pdf->lastfontsize=-1;
     /* Fix: 24 Nov 2016 */
     showbitmap = (ocr_render_flags&5);
     /* If only showing boxes, clear the bitmap */
@@ -325,15 +347,15 @@ ocrwords->word[i].h);
     pw=bmp->width*72./dpi;
     ph=bmp->height*72./dpi;
 
+    wprofile_start(&timer);
     /* New page object */
     pdffile_new_object(pdf,3);
+    pos0=pdf->object[pdf->n-1].ptr[0];
     pdf->imc++;
     fprintf(pdf->f,"<<\n"
                    "/Type /Page\n"
                    "/Parent ");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    pdf->object[pdf->n-1].ptr[1]=ftell(pdf->f);
+    pdf->object[pdf->n-1].ptr[1]=pdffile_tell(pdf);
     fprintf(pdf->f,"%s 0 R\n"
                    "/Resources\n    <<\n",
                    pdf->pae>0 ? "2" : "      ");
@@ -387,14 +409,10 @@ ocrwords->word[i].h);
     /* Execution stream:  draw bitmap and OCR words */
     pdffile_new_object(pdf,0);
     fprintf(pdf->f,"<< /Length ");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptrlen=ftell(pdf->f);
-    fprintf(pdf->f,"         >>\n"
+    ptrlen=pdffile_tell(pdf);
+    fprintf(pdf->f,"             >>\n"
                    "stream\n");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr1=ftell(pdf->f);
+    ptr1=pdffile_tell(pdf);
     if (showbitmap)
         fprintf(pdf->f,"q\n%.1f 0 0 %.1f 0 0 cm\n/Im%d Do\nQ\n",pw,ph,pdf->imc);
     if (ocrwords!=NULL)
@@ -407,16 +425,14 @@ ocrwords->word[i].h);
             use_spaces=1;
         else
             use_spaces=0;
-        ocrwords_to_pdf_stream(ocrwords,pdf->f,dpi,ph,(ocr_render_flags&2)?0:3,cmaplist,use_spaces,
+        ocrwords_to_pdf_stream(ocrwords,pdf,dpi,ph,(ocr_render_flags&2)?0:3,cmaplist,use_spaces,
                                ocr_render_flags);
         /* 2-1-14: Fix memory leak */
         willuscharmaplist_free(cmaplist);
         }
     if (ocr_render_flags&4)
         ocrwords_box(ocrwords,bmp);
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr2=ftell(pdf->f);
+    ptr2=pdffile_tell(pdf);
     fprintf(pdf->f,"endstream\n"
                    "endobj\n");
     insert_length(pdf->f,ptrlen,ptr2-ptr1);
@@ -427,8 +443,189 @@ ocrwords->word[i].h);
         /* Stream the thumbnail */
         pdffile_bmp_stream(pdf,bmp,quality,halfsize,1);
         }
+    wprofile_stop(&timer,"pdfwrite",(double)(wfile_tell(pdf->f)-pos0));
+    }
+
+/*
+** Add a bitmap page whose OCR text is not known yet (v2.56).  The page is
+** written now, but it references a reserved resources object and a reserved
+** text-layer stream that are written later by pdffile_add_deferred_ocrwords()
+** (or left empty by pdffile_finish()).  This lets OCR for many pages run at
+** once without holding up the output file.
+**
+** Returns a handle for pdffile_add_deferred_ocrwords().
+**
+** ocr_render_flags are the same as for pdffile_add_bitmap_with_ocrwords()
+** except that boxes around the text (bit 3) are not supported since they
+** are drawn onto the bitmap.
+*/
+int pdffile_add_bitmap_with_deferred_ocrwords(PDFFILE *pdf,WILLUSBITMAP *bmp,double dpi,
+                                              int quality,int halfsize,int ocr_render_flags)
+
+    {
+    static char *funcname="pdffile_add_bitmap_with_deferred_ocrwords";
+    PDFDEFERREDPAGE *dpage;
+    double pw,ph;
+    int showbitmap;
+    long long ptr1,ptr2,ptrlen,pos0;
+    WPROFILETIMER timer;
+
+    if (pdf->ndp>=pdf->ndpa)
+        {
+        int newsize;
+
+        newsize = pdf->ndpa < 64 ? 128 : pdf->ndpa*2;
+        willus_mem_realloc_robust_warn((void **)&pdf->dpage,newsize*sizeof(PDFDEFERREDPAGE),
+                                       pdf->ndpa*sizeof(PDFDEFERREDPAGE),funcname,10);
+        pdf->ndpa=newsize;
+        }
+    dpage=&pdf->dpage[pdf->ndp];
+    showbitmap = (ocr_render_flags&1);
+    pw=bmp->width*72./dpi;
+    ph=bmp->height*72./dpi;
+
+    wprofile_start(&timer);
+    /* New page object:  resources and text stream objects are reserved right after it */
+    pdffile_new_object(pdf,3);
+    pos0=pdf->object[pdf->n-1].ptr[0];
+    pdf->imc++;
+    dpage->resobj=pdf->n+1;
+    dpage->textobj=pdf->n+2;
+    dpage->imobj=showbitmap ? pdf->n+4 : 0;
+    dpage->imc=pdf->imc;
+    dpage->ocr_render_flags=ocr_render_flags;
+    dpage->dpi=dpi;
+    dpage->ph=ph;
+    fprintf(pdf->f,"<<\n"
+                   "/Type /Page\n"
+                   "/Parent ");
+    pdf->object[pdf->n-1].ptr[1]=pdffile_tell(pdf);
+    fprintf(pdf->f,"%s 0 R\n"
+                   "/Resources %d 0 R\n"
+                   "/MediaBox [0 0 %.1f %.1f]\n"
+                   "/CropBox [0 0 %.1f %.1f]\n"
+                   "/Contents [ %d 0 R %d 0 R ]\n",
+                   pdf->pae>0 ? "2" : "      ",dpage->resobj,
+                   pw,ph,pw,ph,
+                   pdf->n+3,dpage->textobj);
+    if (showbitmap)
+        fprintf(pdf->f,"/Thumb %d 0 R\n",pdf->n+5);
+    fprintf(pdf->f,">>\n"
+                   "endobj\n");
+    pdffile_reserve_object(pdf);
+    pdffile_reserve_object(pdf);
+
+    /* Execution stream:  draw bitmap */
+    pdffile_new_object(pdf,0);
+    fprintf(pdf->f,"<< /Length ");
+    ptrlen=pdffile_tell(pdf);
+    fprintf(pdf->f,"             >>\n"
+                   "stream\n");
+    ptr1=pdffile_tell(pdf);
+    if (showbitmap)
+        fprintf(pdf->f,"q\n%.1f 0 0 %.1f 0 0 cm\n/Im%d Do\nQ\n",pw,ph,pdf->imc);
+    ptr2=pdffile_tell(pdf);
+    fprintf(pdf->f,"endstream\n"
+                   "endobj\n");
+    insert_length(pdf->f,ptrlen,ptr2-ptr1);
+    if (showbitmap)
+        {
+        /* Stream the bitmap */
+        pdffile_bmp_stream(pdf,bmp,quality,halfsize,0);
+        /* Stream the thumbnail */
+        pdffile_bmp_stream(pdf,bmp,quality,halfsize,1);
+        }
+    wprofile_stop(&timer,"pdfwrite",(double)(wfile_tell(pdf->f)-pos0));
+    return(pdf->ndp++);
+    }
+
+
+/*
+** Write the OCR text layer of a page added with
+** pdffile_add_bitmap_with_deferred_ocrwords().  ocrwords may be NULL (no text).
+*/
+void pdffile_add_deferred_ocrwords(PDFFILE *pdf,int handle,OCRWORDS *ocrwords)
+
+    {
+    PDFDEFERREDPAGE *dpage;
+    WILLUSCHARMAPLIST *cmaplist,_cmaplist;
+    int nf;
+    long long ptr1,ptr2,ptrlen,pos0;
+    WPROFILETIMER timer;
+
+    if (handle<0 || handle>=pdf->ndp || pdf->dpage[handle].resobj==0)
+        return;
+    wprofile_start(&timer);
+    dpage=&pdf->dpage[handle];
+    pdf->lastfont=-1;
+    pdf->lastfontsize=-1;
+    fflush(pdf->f);
+    wfile_seek(pdf->f,0,2);
+    pos0=wfile_tell(pdf->f);
+
+    /* Page resources */
+    pdffile_reserved_object_start(pdf,dpage->resobj);
+    fprintf(pdf->f,"<<\n");
+    if (ocrwords!=NULL)
+        {
+        int maxid,ifont;
+
+        cmaplist=&_cmaplist;
+        willuscharmaplist_init(cmaplist);
+        willuscharmaplist_populate(cmaplist,ocrwords);
+        maxid=willuscharmaplist_maxcid(cmaplist);
+        nf=(maxid>>8)&0xfff;
+        fprintf(pdf->f,"    /Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>");
+        for (ifont=1;ifont<=nf;ifont++)
+            fprintf(pdf->f,"\n             /F%d << /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding /ToUnicode %d 0 R >>",ifont+1,pdf->n+ifont);
+        fprintf(pdf->f," >>\n");
+        }
+    else
+        nf=0;
+    if (dpage->imobj>0)
+        fprintf(pdf->f,"    /XObject << /Im%d %d 0 R >>\n"
+                   "    /ProcSet [ /PDF /Text /ImageC ]\n",
+                   dpage->imc,dpage->imobj);
+    fprintf(pdf->f,">>\n"
+                   "endobj\n");
+    if (ocrwords!=NULL)
+        {
+        int i;
+        for (i=0;i<nf;i++)
+            pdffile_unicode_map(pdf,cmaplist,i+1);
+        }
+
+    /* OCR text stream */
+    pdffile_reserved_object_start(pdf,dpage->textobj);
+    fprintf(pdf->f,"<< /Length ");
+    ptrlen=pdffile_tell(pdf);
+    fprintf(pdf->f,"             >>\n"
+                   "stream\n");
+    ptr1=pdffile_tell(pdf);
+    if (ocrwords!=NULL)
+        {
+        int use_spaces,flags;
+
+        flags=dpage->ocr_render_flags;
+        if (flags&16)
+            use_spaces=2;
+        else if (flags&8)
+            use_spaces=1;
+        else
+            use_spaces=0;
+        ocrwords_to_pdf_stream(ocrwords,pdf,dpage->dpi,dpage->ph,(flags&2)?0:3,cmaplist,
+                               use_spaces,flags);
+        willuscharmaplist_free(cmaplist);
+        }
+    ptr2=pdffile_tell(pdf);
+    fprintf(pdf->f,"endstream\n"
+                   "endobj\n");
+    insert_length(pdf->f,ptrlen,ptr2-ptr1);
+    dpage->resobj=0;
+    wprofile_stop(&timer,"pdfwrite",(double)(wfile_tell(pdf->f)-pos0));
     }
 
+
 /*
 ** Example fonts string:
 **     /Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>
@@ -438,10 +635,10 @@ ocrwords->word[i].h);
 void pdffile_add_page_with_stream(PDFFILE *pdf,char *fonts,char *streamtext)
 
     {
-    int ptr1,ptr2,ptrlen;
+    long long ptr1,ptr2,ptrlen;
 
-    lastfont=-1;
-    lastfontsize=-1;
+    pdf->lastfont=-1;
+    pdf->lastfontsize=-1;
 
     /* New page object */
     pdffile_new_object(pdf,3);
@@ -450,9 +647,7 @@ void pdffile_add_page_with_stream(PDFFILE *pdf,char *fonts,char *streamtext)
                    "/MediaBox [0 0 612 792]\n"
                    "/Rotate 0\n"
                    "/Parent ");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    pdf->object[pdf->n-1].ptr[1]=ftell(pdf->f);
+    pdf->object[pdf->n-1].ptr[1]=pdffile_tell(pdf);
     fprintf(pdf->f,"%s 0 R\n"
                    "/Resources\n    <<\n",
                    pdf->pae>0 ? "2" : "      ");
@@ -468,18 +663,12 @@ void pdffile_add_page_with_stream(PDFFILE *pdf,char *fonts,char *streamtext)
     /* Execution stream:  Write the text stream */
     pdffile_new_object(pdf,0);
     fprintf(pdf->f,"<< /Length ");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptrlen=ftell(pdf->f);
-    fprintf(pdf->f,"         >>\n"
+    ptrlen=pdffile_tell(pdf);
+    fprintf(pdf->f,"             >>\n"
                    "stream\n");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr1=ftell(pdf->f);
+    ptr1=pdffile_tell(pdf);
     fprintf(pdf->f,"%s\n",streamtext);
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr2=ftell(pdf->f);
+    ptr2=pdffile_tell(pdf);
     fprintf(pdf->f,"endstream\n"
                    "endobj\n");
     insert_length(pdf->f,ptrlen,ptr2-ptr1);
@@ -508,17 +697,13 @@ static void pdffile_unicode_map(PDFFILE *pdf,WILLUSCHARMAPLIST *cmaplist,int nf)
         }
     if (c>0)
         {
-        int ptr1,ptr2,ptrlen;
+        long long ptr1,ptr2,ptrlen;
 
         fprintf(pdf->f,"<< /Length ");
-        fflush(pdf->f);
-        fseek(pdf->f,0L,1);
-        ptrlen=ftell(pdf->f);
-        fprintf(pdf->f,"         >>\n"
+        ptrlen=pdffile_tell(pdf);
+        fprintf(pdf->f,"             >>\n"
                        "stream\n");
-        fflush(pdf->f);
-        fseek(pdf->f,0L,1);
-        ptr1=ftell(pdf->f);
+        ptr1=pdffile_tell(pdf);
         fprintf(pdf->f,"/CIDInit /ProcSet findresource begin\n"
                        "12 dict begin\n"
                        "begincmap\n"
@@ -542,9 +727,7 @@ static void pdffile_unicode_map(PDFFILE *pdf,WILLUSCHARMAPLIST *cmaplist,int nf)
                        "end\n"
                        "end\n"
                        "endstream\n");
-        fflush(pdf->f);
-        fseek(pdf->f,0L,1);
-        ptr2=ftell(pdf->f);
+        ptr2=pdffile_tell(pdf);
         fprintf(pdf->f,"endstream\n"
                        "endobj\n");
         insert_length(pdf->f,ptrlen,ptr2-ptr1);
@@ -582,8 +765,10 @@ static void thumbnail_create(WILLUSBITMAP *thumb,WILLUSBITMAP *bmp)
 static void pdffile_bmp_stream(PDFFILE *pdf,WILLUSBITMAP *src,int quality,int halfsize,int thumb)
 
     {
-    int ptrlen,ptr1,ptr2,bpc;
+    long long ptrlen,ptr1,ptr2;
+    int bpc,g4,predictor;
     WILLUSBITMAP *bmp,_bmp;
+    WPROFILETIMER timer;
 
     if (thumb)
         {
@@ -597,21 +782,55 @@ static void pdffile_bmp_stream(PDFFILE *pdf,WILLUSBITMAP *src,int quality,int ha
         bpc=8>>halfsize;
     else
         bpc=8;
+    /*
+    ** v2.56:  Bilevel grey images (including -bpc 1) are CCITT Group 4 encoded,
+    ** which is several times smaller than flate for text, unless 1-bit flate
+    ** does better on the first band (dithered or noisy images).
+    */
+    g4 = (quality<=0 && bmp->bpp==8 && bmp_is_grayscale(bmp)
+                     && (bpc==1 || bmp_is_bilevel(bmp)));
+    if (g4)
+        {
+        bpc=1;
+        halfsize=3;
+#ifdef HAVE_Z_LIB
+        g4=g4_beats_flate(pdf,bmp);
+#endif
+        }
+    /*
+    ** v2.56:  PNG row predictors (see pdffile_flate_image()) only go in if they
+    ** make the first band of the image smaller.  They don't for dithered or
+    ** noisy images.
+    */
+    predictor=0;
+#ifdef HAVE_Z_LIB
+    if (!g4 && quality<=0 && bpc==8)
+        predictor=(flate_trial_size(pdf,bmp,halfsize,1) < flate_trial_size(pdf,bmp,halfsize,0));
+#endif
     /* The bitmap */
     pdffile_new_object(pdf,0);
     fprintf(pdf->f,"<<\n");
     if (!thumb)
         fprintf(pdf->f,"/Type /XObject\n"
                        "/Subtype /Image\n");
+    if (g4)
+        fprintf(pdf->f,"/Filter %s/CCITTFaxDecode%s\n"
+                       "/DecodeParms %s<< /K -1 /Columns %d /Rows %d /BlackIs1 false >>%s\n",
+                       thumb?"[ ":"",thumb?" ]":"",
+                       thumb?"[ ":"",bmp->width,bmp->height,thumb?" ]":"");
 #ifdef HAVE_JPEG_LIB
-    if (quality>0)
+    else if (quality>0)
         fprintf(pdf->f,"/Filter %s/DCTDecode%s\n",thumb?"[ ":"",thumb?" ]":"");
 #endif
-#if (defined(HAVE_JPEG_LIB) && defined(HAVE_Z_LIB))
-    else
-#endif
 #ifdef HAVE_Z_LIB
+    else
+        {
         fprintf(pdf->f,"/Filter %s/FlateDecode%s\n",thumb?"[ ":"",thumb?" ]":"");
+        if (predictor)
+            fprintf(pdf->f,"/DecodeParms %s<< /Predictor 15 /Colors %d /BitsPerComponent 8 "
+                           "/Columns %d >>%s\n",
+                           thumb?"[ ":"",bmp->bpp==8?1:3,bmp->width,thumb?" ]":"");
+        }
 #endif
     fprintf(pdf->f,"/Width %d\n"
                    "/Height %d\n"
@@ -621,33 +840,36 @@ static void pdffile_bmp_stream(PDFFILE *pdf,WILLUSBITMAP *src,int quality,int ha
                    bmp->width,bmp->height,
                    bmp->bpp==8?"Gray":"RGB",
                    bpc);
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptrlen=(int)ftell(pdf->f);
-    fprintf(pdf->f,"         \n"
+    ptrlen=pdffile_tell(pdf);
+    fprintf(pdf->f,"             \n"
                    ">>\n"
                    "stream\n");
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr1=(int)ftell(pdf->f);
+    ptr1=pdffile_tell(pdf);
+    wprofile_start(&timer);
+    if (g4)
+        {
+        /* Same threshold as the -bpc 1 flate packing */
+        bmp_write_ccitt_g4_stream(bmp,pdf->f,128);
+        fprintf(pdf->f,"\n");
+        }
 #ifdef HAVE_JPEG_LIB
-    if (quality>0)
+    else if (quality>0)
         {
         bmp_write_jpeg_stream(bmp,pdf->f,quality,NULL);
         fprintf(pdf->f,"\n");
         }
-    else
 #endif
+    else
         {
-        compress_handle h;
-        h=compress_start(pdf->f,7); /* compression level = 7 */
-        bmp_flate_decode(bmp,pdf->f,h,halfsize);
-        compress_done(pdf->f,&h);
+#ifdef HAVE_Z_LIB
+        pdffile_flate_image(pdf,bmp,halfsize,predictor);
+#else
+        bmp_flate_decode(bmp,pdf->f,halfsize);
+#endif
         fprintf(pdf->f,"\n");
         }
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr2=(int)ftell(pdf->f)-1;
+    ptr2=pdffile_tell(pdf)-1;
+    wprofile_stop(&timer,g4 ? "ccitt" : (quality>0 ? "jpeg" : "flate"),(double)(ptr2-ptr1));
     fprintf(pdf->f,"endstream\nendobj\n");
     insert_length(pdf->f,ptrlen,ptr2-ptr1);
     if (thumb)
@@ -657,108 +879,525 @@ static void pdffile_bmp_stream(PDFFILE *pdf,WILLUSBITMAP *src,int quality,int ha
 
 
 /*
+** Bytes in each row of bmp as stored in the PDF image stream.
+**
 ** halfsize==0 for 8-bits per color plane
 **         ==1 for 4-bits per color plane
 **         ==2 for 2-bits per color plane
 **         ==3 for 1-bit  per color plane
-**
-** To do:  Check for errors when writing
 */
-static void bmp_flate_decode(WILLUSBITMAP *bmp,FILE *f,compress_handle handle,int halfsize)
+static int bmp_packed_row_bytes(WILLUSBITMAP *bmp,int halfsize)
 
     {
-    int row;
-    static char *funcname="bmp_flate_decode";
+    int nb;
 
+    nb=bmp->bpp==8 ? bmp->width : bmp->width*3;
+    if (halfsize==1)
+        return((nb+1)/2);
+    if (halfsize==2)
+        return((nb+3)/4);
+    if (halfsize==3)
+        return((nb+7)/8);
+    return(nb);
+    }
+
+
+/*
+** Pack row of bmp into dst (bmp_packed_row_bytes() bytes) per halfsize
+** (see bmp_packed_row_bytes()).
+*/
+static void bmp_pack_row(unsigned char *dst,WILLUSBITMAP *bmp,int row,int halfsize)
+
+    {
+    int i,j,k,nb,w2;
+    unsigned char *p;
+
+    nb=bmp->bpp==8 ? bmp->width : bmp->width*3;
+    w2=bmp_packed_row_bytes(bmp,halfsize);
+    p=bmp_rowptr_from_top(bmp,row);
     if (halfsize==1)
         {
-        int w2,nb;
-        unsigned char *data;
-        nb=bmp->bpp==8 ? bmp->width : bmp->width*3;
-        w2=(nb+1)/2;
-        willus_mem_alloc_warn((void **)&data,w2,funcname,10);
-        for (row=0;row<bmp->height;row++)
-            {
-            int i;
-            unsigned char *p;
-            p=bmp_rowptr_from_top(bmp,row);
-            for (i=0;i<w2-1;i++,p+=2)
-                data[i]=(p[0] & 0xf0) | (p[1] >> 4);
-            if (nb&1)
-                data[i]=p[0]&0xf0;
-            else
-                data[i]=(p[0]&0xf0) | (p[1] >> 4);
-            compress_write(f,handle,data,w2);
-            }
-        willus_mem_free((double **)&data,funcname);
+        for (i=0;i<w2-1;i++,p+=2)
+            dst[i]=(p[0] & 0xf0) | (p[1] >> 4);
+        if (nb&1)
+            dst[i]=p[0]&0xf0;
+        else
+            dst[i]=(p[0]&0xf0) | (p[1] >> 4);
         }
     else if (halfsize==2)
         {
-        int w2,nb;
-        unsigned char *data;
-        nb=bmp->bpp==8 ? bmp->width : bmp->width*3;
-        w2=(nb+3)/4;
-        willus_mem_alloc_warn((void **)&data,w2,funcname,10);
-        for (row=0;row<bmp->height;row++)
-            {
-            int i,j,k;
-            unsigned char *p;
-            p=bmp_rowptr_from_top(bmp,row);
-            for (i=0;i<w2-1;i++,p+=4)
-                data[i]=(p[0] & 0xc0) | ((p[1] >> 2)&0x30) | ((p[2]>>4)&0xc) | (p[3]>>6);
-            data[i]=0;
-            j=(nb&3);
-            if (j==0)
-                j=4;
-            for (k=0;k<j;k++)
-                data[i]|=((p[k]&0xc0)>>(k*2));
-            compress_write(f,handle,data,w2);
-            }
-        willus_mem_free((double **)&data,funcname);
+        for (i=0;i<w2-1;i++,p+=4)
+            dst[i]=(p[0] & 0xc0) | ((p[1] >> 2)&0x30) | ((p[2]>>4)&0xc) | (p[3]>>6);
+        dst[i]=0;
+        j=(nb&3);
+        if (j==0)
+            j=4;
+        for (k=0;k<j;k++)
+            dst[i]|=((p[k]&0xc0)>>(k*2));
         }
     else if (halfsize==3)
         {
-        int w2,nb;
-        unsigned char *data;
-        nb=bmp->bpp==8 ? bmp->width : bmp->width*3;
-        w2=(nb+7)/8;
-        willus_mem_alloc_warn((void **)&data,w2,funcname,10);
-        for (row=0;row<bmp->height;row++)
+        for (i=0;i<w2-1;i++,p+=8)
+            dst[i]=(p[0] & 0x80) | ((p[1]&0x80) >> 1)
+                                 | ((p[2]&0x80) >> 2)
+                                 | ((p[3]&0x80) >> 3)
+                                 | ((p[4]&0x80) >> 4)
+                                 | ((p[5]&0x80) >> 5)
+                                 | ((p[6]&0x80) >> 6)
+                                 | ((p[7]&0x80) >> 7);
+        dst[i]=0;
+        j=(nb&7);
+        if (j==0)
+            j=8;
+        for (k=0;k<j;k++)
+            dst[i]|=((p[k]&0x80)>>k);
+        }
+    else
+        memcpy(dst,p,nb);
+    }
+
+
+#ifdef HAVE_Z_LIB
+/*
+** v2.56:  Flate-encoded images are compressed by up to pdf->nthreads threads.
+** The rows are split into bands and each band is deflated into memory by its
+** own thread, like pigz does it:  each band is primed with the last 32K of
+** the (filtered) band above it and ends with a sync flush (the last band is
+** finished), so the bands joined together behind one zlib header make a
+** single zlib stream.
+**
+** With predictor!=0 (8-bit rows only), the rows are PNG filtered
+** (/Predictor 15) using the filter that gives the smallest sum of absolute
+** differences (the usual PNG heuristic).  This makes grey and photo-like
+** images noticeably smaller, but dithered or noisy ones bigger, so
+** pdffile_bmp_stream() decides per image using flate_trial_size().  Rows with
+** fewer bits per color are never filtered--as with PNG, they compress worse.
+*/
+#define FLATE_LEVEL          7
+#define FLATE_MIN_BAND_BYTES (1<<20)
+#define FLATE_TRIAL_BYTES    FLATE_MIN_BAND_BYTES
+#define FLATE_WINDOW         32768
+#define FLATE_MAX_STORED     65535
+
+typedef struct
+    {
+    WILLUSBITMAP *bmp;
+    int halfsize;
+    int rowbytes;   /* Packed bytes per row (not counting filter byte) */
+    int predictor;  /* Non-zero to PNG filter the rows */
+    int n;          /* Bytes per row in the stream */
+    int bpp;        /* Bytes per pixel for the PNG predictors */
+    int r1,r2;      /* Rows r1 to r2-1 are in this band */
+    int last;
+    unsigned char *out;
+    size_t nout;
+    uLong adler;    /* Adler-32 of the (filtered) rows in this band */
+    } FLATEBAND;
+
+
+/*
+** Number of bands (threads) pdffile_flate_image() splits bmp into.
+*/
+static int flate_band_count(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize)
+
+    {
+    double nbytes;
+    int nb;
+
+    nbytes=(double)bmp_packed_row_bytes(bmp,halfsize)*bmp->height;
+    nb=pdf->nthreads;
+    if (nb > nbytes/FLATE_MIN_BAND_BYTES)
+        nb=nbytes/FLATE_MIN_BAND_BYTES;
+    if (nb > bmp->height)
+        nb=bmp->height;
+    if (nb<1)
+        nb=1;
+    return(nb);
+    }
+
+
+/*
+** v2.56:  Rows in the first band of bmp (at most FLATE_TRIAL_BYTES of it).
+*/
+static int flate_trial_rows(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize)
+
+    {
+    int rows,maxrows;
+
+    rows=bmp->height/flate_band_count(pdf,bmp,halfsize);
+    maxrows=FLATE_TRIAL_BYTES/bmp_packed_row_bytes(bmp,halfsize)+1;
+    return(rows>maxrows ? maxrows : rows);
+    }
+
+
+/*
+** v2.56:  Compressed size of the first band of bmp as pdffile_flate_image()
+** would write it.
+*/
+static size_t flate_trial_size(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize,int predictor)
+
+    {
+    static char *funcname="flate_trial_size";
+    FLATEBAND _band,*band;
+
+    band=&_band;
+    band->bmp=bmp;
+    band->halfsize=halfsize;
+    band->rowbytes=bmp_packed_row_bytes(bmp,halfsize);
+    band->predictor=predictor;
+    band->n=band->rowbytes+predictor;
+    band->bpp=bmp->bpp==8 ? 1 : 3;
+    band->r1=0;
+    band->r2=flate_trial_rows(pdf,bmp,halfsize);
+    band->last=1;
+    flateband_deflate(band);
+    willus_mem_free((double **)&band->out,funcname);
+    return(band->nout);
+    }
+
+
+/*
+** v2.56:  Non-zero if CCITT G4 encodes the first band of bilevel bmp in no
+** more bytes than 1-bit flate does.  G4 can be twice the size of flate on
+** dithered or noisy images.
+*/
+static int g4_beats_flate(PDFFILE *pdf,WILLUSBITMAP *bmp)
+
+    {
+    WILLUSBITMAP _band,*band;
+    long ng4;
+
+    band=&_band;
+    (*band)=(*bmp);
+    band->height=flate_trial_rows(pdf,bmp,3);
+    if (bmp->type==WILLUSBITMAP_TYPE_WIN32)
+        band->data=bmp_rowptr_from_top(bmp,band->height-1);
+    ng4=bmp_write_ccitt_g4_stream(band,NULL,128);
+    return((size_t)ng4 <= flate_trial_size(pdf,bmp,3,0));
+    }
+
+
+static void pdffile_flate_image(PDFFILE *pdf,WILLUSBITMAP *bmp,int halfsize,int predictor)
+
+    {
+    static char *funcname="pdffile_flate_image";
+    FLATEBAND *band;
+    pthread_t *thread;
+    int *started;
+    int i,nb,rowbytes;
+    uLong adler;
+    unsigned char hdr[4];
+
+    rowbytes=bmp_packed_row_bytes(bmp,halfsize);
+    nb=flate_band_count(pdf,bmp,halfsize);
+    willus_mem_alloc_warn((void **)&band,sizeof(FLATEBAND)*nb,funcname,10);
+    willus_mem_alloc_warn((void **)&thread,sizeof(pthread_t)*nb,funcname,10);
+    willus_mem_alloc_warn((void **)&started,sizeof(int)*nb,funcname,10);
+    for (i=0;i<nb;i++)
+        {
+        band[i].bmp=bmp;
+        band[i].halfsize=halfsize;
+        band[i].rowbytes=rowbytes;
+        band[i].predictor=predictor;
+        band[i].n=rowbytes+band[i].predictor;
+        band[i].bpp=bmp->bpp==8 ? 1 : 3;
+        band[i].r1=(int)((double)bmp->height*i/nb);
+        band[i].r2=(int)((double)bmp->height*(i+1)/nb);
+        band[i].last=(i==nb-1);
+        started[i]=0;
+        }
+    /* This thread does the first band */
+    for (i=1;i<nb;i++)
+        started[i]=(pthread_create(&thread[i],NULL,flateband_deflate,&band[i])==0);
+    flateband_deflate(&band[0]);
+    for (i=1;i<nb;i++)
+        {
+        if (started[i])
+            pthread_join(thread[i],NULL);
+        else
+            flateband_deflate(&band[i]);
+        }
+    /* zlib header (deflate, 32K window, compression level 7) */
+    hdr[0]=0x78;
+    hdr[1]=0xda;
+    fwrite(hdr,1,2,pdf->f);
+    adler=adler32(0L,Z_NULL,0);
+    for (i=0;i<nb;i++)
+        {
+        fwrite(band[i].out,1,band[i].nout,pdf->f);
+        adler=adler32_combine(adler,band[i].adler,
+                              (z_off_t)band[i].n*(band[i].r2-band[i].r1));
+        willus_mem_free((double **)&band[i].out,funcname);
+        }
+    for (i=0;i<4;i++)
+        hdr[i]=(adler>>(24-8*i))&0xff;
+    fwrite(hdr,1,4,pdf->f);
+    willus_mem_free((double **)&started,funcname);
+    willus_mem_free((double **)&thread,funcname);
+    willus_mem_free((double **)&band,funcname);
+    }
+
+
+/*
+** Raw-deflate one band of rows into band->out.  Can be run as a thread.
+*/
+static void *flateband_deflate(void *data)
+
+    {
+    static char *funcname="flateband_deflate";
+    FLATEBAND *band;
+    z_stream zs;
+    unsigned char *cur,*prev,*filt,*dict;
+    size_t nalloc;
+    int n,r,r0,status,zok;
+
+    band=(FLATEBAND *)data;
+    n=band->n;
+    willus_mem_alloc_warn((void **)&cur,band->rowbytes,funcname,10);
+    willus_mem_alloc_warn((void **)&prev,band->rowbytes,funcname,10);
+    memset(&zs,0,sizeof(z_stream));
+    /* v2.56:  If zlib can't start (out of memory), store the rows uncompressed */
+    zok=(deflateInit2(&zs,FLATE_LEVEL,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)==Z_OK);
+    if (!zok)
+        printf("WILLUS lib %s:  deflateInit2() failed--image rows stored uncompressed.\n",
+               willuslibversion());
+    /* Filter enough rows above the band to prime the compressor with */
+    r0 = band->r1 - (FLATE_WINDOW+n-1)/n;
+    if (r0<0)
+        r0=0;
+    if (r0>0)
+        bmp_pack_row(prev,band->bmp,r0-1,band->halfsize);
+    else
+        memset(prev,0,band->rowbytes);
+    willus_mem_alloc_warn((void **)&dict,(size_t)n*(band->r1-r0+1),funcname,10);
+    for (r=r0;r<band->r1;r++)
+        flateband_row(band,&dict[(size_t)n*(r-r0)],r,&cur,&prev);
+    if (zok && band->r1>r0)
+        {
+        size_t nd;
+
+        nd=(size_t)n*(band->r1-r0);
+        if (nd>FLATE_WINDOW)
+            deflateSetDictionary(&zs,&dict[nd-FLATE_WINDOW],FLATE_WINDOW);
+        else
+            deflateSetDictionary(&zs,dict,nd);
+        }
+    filt=dict;
+    if (zok)
+        nalloc=deflateBound(&zs,(uLong)n*(band->r2-band->r1))+64;
+    else
+        nalloc=(size_t)(n+5)*(band->r2-band->r1+1);
+    willus_mem_alloc_warn((void **)&band->out,nalloc,funcname,10);
+    zs.next_out=band->out;
+    zs.avail_out=nalloc;
+    band->nout=0;
+    band->adler=adler32(0L,Z_NULL,0);
+    for (r=band->r1;r<=band->r2;r++)
+        {
+        int flush;
+
+        if (!zok)
             {
-            int i,j,k;
-            unsigned char *p;
-            p=bmp_rowptr_from_top(bmp,row);
-            for (i=0;i<w2-1;i++,p+=8)
-                data[i]=(p[0] & 0x80) | ((p[1]&0x80) >> 1)
-                                      | ((p[2]&0x80) >> 2)
-                                      | ((p[3]&0x80) >> 3)
-                                      | ((p[4]&0x80) >> 4)
-                                      | ((p[5]&0x80) >> 5)
-                                      | ((p[6]&0x80) >> 6)
-                                      | ((p[7]&0x80) >> 7);
-            data[i]=0;
-            j=(nb&7);
-            if (j==0)
-                j=8;
-            for (k=0;k<j;k++)
-                data[i]|=((p[k]&0x80)>>k);
-            compress_write(f,handle,data,w2);
+            if (r<band->r2)
+                {
+                flateband_row(band,filt,r,&cur,&prev);
+                band->adler=adler32(band->adler,filt,n);
+                flateband_store(band,&nalloc,filt,n,0);
+                }
+            else if (band->last)
+                flateband_store(band,&nalloc,filt,0,1);
+            continue;
+            }
+        if (r<band->r2)
+            {
+            flateband_row(band,filt,r,&cur,&prev);
+            band->adler=adler32(band->adler,filt,n);
+            zs.next_in=filt;
+            zs.avail_in=n;
+            flush=Z_NO_FLUSH;
+            }
+        else
+            {
+            zs.next_in=filt;
+            zs.avail_in=0;
+            flush=band->last ? Z_FINISH : Z_SYNC_FLUSH;
+            }
+        /* Make more room in the output buffer as needed */
+        while (1)
+            {
+            status=deflate(&zs,flush);
+            if (zs.avail_out>0 || status==Z_STREAM_END || status==Z_STREAM_ERROR)
+                break;
+            willus_mem_realloc_robust_warn((void **)&band->out,2*nalloc,nalloc,funcname,10);
+            zs.next_out=&band->out[nalloc];
+            zs.avail_out=nalloc;
+            nalloc*=2;
             }
-        willus_mem_free((double **)&data,funcname);
         }
-    else
+    if (zok)
         {
+        band->nout=nalloc-zs.avail_out;
+        deflateEnd(&zs);
+        }
+    willus_mem_free((double **)&dict,funcname);
+    willus_mem_free((double **)&prev,funcname);
+    willus_mem_free((double **)&cur,funcname);
+    return(NULL);
+    }
+
+
+/*
+** Append n bytes of data to band->out (band->nout bytes used of *nalloc) as
+** stored (uncompressed) deflate blocks.  final!=0 makes the last block the
+** end of the deflate stream.  Stored blocks are byte aligned, so they join
+** up with the sync-flushed bands around them.
+*/
+static void flateband_store(void *data,size_t *nalloc,unsigned char *src,int n,int final)
+
+    {
+    static char *funcname="flateband_store";
+    FLATEBAND *band;
+
+    band=(FLATEBAND *)data;
+    do
+        {
+        unsigned char *p;
         int nb;
-        nb=bmp->bpp==8 ? bmp->width : bmp->width*3;
-        for (row=0;row<bmp->height;row++)
+
+        nb = n>FLATE_MAX_STORED ? FLATE_MAX_STORED : n;
+        if (band->nout+nb+5 > (*nalloc))
+            {
+            willus_mem_realloc_robust_warn((void **)&band->out,2*(*nalloc)+nb+5,(*nalloc),
+                                           funcname,10);
+            (*nalloc) = 2*(*nalloc)+nb+5;
+            }
+        p=&band->out[band->nout];
+        p[0]=(final && nb==n) ? 1 : 0;
+        p[1]=nb&0xff;
+        p[2]=(nb>>8)&0xff;
+        p[3]=(~nb)&0xff;
+        p[4]=((~nb)>>8)&0xff;
+        memcpy(&p[5],src,nb);
+        band->nout += nb+5;
+        src += nb;
+        n -= nb;
+        } while (n>0);
+    }
+
+
+/*
+** Put row of the band's bitmap into dst as it goes into the stream.
+** (*prev) must hold the packed row above it, and the packed row is returned
+** in (*prev).
+*/
+static void flateband_row(void *data,unsigned char *dst,int row,unsigned char **cur,
+                          unsigned char **prev)
+
+    {
+    FLATEBAND *band;
+    unsigned char *t;
+
+    band=(FLATEBAND *)data;
+    if (!band->predictor)
+        {
+        bmp_pack_row(dst,band->bmp,row,band->halfsize);
+        return;
+        }
+    bmp_pack_row((*cur),band->bmp,row,band->halfsize);
+    png_filter_row(dst,(*cur),(*prev),band->rowbytes,band->bpp);
+    t=(*prev);
+    (*prev)=(*cur);
+    (*cur)=t;
+    }
+
+
+/*
+** PNG-filter row (n bytes, bpp bytes per pixel, prev = row above) into dst
+** (filter type byte followed by n bytes).
+*/
+static void png_filter_row(unsigned char *dst,unsigned char *row,unsigned char *prev,int n,
+                           int bpp)
+
+    {
+    int i,f,best;
+    long sum[5];
+
+    for (f=0;f<5;f++)
+        sum[f]=0;
+    for (i=0;i<n;i++)
+        {
+        int a,b,c,p,pa,pb,pc,x;
+
+        x=row[i];
+        a = i>=bpp ? row[i-bpp] : 0;
+        b = prev[i];
+        c = i>=bpp ? prev[i-bpp] : 0;
+        p=a+b-c;
+        pa=abs(p-a);
+        pb=abs(p-b);
+        pc=abs(p-c);
+        p = (pa<=pb && pa<=pc) ? a : (pb<=pc ? b : c);
+        sum[0] += abs((signed char)x);
+        sum[1] += abs((signed char)(x-a));
+        sum[2] += abs((signed char)(x-b));
+        sum[3] += abs((signed char)(x-((a+b)>>1)));
+        sum[4] += abs((signed char)(x-p));
+        }
+    for (best=0,f=1;f<5;f++)
+        if (sum[f]<sum[best])
+            best=f;
+    dst[0]=best;
+    dst++;
+    for (i=0;i<n;i++)
+        {
+        int a,b,c,p,pa,pb,pc;
+
+        a = i>=bpp ? row[i-bpp] : 0;
+        b = prev[i];
+        c = i>=bpp ? prev[i-bpp] : 0;
+        if (best==0)
+            p=0;
+        else if (best==1)
+            p=a;
+        else if (best==2)
+            p=b;
+        else if (best==3)
+            p=(a+b)>>1;
+        else
             {
-            unsigned char *p;
-            p=bmp_rowptr_from_top(bmp,row);
-            compress_write(f,handle,p,nb);
+            p=a+b-c;
+            pa=abs(p-a);
+            pb=abs(p-b);
+            pc=abs(p-c);
+            p = (pa<=pb && pa<=pc) ? a : (pb<=pc ? b : c);
             }
+        dst[i]=row[i]-p;
         }
     }
 
+#else /* HAVE_Z_LIB */
+
+/*
+** No zlib:  write the image uncompressed.
+*/
+static void bmp_flate_decode(WILLUSBITMAP *bmp,FILE *f,int halfsize)
+
+    {
+    static char *funcname="bmp_flate_decode";
+    unsigned char *data;
+    int row,w2;
+
+    w2=bmp_packed_row_bytes(bmp,halfsize);
+    willus_mem_alloc_warn((void **)&data,w2,funcname,10);
+    for (row=0;row<bmp->height;row++)
+        {
+        bmp_pack_row(data,bmp,row,halfsize);
+        fwrite(data,1,w2,f);
+        }
+    willus_mem_free((double **)&data,funcname);
+    }
+#endif /* HAVE_Z_LIB */
+
 
 void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *cdate)
 
@@ -766,7 +1405,7 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
     int icat,i,pagecount;
     time_t now;
     struct tm today;
-    size_t ptr;
+    long long ptr;
     char nbuf[12];
     char buf[128];
     char mdate[128];
@@ -775,6 +1414,10 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
     time(&now);
     today=(*localtime(&now));
 
+    /* v2.56:  Any deferred OCR text layers that never got written are left empty */
+    for (i=0;i<pdf->ndp;i++)
+        pdffile_add_deferred_ocrwords(pdf,i,NULL);
+
     /* Insert outline reference if available */
     for (i=0;i<pdf->n;i++)
         if (pdf->object[i].flags&4)
@@ -782,20 +1425,20 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
     if (i<pdf->n)
         {
         fflush(pdf->f);
-        fseek(pdf->f,pdf->object[0].ptr[2],0);
+        wfile_seek(pdf->f,pdf->object[0].ptr[2],0);
         sprintf(nbuf,"%6d",i+1);
         fwrite(nbuf,1,6,pdf->f);
         }
     else
         {
         fflush(pdf->f);
-        fseek(pdf->f,pdf->object[0].ptr[2]-10,0);
+        wfile_seek(pdf->f,pdf->object[0].ptr[2]-10,0);
         strcpy(nbuf,"%% ");
         fwrite(nbuf,1,3,pdf->f);
         }
         
     ptr=0; /* Avoid compiler warning */
-    fseek(pdf->f,0L,2);
+    wfile_seek(pdf->f,0,2);
     if (pdf->pae==0)
         {
         pdffile_new_object(pdf,0);
@@ -806,11 +1449,9 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
         }
     else
         {
-        fflush(pdf->f);
-        fseek(pdf->f,0L,1);
-        ptr=ftell(pdf->f);
+        ptr=pdffile_tell(pdf);
         icat=pdf->n;
-        fseek(pdf->f,pdf->pae,0);
+        wfile_seek(pdf->f,pdf->pae,0);
         }
     for (pagecount=i=0;i<pdf->n;i++)
         if (pdf->object[i].flags&1)
@@ -830,7 +1471,7 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
                    "endobj\n",pagecount);
     if (pdf->pae > 0)
         {
-        fseek(pdf->f,ptr,0);
+        wfile_seek(pdf->f,ptr,0);
         }
 
     pdffile_new_object(pdf,0);
@@ -860,24 +1501,31 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
                    cdate!=NULL && cdate[0]!='\0' ? cdate : mdate,
                    mdate,
                    producer==NULL ? buf : producer);
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    ptr=ftell(pdf->f);
-    /* Kindles require the space after the 'f' and 'n' in the lines below. */
-    fprintf(pdf->f,"xref\n"
-                   "0 %d\n"
-                   "0000000000 65535 f \n",pdf->n+1);
-    for (i=0;i<pdf->n;i++)
-        fprintf(pdf->f,"%010d 00000 n \n",(int)pdf->object[i].ptr[0]);
-    fprintf(pdf->f,"trailer\n"
-                   "<<\n"
-                   "/Size %d\n"
-                   "/Info %d 0 R\n"
-                   "/Root 1 0 R\n"
-                   ">>\n"
-                   "startxref\n"
-                   "%d\n"
-                   "%%%%EOF\n",pdf->n+1,pdf->n,(int)ptr);
+    ptr=pdffile_tell(pdf);
+    /*
+    ** v2.56:  The 10-digit offsets in an xref table only go to 10 GB, so use
+    ** an xref stream for anything bigger.
+    */
+    if (pdf->xref_stream || ptr>9999999999LL)
+        pdffile_xref_stream(pdf,pdf->n);
+    else
+        {
+        /* Kindles require the space after the 'f' and 'n' in the lines below. */
+        fprintf(pdf->f,"xref\n"
+                       "0 %d\n"
+                       "0000000000 65535 f \n",pdf->n+1);
+        for (i=0;i<pdf->n;i++)
+            fprintf(pdf->f,"%010lld 00000 n \n",pdf->object[i].ptr[0]);
+        fprintf(pdf->f,"trailer\n"
+                       "<<\n"
+                       "/Size %d\n"
+                       "/Info %d 0 R\n"
+                       "/Root 1 0 R\n"
+                       ">>\n"
+                       "startxref\n"
+                       "%lld\n"
+                       "%%%%EOF\n",pdf->n+1,pdf->n,ptr);
+        }
     /*
     ** Go back and put in catalog block references
     */
@@ -887,7 +1535,7 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
         for (i=0;i<pdf->n;i++)
             if (pdf->object[i].flags&2)
                 {
-                fseek(pdf->f,pdf->object[i].ptr[1],0);
+                wfile_seek(pdf->f,pdf->object[i].ptr[1],0);
                 fwrite(nbuf,1,6,pdf->f);
                 }
         }
@@ -896,20 +1544,139 @@ void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *c
     }
 
 
+/*
+** v2.56:  Cross-reference stream (PDF 1.5) written as the last object, in
+** place of the xref table and trailer.  Each entry is a 1-byte type, an
+** offset of as many bytes as the largest offset needs, and a 2-byte
+** generation number, so any file size works, and the (flate compressed)
+** entries take a few bytes per object instead of 20.
+*/
+static void pdffile_xref_stream(PDFFILE *pdf,int infoobj)
+
+    {
+    static char *funcname="pdffile_xref_stream";
+    unsigned char *xref;
+    long long ptr,ptrlen,ptr1,ptr2;
+    int i,j,nb,ne,n;
+
+    pdffile_new_object(pdf,0);
+    ptr=pdf->object[pdf->n-1].ptr[0];
+    for (nb=4;nb<8 && (ptr>>(8*nb))!=0;nb++);
+    ne=nb+3;
+    n=pdf->n+1;
+    willus_mem_alloc_warn((void **)&xref,(size_t)n*ne,funcname,10);
+    /* Object 0 is the head of the (empty) free list, generation 65535 */
+    memset(xref,0,ne);
+    xref[ne-2]=xref[ne-1]=0xff;
+    for (i=1;i<n;i++)
+        {
+        unsigned char *p;
+
+        p=&xref[(size_t)i*ne];
+        p[0]=1;
+        for (j=0;j<nb;j++)
+            p[nb-j]=(pdf->object[i-1].ptr[0]>>(8*j))&0xff;
+        p[nb+1]=p[nb+2]=0;
+        }
+    fprintf(pdf->f,"<<\n"
+                   "/Type /XRef\n"
+                   "/Size %d\n"
+                   "/W [1 %d 2]\n"
+                   "/Root 1 0 R\n"
+                   "/Info %d 0 R\n",n,nb,infoobj);
+#ifdef HAVE_Z_LIB
+    {
+    unsigned char *zbuf;
+    uLongf nz;
+
+    nz=compressBound((uLong)n*ne);
+    willus_mem_alloc_warn((void **)&zbuf,nz,funcname,10);
+    if (compress2(zbuf,&nz,xref,(uLong)n*ne,Z_BEST_COMPRESSION)==Z_OK)
+        {
+        willus_mem_free((double **)&xref,funcname);
+        xref=zbuf;
+        ne=(int)nz;
+        n=1;
+        fprintf(pdf->f,"/Filter /FlateDecode\n");
+        }
+    else
+        willus_mem_free((double **)&zbuf,funcname);
+    }
+#endif
+    fprintf(pdf->f,"/Length ");
+    ptrlen=pdffile_tell(pdf);
+    fprintf(pdf->f,"             \n"
+                   ">>\n"
+                   "stream\n");
+    ptr1=pdffile_tell(pdf);
+    fwrite(xref,1,(size_t)n*ne,pdf->f);
+    ptr2=pdffile_tell(pdf);
+    fprintf(pdf->f,"\nendstream\n"
+                   "endobj\n"
+                   "startxref\n"
+                   "%lld\n"
+                   "%%%%EOF\n",ptr);
+    insert_length(pdf->f,ptrlen,ptr2-ptr1);
+    willus_mem_free((double **)&xref,funcname);
+    /* Xref streams need PDF 1.5 (same length as the "%PDF-1.3" header) */
+    fflush(pdf->f);
+    wfile_seek(pdf->f,0,0);
+    fprintf(pdf->f,"%%PDF-1.5");
+    fflush(pdf->f);
+    wfile_seek(pdf->f,0,2);
+    }
+
+
+/*
+** v2.56:  Current position in the output file (64-bit)
+*/
+static long long pdffile_tell(PDFFILE *pdf)
+
+    {
+    fflush(pdf->f);
+    wfile_seek(pdf->f,0,1);
+    return(wfile_tell(pdf->f));
+    }
+
+
 static void pdffile_new_object(PDFFILE *pdf,int flags)
 
     {
     PDFOBJECT obj;
 
-    fflush(pdf->f);
-    fseek(pdf->f,0L,1);
-    obj.ptr[0]=obj.ptr[1]=ftell(pdf->f);
+    obj.ptr[0]=obj.ptr[1]=pdffile_tell(pdf);
     obj.flags=flags;
     pdffile_add_object(pdf,&obj);
     fprintf(pdf->f,"%d 0 obj\n",pdf->n);
     }
 
 
+/*
+** Reserve the next object number.  The object is written later with
+** pdffile_reserved_object_start().
+*/
+static void pdffile_reserve_object(PDFFILE *pdf)
+
+    {
+    PDFOBJECT obj;
+
+    obj.ptr[0]=obj.ptr[1]=obj.ptr[2]=0;
+    obj.flags=0;
+    pdffile_add_object(pdf,&obj);
+    }
+
+
+/*
+** Start writing a reserved object at the current file position
+*/
+static void pdffile_reserved_object_start(PDFFILE *pdf,int objnum)
+
+    {
+    pdf->object[objnum-1].ptr[0]=pdf->object[objnum-1].ptr[1]=pdffile_tell(pdf);
+    fprintf(pdf->f,"%d 0 obj\n",objnum);
+    }
+
+
 static void pdffile_add_object(PDFFILE *pdf,PDFOBJECT *object)
 
     {
@@ -1102,21 +1869,24 @@ static int wpdf_getbufline(char *buf,int maxlen,char *opbuf,int *i0,int bufsize)
 #endif /* HAVE_Z_LIB */
 
 
-static void insert_length(FILE *f,long pos,int len)
+/*
+** Write len into the blank /Length field at pos (v2.56:  12 digits max).
+*/
+static void insert_length(FILE *f,long long pos,long long len)
 
     {
-    long ptr;
+    long long ptr;
     int i;
     char nbuf[64];
 
     fflush(f);
-    fseek(f,0L,1);
-    ptr=ftell(f);
-    fseek(f,pos,0);
-    sprintf(nbuf,"%d",len);
-    for (i=0;i<8 && nbuf[i]!='\0';i++)
+    wfile_seek(f,0,1);
+    ptr=wfile_tell(f);
+    wfile_seek(f,pos,0);
+    sprintf(nbuf,"%lld",len);
+    for (i=0;i<12 && nbuf[i]!='\0';i++)
         fputc(nbuf[i],f);
-    fseek(f,ptr,0);
+    wfile_seek(f,ptr,0);
     }
 
 
@@ -1175,14 +1945,16 @@ void ocrwords_box(OCRWORDS *ocrwords,WILLUSBITMAP *bmp)
     }
 
 
-static void ocrwords_to_pdf_stream(OCRWORDS *ocrwords,FILE *f,double dpi,
+static void ocrwords_to_pdf_stream(OCRWORDS *ocrwords,PDFFILE *pdf,double dpi,
                                    double page_height_pts,int text_render_mode,
                                    WILLUSCHARMAPLIST *cmaplist,int use_spaces,int ocr_flags)
 
     {
     int i;
     double median_size;
+    FILE *f;
 
+    f=pdf->f;
     fprintf(f,"BT\n%d Tr\n",text_render_mode);
     median_size=ocrwords_median_size(ocrwords,dpi,cmaplist);
     if (use_spaces)
@@ -1197,7 +1969,7 @@ static void ocrwords_to_pdf_stream(OCRWORDS *ocrwords,FILE *f,double dpi,
                 ocrword_init(&word);
                 ocrwords_optimize_spaces(&word,&ocrwords->word[i1],i-i1+1,dpi,cmaplist,
                                          use_spaces==2 ? 1 : 0);
-                ocrword_to_pdf_stream(&word,f,dpi,page_height_pts,median_size,cmaplist,ocr_flags);
+                ocrword_to_pdf_stream(&word,pdf,dpi,page_height_pts,median_size,cmaplist,ocr_flags);
                 ocrword_free(&word);
                 i1=i+1;
                 }
@@ -1205,7 +1977,7 @@ static void ocrwords_to_pdf_stream(OCRWORDS *ocrwords,FILE *f,double dpi,
         }
     else
         for (i=0;i<ocrwords->n;i++)
-            ocrword_to_pdf_stream(&ocrwords->word[i],f,dpi,page_height_pts,median_size,cmaplist,
+            ocrword_to_pdf_stream(&ocrwords->word[i],pdf,dpi,page_height_pts,median_size,cmaplist,
                                   ocr_flags);
     fprintf(f,"ET\n");
     }
@@ -1215,7 +1987,7 @@ static double ocrwords_median_size(OCRWORDS *ocrwords,double dpi,WILLUSCHARMAPLI
 
     {
     static char *funcname="ocrwords_to_histogram";
-    static double *fontsize_hist;
+    double *fontsize_hist;
     double msize;
     int i;
 
@@ -1524,7 +2296,7 @@ printf("\n");
     }
 
 
-static void ocrword_to_pdf_stream(OCRWORD *word,FILE *f,double dpi,
+static void ocrword_to_pdf_stream(OCRWORD *word,PDFFILE *pdf,double dpi,
                                   double page_height_pts,double median_size_pts,
                                   WILLUSCHARMAPLIST *cmaplist,int ocr_flags)
 
@@ -1534,8 +2306,10 @@ static void ocrword_to_pdf_stream(OCRWORD *word,FILE *f,double dpi,
     double width_per_point,height_per_point,arat;
     char rotbuf[48];
     int *d;
+    FILE *f;
     static char *funcname="ocrword_to_pdf_stream";
 
+    f=pdf->f;
 /*
 printf("word->text='%s'\n",word->text);
 printf("    wxh = %dx%d, dpi=%g\n",word->w,word->h,dpi);
@@ -1610,7 +2384,7 @@ printf("    fontsize_height=%g\n",fontsize_height);
             }
         if (cid<32 || cid>255)
             cid=32;
-        if (fn!=lastfont || fabs(fontsize_height-lastfontsize)>.01)
+        if (fn!=pdf->lastfont || fabs(fontsize_height-pdf->lastfontsize)>.01)
             {
             if (cc>0)
                 {
@@ -1618,8 +2392,8 @@ printf("    fontsize_height=%g\n",fontsize_height);
                 cc=0;
                 }
             fprintf(f,"/F%d %.2f Tf\n",fn,fontsize_height);
-            lastfontsize=fontsize_height;
-            lastfont=fn;
+            pdf->lastfontsize=fontsize_height;
+            pdf->lastfont=fn;
             }
         if (i==0)
             fprintf(f,"%s %.2f %.2f Tm\n",rotbuf,x0,y0);
@@ -42,6 +42,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #ifdef HAVE_GHOSTSCRIPT
 /*
@@ -60,6 +61,43 @@ static int willusgs_isdll=0;
 static int willusgs_device_width_pts=-1;
 static int willusgs_device_height_pts=-1;
 
+/*
+** v2.56:  Render sessions.  Instead of running Ghostscript once per page
+** (re-interpreting the document each time and passing the page through a
+** temporary PNG file), a session runs Ghostscript once from the requested
+** page on, with the raw ppm device writing every page after it to a pipe.
+** The next page requested from the same file at the same resolution is
+** simply the next frame in the pipe.  Two sessions are kept because pages
+** are often read at two resolutions in turn (a low-dpi size check and then
+** the full read).  Not used with the Ghostscript DLL.  The sessions (and
+** Ghostscript itself, which is not thread safe) are used by one thread at a
+** time:  willusgs_mutex is held while a page is read or a file converted.
+*/
+#define WGS_MAXSESSIONS 2
+#define WGS_MAXSKIP     2   /* Max PDF pages read and thrown away to get to a page */
+typedef struct
+    {
+    FILE *f;            /* ppmraw stream from Ghostscript, NULL = not running */
+    char filename[MAXFILENAMELEN];
+    double dpi;
+    int devw,devh;      /* willusgs_device_width/height_pts at start */
+    int nextpage;       /* Page number of the next frame in the stream */
+    int lastuse;
+    } WGSSESSION;
+static WGSSESSION willusgs_session[WGS_MAXSESSIONS];
+static int willusgs_session_count=0;
+static pthread_mutex_t willusgs_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+static int willusgs_read_pdf_or_ps_bmp_1(WILLUSBITMAP *bmp,char *filename,int pageno,
+                                         double dpi,FILE *out);
+static int willusgs_session_read(WILLUSBITMAP *bmp,char *filename,int pageno,double dpi,
+                                 FILE *out);
+static WGSSESSION *willusgs_session_get(char *filename,int pageno,double dpi,FILE *out);
+static void willusgs_session_end(WGSSESSION *session);
+static int willusgs_read_ppm_frame(WILLUSBITMAP *bmp,FILE *f,int skip);
+static int willusgs_ppm_header_int(FILE *f);
+static void willusgs_cmdline(char *cmd,int argc,char *argv[]);
+
 /*
 ** Pointers which will get pointed to the DLL functions
 */
@@ -113,6 +151,20 @@ void willusgs_set_device_width_and_height_pts(int w,int h)
 
 int willusgs_read_pdf_or_ps_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,double dpi,FILE *out)
 
+    {
+    int status;
+
+    willusgs_init(out);
+    pthread_mutex_lock(&willusgs_mutex);
+    status=willusgs_read_pdf_or_ps_bmp_1(bmp,filename,pageno,dpi,out);
+    pthread_mutex_unlock(&willusgs_mutex);
+    return(status);
+    }
+
+
+static int willusgs_read_pdf_or_ps_bmp_1(WILLUSBITMAP *bmp,char *filename,int pageno,
+                                         double dpi,FILE *out)
+
     {
     char argdata[NARGSMAX][48];
     char *argv[NARGSMAX];
@@ -121,7 +173,9 @@ int willusgs_read_pdf_or_ps_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,doub
     char argtemp[280];
     char srcfile[256];
 
-    willusgs_init(out);
+    /* v2.56:  Get the page from a render session if possible */
+    if (willusgs_session_read(bmp,filename,pageno,dpi,out)==0)
+        return(0);
     wfile_abstmpnam(tempfile);
     for (i=0;i<NARGSMAX;i++)
         argv[i]=&argdata[i][0];
@@ -166,6 +220,233 @@ printf("bitmap is %d x %d x %d\n",bmp->width,bmp->height,bmp->bpp);
     return(0);
     }
 
+
+/*
+** Returns 0 if page pageno of filename was read from a render session.
+*/
+static int willusgs_session_read(WILLUSBITMAP *bmp,char *filename,int pageno,double dpi,
+                                 FILE *out)
+
+    {
+    WGSSESSION *session;
+
+    if (willusgs_isdll || pageno<=0 || strlen(filename)>=MAXFILENAMELEN)
+        return(-1);
+    session=willusgs_session_get(filename,pageno,dpi,out);
+    if (session==NULL)
+        return(-1);
+    /* Throw away the pages in between */
+    for (;session->nextpage<pageno;session->nextpage++)
+        if (willusgs_read_ppm_frame(bmp,session->f,1)<0)
+            {
+            willusgs_session_end(session);
+            return(-2);
+            }
+    if (willusgs_read_ppm_frame(bmp,session->f,0)<0)
+        {
+        /* Past the last page or Ghostscript error */
+        willusgs_session_end(session);
+        return(-3);
+        }
+    session->nextpage++;
+    return(0);
+    }
+
+
+/*
+** Returns a running session for filename at dpi that is at or before page
+** pageno, starting a new one if needed.  Returns NULL if Ghostscript cannot
+** be started this way, or if pageno is before the next page of a PostScript
+** session (the page is then read the one-shot way).
+*/
+static WGSSESSION *willusgs_session_get(char *filename,int pageno,double dpi,FILE *out)
+
+    {
+    WGSSESSION *session;
+    char argdata[NARGSMAX][48];
+    char *argv[NARGSMAX];
+    char cmd[1024];
+    int i,ps;
+
+    /*
+    ** PostScript has to be interpreted from the start anyway, so never restart it.
+    ** An earlier page is read the one-shot way and the session is kept for the
+    ** pages after it.
+    */
+    ps=(!stricmp(wfile_ext(filename),"ps") || !stricmp(wfile_ext(filename),"eps"));
+    for (i=0;i<WGS_MAXSESSIONS;i++)
+        {
+        session=&willusgs_session[i];
+        if (session->f==NULL || strcmp(session->filename,filename) || session->dpi!=dpi
+                   || session->devw!=willusgs_device_width_pts
+                   || session->devh!=willusgs_device_height_pts)
+            continue;
+        if (session->nextpage<=pageno && (ps || pageno-session->nextpage<=WGS_MAXSKIP))
+            {
+            session->lastuse=++willusgs_session_count;
+            return(session);
+            }
+        if (ps)
+            return(NULL);
+        willusgs_session_end(session);
+        break;
+        }
+    /* Use an idle session or the one used longest ago */
+    if (i>=WGS_MAXSESSIONS)
+        for (i=0;i<WGS_MAXSESSIONS;i++)
+            if (willusgs_session[i].f==NULL)
+                break;
+    if (i>=WGS_MAXSESSIONS)
+        {
+        int j;
+        for (i=0,j=1;j<WGS_MAXSESSIONS;j++)
+            if (willusgs_session[j].lastuse<willusgs_session[i].lastuse)
+                i=j;
+        }
+    session=&willusgs_session[i];
+    willusgs_session_end(session);
+    for (i=0;i<NARGSMAX;i++)
+        argv[i]=&argdata[i][0];
+    i=0;
+    strcpy(argv[i++],"gs"); /* Not passed */
+    strcpy(argv[i++],"-q");
+    strcpy(argv[i++],"-P-");
+    strcpy(argv[i++],"-dSAFER");
+    strcpy(argv[i++],"-dBATCH");
+    strcpy(argv[i++],"-dNOPAUSE");
+    strcpy(argv[i++],"-sDEVICE=ppmraw");
+    /* Keep Ghostscript messages out of the page stream */
+    strcpy(argv[i++],"-sstdout=%stderr");
+    if (willusgs_device_width_pts>0)
+        sprintf(argv[i++],"-dDEVICEWIDTHPOINTS=%d",willusgs_device_width_pts);
+    if (willusgs_device_height_pts>0)
+        sprintf(argv[i++],"-dDEVICEHEIGHTPOINTS=%d",willusgs_device_height_pts);
+    strcpy(argv[i++],"-dGraphicsAlphaBits=4");
+    strcpy(argv[i++],"-dTextAlphaBits=4");
+    sprintf(argv[i++],"-r%g",dpi);
+    sprintf(argv[i++],"-dFirstPage=%d",ps ? 1 : pageno);
+    strcpy(argv[i++],"-sOutputFile=-");
+    argv[i++]=filename;
+    willusgs_cmdline(cmd,i,argv);
+#if (defined(WIN32) || defined(WIN64))
+    strcat(cmd,"\"");
+    session->f=_popen(cmd,"rb");
+#else
+    session->f=popen(cmd,"r");
+#endif
+    if (session->f==NULL)
+        {
+        nprintf(out,"Cannot start Ghostscript render session.\n");
+        return(NULL);
+        }
+    strcpy(session->filename,filename);
+    session->dpi=dpi;
+    session->devw=willusgs_device_width_pts;
+    session->devh=willusgs_device_height_pts;
+    session->nextpage = ps ? 1 : pageno;
+    session->lastuse=++willusgs_session_count;
+    return(session);
+    }
+
+
+/*
+** Stop all render sessions (e.g. when done with a document).
+*/
+void willusgs_sessions_end(void)
+
+    {
+    int i;
+
+    pthread_mutex_lock(&willusgs_mutex);
+    for (i=0;i<WGS_MAXSESSIONS;i++)
+        willusgs_session_end(&willusgs_session[i]);
+    pthread_mutex_unlock(&willusgs_mutex);
+    }
+
+
+static void willusgs_session_end(WGSSESSION *session)
+
+    {
+    if (session->f==NULL)
+        return;
+    /* Ghostscript quits when it can't write to the pipe any more */
+#if (defined(WIN32) || defined(WIN64))
+    _pclose(session->f);
+#else
+    pclose(session->f);
+#endif
+    session->f=NULL;
+    }
+
+
+/*
+** Read one ppm (P6) page from f into bmp (or just past it if skip!=0).
+** Returns 0 if okay, -1 at end of stream or on a format error.
+*/
+static int willusgs_read_ppm_frame(WILLUSBITMAP *bmp,FILE *f,int skip)
+
+    {
+    int i,w,h,maxval;
+
+    if (fgetc(f)!='P' || fgetc(f)!='6')
+        return(-1);
+    w=willusgs_ppm_header_int(f);
+    h=willusgs_ppm_header_int(f);
+    /* (Also reads the single whitespace char that ends the header) */
+    maxval=willusgs_ppm_header_int(f);
+    if (w<=0 || h<=0 || maxval!=255)
+        return(-1);
+    if (skip)
+        {
+        unsigned char buf[4096];
+        double n;
+
+        for (n=(double)w*h*3;n>0;n-=sizeof(buf))
+            if (fread(buf,1,n<sizeof(buf)?(size_t)n:sizeof(buf),f)==0)
+                return(-1);
+        return(0);
+        }
+    bmp->width=w;
+    bmp->height=h;
+    bmp->bpp=24;
+    bmp->type=WILLUSBITMAP_TYPE_NATIVE;
+    bmp_alloc(bmp);
+    for (i=0;i<h;i++)
+        if (fread(bmp_rowptr_from_top(bmp,i),1,w*3,f)<(size_t)w*3)
+            return(-1);
+    return(0);
+    }
+
+
+/*
+** Next decimal integer in a ppm header (skipping whitespace and # comments).
+** The char after the integer is read too.
+*/
+static int willusgs_ppm_header_int(FILE *f)
+
+    {
+    int c,x;
+
+    while (1)
+        {
+        c=fgetc(f);
+        if (c=='#')
+            {
+            while (c!='\n' && c!=EOF)
+                c=fgetc(f);
+            continue;
+            }
+        if (c!=' ' && c!='\t' && c!='\r' && c!='\n')
+            break;
+        }
+    if (c<'0' || c>'9')
+        return(-1);
+    for (x=0;c>='0' && c<='9';c=fgetc(f))
+        x=x*10+(c-'0');
+    return(x);
+    }
+
+
 /*
 ** Source file can be PS or PDF
 ** Google "ps2pdf options" to see more about these options.
@@ -212,7 +493,9 @@ int willusgs_ps_to_pdf(char *dstfile,char *srcfile,FILE *out)
 */
     argv[i++]=&argsrc[0];
     sprintf(argsrc,"%s",srcfile);
+    pthread_mutex_lock(&willusgs_mutex);
     status=willusgs_exec(i,argv,out);
+    pthread_mutex_unlock(&willusgs_mutex);
     return(status);
     }
 
@@ -335,7 +618,7 @@ int willusgs_init(FILE *out)
 int willusgs_exec(int argc,char *argv[],FILE *out)
 
     {
-    int i,status;
+    int status;
     char cmd[1024];
 
 /*
@@ -382,13 +665,8 @@ printf("    argv[%d]='%s'\n",i,argv[i]);
             return(0);
         return(-2);
         }
-    strcpy(cmd,"\"");
-#else
-    cmd[0]='\0';
 #endif
-    sprintf(&cmd[strlen(cmd)],"\"%s\"",willusgs_name);
-    for (i=1;i<argc;i++)
-        sprintf(&cmd[strlen(cmd)]," \"%s\"",argv[i]);
+    willusgs_cmdline(cmd,argc,argv);
 /*
 #if (defined(WIN32) || defined(WIN64))
     strcat(cmd," 1> nul 2> nul\"");
@@ -401,6 +679,25 @@ printf("    argv[%d]='%s'\n",i,argv[i]);
     }
 
 
+/*
+** Ghostscript command line for system() / popen().  argv[0] is not used.
+*/
+static void willusgs_cmdline(char *cmd,int argc,char *argv[])
+
+    {
+    int i;
+
+#if (defined(WIN32) || defined(WIN64))
+    strcpy(cmd,"\"");
+#else
+    cmd[0]='\0';
+#endif
+    sprintf(&cmd[strlen(cmd)],"\"%s\"",willusgs_name);
+    for (i=1;i<argc;i++)
+        sprintf(&cmd[strlen(cmd)]," \"%s\"",argv[i]);
+    }
+
+
 #if (defined(WIN32) || defined(WIN64))
 static int gsdll_stdio(void *instance,const char *str,int len)
 
@@ -413,6 +710,7 @@ static int gsdll_stdio(void *instance,const char *str,int len)
 void willusgs_close(void)
 
     {
+    willusgs_sessions_end();
 #if (defined(WIN32) || defined(WIN64))
     if (willusgs_isdll && willusgs_lib!=NULL)
         FreeLibrary(willusgs_lib);
@@ -170,7 +170,8 @@ typedef double  real;
 #define WILLUS_BIGENDIAN
 #endif
 
-#if (defined(__GNUC__) && __GNUC__ >= 4 && __GNUC_MINOR__ > 4)
+/* v2.56:  Was __GNUC__>=4 && __GNUC_MINOR__>4, which is false for e.g. gcc 12.2 */
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ > 4)))
 /* For my code */
 #ifndef WILLUS_HAVE_FILE64
 #define WILLUS_HAVE_FILE64
@@ -443,6 +444,25 @@ void strbuf_dsprintf(STRBUF *sbuf,STRBUF *sbuf2,char *fmt,...);
 void strbuf_sprintf_no_space(STRBUF *sbuf,char *fmt,...);
 void strbuf_dsprintf_no_space(STRBUF *sbuf,STRBUF *sbuf2,char *fmt,...);
 
+/* wprofile.c */
+typedef struct
+    {
+    void *prof;
+    double wall_secs;
+    double cpu_secs;
+    } WPROFILETIMER;
+void  *wprofile_new(void);
+void   wprofile_free(void *handle);
+void   wprofile_use(void *handle);
+void  *wprofile_current(void);
+double wprofile_wall_secs(void);
+double wprofile_cpu_secs(void);
+void   wprofile_start(WPROFILETIMER *timer);
+void   wprofile_stop(WPROFILETIMER *timer,char *stage,double bytes);
+void   wprofile_stop_cpu(WPROFILETIMER *timer,char *stage,double cpu_secs,double bytes);
+void   wprofile_page_reset(void *handle);
+void   wprofile_stages_json(STRBUF *json,void *handle,int page);
+
 /* array.c */
 int array_mean_xy(double *x,double *y,int n,double x1,double x2,double *mean,double *stdev);
 double array_mean(double *a,int n,double *mean,double *stddev);
@@ -589,12 +609,10 @@ void bmp_draw_filled_rect(WILLUSBITMAP *bmp,int col1,int row1,int col2,int row2,
 ** the fixed-point version on 64-bit compiles.  For 32-bit Intel (and ARM),
 ** the fixed-point version is considerably faster.
 ** (__x86_64 is automatically pre-defined for 64-bit gcc compiles on Intel CPUs.)
+** v2.56:  The separable fixed-point version is now 4 - 10 times faster than
+** bmp_resample() on all platforms.
 */
-#ifdef __x86_64
-#define bmp_resample_optimum_performance bmp_resample
-#else
 #define bmp_resample_optimum_performance bmp_resample_fixed_point
-#endif
 int  bmp_resample(WILLUSBITMAP *dest,WILLUSBITMAP *src,double x1,double y1,
                   double x2,double y2,int newwidth,int newheight);
 int  bmp_resample_fixed_point(WILLUSBITMAP *dest,WILLUSBITMAP *src,double fx1,double fy1,
@@ -626,13 +644,43 @@ int bmp_jasper_read(WILLUSBITMAP *bmp,char *filename,FILE *out);
 #endif
 void bmp_more_rows(WILLUSBITMAP *bmp,double ratio,int pixval);
 double bmp_autostraighten(WILLUSBITMAP *src,WILLUSBITMAP *srcgrey,int white,double maxdegrees,
-                        double mindegrees,int debug,FILE *out);
+                        double mindegrees,int nthreads,int debug,FILE *out);
 void bmp_apply_whitethresh(WILLUSBITMAP *bmp,int whitethresh);
 void bmp_dither_to_bpc(WILLUSBITMAP *bmp,int newbpc);
 void bmp_extract(WILLUSBITMAP *dst,WILLUSBITMAP *src,int x0,int y0_from_top,int width,int height);
 int  bmp_read_pcl(WILLUSBITMAP *bmp,char *pclbuf,int n);
 void bmp_autocrop(WILLUSBITMAP *bmp,int pad);
 
+/* bmpcache.c */
+void bmpcache_set_max_bytes(double max_bytes);
+int  bmpcache_get(WILLUSBITMAP *bmp,char *key);
+void bmpcache_put(WILLUSBITMAP *bmp,char *key);
+void bmpcache_clear(void);
+
+/* bmppool.c */
+void   bmppool_set_max_bytes(double max_bytes);
+size_t bmppool_size(size_t size);
+void  *bmppool_get(size_t *size,char *name);
+int    bmppool_put(void *ptr,size_t size);
+void   bmppool_page_end(void);
+void   bmppool_free_all(void);
+void   bmppool_stats(double *hits,double *misses,double *bytes_reused);
+
+/* bmpg4.c */
+int  bmp_is_bilevel(WILLUSBITMAP *bmp);
+long bmp_write_ccitt_g4_stream(WILLUSBITMAP *bmp,FILE *f,int whitethresh);
+
+/* bmpsimd.c */
+#define BMP_SIMD_NONE   0
+#define BMP_SIMD_SSE2   1
+#define BMP_SIMD_AVX2   2
+int  bmp_simd_level(void);
+void bmp_simd_set_level(int level);
+void bmp_simd_rgb_to_grey(unsigned char *dst,unsigned char *src,int n,int ir,int ib);
+void bmp_simd_whitethresh(unsigned char *p,int n,int whitethresh);
+void bmp_simd_invert(unsigned char *p,int n);
+void bmp_simd_madd(int *acc,int *src,int w,int n);
+
 /* fontrender.c */
 void fontrender_set_or(int status);
 void fontrender_set_typeface(char *name);
@@ -817,6 +865,7 @@ typedef struct
                /* bitmap that should be used to determine the word.             */
     double dpi; /* DPI of bitmap */
     double bmpscale; /* Scale bmp pixels by this immediately after OCR */
+    int ocrjob; /* Ticket of OCR pool job already started on xbmp (0 = none) */
 
     /* Used by MuPDF */
     double x0,y0; /* Position of top-left of first char of word rel. to top-left of
@@ -866,7 +915,7 @@ void ocrword_bitmap_free(OCRWORD *word);
 /* pdfwrite.c */
 typedef struct
     {
-    size_t ptr[3];
+    long long ptr[3]; /* v2.56:  64-bit file offsets */
     int    flags;    /*
                      ** 1 = new page
                      ** 2 = needs parent reference
@@ -885,15 +934,34 @@ typedef struct wpdfoutline_s
     struct wpdfoutline_s *down;
     } WPDFOUTLINE;
 
+/* Page whose OCR text layer gets written after the page (v2.56) */
+typedef struct
+    {
+    int resobj;  /* Reserved object number for page resources (0 = already written) */
+    int textobj; /* Reserved object number for OCR text stream */
+    int imobj;   /* Object number of page image (0 = no image) */
+    int imc;     /* Image number */
+    int ocr_render_flags;
+    double dpi;
+    double ph;   /* Page height in points */
+    } PDFDEFERREDPAGE;
+
 typedef struct
     {
     PDFOBJECT *object; /* PDF reference number = index + 1 */
     int n;
     int na;
     int imc;    // Image count
-    size_t pae; // Pointer into page type reference
+    long long pae; // Pointer into page type reference
     FILE *f;
     char filename[512];
+    PDFDEFERREDPAGE *dpage; /* Pages with OCR text layer not yet written */
+    int ndp;
+    int ndpa;
+    int nthreads; /* v2.56:  Max threads used to compress each image */
+    int xref_stream; /* v2.56:  Non-zero = cross-reference stream (PDF 1.5) */
+    int lastfont;    /* v2.56:  Font and size of the last OCR text Tf (was static) */
+    double lastfontsize;
     } PDFFILE;
 
 FILE *pdffile_init(PDFFILE *pdf,char *filename,int pages_at_end);
@@ -905,6 +973,9 @@ void pdffile_add_page_with_stream(PDFFILE *pdf,char *fonts,char *streamtext);
 void pdffile_add_bitmap_with_ocrwords(PDFFILE *pdf,WILLUSBITMAP *bmp,double dpi,
                                       int quality,int halfsize,OCRWORDS *ocrwords,
                                       int ocr_render_flags);
+int  pdffile_add_bitmap_with_deferred_ocrwords(PDFFILE *pdf,WILLUSBITMAP *bmp,double dpi,
+                                              int quality,int halfsize,int ocr_render_flags);
+void pdffile_add_deferred_ocrwords(PDFFILE *pdf,int handle,OCRWORDS *ocrwords);
 void pdffile_finish(PDFFILE *pdf,char *title,char *author,char *producer,char *cdate);
 int  pdf_numpages(char *filename);
 void ocrwords_box(OCRWORDS *ocrwords,WILLUSBITMAP *bmp);
@@ -977,9 +1048,20 @@ typedef struct
     } RFIND;
 
 #ifdef WILLUS_HAVE_FILE64
+/*
+** v2.56:  ftello64() / fseeko64() are only declared by glibc if
+**         _LARGEFILE64_SOURCE was set before <stdio.h> was first included,
+**         so away from Windows use ftello() / fseeko() (off_t is 64 bits
+**         on LP64 targets).  MinGW always declares the *64 versions.
+*/
+#if (defined(WIN32) || defined(WIN64))
 #define wfile_tell(f) ((long long)(ftello64(f)))
 #define wfile_seek(f,pos,offtype) fseeko64(f,(_off64_t)(pos),offtype)
 #else
+#define wfile_tell(f) ((long long)(ftello(f)))
+#define wfile_seek(f,pos,offtype) fseeko(f,(off_t)(pos),offtype)
+#endif
+#else
 #define wfile_tell(f) ftell(f)
 #define wfile_seek(f,pos,offtype) fseek(f,pos,offtype)
 #endif
@@ -1598,14 +1680,29 @@ int willusgs_ps_to_pdf(char *dstfile,char *srcfile,FILE *out);
 int willusgs_init(FILE *out);
 int willusgs_exec(int argc,char *argv[],FILE *out);
 void willusgs_close(void);
+void willusgs_sessions_end(void);
 #endif
 
 /* ocr.c */
 void ocrwords_queue_bitmap(OCRWORDS *words,WILLUSBITMAP *bmp8,int dpi,
                            int c1,int r1,int c2,int r2,int lcheight);
+void *ocrpool_start(void **ocr_api,int nthreads);
+void ocrpool_stop(void *handle);
+void ocrpool_set_batch(void *handle,int maxwords);
+void ocrpool_submit(void *handle,void *owner,OCRWORD *word,int type,int target_dpi);
+double ocrpool_ocrwords(void *handle,OCRWORDS *words,int type,int target_dpi);
+int ocrpool_ocrwords_done(void *handle,void *owner,OCRWORDS *words,int type,
+                          int target_dpi);
+void ocrpool_discard(void *handle,void *owner,int ticket);
 double ocrwords_multithreaded_ocr(OCRWORDS *words,void **ocr_api,int nthreads,int type,int target_dpi);
 void ocr_text_proc(char *s,int allow_spaces);
 
+/* ocrcache.c */
+void ocrcache_init(double max_bytes,char *filename,char *tag);
+int  ocrcache_get(OCRWORDS *words,WILLUSBITMAP *bmp,int type,int dpi,double downsample);
+void ocrcache_put(OCRWORDS *words,WILLUSBITMAP *bmp,int type,int dpi,double downsample);
+void ocrcache_clear(void);
+
 #ifdef HAVE_GOCR_LIB
 /* ocrgocr.c */
 void gocr_single_word_from_bmp8(char *text,int maxlen,WILLUSBITMAP *bmp8,
@@ -1820,6 +1917,12 @@ int  wpdf_docenc_from_utf8(char *dst,char *src_utf8,int maxlen);
 int bmpmupdf_pdffile_to_bmp(WILLUSBITMAP *bmp,char *filename,int pageno,double dpi,int bpp);
 void wmupdf_cbzinfo_get(char *filename,int *pagelist,char **buf0);
 int bmpmupdf_pdffile_width_and_height(char *filename,int pageno,double *width_in,double *height_in);
+void bmpmupdf_session_close(void);
+void *bmpmupdf_session_new(void);
+void bmpmupdf_session_free(void *session);
+void bmpmupdf_session_use(void *session);
+int bmpmupdf_session_pdffile_to_bmp(void *session,WILLUSBITMAP *bmp,char *filename,
+                                    int pageno,double dpi,int bpp);
 #endif /* HAVE_MUPDF_LIB */
 
 /* wmupdf.c */
@@ -2062,8 +2165,10 @@ int  willusgui_shiftkey_state(void);
 /* Generic (cross-platform) message box functions */
 /* wleptonica.c */
 #ifdef HAVE_LEPTONICA_LIB
-void wlept_bmp_dewarp(WILLUSBITMAP *src,WILLUSBITMAP *bmp1,WILLUSBITMAP *bmp2,int wthresh,int fit_order,
-                      char *debugfile);
+void *wlept_dewarp_models_new(int maxdist);
+void wlept_dewarp_models_free(void *models);
+void wlept_bmp_dewarp(void *models,int pageno,WILLUSBITMAP *src,WILLUSBITMAP *bmp1,
+                      WILLUSBITMAP *bmp2,int wthresh,int fit_order,char *debugfile);
 #endif
 
 
@@ -25,8 +25,21 @@
 #ifdef HAVE_LEPTONICA_LIB
 #include <leptonica.h>
 
+/*
+** v2.56:  Dewarp models kept from page to page of a document.  A page
+** whose own model fails (e.g. not enough text lines) uses the model of
+** the last page on the same side of the book (even/odd page number) that
+** had one, if it is within maxdist pages.
+*/
+typedef struct
+    {
+    L_DEWARPA *dewa;
+    int lastpage[2];  /* Even and odd pages with the last good model (-1 = none) */
+    } WLEPTDEWARP;
+
 static void wlept_pix_from_bmp(PIX **pixptr,WILLUSBITMAP *bmp);
 static void wlept_bmp_from_pix(WILLUSBITMAP *bmp,PIX *pix);
+static void wlept_apply_disparity(L_DEWARPA *dewa,int pageno,WILLUSBITMAP *bmp);
 
 static void wlept_pix_from_bmp(PIX **pixptr,WILLUSBITMAP *bmp)
 
@@ -105,19 +118,74 @@ static void wlept_bmp_from_pix(WILLUSBITMAP *bmp,PIX *pix)
     }
 
 
+void *wlept_dewarp_models_new(int maxdist)
+
+    {
+    static char *funcname="wlept_dewarp_models_new";
+    WLEPTDEWARP *wdew;
+
+    willus_mem_alloc_warn((void **)&wdew,sizeof(WLEPTDEWARP),funcname,10);
+    wdew->dewa=dewarpaCreate(2,50,1,10,maxdist);
+    dewarpaUseBothArrays(wdew->dewa,1);
+    wdew->lastpage[0]=wdew->lastpage[1]=-1;
+    return((void *)wdew);
+    }
+
+
+void wlept_dewarp_models_free(void *models)
+
+    {
+    static char *funcname="wlept_dewarp_models_free";
+    WLEPTDEWARP *wdew;
+
+    wdew=(WLEPTDEWARP *)models;
+    if (wdew==NULL)
+        return;
+    dewarpaDestroy(&wdew->dewa);
+    willus_mem_free((double **)&wdew,funcname);
+    }
+
+
 /* De-warp image using Leptonica algorithm--based on dewarptest1.c in Leptonica distro */
 /* src2 -> dst2 using the same warpedness of src -> dst */
 /* Fit order = 2, 3, or 4 */
-void wlept_bmp_dewarp(WILLUSBITMAP *src,WILLUSBITMAP *bmp1,WILLUSBITMAP *bmp2,int wthresh,
-                      int fit_order,char *debugfile)
+/*
+** v2.56:
+**     models = wlept_dewarp_models_new() handle that keeps the last good
+**              model for pages of the same document (page number pageno),
+**              or NULL to model the page by itself (as before).
+*/
+void wlept_bmp_dewarp(void *models,int pageno,WILLUSBITMAP *src,WILLUSBITMAP *bmp1,
+                      WILLUSBITMAP *bmp2,int wthresh,int fit_order,char *debugfile)
 
     {
+    WLEPTDEWARP _wdew,*wdew;
     PIX *pix,*pixg,*pixb;
-    L_DEWARPA *dewa;
-    L_DEWARP  *dew1;
+    L_DEWARP  *dew1,*dew;
     char *debug;
 
     debug=(debugfile==NULL || debugfile[0]=='\0') ? NULL : debugfile;
+    if (models==NULL)
+        {
+        wdew=&_wdew;
+        wdew->dewa=dewarpaCreate(2,50,1,10,30);
+        dewarpaUseBothArrays(wdew->dewa,1);
+        pageno=1;
+        }
+    else
+        wdew=(WLEPTDEWARP *)models;
+    /*
+    ** Same page again (e.g. listed twice with -p) and it has the kept model:
+    ** re-use it.  dewarpaInsertDewarp() would destroy it, and if the new
+    ** model failed, lastpage would be left pointing at a bad one.
+    */
+    if (models!=NULL && wdew->lastpage[pageno&1]==pageno)
+        {
+        wlept_apply_disparity(wdew->dewa,pageno,bmp1);
+        if (bmp2!=bmp1)
+            wlept_apply_disparity(wdew->dewa,pageno,bmp2);
+        return;
+        }
     wlept_pix_from_bmp(&pix,src);
     if (pixGetDepth(pix)>8)
         pixg=pixConvertRGBToGray(pix,.5,.3,.2);
@@ -126,35 +194,72 @@ void wlept_bmp_dewarp(WILLUSBITMAP *src,WILLUSBITMAP *bmp1,WILLUSBITMAP *bmp2,in
     pixb=pixThresholdToBinary(pixg,wthresh);
     if (pixg!=pix)
         pixDestroy(&pixg);
+    pixDestroy(&pix);
 /*
 printf("pixb=%dx%dx%d\n",pixb->w,pixb->h,pixb->d);
 pixWrite("pixb.png",pixb,IFF_PNG);
 */
-    dewa=dewarpaCreate(2,50,1,10,30);
-    dewarpaUseBothArrays(dewa,1);
-    dew1=dewarpCreate(pixb,1);
+    dew1=dewarpCreate(pixb,pageno);
     pixDestroy(&pixb);
-    dewarpaInsertDewarp(dewa,dew1);
+    dewarpaInsertDewarp(wdew->dewa,dew1);
     dewarpBuildPageModel_ex(dew1,debug,fit_order);
-    if (bmp1!=NULL)
+    /* Validates the models and points this page at the last good one if needed */
+    dewarpaInsertRefModels(wdew->dewa,0,0);
+    dew=dewarpaGetDewarp(wdew->dewa,pageno);
+    if (dew!=NULL && dew->hasref)
+        dew=dewarpaGetDewarp(wdew->dewa,dew->refpage);
+    if (dew!=NULL && dew->vvalid)
         {
-        PIX *pix2,*pix2d;
-        wlept_pix_from_bmp(&pix2,bmp1);
-        dewarpaApplyDisparity(dewa,1,pix2,-1,0,0,&pix2d,NULL);
-        wlept_bmp_from_pix(bmp1,pix2d);
-        pixDestroy(&pix2d);
-        pixDestroy(&pix2);
+        wlept_apply_disparity(wdew->dewa,pageno,bmp1);
+        if (bmp2!=bmp1)
+            wlept_apply_disparity(wdew->dewa,pageno,bmp2);
         }
-    if (bmp2!=NULL && bmp2!=bmp1)
+    if (models==NULL)
         {
-        PIX *pix2,*pix2d;
-        wlept_pix_from_bmp(&pix2,bmp2);
-        dewarpaApplyDisparity(dewa,1,pix2,-1,0,0,&pix2d,NULL);
-        wlept_bmp_from_pix(bmp2,pix2d);
+        dewarpaDestroy(&wdew->dewa); /* Includes dewarpDestroy of dew1 */
+        return;
+        }
+    /*
+    ** Keep one model per side:  this page's if it's good, else the last good
+    ** one.  Kept models only need their sampled disparity arrays.
+    */
+    {
+    int *lastpage;
+
+    lastpage=&wdew->lastpage[pageno&1];
+    dew1=dewarpaGetDewarp(wdew->dewa,pageno);
+    if (dew1!=NULL && dew1->vvalid)
+        {
+        if ((*lastpage)>=0 && (*lastpage)!=pageno)
+            dewarpaDestroyDewarp(wdew->dewa,(*lastpage));
+        (*lastpage)=pageno;
+        }
+    else if (pageno!=(*lastpage))
+        dewarpaDestroyDewarp(wdew->dewa,pageno);
+    if ((*lastpage)>=0)
+        dewarpMinimize(dewarpaGetDewarp(wdew->dewa,(*lastpage)));
+    }
+    }
+
+
+/*
+** v2.56:  Apply the page model for pageno (or the model it refers to) to bmp.
+*/
+static void wlept_apply_disparity(L_DEWARPA *dewa,int pageno,WILLUSBITMAP *bmp)
+
+    {
+    PIX *pix2,*pix2d;
+
+    if (bmp==NULL)
+        return;
+    wlept_pix_from_bmp(&pix2,bmp);
+    pix2d=NULL;
+    dewarpaApplyDisparity(dewa,pageno,pix2,-1,0,0,&pix2d,NULL);
+    if (pix2d!=NULL)
+        {
+        wlept_bmp_from_pix(bmp,pix2d);
         pixDestroy(&pix2d);
-        pixDestroy(&pix2);
         }
-    dewarpaDestroy(&dewa); /* Includes dewarpDestroy of dew1 */
-    pixDestroy(&pix);
+    pixDestroy(&pix2);
     }
 #endif /* HAVE_LEPTONICA_LIB */
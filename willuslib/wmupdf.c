@@ -31,6 +31,7 @@
 #ifdef HAVE_MUPDF_LIB
 #include <mupdf/pdf.h>
 void pdf_install_load_system_font_funcs(fz_context *ctx);
+fz_document *bmpmupdf_session_document(fz_context **ctx,char *filename,char *password);
 
 static void info_update(fz_context *ctx,pdf_document *xref,char *producer,char *author,char *title);
 static void dict_put_string(fz_context *ctx,pdf_obj *dict,char *key,char *string);
@@ -45,7 +46,7 @@ static void wmupdf_convert_single_page_to_form(pdf_document *xref,fz_context *ct
                                                pdf_obj *srcpageref,int pageno,double *defaultbbox);
 static int stream_deflate(pdf_document *xref,fz_context *ctx,int pageref,int *length);
 static int add_to_srcpage_stream(pdf_document *xref,fz_context *ctx,int pageref,pdf_obj *dict);
-static char *xobject_name(int pageno);
+static char *xobject_name(char *buf,int pageno);
 static pdf_obj *start_new_destpage(fz_context *ctx,pdf_document *doc,double width_pts,double height_pts);
 static void wmupdf_preserve_old_dests(pdf_obj *olddests,fz_context *ctx,pdf_document *xref,
                                       pdf_obj *pages);
@@ -82,24 +83,19 @@ int wmupdf_numpages(char *filename)
     fz_document *doc;
     int np;
 
-    doc=NULL;
-    ctx = fz_new_context(NULL,NULL,FZ_STORE_DEFAULT);
-    if (!ctx)
-        return(-1);
+    /* v2.56:  Opened document is kept for subsequent page renders */
+    doc=bmpmupdf_session_document(&ctx,filename,NULL);
+    if (doc==NULL)
+        return(-2);
+    np=-3;
     fz_try(ctx)
         {
-        fz_register_document_handlers(ctx);
-        doc=fz_open_document(ctx,filename);
+        np=fz_count_pages(ctx,doc);
         }
     fz_catch(ctx)
         {
-        fz_drop_context(ctx);
-        return(-2);
+        np=-3;
         }
-    np=fz_count_pages(ctx,doc);
-    fz_drop_document(ctx,doc);
-    fz_flush_warnings(ctx);
-    fz_drop_context(ctx);
     return(np);
     }
 
@@ -424,10 +420,10 @@ static int wmupdf_pdfdoc_newpages(pdf_document *xref,fz_context *ctx,WPDFPAGEINF
         {
         WPDFBOX *box;
         int j,k,newsrc;
-        static char buf[512];
+        char buf[512],xname[32];
         pdf_obj *s1indirect,*qindirect,*rotobj;
-        static double cpm[3][3],m[3][3],m1[3][3];
-        static double xclip[4],yclip[4];
+        double cpm[3][3],m[3][3],m1[3][3];
+        double xclip[4],yclip[4];
 /*
 printf("box[%d/%d], srccount=%d\n",i,pageinfo->boxes.n,srccount);
 if (i<pageinfo->boxes.n)
@@ -573,7 +569,7 @@ pdf_resolve_indirect(ctx,obj);
                 xobjdict=pdf_dict_gets(ctx,destpageresources,"XObject");
                 pageno=box->srcbox.pageno;
                 pageref=pdf_lookup_page_obj(ctx,xref,pageno-1);
-                pdf_dict_puts(ctx,xobjdict,xobject_name(pageno),pageref);
+                pdf_dict_puts(ctx,xobjdict,xobject_name(xname,pageno),pageref);
                 pdf_dict_puts(ctx,destpageresources,"XObject",xobjdict);
                 }
             else
@@ -686,7 +682,7 @@ printf("Clip path:\n    %7.2f %7.2f\n    %7.2f,%7.2f\n    %7.2f,%7.2f\n"
         if (use_forms)
             {
             /* FORM METHOD */
-            sprintf(&buf[strlen(buf)]," /%s Do Q\n",xobject_name(box->srcbox.pageno));
+            sprintf(&buf[strlen(buf)]," /%s Do Q\n",xobject_name(xname,box->srcbox.pageno));
             if (strlen(bigbuf)+strlen(buf) > nbb)
                 {
                 int newsize;
@@ -1068,11 +1064,9 @@ printf("    dstlen after = %d\n",dstlen);
     }
 
 
-static char *xobject_name(int pageno)
+static char *xobject_name(char *buf,int pageno)
 
     {
-    static char buf[32];
-
     sprintf(buf,"Xfk2p%d",pageno);
     return(buf);
     }
@@ -1389,113 +1383,73 @@ int wtextchars_fill_from_page_ex(WTEXTCHARS *wtc,char *filename,int pageno,char
                                  int boundingbox)
 
     {
-    fz_document *doc=NULL;
+    fz_document *doc;
     fz_display_list *list=NULL;
     fz_context *ctx;
-    fz_page *page;
+    fz_page *page=NULL;
     fz_stext_page *text=NULL;
     fz_device *dev=NULL;
     fz_rect bounds;
 
-    fz_var(doc);
-    ctx=fz_new_context(NULL,NULL,FZ_STORE_DEFAULT);
-    if (ctx==NULL)
-        return(-1);
+    /* v2.56:  Share open document with page renderer */
+    doc=bmpmupdf_session_document(&ctx,filename,password);
+    if (doc==NULL)
+        return(-2);
+    fz_var(page);
+    fz_var(list);
+    fz_var(dev);
     fz_try(ctx)
         {
-        fz_register_document_handlers(ctx);
-        fz_set_aa_level(ctx,8);
-        /* Sumatra version of MuPDF v1.4 -- use locally installed fonts */
-        pdf_install_load_system_font_funcs(ctx);
-        doc=fz_open_document(ctx,filename);
-        if (doc==NULL)
-            {
-            fz_drop_context(ctx);
-            return(-2);
-            }
-        if (fz_needs_password(ctx,doc) && !fz_authenticate_password(ctx,doc,password))
-            {
-            fz_drop_document(ctx,doc);
-            fz_drop_context(ctx);
-            return(-3);
-            }
         page=fz_load_page(ctx,doc,pageno-1);
-        if (page==NULL)
-            {
-            fz_drop_page(ctx,page);
-            fz_drop_document(ctx,doc);
-            fz_drop_context(ctx);
-            return(-3);
-            }
         bounds=fz_bound_page(ctx,page);
-        fz_try(ctx)
-            {
-            list=fz_new_display_list(ctx,bounds);
-            dev=fz_new_list_device(ctx,list);
-            fz_run_page(ctx,page,dev,fz_identity,NULL);
-            }
-        fz_always(ctx)
-            {
-            fz_close_device(ctx,dev);
-            fz_drop_device(ctx,dev);
-            dev=NULL;
-            }
-        fz_catch(ctx)
-            {
-            fz_drop_display_list(ctx,list);
-            fz_drop_page(ctx,page);
-            fz_drop_document(ctx,doc);
-            fz_drop_context(ctx);
-            return(-4);
-            }
-        fz_var(text);
-        /* Mupdf v1.14:  bounds.y1 > bounds.y0 */
-        wtc->width=fabs(bounds.x1-bounds.x0);
-        wtc->height=fabs(bounds.y1-bounds.y0);
-        fz_try(ctx)
-            {
-            /* options= FZ_STEXT_PRESERVE_LIGATURES | FZ_STEXT_PRESERVE_WHITESPACE; */
-            /* Do not preserve ligatures or white space */
-            if (list)
-                text=fz_new_stext_page_from_display_list(ctx,list,NULL);
-            else
-                text=fz_new_stext_page_from_page(ctx,page,NULL);
-/*
-            dev=fz_new_stext_device(ctx,textsheet,text,options);
-            if (list)
-                fz_run_display_list(ctx,list,dev,&fz_identity,&fz_infinite_rect,NULL);
-            else
-                fz_run_page(ctx,page,dev,&fz_identity,NULL);
-            fz_close_device(ctx,dev);
-            fz_drop_device(ctx,dev);
-            dev=NULL;
-*/
-            wtextchars_add_fz_chars(wtc,ctx,text,boundingbox);
-            }
-        fz_always(ctx)
-            {
-/*
-            fz_close_device(ctx,dev);
-            fz_drop_device(ctx,dev);
-            dev=NULL;
-*/
-            fz_drop_stext_page(ctx,text);
-            fz_drop_display_list(ctx,list);
-            fz_drop_page(ctx,page);
-            fz_drop_document(ctx,doc);
-            }
-        fz_catch(ctx)
-            {
-            fz_drop_context(ctx);
-            return(-5);
-            }
         }
     fz_catch(ctx)
         {
-        fz_drop_context(ctx);
-        return(-20);
+        fz_drop_page(ctx,page);
+        return(-3);
+        }
+    fz_try(ctx)
+        {
+        list=fz_new_display_list(ctx,bounds);
+        dev=fz_new_list_device(ctx,list);
+        fz_run_page(ctx,page,dev,fz_identity,NULL);
+        }
+    fz_always(ctx)
+        {
+        fz_close_device(ctx,dev);
+        fz_drop_device(ctx,dev);
+        dev=NULL;
+        }
+    fz_catch(ctx)
+        {
+        fz_drop_display_list(ctx,list);
+        fz_drop_page(ctx,page);
+        return(-4);
+        }
+    fz_var(text);
+    /* Mupdf v1.14:  bounds.y1 > bounds.y0 */
+    wtc->width=fabs(bounds.x1-bounds.x0);
+    wtc->height=fabs(bounds.y1-bounds.y0);
+    fz_try(ctx)
+        {
+        /* options= FZ_STEXT_PRESERVE_LIGATURES | FZ_STEXT_PRESERVE_WHITESPACE; */
+        /* Do not preserve ligatures or white space */
+        if (list)
+            text=fz_new_stext_page_from_display_list(ctx,list,NULL);
+        else
+            text=fz_new_stext_page_from_page(ctx,page,NULL);
+        wtextchars_add_fz_chars(wtc,ctx,text,boundingbox);
+        }
+    fz_always(ctx)
+        {
+        fz_drop_stext_page(ctx,text);
+        fz_drop_display_list(ctx,list);
+        fz_drop_page(ctx,page);
+        }
+    fz_catch(ctx)
+        {
+        return(-5);
         }
-    fz_drop_context(ctx);
     return(0);
     }
 
@@ -1674,34 +1628,20 @@ WPDFOUTLINE *wpdfoutline_read_from_pdf_file(char *filename)
     WPDFOUTLINE *wpdfoutline;
 
     wpdfoutline=NULL;
-    doc=NULL;
-    ctx = fz_new_context(NULL,NULL,FZ_STORE_DEFAULT);
-    if (!ctx)
+    doc=bmpmupdf_session_document(&ctx,filename,NULL);
+    if (doc==NULL)
         return(NULL);
     fz_try(ctx)
         {
-        fz_register_document_handlers(ctx);
-        fz_set_aa_level(ctx,8);
-        /* Sumatra version of MuPDF v1.4 -- use locally installed fonts */
-        pdf_install_load_system_font_funcs(ctx);
-        fz_try(ctx) { doc=fz_open_document(ctx,filename); }
-        fz_catch(ctx) 
-            { 
-            fz_drop_context(ctx);
-            return(NULL);
-            }
         fzoutline=fz_load_outline(ctx,doc);
         wpdfoutline=wpdfoutline_convert_from_fitz_outline(fzoutline);
         if (fzoutline!=NULL)
             fz_drop_outline(ctx,fzoutline);
-        fz_drop_document(ctx,doc);
         }
     fz_catch(ctx)
         {
-        fz_drop_context(ctx);
         return(NULL);
         }
-    fz_drop_context(ctx);
     return(wpdfoutline);
     }
 
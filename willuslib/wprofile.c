@@ -0,0 +1,278 @@
+/*
+** wprofile.c   Wall / CPU time, call count, and byte counters for named
+**              processing stages (e.g. "deskew", "flate"), collected per
+**              page and in total.  A thread selects the counters it adds to
+**              with wprofile_use(), so library code can time its stages
+**              without knowing who (if anyone) is collecting them.
+**
+** Part of willus.com general purpose C code library.
+**
+** Copyright (C) 2026  http://willus.com
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU Affero General Public License as
+** published by the Free Software Foundation, either version 3 of the
+** License, or (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU Affero General Public License for more details.
+**
+** You should have received a copy of the GNU Affero General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**
+*/
+#include "willus.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define WPROFILE_MAXSTAGES 24
+
+typedef struct
+    {
+    char *name;         /* Static string passed to wprofile_stop() */
+    int calls;
+    double wall_secs;
+    double cpu_secs;    /* CPU time of the thread(s) that ran the stage */
+    double bytes;
+    } WPROFILESTAGE;
+
+typedef struct
+    {
+    WPROFILESTAGE stage[WPROFILE_MAXSTAGES];
+    int n;
+    } WPROFILECOUNTERS;
+
+typedef struct
+    {
+    WPROFILECOUNTERS page;
+    WPROFILECOUNTERS total;
+    pthread_mutex_t mutex;
+    } WPROFILE;
+
+static pthread_key_t thread_profile_key; /* Counters selected by wprofile_use() */
+static pthread_once_t thread_profile_once=PTHREAD_ONCE_INIT;
+
+static void wprofile_thread_key_create(void);
+static void wprofile_counters_add(WPROFILECOUNTERS *counters,char *name,double wall_secs,
+                                  double cpu_secs,double bytes);
+
+
+void *wprofile_new(void)
+
+    {
+    static char *funcname="wprofile_new";
+    WPROFILE *prof;
+
+    willus_mem_alloc_warn((void **)&prof,sizeof(WPROFILE),funcname,10);
+    prof->page.n=0;
+    prof->total.n=0;
+    pthread_mutex_init(&prof->mutex,NULL);
+    return((void *)prof);
+    }
+
+
+void wprofile_free(void *handle)
+
+    {
+    static char *funcname="wprofile_free";
+    WPROFILE *prof;
+
+    prof=(WPROFILE *)handle;
+    if (prof==NULL)
+        return;
+    if (wprofile_current()==handle)
+        wprofile_use(NULL);
+    pthread_mutex_destroy(&prof->mutex);
+    willus_mem_free((double **)&prof,funcname);
+    }
+
+
+/*
+** Stages timed by the calling thread are added to handle (NULL = none).
+*/
+void wprofile_use(void *handle)
+
+    {
+    pthread_once(&thread_profile_once,wprofile_thread_key_create);
+    pthread_setspecific(thread_profile_key,handle);
+    }
+
+
+void *wprofile_current(void)
+
+    {
+    pthread_once(&thread_profile_once,wprofile_thread_key_create);
+    return(pthread_getspecific(thread_profile_key));
+    }
+
+
+static void wprofile_thread_key_create(void)
+
+    {
+    pthread_key_create(&thread_profile_key,NULL);
+    }
+
+
+/*
+** Seconds since an arbitrary start point (not affected by changes to the
+** system clock).
+*/
+double wprofile_wall_secs(void)
+
+    {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC,&ts)==0)
+        return((double)ts.tv_sec+(double)ts.tv_nsec/1e9);
+#endif
+    return((double)time(NULL));
+    }
+
+
+/*
+** CPU seconds used by the calling thread.
+*/
+double wprofile_cpu_secs(void)
+
+    {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts)==0)
+        return((double)ts.tv_sec+(double)ts.tv_nsec/1e9);
+#endif
+    return((double)clock()/CLOCKS_PER_SEC);
+    }
+
+
+/*
+** Start timing a stage.  Does nothing (quickly) if the calling thread
+** isn't collecting counters.
+*/
+void wprofile_start(WPROFILETIMER *timer)
+
+    {
+    timer->prof=wprofile_current();
+    if (timer->prof==NULL)
+        return;
+    timer->wall_secs=wprofile_wall_secs();
+    timer->cpu_secs=wprofile_cpu_secs();
+    }
+
+
+/*
+** Add the time since wprofile_start(timer) and bytes (the amount of data
+** produced or processed, 0 if not applicable) to stage.  stage must be
+** a static string.
+*/
+void wprofile_stop(WPROFILETIMER *timer,char *stage,double bytes)
+
+    {
+    if (timer->prof==NULL)
+        return;
+    wprofile_stop_cpu(timer,stage,wprofile_cpu_secs()-timer->cpu_secs,bytes);
+    }
+
+
+/*
+** Same as wprofile_stop(), but for stages that are run by other threads
+** (e.g. an OCR thread pool), where the caller knows the CPU time used.
+*/
+void wprofile_stop_cpu(WPROFILETIMER *timer,char *stage,double cpu_secs,double bytes)
+
+    {
+    WPROFILE *prof;
+    double wall_secs;
+
+    prof=(WPROFILE *)timer->prof;
+    if (prof==NULL)
+        return;
+    wall_secs=wprofile_wall_secs()-timer->wall_secs;
+    pthread_mutex_lock(&prof->mutex);
+    wprofile_counters_add(&prof->page,stage,wall_secs,cpu_secs,bytes);
+    wprofile_counters_add(&prof->total,stage,wall_secs,cpu_secs,bytes);
+    pthread_mutex_unlock(&prof->mutex);
+    }
+
+
+static void wprofile_counters_add(WPROFILECOUNTERS *counters,char *name,double wall_secs,
+                                  double cpu_secs,double bytes)
+
+    {
+    WPROFILESTAGE *stage;
+    int i;
+
+    for (i=0;i<counters->n;i++)
+        if (counters->stage[i].name==name || !strcmp(counters->stage[i].name,name))
+            break;
+    if (i>=counters->n)
+        {
+        if (counters->n>=WPROFILE_MAXSTAGES)
+            return;
+        counters->n++;
+        stage=&counters->stage[i];
+        stage->name=name;
+        stage->calls=0;
+        stage->wall_secs=stage->cpu_secs=stage->bytes=0.;
+        }
+    stage=&counters->stage[i];
+    stage->calls++;
+    stage->wall_secs += wall_secs;
+    stage->cpu_secs += cpu_secs;
+    stage->bytes += bytes;
+    }
+
+
+/*
+** Start a new set of page counters.
+*/
+void wprofile_page_reset(void *handle)
+
+    {
+    WPROFILE *prof;
+
+    prof=(WPROFILE *)handle;
+    if (prof==NULL)
+        return;
+    pthread_mutex_lock(&prof->mutex);
+    prof->page.n=0;
+    pthread_mutex_unlock(&prof->mutex);
+    }
+
+
+/*
+** Append the page (page!=0) or total counters as a JSON object, e.g.
+**     {"deskew":{"calls":1,"wall_secs":0.0213,"cpu_secs":0.0211,"bytes":0}, ...}
+*/
+void wprofile_stages_json(STRBUF *json,void *handle,int page)
+
+    {
+    WPROFILE *prof;
+    WPROFILECOUNTERS *counters;
+    int i;
+
+    prof=(WPROFILE *)handle;
+    strbuf_cat_ex(json,"{");
+    if (prof!=NULL)
+        {
+        pthread_mutex_lock(&prof->mutex);
+        counters = page ? &prof->page : &prof->total;
+        for (i=0;i<counters->n;i++)
+            {
+            WPROFILESTAGE *stage;
+
+            stage=&counters->stage[i];
+            strbuf_sprintf_no_space(json,"%s\"%s\":{\"calls\":%d,\"wall_secs\":%.4f,"
+                                         "\"cpu_secs\":%.4f,\"bytes\":%.0f}",
+                                    i>0?",":"",stage->name,stage->calls,stage->wall_secs,
+                                    stage->cpu_secs,stage->bytes);
+            }
+        pthread_mutex_unlock(&prof->mutex);
+        }
+    strbuf_cat_ex(json,"}");
+    }